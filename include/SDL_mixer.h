@@ -266,6 +266,13 @@ typedef enum {
     OPNMIDI_OPN2_EMU_MIME = 0 /*!!!TYPO!!!*/
 } Mix_OPNMIDI_Emulator;
 
+/* Interpolation of the Timidity voices */
+typedef enum {
+    TIMIDITY_INTERP_LINEAR = 0,
+    TIMIDITY_INTERP_CUBIC,
+    TIMIDITY_INTERP_SINC
+} Mix_Timidity_Interpolation;
+
 /* The internal format for a music chunk interpreted via codecs */
 typedef struct _Mix_Music Mix_Music;
 
@@ -299,6 +306,18 @@ extern DECLSPEC int MIXCALL Mix_QuerySpec(int *frequency,Uint16 *format,int *cha
 */
 extern DECLSPEC Mix_Chunk * MIXCALL Mix_LoadWAV_RW(SDL_RWops *src, int freesrc);
 #define Mix_LoadWAV(file)   Mix_LoadWAV_RW(SDL_RWFromFile(file, "rb"), 1)
+
+/*
+    Load a sound like Mix_LoadWAV_RW(), but if keep_compressed is non-zero,
+    the OGG, Opus, FLAC and MP3 data is kept compressed in memory: each
+    channel playing the chunk decodes it while mixing. The decoders are
+    reused by the next plays of the chunk once the channels are done.
+    Other formats are decoded in full as usual.
+    The compressed chunk has no abuf, its alen is the estimated length of the
+    decoded sound. Free it by Mix_FreeChunk() before closing the audio.
+ */
+extern DECLSPEC Mix_Chunk * MIXCALL Mix_LoadWAV_RW_Compressed(SDL_RWops *src, int freesrc, int keep_compressed); /*MIXER-X*/
+#define Mix_LoadWAV_Compressed(file)   Mix_LoadWAV_RW_Compressed(SDL_RWFromFile(file, "rb"), 1, 1) /*MIXER-X*/
 extern DECLSPEC Mix_Music * MIXCALL Mix_LoadMUS(const char *file);
 
 /* Set the displayable filename used in cases of memory-read files */
@@ -1057,6 +1076,44 @@ extern DECLSPEC int MIXCALL Mix_SetMusicTempo(Mix_Music *music, double tempo);
  */
 extern DECLSPEC double MIXCALL Mix_GetMusicTempo(Mix_Music *music);
 
+/* Sample rate conversion quality of music streams */
+typedef enum
+{
+    MIX_RESAMPLE_SDL = 0,   /* Use the resampler of SDL itself (default) */
+    MIX_RESAMPLE_LINEAR,    /* Linear interpolation, fastest */
+    MIX_RESAMPLE_MEDIUM,    /* 16-tap windowed sinc filter */
+    MIX_RESAMPLE_HIGH       /* 32-tap Kaiser-windowed sinc filter with interpolated phases */
+} Mix_ResampleQuality; /*MIXER-X*/
+
+/*
+    Set the sample rate conversion quality (one of Mix_ResampleQuality values)
+    used by all music codecs. Applies to music streams opened after this call.
+    This returns 0 if successful, or -1 if the quality value is invalid.
+ */
+extern DECLSPEC int MIXCALL Mix_SetMusicResampleQuality(int quality); /*MIXER-X*/
+
+/*
+    Get the sample rate conversion quality used by music codecs
+ */
+extern DECLSPEC int MIXCALL Mix_GetMusicResampleQuality(void); /*MIXER-X*/
+
+/*
+    Set the length (in milliseconds) of the decoded PCM kept at the loop start
+    of OGG Vorbis, Opus and FLAC songs with loop tags. When the loop wraps, the
+    cached PCM gets played while a worker thread seeks the decoder past it.
+    One worker serves all songs, it runs while any song with the cache is
+    loaded. If the seek lasts longer than the cached PCM, the playback waits
+    for it. 0 disables the cache (the default). Applies to music loaded after
+    this call.
+    This returns 0 if successful, or -1 if the value is invalid.
+ */
+extern DECLSPEC int MIXCALL Mix_SetMusicLoopCache(int milliseconds); /*MIXER-X*/
+
+/*
+    Get the length (in milliseconds) of the PCM cache at the loop start
+ */
+extern DECLSPEC int MIXCALL Mix_GetMusicLoopCache(void); /*MIXER-X*/
+
 /*
     Get the count of concurrently playing tracks at the song (MIDI, Tracker,.etc.)
  */
@@ -1067,6 +1124,19 @@ extern DECLSPEC int MIXCALL Mix_GetMusicTracks(Mix_Music *music);
  */
 extern DECLSPEC int MIXCALL Mix_SetMusicTrackMute(Mix_Music *music, int track, int mute);
 
+/*
+    Get the count of songs stored in the music file (NSF, GBS, HES, etc.),
+    returns -1 if the music type has no such songs
+ */
+extern DECLSPEC int MIXCALL Mix_GetNumTracks(Mix_Music *music); /*MIXER-X*/
+
+/*
+    Switch to another song of the music file (NSF, GBS, HES, etc.) without
+    reloading it, the song starts from its beginning (from 0 to N-1)
+    returns 0 on success, or -1 on error
+ */
+extern DECLSPEC int MIXCALL Mix_StartTrack(Mix_Music *music, int track); /*MIXER-X*/
+
 /*
     Get the loop start time position of music stream
     returns -1.0 if this feature is not used for this music or not supported for some codec
@@ -1083,6 +1153,69 @@ extern DECLSPEC double MIXCALL Mix_GetMusicLoopEndTime(Mix_Music *music);
  */
 extern DECLSPEC double MIXCALL Mix_GetMusicLoopLengthTime(Mix_Music *music);
 
+/*
+    Build the seek index of MP3 and FLAC music: the frame offset table
+    that makes Mix_SetMusicPosition() fast on files without one.
+    The index is kept with the music object. If music is NULL,
+    the currently playing music is used. The scan runs in the calling
+    thread next to the playback, it doesn't stall the audio output.
+    Returns 0 if successful, or -1 if failed or isn't supported.
+ */
+extern DECLSPEC int MIXCALL Mix_BuildMusicSeekIndex(Mix_Music *music); /*MIXER-X*/
+/*
+    Save the seek index of the music into the cache file (the index gets
+    built if wasn't yet). Returns 0 if successful, or -1 if failed.
+ */
+extern DECLSPEC int MIXCALL Mix_SaveMusicSeekIndex(Mix_Music *music, const char *file); /*MIXER-X*/
+/*
+    Load the seek index saved by Mix_SaveMusicSeekIndex() into the music.
+    Returns 0 if successful, or -1 if the file doesn't match the music.
+ */
+extern DECLSPEC int MIXCALL Mix_LoadMusicSeekIndex(Mix_Music *music, const char *file); /*MIXER-X*/
+
+/*
+    Convert the MIDI, RIFF MIDI, MUS, XMI, GMF, CMF or IMF song into the song
+    cache: the built timeline of the song that gets loaded by Mix_LoadMUS()
+    without the format conversion and the timing calculation. The song cache
+    is playable by FluidSynth (FluidLite) and the Native MIDI on Windows only.
+    Returns 0 if successful, or -1 on error or if these MIDI players aren't built.
+ */
+extern DECLSPEC int MIXCALL Mix_SaveMIDISongCache(const char *file, const char *cache_file); /*MIXER-X*/
+extern DECLSPEC int MIXCALL Mix_SaveMIDISongCache_RW(SDL_RWops *src, int freesrc, SDL_RWops *dst); /*MIXER-X*/
+
+/* Music information returned by Mix_ProbeMusic() */
+typedef struct Mix_MusicInfo
+{
+    Mix_MusicType type;
+    double duration;    /* Seconds, or -1.0 if unknown */
+    double loop_start;  /* Seconds, or -1.0 if the music has no loop */
+    double loop_end;    /* Seconds, or -1.0 if the music has no loop */
+    int channels;       /* 0 for synthesized music (MIDI, trackers, chiptunes) */
+    int rate;           /* 0 for synthesized music (MIDI, trackers, chiptunes) */
+    char title[256];
+    char artist[256];
+    char album[256];
+    char copyright[256];
+} Mix_MusicInfo; /*MIXER-X*/
+
+/*
+    Get the type, duration, loop points, format and tags of the music file
+    without loading it: WAV, AIFF, OGG, Opus, FLAC, MP3 and MIDI files are
+    probed by their headers only. Other formats are loaded in full, this
+    requires the opened audio device.
+    Returns 0 if successful, or -1 on error.
+ */
+extern DECLSPEC int MIXCALL Mix_ProbeMusic(const char *file, Mix_MusicInfo *info); /*MIXER-X*/
+extern DECLSPEC int MIXCALL Mix_ProbeMusic_RW(SDL_RWops *src, int freesrc, Mix_MusicInfo *info); /*MIXER-X*/
+
+/*
+    Probe the list of music files using the given number of threads,
+    or the number of CPU cores if threads is 0.
+    The info of every file that failed to be probed has the MUS_NONE type.
+    Returns the number of successfully probed files, or -1 on error.
+ */
+extern DECLSPEC int MIXCALL Mix_ProbeMusicBatch(const char * const *files, Mix_MusicInfo *infos, int count, int threads); /*MIXER-X*/
+
 
 /* Check the status of a specific channel.
    If the specified channel is -1, check all channels.
@@ -1105,10 +1238,28 @@ extern DECLSPEC const char* MIXCALL Mix_GetSoundFonts(void);
 extern DECLSPEC int MIXCALL Mix_EachSoundFont(int (SDLCALL *function)(const char*, void*), void *data);
 extern DECLSPEC int MIXCALL Mix_EachSoundFontEx(const char* cpaths, int (SDLCALL *function)(const char*, void*), void *data);
 
+/*
+    SoundFonts are loaded by FluidLite once and shared by all songs, unused
+    ones stay in memory for the next songs. This frees the SoundFonts that are
+    not used by any loaded song and returns the number of freed SoundFonts.
+    Returns 0 when built without FluidLite.
+ */
+extern DECLSPEC int MIXCALL Mix_FlushSoundFontCache(void); /*MIXER-X*/
+
 /* Set/Get full path of Timidity config file (e.g. /etc/timidity.cfg) */
 extern DECLSPEC int MIXCALL Mix_SetTimidityCfg(const char *path);
 extern DECLSPEC const char* MIXCALL Mix_GetTimidityCfg(void);
 
+/* Get the interpolation of Timidity voices */
+extern DECLSPEC int  MIXCALL Mix_Timidity_getInterpolation(void); /*MIXER-X*/
+/* Set the interpolation of Timidity voices (Mix_Timidity_Interpolation, Applying on stop/play) */
+extern DECLSPEC void MIXCALL Mix_Timidity_setInterpolation(int interpolation); /*MIXER-X*/
+/* Get the maximum count of voices playing at once in Timidity */
+extern DECLSPEC int  MIXCALL Mix_Timidity_getPolyphony(void); /*MIXER-X*/
+/* Set the maximum count of voices playing at once in Timidity, the quietest
+   released notes get cut first (from 1 to 256, or -1 to restore default, Applying on stop/play) */
+extern DECLSPEC void MIXCALL Mix_Timidity_setPolyphony(int voices); /*MIXER-X*/
+
 /* Get the Mix_Chunk currently associated with a mixer channel
     Returns NULL if it's an invalid channel, or there's no chunk associated.
 */
@@ -1056,6 +1056,35 @@ Return Value
 DRFLAC_API drflac_bool32 drflac_seek_to_pcm_frame(drflac* pFlac, drflac_uint64 pcmFrameIndex);
 
 
+/*
+Replaces the seek table of the stream (SDL Mixer X addition).
+
+
+Parameters
+----------
+pFlac (in)
+    The decoder.
+
+seekpointCount (in)
+    The number of items in pSeekpoints. 0 unbinds the seek table.
+
+pSeekpoints (in)
+    The seek points, sorted by firstPCMFrame. NULL unbinds the seek table.
+
+
+Return Value
+------------
+`DRFLAC_TRUE` if successful; `DRFLAC_FALSE` otherwise.
+
+
+Remarks
+-------
+The memory is owned by the client and must stay valid until it's unbound or the decoder is closed. dr_flac will never
+attempt to free this pointer. The seek table read from the stream is no longer used after this call.
+*/
+DRFLAC_API drflac_bool32 drflac_bind_seek_table(drflac* pFlac, drflac_uint32 seekpointCount, drflac_seekpoint* pSeekpoints);
+
+
 
 #ifndef DR_FLAC_NO_STDIO
 /*
@@ -11538,6 +11567,27 @@ DRFLAC_API drflac_bool32 drflac_seek_to_pcm_frame(drflac* pFlac, drflac_uint64 p
 }
 
 
+/* SDL Mixer X: Replaces the seek table of the stream */
+DRFLAC_API drflac_bool32 drflac_bind_seek_table(drflac* pFlac, drflac_uint32 seekpointCount, drflac_seekpoint* pSeekpoints)
+{
+    if (pFlac == NULL) {
+        return DRFLAC_FALSE;
+    }
+
+    if (seekpointCount == 0 || pSeekpoints == NULL) {
+        /* Unbinding. */
+        pFlac->seekpointCount = 0;
+        pFlac->pSeekpoints = NULL;
+    } else {
+        /* Binding. */
+        pFlac->seekpointCount = seekpointCount;
+        pFlac->pSeekpoints = pSeekpoints;
+    }
+
+    return DRFLAC_TRUE;
+}
+
+
 
 /* High Level APIs */
 
@@ -114,23 +114,8 @@ typedef struct MUSHeader {
 } MUSHeader ;
 #define MUS_HEADERSIZE 14
 
-typedef struct MidiHeaderChunk {
-    char name[4];
-    int32_t length;
-    int16_t format; /* make 0 */
-    int16_t ntracks;/* make 1 */
-    int16_t division; /* 0xe250 ?? */
-} MidiHeaderChunk;
-#define MIDI_HEADERSIZE 14
-
-typedef struct MidiTrackChunk {
-    char name[4];
-    int32_t length;
-} MidiTrackChunk;
-#define TRK_CHUNKSIZE 8
-
 struct mus_ctx {
-    uint8_t *src, *src_ptr;
+    const uint8_t *src, *src_ptr;
     uint32_t srcsize;
     uint32_t datastart;
     uint8_t *dst, *dst_ptr;
@@ -163,37 +148,6 @@ static void mus2mid_write2(struct mus_ctx *ctx, uint32_t val)
     ctx->dstrem -= 2;
 }
 
-static void mus2mid_write4(struct mus_ctx *ctx, uint32_t val)
-{
-    if (ctx->dstrem < 4)
-        mus2mid_resize_dst(ctx);
-    *ctx->dst_ptr++ = (uint8_t)((val>>24)&0xff);
-    *ctx->dst_ptr++ = (uint8_t)((val>>16)&0xff);
-    *ctx->dst_ptr++ = (uint8_t)((val>>8) & 0xff);
-    *ctx->dst_ptr++ = (uint8_t)((val & 0xff));
-    ctx->dstrem -= 4;
-}
-
-static void mus2mid_seekdst(struct mus_ctx *ctx, uint32_t pos) {
-    ctx->dst_ptr = ctx->dst + pos;
-    while (ctx->dstsize < pos)
-        mus2mid_resize_dst(ctx);
-    ctx->dstrem = ctx->dstsize - pos;
-}
-
-static void mus2mid_skipdst(struct mus_ctx *ctx, int32_t pos) {
-    size_t newpos;
-    ctx->dst_ptr += pos;
-    newpos = ctx->dst_ptr - ctx->dst;
-    while (ctx->dstsize < newpos)
-        mus2mid_resize_dst(ctx);
-    ctx->dstrem = (uint32_t)(ctx->dstsize - newpos);
-}
-
-static uint32_t mus2mid_getdstpos(struct mus_ctx *ctx) {
-    return (uint32_t)(ctx->dst_ptr - ctx->dst);
-}
-
 /* writes a variable length integer to a buffer, and returns bytes written */
 static int32_t mus2mid_writevarlen(int32_t value, uint8_t *out)
 {
@@ -218,17 +172,29 @@ static int32_t mus2mid_writevarlen(int32_t value, uint8_t *out)
     return (count);
 }
 
+/* Score bytes are read in place: the end of the source data reads as zeros */
+static uint8_t mus2mid_peek(const uint8_t *cur, const uint8_t *limit)
+{
+    return (cur < limit) ? *cur : 0;
+}
+
+static uint8_t mus2mid_read(const uint8_t **cur, const uint8_t *limit)
+{
+    return (*cur < limit) ? *(*cur)++ : 0;
+}
+
 #define MUS_READ_INT16(b) ((b)[0] | ((b)[1] << 8))
 #define MUS_READ_INT32(b) ((b)[0] | ((b)[1] << 8) | ((b)[2] << 16) | ((b)[3] << 24))
 
-static int Convert_mus2midi(uint8_t *in, uint32_t insize,
-                            uint8_t **out, uint32_t *outsize,
-                            uint16_t frequency)
+/* Converts MUS into the body of a single MTrk chunk, without the SMF header
+ * and the chunk header: the track is timed by MUS_DIVISION */
+static int Convert_mus2midi_track(const uint8_t *in, uint32_t insize,
+                                  uint8_t **out, uint32_t *outsize,
+                                  uint16_t frequency)
 {
     struct mus_ctx ctx;
     MUSHeader header;
-    uint8_t *cur, *end;
-    uint32_t track_size_pos, begin_track_pos, current_pos;
+    const uint8_t *cur, *end, *limit = in + insize;
     int32_t delta_time;/* Delta time for midi event */
     int temp, ret = -1;
     int channel_volume[MUS_MIDI_MAXCHANNELS];
@@ -280,24 +246,8 @@ static int Convert_mus2midi(uint8_t *in, uint32_t insize,
     }
     channelMap[15] = 9;
 
-    /* Header is 14 bytes long and add the rest as well */
-    mus2mid_write1(&ctx, 'M');
-    mus2mid_write1(&ctx, 'T');
-    mus2mid_write1(&ctx, 'h');
-    mus2mid_write1(&ctx, 'd');
-    mus2mid_write4(&ctx, 6);    /* length of header */
-    mus2mid_write2(&ctx, 0);    /* MIDI type (always 0) */
-    mus2mid_write2(&ctx, 1);    /* MUS files only have 1 track */
-    mus2mid_write2(&ctx, MUS_DIVISION); /* division */
-
-    /* Write out track header and track length position for later */
-    begin_track_pos = mus2mid_getdstpos(&ctx);
-    mus2mid_write1(&ctx, 'M');
-    mus2mid_write1(&ctx, 'T');
-    mus2mid_write1(&ctx, 'r');
-    mus2mid_write1(&ctx, 'k');
-    track_size_pos = mus2mid_getdstpos(&ctx);
-    mus2mid_skipdst(&ctx, 4);
+    if (!ctx.dst)
+        return (-1);
 
     /* write tempo: microseconds per quarter note */
     mus2mid_write1(&ctx, 0x00); /* delta time */
@@ -330,7 +280,7 @@ static int Convert_mus2midi(uint8_t *in, uint32_t insize,
         uint8_t status, bit1, bit2, bitc = 2;
 
         /* read in current bit */
-        event = *cur++;
+        event = mus2mid_read(&cur, limit);
         channel = (event & 15);     /* current channel */
 
         /* write variable length delta time */
@@ -352,47 +302,47 @@ static int Convert_mus2midi(uint8_t *in, uint32_t insize,
         switch ((event & 122) >> 4){
             case MUSEVENT_KEYOFF:
                 status |=  0x80;
-                bit1 = *cur++;
+                bit1 = mus2mid_read(&cur, limit);
                 bit2 = 0x40;
                 break;
             case MUSEVENT_KEYON:
                 status |= 0x90;
-                bit1 = *cur & 127;
-                if (*cur++ & 128)   /* volume bit? */
-                    channel_volume[channelMap[channel]] = *cur++;
+                bit1 = mus2mid_peek(cur, limit) & 127;
+                if (mus2mid_read(&cur, limit) & 128)   /* volume bit? */
+                    channel_volume[channelMap[channel]] = mus2mid_read(&cur, limit);
                 bit2 = channel_volume[channelMap[channel]];
                 break;
             case MUSEVENT_PITCHWHEEL:
                 status |= 0xE0;
-                bit1 = (*cur & 1) >> 6;
-                bit2 = (*cur++ >> 1) & 127;
+                bit1 = (mus2mid_peek(cur, limit) & 1) >> 6;
+                bit2 = (mus2mid_read(&cur, limit) >> 1) & 127;
                 break;
             case MUSEVENT_CHANNELMODE:
                 status |= 0xB0;
-                if (*cur >= sizeof(mus_midimap) / sizeof(mus_midimap[0])) {
+                if (mus2mid_peek(cur, limit) >= sizeof(mus_midimap) / sizeof(mus_midimap[0])) {
                     /*_WM_ERROR_NEW("%s:%i: can't map %u to midi",
                                   __FUNCTION__, __LINE__, *cur);*/
                     goto _end;
                 }
-                bit1 = mus_midimap[*cur++];
-                bit2 = (*cur++ == 12) ? header.channels + 1 : 0x00;
+                bit1 = mus_midimap[mus2mid_read(&cur, limit)];
+                bit2 = (mus2mid_read(&cur, limit) == 12) ? header.channels + 1 : 0x00;
                 break;
             case MUSEVENT_CONTROLLERCHANGE:
-                if (*cur == 0) {
-                    cur++;
+                if (mus2mid_peek(cur, limit) == 0) {
+                    mus2mid_read(&cur, limit);
                     status |= 0xC0;
-                    bit1 = *cur++;
+                    bit1 = mus2mid_read(&cur, limit);
                     bit2 = 0;/* silence bogus warnings */
                     bitc = 1;
                 } else {
                     status |= 0xB0;
-                    if (*cur >= sizeof(mus_midimap) / sizeof(mus_midimap[0])) {
+                    if (mus2mid_peek(cur, limit) >= sizeof(mus_midimap) / sizeof(mus_midimap[0])) {
                         /*_WM_ERROR_NEW("%s:%i: can't map %u to midi",
                                       __FUNCTION__, __LINE__, *cur);*/
                         goto _end;
                     }
-                    bit1 = mus_midimap[*cur++];
-                    bit2 = *cur++;
+                    bit1 = mus_midimap[mus2mid_read(&cur, limit)];
+                    bit2 = mus2mid_read(&cur, limit);
                 }
                 break;
             case MUSEVENT_END:  /* End */
@@ -432,19 +382,13 @@ static int Convert_mus2midi(uint8_t *in, uint32_t insize,
         if (event & 128) {
             delta_time = 0;
             do {
-                delta_time = (int32_t)((delta_time * 128 + (*cur & 127)) * (140.0 / (double)frequency));
-            } while ((*cur++ & 128));
+                delta_time = (int32_t)((delta_time * 128 + (mus2mid_peek(cur, limit) & 127)) * (140.0 / (double)frequency));
+            } while ((mus2mid_read(&cur, limit) & 128));
         } else {
             delta_time = 0;
         }
     }
 
-    /* write out track length */
-    current_pos = mus2mid_getdstpos(&ctx);
-    mus2mid_seekdst(&ctx, track_size_pos);
-    mus2mid_write4(&ctx, current_pos - begin_track_pos - TRK_CHUNKSIZE);
-    mus2mid_seekdst(&ctx, current_pos); /* reseek to end position */
-
     *out = ctx.dst;
     *outsize = ctx.dstsize - ctx.dstrem;
     ret = 0;
@@ -28,8 +28,6 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
-#include <stdint.h>
-#include <assert.h>
 
 #ifdef __DJGPP__
 typedef signed char     int8_t;
@@ -91,7 +89,8 @@ typedef struct {
 } midi_descriptor;
 
 struct xmi2mid_xmi_ctx {
-    uint8_t *src, *src_ptr, *src_end;
+    const uint8_t *src;
+    uint32_t src_pos;
     uint32_t srcsize;
     uint32_t datastart;
     uint8_t *dst, *dst_ptr;
@@ -111,6 +110,16 @@ typedef struct {
     uint32_t offset[128];
 } xmi2mid_rbrn;
 
+/* Converted tracks: the events of every track as in a MTrk chunk body,
+ * stored back to back without the SMF header and the chunk headers */
+typedef struct {
+    uint8_t *data;
+    uint32_t *offsets; /* Begin of every track in the data, and the end of the last one */
+    uint32_t count;
+    uint16_t type;
+    uint16_t division;
+} xmi2mid_tracks;
+
 /* forward declarations of private functions */
 static void xmi2mid_DeleteEventList(midi_event *mlist);
 static void xmi2mid_CreateNewEvent(struct xmi2mid_xmi_ctx *ctx, int32_t time); /* List manipulation */
@@ -122,55 +131,60 @@ static int xmi2mid_ConvertEvent(struct xmi2mid_xmi_ctx *ctx,
 static int32_t xmi2mid_ConvertSystemMessage(struct xmi2mid_xmi_ctx *ctx,
                 const int32_t time, const uint8_t status);
 static int32_t xmi2mid_ConvertFiletoList(struct xmi2mid_xmi_ctx *ctx, const xmi2mid_rbrn *rbrn);
-static uint32_t xmi2mid_ConvertListToMTrk(struct xmi2mid_xmi_ctx *ctx, midi_event *mlist);
+static uint32_t xmi2mid_ConvertListToTrack(struct xmi2mid_xmi_ctx *ctx, midi_event *mlist);
 static int xmi2mid_ParseXMI(struct xmi2mid_xmi_ctx *ctx);
 static int xmi2mid_ExtractTracks(struct xmi2mid_xmi_ctx *ctx);
 static uint32_t xmi2mid_ExtractTracksFromXmi(struct xmi2mid_xmi_ctx *ctx);
 
+/* The source is read in place: bytes past its end are read as zeros */
 static uint32_t xmi2mid_read1(struct xmi2mid_xmi_ctx *ctx)
 {
-    uint8_t b0;
-    assert(ctx->src_ptr + 1 < ctx->src_end);
-    b0 = *ctx->src_ptr++;
+    uint8_t b0 = 0;
+    if (ctx->src_pos < ctx->srcsize)
+        b0 = ctx->src[ctx->src_pos];
+    ctx->src_pos++;
     return (b0);
 }
 
 static uint32_t xmi2mid_read2(struct xmi2mid_xmi_ctx *ctx)
 {
     uint8_t b0, b1;
-    assert(ctx->src_ptr + 2 < ctx->src_end);
-    b0 = *ctx->src_ptr++;
-    b1 = *ctx->src_ptr++;
+    b0 = (uint8_t)xmi2mid_read1(ctx);
+    b1 = (uint8_t)xmi2mid_read1(ctx);
     return (b0 + ((uint32_t)b1 << 8));
 }
 
 static uint32_t xmi2mid_read4(struct xmi2mid_xmi_ctx *ctx)
 {
     uint8_t b0, b1, b2, b3;
-    assert(ctx->src_ptr + 4 < ctx->src_end);
-    b3 = *ctx->src_ptr++;
-    b2 = *ctx->src_ptr++;
-    b1 = *ctx->src_ptr++;
-    b0 = *ctx->src_ptr++;
+    b3 = (uint8_t)xmi2mid_read1(ctx);
+    b2 = (uint8_t)xmi2mid_read1(ctx);
+    b1 = (uint8_t)xmi2mid_read1(ctx);
+    b0 = (uint8_t)xmi2mid_read1(ctx);
     return (b0 + ((uint32_t)b1<<8) + ((uint32_t)b2<<16) + ((uint32_t)b3<<24));
 }
 
 static uint32_t xmi2mid_read4le(struct xmi2mid_xmi_ctx *ctx)
 {
     uint8_t b0, b1, b2, b3;
-    assert(ctx->src_ptr + 4 < ctx->src_end);
-    b3 = *ctx->src_ptr++;
-    b2 = *ctx->src_ptr++;
-    b1 = *ctx->src_ptr++;
-    b0 = *ctx->src_ptr++;
+    b3 = (uint8_t)xmi2mid_read1(ctx);
+    b2 = (uint8_t)xmi2mid_read1(ctx);
+    b1 = (uint8_t)xmi2mid_read1(ctx);
+    b0 = (uint8_t)xmi2mid_read1(ctx);
     return (b3 + ((uint32_t)b2<<8) + ((uint32_t)b1<<16) + ((uint32_t)b0<<24));
 }
 
 static void xmi2mid_copy(struct xmi2mid_xmi_ctx *ctx, char *b, uint32_t len)
 {
-    assert(ctx->src_ptr + len < ctx->src_end);
-    memcpy(b, ctx->src_ptr, len);
-    ctx->src_ptr += len;
+    uint32_t avail = 0;
+    if (ctx->src_pos < ctx->srcsize)
+        avail = ctx->srcsize - ctx->src_pos;
+    if (avail > len)
+        avail = len;
+    if (avail)
+        memcpy(b, ctx->src + ctx->src_pos, avail);
+    memset(b + avail, 0, len - avail);
+    ctx->src_pos += len;
 }
 
 #define DST_CHUNK 8192
@@ -190,48 +204,12 @@ static void xmi2mid_write1(struct xmi2mid_xmi_ctx *ctx, uint32_t val)
     ctx->dstrem--;
 }
 
-static void xmi2mid_write2(struct xmi2mid_xmi_ctx *ctx, uint32_t val)
-{
-    if (ctx->dstrem < 2)
-        xmi2mid_resize_dst(ctx);
-    *ctx->dst_ptr++ = (val>>8) & 0xff;
-    *ctx->dst_ptr++ = val & 0xff;
-    ctx->dstrem -= 2;
-}
-
-static void xmi2mid_write4(struct xmi2mid_xmi_ctx *ctx, uint32_t val)
-{
-    if (ctx->dstrem < 4)
-        xmi2mid_resize_dst(ctx);
-    *ctx->dst_ptr++ = (val>>24)&0xff;
-    *ctx->dst_ptr++ = (val>>16)&0xff;
-    *ctx->dst_ptr++ = (val>>8) & 0xff;
-    *ctx->dst_ptr++ = val & 0xff;
-    ctx->dstrem -= 4;
-}
-
 static void xmi2mid_seeksrc(struct xmi2mid_xmi_ctx *ctx, uint32_t pos) {
-    ctx->src_ptr = ctx->src + pos;
-}
-
-static void xmi2mid_seekdst(struct xmi2mid_xmi_ctx *ctx, uint32_t pos) {
-    ctx->dst_ptr = ctx->dst + pos;
-    while (ctx->dstsize < pos)
-        xmi2mid_resize_dst(ctx);
-    ctx->dstrem = ctx->dstsize - pos;
+    ctx->src_pos = pos;
 }
 
 static void xmi2mid_skipsrc(struct xmi2mid_xmi_ctx *ctx, int32_t pos) {
-    ctx->src_ptr += pos;
-}
-
-static void xmi2mid_skipdst(struct xmi2mid_xmi_ctx *ctx, int32_t pos) {
-    size_t newpos;
-    ctx->dst_ptr += pos;
-    newpos = ctx->dst_ptr - ctx->dst;
-    while (ctx->dstsize < newpos)
-        xmi2mid_resize_dst(ctx);
-    ctx->dstrem = (uint32_t)(ctx->dstsize - newpos);
+    ctx->src_pos += pos;
 }
 
 static uint32_t xmi2mid_getsrcsize(struct xmi2mid_xmi_ctx *ctx) {
@@ -239,7 +217,7 @@ static uint32_t xmi2mid_getsrcsize(struct xmi2mid_xmi_ctx *ctx) {
 }
 
 static uint32_t xmi2mid_getsrcpos(struct xmi2mid_xmi_ctx *ctx) {
-    return (uint32_t)(ctx->src_ptr - ctx->src);
+    return (ctx->src_pos);
 }
 
 static uint32_t xmi2mid_getdstpos(struct xmi2mid_xmi_ctx *ctx) {
@@ -515,9 +493,9 @@ static const char xmi2mid_mt32asgs[256] = {
     121, 0  /* 127 Jungle Tune set to Breath Noise */
 };
 
-static int Convert_xmi2midi(uint8_t *in, uint32_t insize,
-                            uint8_t **out, uint32_t *outsize,
-                            uint32_t convert_type)
+static int Convert_xmi2midi_tracks(const uint8_t *in, uint32_t insize,
+                                   xmi2mid_tracks *out,
+                                   uint32_t convert_type)
 {
     struct xmi2mid_xmi_ctx ctx;
     unsigned int i;
@@ -529,9 +507,9 @@ static int Convert_xmi2midi(uint8_t *in, uint32_t insize,
     }
 
     memset(&ctx, 0, sizeof(struct xmi2mid_xmi_ctx));
-    ctx.src = ctx.src_ptr = in;
+    memset(out, 0, sizeof(xmi2mid_tracks));
+    ctx.src = in;
     ctx.srcsize = insize;
-    ctx.src_end = ctx.src + insize;
     ctx.convert_type = convert_type;
 
     if (xmi2mid_ParseXMI(&ctx) < 0) {
@@ -549,29 +527,27 @@ static int Convert_xmi2midi(uint8_t *in, uint32_t insize,
     ctx.dstsize = DST_CHUNK;
     ctx.dstrem = DST_CHUNK;
 
-    /* Header is 14 bytes long and add the rest as well */
-    xmi2mid_write1(&ctx, 'M');
-    xmi2mid_write1(&ctx, 'T');
-    xmi2mid_write1(&ctx, 'h');
-    xmi2mid_write1(&ctx, 'd');
-
-    xmi2mid_write4(&ctx, 6);
+    out->offsets = (uint32_t *)calloc(ctx.info.tracks + 1, sizeof(uint32_t));
+    if (!ctx.dst || !out->offsets)
+        goto _end;
 
-    xmi2mid_write2(&ctx, ctx.info.type);
-    xmi2mid_write2(&ctx, ctx.info.tracks);
-    xmi2mid_write2(&ctx, ctx.timing[0]);/* write divisions from track0 */
+    for (i = 0; i < ctx.info.tracks; i++) {
+        out->offsets[i] = xmi2mid_getdstpos(&ctx);
+        xmi2mid_ConvertListToTrack(&ctx, ctx.events[i]);
+    }
+    out->offsets[ctx.info.tracks] = xmi2mid_getdstpos(&ctx);
 
-    for (i = 0; i < ctx.info.tracks; i++)
-        xmi2mid_ConvertListToMTrk(&ctx, ctx.events[i]);
-    *out = ctx.dst;
-    *outsize = ctx.dstsize - ctx.dstrem;
+    out->data = ctx.dst;
+    out->count = ctx.info.tracks;
+    out->type = ctx.info.type;
+    out->division = (uint16_t)ctx.timing[0];/* divisions from track0 */
     ret = 0;
 
 _end:   /* cleanup */
     if (ret < 0) {
         free(ctx.dst);
-        *out = NULL;
-        *outsize = 0;
+        free(out->offsets);
+        memset(out, 0, sizeof(xmi2mid_tracks));
     }
     if (ctx.events) {
         for (i = 0; i < ctx.info.tracks; i++)
@@ -639,7 +615,7 @@ static int xmi2mid_GetVLQ(struct xmi2mid_xmi_ctx *ctx, uint32_t *quant) {
 
     *quant = 0;
     for (i = 0; i < 4; i++) {
-        if(ctx->src_ptr + 1 >= ctx->src + ctx->srcsize)
+        if (ctx->src_pos >= ctx->srcsize)
             break;
         data = xmi2mid_read1(ctx);
         *quant <<= 7;
@@ -659,7 +635,7 @@ static int xmi2mid_GetVLQ2(struct xmi2mid_xmi_ctx *ctx, uint32_t *quant) {
     int32_t data;
 
     *quant = 0;
-    for (i = 0; xmi2mid_getsrcpos(ctx) != xmi2mid_getsrcsize(ctx); ++i) {
+    for (i = 0; xmi2mid_getsrcpos(ctx) < xmi2mid_getsrcsize(ctx); ++i) {
         data = xmi2mid_read1(ctx);
         if (data & 0x80) {
             xmi2mid_skipsrc(ctx, -1);
@@ -925,27 +901,17 @@ static int32_t xmi2mid_ConvertFiletoList(struct xmi2mid_xmi_ctx *ctx, const xmi2
     return ((tempo * 3) / 25000);
 }
 
-/* Converts and event list to a MTrk
- * Returns bytes of the array
- * buf can be NULL */
-static uint32_t xmi2mid_ConvertListToMTrk(struct xmi2mid_xmi_ctx *ctx, midi_event *mlist) {
+/* Converts and event list to the body of a MTrk chunk
+ * Returns bytes of the array */
+static uint32_t xmi2mid_ConvertListToTrack(struct xmi2mid_xmi_ctx *ctx, midi_event *mlist) {
     int32_t time = 0;
     midi_event *event;
     uint32_t delta;
     uint8_t last_status = 0;
-    uint32_t i = 8;
+    uint32_t i = 0;
     uint32_t j;
-    uint32_t size_pos, cur_pos;
     int end = 0;
 
-    xmi2mid_write1(ctx, 'M');
-    xmi2mid_write1(ctx, 'T');
-    xmi2mid_write1(ctx, 'r');
-    xmi2mid_write1(ctx, 'k');
-
-    size_pos = xmi2mid_getdstpos(ctx);
-    xmi2mid_skipdst(ctx, 4);
-
     for (event = mlist; event && !end; event = event->next) {
         delta = (event->time - time);
         time = event->time;
@@ -1005,11 +971,6 @@ static uint32_t xmi2mid_ConvertListToMTrk(struct xmi2mid_xmi_ctx *ctx, midi_even
         }
     }
 
-    cur_pos = xmi2mid_getdstpos(ctx);
-    xmi2mid_seekdst(ctx, size_pos);
-    xmi2mid_write4(ctx, i - 8);
-    xmi2mid_seekdst(ctx, cur_pos);
-
     return (i);
 }
 
@@ -1091,6 +1052,8 @@ static uint32_t xmi2mid_ExtractTracksFromXmi(struct xmi2mid_xmi_ctx *ctx) {
         /* Convert it */
         if (!(ppqn = xmi2mid_ConvertFiletoList(ctx, &rbrn))) {
             /*_WM_GLOBAL_ERROR(__FUNCTION__, __LINE__, WM_ERR_CORUPT, NULL, 0);*/
+            xmi2mid_DeleteEventList(ctx->list);
+            ctx->list = NULL;
             break;
         }
         ctx->timing[num] = ppqn;
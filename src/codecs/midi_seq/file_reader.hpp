@@ -271,6 +271,15 @@ public:
             return m_mp_tell >= m_mp_size;
     }
 
+    /**
+     * @brief Get the opened memory block
+     * @return Pointer to the memory block, or NULL if a file from a disk is opened
+     */
+    const void *memoryData() const
+    {
+        return m_mp;
+    }
+
     /**
      * @brief Get a current file name
      * @return File name of currently loaded file
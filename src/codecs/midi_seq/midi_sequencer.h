@@ -73,6 +73,52 @@ typedef size_t (*RtCurrentDevice)(void *userdata, size_t track);
 /*! [Non-Standard] Pass raw OPL3 data to the chip (when playing IMF files) */
 typedef void (*RtRawOPL)(void *userdata, uint8_t reg, uint8_t value);
 
+/*! Types of events passed into the block render hook */
+enum BW_MidiTimedEventType
+{
+    /*! Note-On: data[0] is a note, data[1] is a velocity */
+    BW_MIDI_TIMED_NOTE_ON = 0,
+    /*! Note-Off: data[0] is a note, data[1] is a velocity */
+    BW_MIDI_TIMED_NOTE_OFF,
+    /*! Note aftertouch: data[0] is a note, data[1] is a value */
+    BW_MIDI_TIMED_NOTE_AFTERTOUCH,
+    /*! Channel aftertouch: data[0] is a value */
+    BW_MIDI_TIMED_CHANNEL_AFTERTOUCH,
+    /*! Controller change: data[0] is a controller, data[1] is a value */
+    BW_MIDI_TIMED_CONTROLLER,
+    /*! Patch change: data[0] is a patch */
+    BW_MIDI_TIMED_PATCH,
+    /*! Pitch bend: data[0] is MSB, data[1] is LSB */
+    BW_MIDI_TIMED_PITCH_BEND,
+    /*! System Exclusive message: sysex and sysex_size are the message */
+    BW_MIDI_TIMED_SYSEX,
+    /*! [Non-Standard] Raw OPL3 data: data[0] is a register, data[1] is a value */
+    BW_MIDI_TIMED_RAW_OPL
+};
+
+/**
+  \brief MIDI event to apply at the given frame of the render block
+ */
+typedef struct BW_MidiTimedEvent
+{
+    /*! Offset from the block begin in frames, can be equal to the block length */
+    uint32_t frame;
+    /*! Type of the event, one of BW_MidiTimedEventType */
+    uint8_t type;
+    /*! Targeted MIDI channel */
+    uint8_t channel;
+    /*! Data bytes of the event */
+    uint8_t data[2];
+    /*! System Exclusive message, valid until the hook returns */
+    const uint8_t *sysex;
+    /*! Size of the System Exclusive message in bytes */
+    size_t sysex_size;
+} BW_MidiTimedEvent;
+
+/*! PCM render of the whole block with events sorted by their frame */
+typedef void (*PcmRenderBlock)(void *userdata, uint8_t *stream, size_t length,
+                               const BW_MidiTimedEvent *events, size_t eventsCount);
+
 /**
   \brief Real-Time MIDI interface between Sequencer and the Synthesizer
  */
@@ -94,6 +140,13 @@ typedef struct BW_MidiRtInterface
     /*! Size of one sample in bytes */
     uint32_t pcmFrameSize;
 
+    /*! [Optional] PCM render hook of the whole block. When set, it's used instead of
+        On-PCM-render hook, and the block events are passed into it instead of MIDI
+        Real-Time calls while playing the stream */
+    PcmRenderBlock onPcmRenderBlock;
+    /*! User data which will be passed through On-PCM-render-block hook */
+    void           *onPcmRenderBlock_userData;
+
     /*! Debug message hook */
     DebugMessageHook onDebugMessage;
     /*! User data which will be passed through Debug Message hook */
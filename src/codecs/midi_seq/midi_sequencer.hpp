@@ -26,7 +26,6 @@
 #ifndef BW_MIDI_SEQUENCER_HHHHPPP
 #define BW_MIDI_SEQUENCER_HHHHPPP
 
-#include <list>
 #include <vector>
 
 #include "fraction.hpp"
@@ -137,20 +136,27 @@ class BW_MidiSequencer
             // Built-in hooks
             ST_SONG_BEGIN_HOOK    = 0x101
         };
+        enum
+        {
+            //! Maximum size of data stored inside of the event record
+            INLINE_DATA_SIZE = 10
+        };
+        //! Absolute tick position (Used for the tempo calculation only)
+        uint64_t absPosition;
+        //! Size of the event data in bytes
+        uint32_t dataSize;
+        //! Offset of the data in the data bank (when data size is bigger than INLINE_DATA_SIZE)
+        uint32_t dataLoc;
         //! Main type of event
-        uint_fast16_t type;
+        uint16_t type;
         //! Sub-type of the event
-        uint_fast16_t subtype;
+        uint16_t subtype;
         //! Targeted MIDI channel
-        uint_fast16_t channel;
+        uint8_t channel;
         //! Is valid event
-        uint_fast16_t isValid;
-        //! Reserved 5 bytes padding
-        uint_fast16_t __padding[4];
-        //! Absolute tick position (Used for the tempo calculation only)
-        uint64_t absPosition;
-        //! Raw data of this event
-        std::vector<uint8_t> data;
+        uint8_t isValid;
+        //! Short data of this event (Note, controller, tempo, etc. events)
+        uint8_t data[INLINE_DATA_SIZE];
     };
 
     /**
@@ -173,13 +179,16 @@ class BW_MidiSequencer
         uint64_t absPos;
         //! Delay to next event in seconds
         double timeDelay;
-        //! List of MIDI events in the current row
-        std::vector<MidiEvent> events;
+        //! Index of the first event of the row in the events bank
+        size_t eventsBegin;
+        //! Index after the last event of the row in the events bank
+        size_t eventsEnd;
         /**
          * @brief Sort events in this position
+         * @param eventsBank Events bank that contains events of this row
          * @param noteStates Buffer of currently pressed/released note keys in the track
          */
-        void sortEvents(bool *noteStates = NULL);
+        void sortEvents(std::vector<MidiEvent> &eventsBank, bool *noteStates = NULL);
     };
 
     /**
@@ -192,7 +201,29 @@ class BW_MidiSequencer
     };
     //P.S. I declared it here instead of local in-function because C++98 can't process templates with locally-declared structures
 
-    typedef std::list<MidiTrackRow> MidiTrackQueue;
+    typedef std::vector<MidiTrackRow> MidiTrackQueue;
+
+    /**
+     * @brief Reference to the track row in the merged playing schedule
+     */
+    struct ScheduledRow
+    {
+        //! Index of the track
+        uint32_t track;
+        //! Index of the row in the track
+        uint32_t row;
+    };
+
+    /**
+     * @brief Raw events data of one track, the body of the MTrk chunk
+     */
+    struct RawTrackData
+    {
+        //! First byte of the track data
+        const uint8_t *begin;
+        //! End of the track data
+        const uint8_t *end;
+    };
 
     /**
      * @brief Song position context
@@ -207,25 +238,9 @@ class BW_MidiSequencer
         double wait;
         //! Absolute time position on the track in seconds
         double absTimePosition;
-        //! Track information
-        struct TrackInfo
-        {
-            //! Delay to next event in a track
-            uint64_t delay;
-            //! Last handled event type
-            int32_t lastHandledEvent;
-            //! Reserved
-            char    __padding2[4];
-            //! MIDI Events queue position iterator
-            MidiTrackQueue::iterator pos;
-
-            TrackInfo() :
-                delay(0),
-                lastHandledEvent(0)
-            {}
-        };
-        std::vector<TrackInfo> track;
-        Position(): began(false), wait(0.0), absTimePosition(0.0), track()
+        //! Index of the next row to handle in the playing schedule
+        size_t schedulePos;
+        Position(): began(false), wait(0.0), absTimePosition(0.0), schedulePos(0)
         {}
     };
 
@@ -244,6 +259,25 @@ class BW_MidiSequencer
      */
     bool buildSmfTrackData(const std::vector<std::vector<uint8_t> > &trackData);
 
+    /**
+     * @brief Build MIDI track data from the raw track data placed elsewhere
+     * @param trackData Ranges of the raw data of every track
+     * @return true if everything successfully processed, or false on any error
+     */
+    bool buildSmfTrackData(const std::vector<RawTrackData> &trackData);
+
+    /**
+     * @brief Build MIDI track data of the song converted from another format
+     * @param fr Context of the source file (used for error messages)
+     * @param trackData Ranges of the raw data of every track
+     * @param smfFormat SMF format of converted tracks
+     * @param deltaTicks Ticks per quarter note
+     * @return true if everything successfully processed, or false on any error
+     */
+    bool buildConvertedTrackData(FileAndMemReader &fr,
+                                 const std::vector<RawTrackData> &trackData,
+                                 unsigned smfFormat, size_t deltaTicks);
+
     /**
      * @brief Build the time line from off loaded events
      * @param tempos Pre-collected list of tempo events
@@ -254,6 +288,11 @@ class BW_MidiSequencer
                        uint64_t loopStartTicks = 0,
                        uint64_t loopEndTicks = 0);
 
+    /**
+     * @brief Merge rows of all tracks into the single playing schedule
+     */
+    void buildSchedule();
+
     /**
      * @brief Parse one event from raw MIDI track stream
      * @param [_inout] ptr pointer to pointer to current position on the raw data track
@@ -263,6 +302,29 @@ class BW_MidiSequencer
      */
     MidiEvent parseEvent(const uint8_t **ptr, const uint8_t *end, int &status);
 
+    /**
+     * @brief Store the data of event: in the event itself when it's short, or in the data bank
+     * @param evt Event to store data of
+     * @param data Source data, or NULL to just allocate the space
+     * @param size Size of the data in bytes
+     * @return Pointer to stored data, valid until the next data bank change
+     */
+    uint8_t *setEventData(MidiEvent &evt, const uint8_t *data, size_t size);
+
+    /**
+     * @brief Get the data of event
+     * @param evt Event entry
+     * @return Pointer to event data (has evt.dataSize bytes)
+     */
+    const uint8_t *getEventData(const MidiEvent &evt) const;
+
+    /**
+     * @brief Append the event to the row which is being built
+     * @param row Row, events of which are stored at the end of the events bank
+     * @param evt Event to add
+     */
+    void addRowEvent(MidiTrackRow &row, const MidiEvent &evt);
+
     /**
      * @brief Process MIDI events on the current tick moment
      * @param isSeek is a seeking process
@@ -361,6 +423,12 @@ private:
 
     //! Pre-processed track data storage
     std::vector<MidiTrackQueue > m_trackData;
+    //! Rows of all tracks in the playing order
+    std::vector<ScheduledRow> m_schedule;
+    //! Events of all tracks, rows are referring their ranges
+    std::vector<MidiEvent> m_eventsBank;
+    //! Data of events which don't fit into the event record (SysEx, meta-events, etc.)
+    std::vector<uint8_t> m_dataBank;
 
     //! CMF instruments
     std::vector<CmfInstrument> m_cmfInstruments;
@@ -559,6 +627,195 @@ private:
         }
     } m_time;
 
+    /**
+     * @brief State of one MIDI channel collected for the seek checkpoint
+     */
+    struct SeekChannelState
+    {
+        enum
+        {
+            //! Count of tracked registered parameters (pitch bend sensitivity, tuning, etc.)
+            RPN_COUNT = 6
+        };
+
+        enum Flags
+        {
+            //! Patch change was sent
+            F_PATCH         = 0x01,
+            //! Pitch bend was sent
+            F_BEND          = 0x02,
+            //! Channel after-touch was sent
+            F_AFTERTOUCH    = 0x04,
+            //! "Reset all controllers" was sent
+            F_RESET         = 0x08,
+            //! Last selected parameter is non-registered
+            F_NRPN          = 0x10,
+            //! Patch was selected with bank MSB set
+            F_PATCH_MSB     = 0x20,
+            //! Patch was selected with bank LSB set
+            F_PATCH_LSB     = 0x40,
+            //! MSB of the parameter selection was sent
+            F_PARAM_MSB     = 0x80,
+            //! LSB of the parameter selection was sent
+            F_PARAM_LSB     = 0x100
+        };
+
+        //! Controller values
+        uint8_t controllers[128];
+        //! Bit flags of controllers have been set
+        uint8_t controllersSet[16];
+        //! Values of registered parameters [MSB, LSB]
+        uint8_t rpnData[RPN_COUNT][2];
+        //! Set parts of registered parameters (1 - MSB, 2 - LSB)
+        uint8_t rpnSet[RPN_COUNT];
+        //! Current patch
+        uint8_t patch;
+        //! Bank [MSB, LSB] the patch was selected with
+        uint8_t patchBank[2];
+        //! Pitch bend value [MSB, LSB]
+        uint8_t bend[2];
+        //! Channel after-touch value
+        uint8_t afterTouch;
+        //! Selected parameter [MSB, LSB], registered or not by F_NRPN
+        uint8_t param[2];
+        //! State flags
+        uint16_t flags;
+    };
+
+    /**
+     * @brief State of the synthesizer collected for the seek checkpoint
+     */
+    struct SeekState
+    {
+        //! Current tempo
+        fraction<uint64_t> tempo;
+        //! Tempo was changed by the song
+        bool tempoKnown;
+        //! Song begin hook was passed
+        bool songStarted;
+        //! Count of passed SysEx messages
+        size_t sysExCount;
+        //! States of MIDI channels
+        SeekChannelState channels[16];
+        //! States of MIDI channels set before their last "reset all controllers"
+        SeekChannelState channelsBeforeReset[16];
+    };
+
+    /**
+     * @brief Seek checkpoint: the sequencer position and the synthesizer state to restore
+     */
+    struct SeekCheckpoint
+    {
+        //! Position to continue playing from (wait is a song time of the next event)
+        Position position;
+        //! State of the synthesizer at this position
+        SeekState state;
+    };
+
+    enum
+    {
+        //! Count of sequencer steps between seek checkpoints
+        SEEK_CHECKPOINT_STEPS = 256
+    };
+
+    //! Seek checkpoints, sorted by time
+    std::vector<SeekCheckpoint> m_seekCheckpoints;
+    //! Data of SysEx messages passed while collecting checkpoints
+    std::vector<uint8_t> m_seekSysExData;
+    //! Sizes of SysEx messages passed while collecting checkpoints
+    std::vector<size_t> m_seekSysExSizes;
+    //! State collected during the checkpoints building
+    SeekState m_seekState;
+    //! Checkpoints were collected for the current song
+    bool m_seekCheckpointsReady;
+    //! Song can't be seeked through checkpoints (raw OPL data, device switching)
+    bool m_seekCheckpointsUnusable;
+    //! Channel events were passed while collecting checkpoints
+    bool m_seekChannelsChanged;
+    /*!
+     * SysEx message was passed after channel events: the restored order of SysEx
+     * and channel events would be wrong since here, so collecting gets stopped
+     */
+    bool m_seekSysExAfterChannels;
+
+    /**
+     * @brief Collect seek checkpoints by the silent pass through the whole song
+     */
+    void buildSeekCheckpoints();
+
+    /**
+     * @brief Drop collected seek checkpoints (they will be collected again on next seek)
+     */
+    void resetSeekCheckpoints();
+
+    /**
+     * @brief Restore the state of checkpoint and send the synthesizer state through the interface
+     * @param cp Seek checkpoint
+     */
+    void restoreSeekCheckpoint(const SeekCheckpoint &cp);
+
+    /**
+     * @brief Apply the channel state over another one, as if they were sent one after another
+     * @param dst Channel state to update
+     * @param src Channel state sent later
+     */
+    static void mergeSeekChannel(SeekChannelState &dst, const SeekChannelState &src);
+
+    /**
+     * @brief Send the channel state through the interface
+     * @param channel MIDI channel
+     * @param ch Channel state
+     */
+    void restoreSeekChannel(uint8_t channel, const SeekChannelState &ch);
+
+    /* Silent interface hooks which collect the synthesizer state for seek checkpoints */
+    static void seekRtNoteOn(void *userdata, uint8_t channel, uint8_t note, uint8_t velocity);
+    static void seekRtNoteOff(void *userdata, uint8_t channel, uint8_t note);
+    static void seekRtNoteAfterTouch(void *userdata, uint8_t channel, uint8_t note, uint8_t atVal);
+    static void seekRtChannelAfterTouch(void *userdata, uint8_t channel, uint8_t atVal);
+    static void seekRtControllerChange(void *userdata, uint8_t channel, uint8_t type, uint8_t value);
+    static void seekRtPatchChange(void *userdata, uint8_t channel, uint8_t patch);
+    static void seekRtPitchBend(void *userdata, uint8_t channel, uint8_t msb, uint8_t lsb);
+    static void seekRtSysEx(void *userdata, const uint8_t *msg, size_t size);
+    static void seekMetaEvent(void *userdata, uint8_t type, const uint8_t *data, size_t len);
+    static void seekRtDeviceSwitch(void *userdata, size_t track, const char *data, size_t length);
+    static void seekRtRawOPL(void *userdata, uint8_t reg, uint8_t value);
+    static void seekSongStart(void *userdata);
+
+    //! Interface which collects events of the render block, used while playStream() is running
+    BW_MidiRtInterface m_blockInterface;
+    //! Interface which receives the render block and its events
+    const BW_MidiRtInterface *m_blockTarget;
+    //! Events of the current render block
+    std::vector<BW_MidiTimedEvent> m_blockEvents;
+    //! Data of SysEx messages of the current render block
+    std::vector<uint8_t> m_blockSysExData;
+    //! Frame of the render block where the sequencer currently is
+    uint32_t m_blockFrame;
+
+    /**
+     * @brief Add the event into the current render block
+     * @param type Type of event, one of BW_MidiTimedEventType
+     * @param channel Targeted MIDI channel
+     * @param data0 First data byte
+     * @param data1 Second data byte
+     */
+    void addBlockEvent(uint8_t type, uint8_t channel, uint8_t data0, uint8_t data1);
+
+    /* Interface hooks which collect events of the render block */
+    static void blockRtNoteOn(void *userdata, uint8_t channel, uint8_t note, uint8_t velocity);
+    static void blockRtNoteOffVel(void *userdata, uint8_t channel, uint8_t note, uint8_t velocity);
+    static void blockRtNoteAfterTouch(void *userdata, uint8_t channel, uint8_t note, uint8_t atVal);
+    static void blockRtChannelAfterTouch(void *userdata, uint8_t channel, uint8_t atVal);
+    static void blockRtControllerChange(void *userdata, uint8_t channel, uint8_t type, uint8_t value);
+    static void blockRtPatchChange(void *userdata, uint8_t channel, uint8_t patch);
+    static void blockRtPitchBend(void *userdata, uint8_t channel, uint8_t msb, uint8_t lsb);
+    static void blockRtSysEx(void *userdata, const uint8_t *msg, size_t size);
+    static void blockRtRawOPL(void *userdata, uint8_t reg, uint8_t value);
+    static void blockMetaEvent(void *userdata, uint8_t type, const uint8_t *data, size_t len);
+    static void blockRtDeviceSwitch(void *userdata, size_t track, const char *data, size_t length);
+    static size_t blockRtCurrentDevice(void *userdata, size_t track);
+
 public:
     BW_MidiSequencer();
     virtual ~BW_MidiSequencer();
@@ -571,6 +828,9 @@ public:
 
     /**
      * @brief Runs ticking in a sync with audio streaming. Use this together with onPcmRender hook to easily play MIDI.
+     *
+     * When onPcmRenderBlock hook is set, the whole buffer is rendered by one call of it,
+     * with events of the buffer instead of MIDI Real-Time calls.
      * @param stream pointer to the output PCM stream
      * @param length length of the buffer in bytes
      * @return Count of recorded data in bytes
@@ -712,6 +972,17 @@ public:
      */
     bool loadMIDI(FileAndMemReader &fr);
 
+    /**
+     * @brief Save the loaded song as a song cache
+     *
+     * The song cache contains the built timeline of the song (events, timings,
+     * loop points, markers and meta-data), it gets loaded by loadMIDI() without
+     * the conversion of the source format and the timeline construction.
+     * @param out Destination buffer
+     * @return true if the song was stored, false if there is no loaded song
+     */
+    bool saveSongCache(std::vector<uint8_t> &out) const;
+
     /**
      * @brief Periodic tick handler.
      * @param s seconds since last call
@@ -830,6 +1101,12 @@ private:
     bool parseXMI(FileAndMemReader &fr);
 #endif
 
+    /**
+     * @brief Load the song cache saved by saveSongCache()
+     * @param fr Context with opened file
+     * @return true on successful load
+     */
+    bool parseSongCache(FileAndMemReader &fr);
 };
 
 #endif /* BW_MIDI_SEQUENCER_HHHHPPP */
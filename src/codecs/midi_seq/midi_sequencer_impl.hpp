@@ -27,7 +27,6 @@
 #include <memory>
 #include <cstring>
 #include <cerrno>
-#include <iterator>  // std::back_inserter
 #include <algorithm> // std::copy
 #include <set>
 #include <assert.h>
@@ -151,18 +150,24 @@ static inline uint64_t readVarLenEx(const uint8_t **ptr, const uint8_t *end, boo
 }
 
 BW_MidiSequencer::MidiEvent::MidiEvent() :
+    absPosition(0),
+    dataSize(0),
+    dataLoc(0),
     type(T_UNKNOWN),
     subtype(T_UNKNOWN),
     channel(0),
-    isValid(1),
-    absPosition(0)
-{}
+    isValid(1)
+{
+    std::memset(data, 0, sizeof(data));
+}
 
 BW_MidiSequencer::MidiTrackRow::MidiTrackRow() :
     time(0.0),
     delay(0),
     absPos(0),
-    timeDelay(0.0)
+    timeDelay(0.0),
+    eventsBegin(0),
+    eventsEnd(0)
 {}
 
 void BW_MidiSequencer::MidiTrackRow::clear()
@@ -171,10 +176,11 @@ void BW_MidiSequencer::MidiTrackRow::clear()
     delay = 0;
     absPos = 0;
     timeDelay = 0.0;
-    events.clear();
+    eventsBegin = 0;
+    eventsEnd = 0;
 }
 
-void BW_MidiSequencer::MidiTrackRow::sortEvents(bool *noteStates)
+void BW_MidiSequencer::MidiTrackRow::sortEvents(std::vector<MidiEvent> &eventsBank, bool *noteStates)
 {
     typedef std::vector<MidiEvent> EvtArr;
     EvtArr sysEx;
@@ -182,20 +188,25 @@ void BW_MidiSequencer::MidiTrackRow::sortEvents(bool *noteStates)
     EvtArr noteOffs;
     EvtArr controllers;
     EvtArr anyOther;
+    const size_t eventsCount = eventsEnd - eventsBegin;
+    MidiEvent *events = eventsCount > 0 ? &eventsBank[eventsBegin] : NULL;
+
+    if(eventsCount < 2 && !noteStates)
+        return; // Nothing to sort
 
-    for(size_t i = 0; i < events.size(); i++)
+    for(size_t i = 0; i < eventsCount; i++)
     {
         if(events[i].type == MidiEvent::T_NOTEOFF)
         {
             if(noteOffs.capacity() == 0)
-                noteOffs.reserve(events.size());
+                noteOffs.reserve(eventsCount);
             noteOffs.push_back(events[i]);
         }
         else if(events[i].type == MidiEvent::T_SYSEX ||
                 events[i].type == MidiEvent::T_SYSEX2)
         {
             if(sysEx.capacity() == 0)
-                sysEx.reserve(events.size());
+                sysEx.reserve(eventsCount);
             sysEx.push_back(events[i]);
         }
         else if((events[i].type == MidiEvent::T_CTRLCHANGE)
@@ -204,7 +215,7 @@ void BW_MidiSequencer::MidiTrackRow::sortEvents(bool *noteStates)
                 || (events[i].type == MidiEvent::T_CHANAFTTOUCH))
         {
             if(controllers.capacity() == 0)
-                controllers.reserve(events.size());
+                controllers.reserve(eventsCount);
             controllers.push_back(events[i]);
         }
         else if((events[i].type == MidiEvent::T_SPECIAL) && (
@@ -219,13 +230,13 @@ void BW_MidiSequencer::MidiTrackRow::sortEvents(bool *noteStates)
             ))
         {
             if(metas.capacity() == 0)
-                metas.reserve(events.size());
+                metas.reserve(eventsCount);
             metas.push_back(events[i]);
         }
         else
         {
             if(anyOther.capacity() == 0)
-                anyOther.reserve(events.size());
+                anyOther.reserve(eventsCount);
             anyOther.push_back(events[i]);
         }
     }
@@ -288,17 +299,12 @@ void BW_MidiSequencer::MidiTrackRow::sortEvents(bool *noteStates)
     }
     /***********************************************************************************/
 
-    events.clear();
-    if(!sysEx.empty())
-        events.insert(events.end(), sysEx.begin(), sysEx.end());
-    if(!noteOffs.empty())
-        events.insert(events.end(), noteOffs.begin(), noteOffs.end());
-    if(!metas.empty())
-        events.insert(events.end(), metas.begin(), metas.end());
-    if(!controllers.empty())
-        events.insert(events.end(), controllers.begin(), controllers.end());
-    if(!anyOther.empty())
-        events.insert(events.end(), anyOther.begin(), anyOther.end());
+    // Put sorted events back into the same range of the bank
+    events = std::copy(sysEx.begin(), sysEx.end(), events);
+    events = std::copy(noteOffs.begin(), noteOffs.end(), events);
+    events = std::copy(metas.begin(), metas.end(), events);
+    events = std::copy(controllers.begin(), controllers.end(), events);
+    std::copy(anyOther.begin(), anyOther.end(), events);
 }
 
 BW_MidiSequencer::BW_MidiSequencer() :
@@ -317,8 +323,15 @@ BW_MidiSequencer::BW_MidiSequencer() :
     m_loopCount(-1),
     m_trackSolo(~static_cast<size_t>(0)),
     m_triggerHandler(NULL),
-    m_triggerUserData(NULL)
+    m_triggerUserData(NULL),
+    m_seekCheckpointsReady(false),
+    m_seekCheckpointsUnusable(false),
+    m_seekChannelsChanged(false),
+    m_seekSysExAfterChannels(false),
+    m_blockTarget(NULL),
+    m_blockFrame(0)
 {
+    std::memset(&m_blockInterface, 0, sizeof(m_blockInterface));
     m_loop.reset();
     m_loop.invalidLoop = false;
     m_time.init();
@@ -366,8 +379,35 @@ int BW_MidiSequencer::playStream(uint8_t *stream, size_t length)
     size_t left = samples;
     size_t periodSize = 0;
     uint8_t *stream_pos = stream;
-
-    assert(m_interface->onPcmRender);
+    const BW_MidiRtInterface *realInterface = m_interface;
+    const bool blockMode = (realInterface->onPcmRenderBlock != NULL);
+
+    assert(m_interface->onPcmRender || blockMode);
+
+    if(blockMode)
+    {
+        // Collect events of the whole block, and render it by one call
+        m_blockInterface = *realInterface;
+        m_blockInterface.rtUserData = this;
+        m_blockInterface.rt_noteOn = blockRtNoteOn;
+        m_blockInterface.rt_noteOff = NULL;
+        m_blockInterface.rt_noteOffVel = blockRtNoteOffVel;
+        m_blockInterface.rt_noteAfterTouch = blockRtNoteAfterTouch;
+        m_blockInterface.rt_channelAfterTouch = blockRtChannelAfterTouch;
+        m_blockInterface.rt_controllerChange = blockRtControllerChange;
+        m_blockInterface.rt_patchChange = blockRtPatchChange;
+        m_blockInterface.rt_pitchBend = blockRtPitchBend;
+        m_blockInterface.rt_systemExclusive = blockRtSysEx;
+        m_blockInterface.rt_rawOPL = realInterface->rt_rawOPL ? blockRtRawOPL : NULL;
+        m_blockInterface.rt_metaEvent = realInterface->rt_metaEvent ? blockMetaEvent : NULL;
+        m_blockInterface.rt_deviceSwitch = realInterface->rt_deviceSwitch ? blockRtDeviceSwitch : NULL;
+        m_blockInterface.rt_currentDevice = realInterface->rt_currentDevice ? blockRtCurrentDevice : NULL;
+        m_blockTarget = realInterface;
+        m_blockEvents.clear();
+        m_blockSysExData.clear();
+        m_blockFrame = 0;
+        m_interface = &m_blockInterface;
+    }
 
     while(left > 0)
     {
@@ -382,10 +422,12 @@ int BW_MidiSequencer::playStream(uint8_t *stream, size_t length)
         if(stream)
         {
             size_t generateSize = periodSize > left ? static_cast<size_t>(left) : static_cast<size_t>(periodSize);
-            m_interface->onPcmRender(m_interface->onPcmRender_userData, stream_pos, generateSize * m_time.frameSize);
+            if(!blockMode)
+                m_interface->onPcmRender(m_interface->onPcmRender_userData, stream_pos, generateSize * m_time.frameSize);
             stream_pos += generateSize * m_time.frameSize;
             count += generateSize;
             left -= generateSize;
+            m_blockFrame = static_cast<uint32_t>(count);
             assert(left <= samples);
         }
 
@@ -396,9 +438,119 @@ int BW_MidiSequencer::playStream(uint8_t *stream, size_t length)
         }
     }
 
+    if(blockMode)
+    {
+        const uint8_t *sysEx = m_blockSysExData.empty() ? NULL : &m_blockSysExData[0];
+        m_interface = realInterface;
+
+        // Messages were stored in the order of their events
+        for(size_t i = 0; i < m_blockEvents.size(); ++i)
+        {
+            BW_MidiTimedEvent &e = m_blockEvents[i];
+            if(e.type != BW_MIDI_TIMED_SYSEX)
+                continue;
+            e.sysex = sysEx;
+            sysEx += e.sysex_size;
+        }
+
+        if(stream)
+            realInterface->onPcmRenderBlock(realInterface->onPcmRenderBlock_userData,
+                                            stream, count * m_time.frameSize,
+                                            m_blockEvents.empty() ? NULL : &m_blockEvents[0],
+                                            m_blockEvents.size());
+    }
+
     return count * static_cast<int>(m_time.frameSize);
 }
 
+void BW_MidiSequencer::addBlockEvent(uint8_t type, uint8_t channel, uint8_t data0, uint8_t data1)
+{
+    BW_MidiTimedEvent e;
+    e.frame = m_blockFrame;
+    e.type = type;
+    e.channel = channel;
+    e.data[0] = data0;
+    e.data[1] = data1;
+    e.sysex = NULL;
+    e.sysex_size = 0;
+    m_blockEvents.push_back(e);
+}
+
+void BW_MidiSequencer::blockRtNoteOn(void *userdata, uint8_t channel, uint8_t note, uint8_t velocity)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+    self->addBlockEvent(BW_MIDI_TIMED_NOTE_ON, channel, note, velocity);
+}
+
+void BW_MidiSequencer::blockRtNoteOffVel(void *userdata, uint8_t channel, uint8_t note, uint8_t velocity)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+    self->addBlockEvent(BW_MIDI_TIMED_NOTE_OFF, channel, note, velocity);
+}
+
+void BW_MidiSequencer::blockRtNoteAfterTouch(void *userdata, uint8_t channel, uint8_t note, uint8_t atVal)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+    self->addBlockEvent(BW_MIDI_TIMED_NOTE_AFTERTOUCH, channel, note, atVal);
+}
+
+void BW_MidiSequencer::blockRtChannelAfterTouch(void *userdata, uint8_t channel, uint8_t atVal)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+    self->addBlockEvent(BW_MIDI_TIMED_CHANNEL_AFTERTOUCH, channel, atVal, 0);
+}
+
+void BW_MidiSequencer::blockRtControllerChange(void *userdata, uint8_t channel, uint8_t type, uint8_t value)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+    self->addBlockEvent(BW_MIDI_TIMED_CONTROLLER, channel, type, value);
+}
+
+void BW_MidiSequencer::blockRtPatchChange(void *userdata, uint8_t channel, uint8_t patch)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+    self->addBlockEvent(BW_MIDI_TIMED_PATCH, channel, patch, 0);
+}
+
+void BW_MidiSequencer::blockRtPitchBend(void *userdata, uint8_t channel, uint8_t msb, uint8_t lsb)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+    self->addBlockEvent(BW_MIDI_TIMED_PITCH_BEND, channel, msb, lsb);
+}
+
+void BW_MidiSequencer::blockRtSysEx(void *userdata, const uint8_t *msg, size_t size)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+    self->m_blockSysExData.insert(self->m_blockSysExData.end(), msg, msg + size);
+    self->addBlockEvent(BW_MIDI_TIMED_SYSEX, 0, 0, 0);
+    self->m_blockEvents.back().sysex_size = size;
+}
+
+void BW_MidiSequencer::blockRtRawOPL(void *userdata, uint8_t reg, uint8_t value)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+    self->addBlockEvent(BW_MIDI_TIMED_RAW_OPL, 0, reg, value);
+}
+
+void BW_MidiSequencer::blockMetaEvent(void *userdata, uint8_t type, const uint8_t *data, size_t len)
+{
+    // Meta events are not rendered, pass them immediately
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+    self->m_blockTarget->rt_metaEvent(self->m_blockTarget->rtUserData, type, data, len);
+}
+
+void BW_MidiSequencer::blockRtDeviceSwitch(void *userdata, size_t track, const char *data, size_t length)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+    self->m_blockTarget->rt_deviceSwitch(self->m_blockTarget->rtUserData, track, data, length);
+}
+
+size_t BW_MidiSequencer::blockRtCurrentDevice(void *userdata, size_t track)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+    return self->m_blockTarget->rt_currentDevice(self->m_blockTarget->rtUserData, track);
+}
+
 BW_MidiSequencer::FileFormat BW_MidiSequencer::getFormat()
 {
     return m_format;
@@ -414,6 +566,8 @@ bool BW_MidiSequencer::setTrackEnabled(size_t track, bool enable)
     size_t trackCount = m_trackData.size();
     if(track >= trackCount)
         return false;
+    if(m_trackDisable[track] != !enable)
+        resetSeekCheckpoints(); // Collected states are depending on enabled tracks
     m_trackDisable[track] = !enable;
     return true;
 }
@@ -447,6 +601,8 @@ bool BW_MidiSequencer::setChannelEnabled(size_t channel, bool enable)
 
 void BW_MidiSequencer::setSoloTrack(size_t track)
 {
+    if(m_trackSolo != track)
+        resetSeekCheckpoints(); // Collected states are depending on enabled tracks
     m_trackSolo = track;
 }
 
@@ -523,6 +679,46 @@ double BW_MidiSequencer::getTempoMultiplier()
     return m_tempoMultiplier;
 }
 
+uint8_t *BW_MidiSequencer::setEventData(MidiEvent &evt, const uint8_t *data, size_t size)
+{
+    uint8_t *dst;
+
+    evt.dataSize = static_cast<uint32_t>(size);
+
+    if(size <= MidiEvent::INLINE_DATA_SIZE)
+    {
+        evt.dataLoc = 0;
+        dst = evt.data;
+    }
+    else
+    {
+        evt.dataLoc = static_cast<uint32_t>(m_dataBank.size());
+        m_dataBank.resize(m_dataBank.size() + size);
+        dst = &m_dataBank[evt.dataLoc];
+    }
+
+    if(data && size > 0)
+        std::memcpy(dst, data, size);
+
+    return dst;
+}
+
+const uint8_t *BW_MidiSequencer::getEventData(const MidiEvent &evt) const
+{
+    if(evt.dataSize <= MidiEvent::INLINE_DATA_SIZE)
+        return evt.data;
+    return &m_dataBank[evt.dataLoc];
+}
+
+void BW_MidiSequencer::addRowEvent(MidiTrackRow &row, const MidiEvent &evt)
+{
+    if(row.eventsBegin == row.eventsEnd)
+        row.eventsBegin = row.eventsEnd = m_eventsBank.size();
+
+    assert(row.eventsEnd == m_eventsBank.size()); // Row events must be continuous!
+    m_eventsBank.push_back(evt);
+    row.eventsEnd++;
+}
 
 void BW_MidiSequencer::buildSmfSetupReset(size_t trackCount)
 {
@@ -539,6 +735,10 @@ void BW_MidiSequencer::buildSmfSetupReset(size_t trackCount)
     m_musMarkers.clear();
     m_trackData.clear();
     m_trackData.resize(trackCount, MidiTrackQueue());
+    m_eventsBank.clear();
+    m_dataBank.clear();
+    resetSeekCheckpoints();
+    m_seekCheckpointsUnusable = false;
     m_trackDisable.resize(trackCount);
 
     m_loop.reset();
@@ -548,11 +748,24 @@ void BW_MidiSequencer::buildSmfSetupReset(size_t trackCount)
     m_currentPosition.began = false;
     m_currentPosition.absTimePosition = 0.0;
     m_currentPosition.wait = 0.0;
-    m_currentPosition.track.clear();
-    m_currentPosition.track.resize(trackCount);
+    m_currentPosition.schedulePos = 0;
+    m_schedule.clear();
 }
 
 bool BW_MidiSequencer::buildSmfTrackData(const std::vector<std::vector<uint8_t> > &trackData)
+{
+    std::vector<RawTrackData> ranges(trackData.size());
+
+    for(size_t tk = 0; tk < trackData.size(); ++tk)
+    {
+        ranges[tk].begin = trackData[tk].data();
+        ranges[tk].end = trackData[tk].data() + trackData[tk].size();
+    }
+
+    return buildSmfTrackData(ranges);
+}
+
+bool BW_MidiSequencer::buildSmfTrackData(const std::vector<RawTrackData> &trackData)
 {
     const size_t trackCount = trackData.size();
     buildSmfSetupReset(trackCount);
@@ -580,6 +793,12 @@ bool BW_MidiSequencer::buildSmfTrackData(const std::vector<std::vector<uint8_t>
     //! Tempo change events list
     std::vector<MidiEvent> temposList;
 
+    // Roughly estimate the count of events to avoid frequent reallocations of the events bank
+    size_t totalDataSize = 0;
+    for(size_t tk = 0; tk < trackCount; ++tk)
+        totalDataSize += static_cast<size_t>(trackData[tk].end - trackData[tk].begin);
+    m_eventsBank.reserve(totalDataSize / 3);
+
     /*
      * TODO: Make this be safer for memory in case of broken input data
      * which may cause going away of available track data (and then give a crash!)
@@ -592,8 +811,8 @@ bool BW_MidiSequencer::buildSmfTrackData(const std::vector<std::vector<uint8_t>
         int status = 0;
         MidiEvent event;
         bool ok = false;
-        const uint8_t *end      = trackData[tk].data() + trackData[tk].size();
-        const uint8_t *trackPtr = trackData[tk].data();
+        const uint8_t *end      = trackData[tk].end;
+        const uint8_t *trackPtr = trackData[tk].begin;
         std::memset(noteStates, 0, sizeof(noteStates));
 
         // Time delay that follows the first event in the track
@@ -617,7 +836,7 @@ bool BW_MidiSequencer::buildSmfTrackData(const std::vector<std::vector<uint8_t>
                 MidiEvent resetEvent;
                 resetEvent.type = MidiEvent::T_SPECIAL;
                 resetEvent.subtype = MidiEvent::ST_SONG_BEGIN_HOOK;
-                evtPos.events.push_back(resetEvent);
+                addRowEvent(evtPos, resetEvent);
             }
 
             evtPos.absPos = abs_position;
@@ -637,7 +856,7 @@ bool BW_MidiSequencer::buildSmfTrackData(const std::vector<std::vector<uint8_t>
                 return false;
             }
 
-            evtPos.events.push_back(event);
+            addRowEvent(evtPos, event);
             if(event.type == MidiEvent::T_SPECIAL)
             {
                 if(event.subtype == MidiEvent::ST_TEMPOCHANGE)
@@ -750,11 +969,12 @@ bool BW_MidiSequencer::buildSmfTrackData(const std::vector<std::vector<uint8_t>
 
 #ifdef ENABLE_END_SILENCE_SKIPPING
             //Have track end on its own row? Clear any delay on the row before
-            if(event.subtype == MidiEvent::ST_ENDTRACK && evtPos.events.size() == 1)
+            if(event.subtype == MidiEvent::ST_ENDTRACK && (evtPos.eventsEnd - evtPos.eventsBegin) == 1)
             {
                 if (!m_trackData[tk].empty())
                 {
                     MidiTrackRow &previous = m_trackData[tk].back();
+                    abs_position -= previous.delay;
                     previous.delay = 0;
                     previous.timeDelay = 0;
                 }
@@ -765,7 +985,7 @@ bool BW_MidiSequencer::buildSmfTrackData(const std::vector<std::vector<uint8_t>
             {
                 evtPos.absPos = abs_position;
                 abs_position += evtPos.delay;
-                evtPos.sortEvents(noteStates);
+                evtPos.sortEvents(m_eventsBank, noteStates);
                 m_trackData[tk].push_back(evtPos);
                 evtPos.clear();
                 gotLoopEventInThisRow = false;
@@ -775,9 +995,6 @@ bool BW_MidiSequencer::buildSmfTrackData(const std::vector<std::vector<uint8_t>
 
         if(ticksSongLength < abs_position)
             ticksSongLength = abs_position;
-        // Set the chain of events begin
-        if(m_trackData[tk].size() > 0)
-            m_currentPosition.track[tk].pos = m_trackData[tk].begin();
     }
 
     if(gotGlobalLoopStart && !gotGlobalLoopEnd)
@@ -804,11 +1021,95 @@ bool BW_MidiSequencer::buildSmfTrackData(const std::vector<std::vector<uint8_t>
     return true;
 }
 
+/**
+ * @brief Next row of the track while merging tracks into the playing schedule
+ */
+struct BW_MidiScheduleHead
+{
+    //! Absolute tick position of the row
+    uint64_t absPos;
+    //! Count of preceding rows of the same track at the same tick
+    uint32_t subStep;
+    //! Index of the track
+    uint32_t track;
+    //! Index of the row in the track
+    uint32_t row;
+};
+
+/**
+ * @brief Heap order of the track heads: the earliest row stays at the top
+ */
+static bool midiScheduleHeadIsLater(const BW_MidiScheduleHead &a, const BW_MidiScheduleHead &b)
+{
+    if(a.absPos != b.absPos)
+        return a.absPos > b.absPos;
+    if(a.subStep != b.subStep)
+        return a.subStep > b.subStep;
+    return a.track > b.track;
+}
+
+void BW_MidiSequencer::buildSchedule()
+{
+    const size_t trackCount = m_trackData.size();
+    std::vector<BW_MidiScheduleHead> heads;
+    size_t rowsCount = 0;
+
+    heads.reserve(trackCount);
+    for(size_t tk = 0; tk < trackCount; ++tk)
+    {
+        rowsCount += m_trackData[tk].size();
+        if(m_trackData[tk].empty())
+            continue;
+        BW_MidiScheduleHead head;
+        head.absPos = m_trackData[tk][0].absPos;
+        head.subStep = 0;
+        head.track = static_cast<uint32_t>(tk);
+        head.row = 0;
+        heads.push_back(head);
+        std::push_heap(heads.begin(), heads.end(), midiScheduleHeadIsLater);
+    }
+
+    m_schedule.clear();
+    m_schedule.reserve(rowsCount);
+
+    /*
+     * Rows of different tracks at the same tick are played at the same step
+     * in order of tracks. Rows following each other at the same tick in one
+     * track (zero delay) are played at separated steps, after rows of other
+     * tracks at this step.
+     */
+    while(!heads.empty())
+    {
+        std::pop_heap(heads.begin(), heads.end(), midiScheduleHeadIsLater);
+        BW_MidiScheduleHead &head = heads.back();
+
+        ScheduledRow entry;
+        entry.track = head.track;
+        entry.row = head.row;
+        m_schedule.push_back(entry);
+
+        const MidiTrackQueue &rows = m_trackData[head.track];
+        if(++head.row >= rows.size())
+        {
+            heads.pop_back();
+            continue;
+        }
+
+        const uint64_t absPos = rows[head.row].absPos;
+        head.subStep = (absPos == head.absPos) ? head.subStep + 1 : 0;
+        head.absPos = absPos;
+        std::push_heap(heads.begin(), heads.end(), midiScheduleHeadIsLater);
+    }
+}
+
 void BW_MidiSequencer::buildTimeLine(const std::vector<MidiEvent> &tempos,
                                           uint64_t loopStartTicks,
                                           uint64_t loopEndTicks)
 {
     const size_t    trackCount = m_trackData.size();
+
+    buildSchedule();
+
     /********************************************************************************/
     // Calculate time basing on collected tempo events
     /********************************************************************************/
@@ -827,7 +1128,7 @@ void BW_MidiSequencer::buildTimeLine(const std::vector<MidiEvent> &tempos,
         std::fflush(stdout);
 #endif
 
-        MidiTrackRow *posPrev = &(*(track.begin()));//First element
+        MidiTrackRow *posPrev = &track.front();//First element
         for(MidiTrackQueue::iterator it = track.begin(); it != track.end(); it++)
         {
 #ifdef DEBUG_TIME_CALCULATION
@@ -854,7 +1155,7 @@ void BW_MidiSequencer::buildTimeLine(const std::vector<MidiEvent> &tempos,
                         TempoChangePoint tempoMarker;
                         const MidiEvent &tempoPoint = tempos[tempo_change_index];
                         tempoMarker.absPos = tempoPoint.absPosition;
-                        tempoMarker.tempo = m_invDeltaTicks * fraction<uint64_t>(readBEint(tempoPoint.data.data(), tempoPoint.data.size()));
+                        tempoMarker.tempo = m_invDeltaTicks * fraction<uint64_t>(readBEint(getEventData(tempoPoint), tempoPoint.dataSize));
                         points.push_back(tempoMarker);
                         tempo_change_index++;
                     }
@@ -900,13 +1201,13 @@ void BW_MidiSequencer::buildTimeLine(const std::vector<MidiEvent> &tempos,
             time += pos.timeDelay;
 
             // Capture markers after time value calculation
-            for(size_t i = 0; i < pos.events.size(); i++)
+            for(size_t i = pos.eventsBegin; i < pos.eventsEnd; i++)
             {
-                MidiEvent &e = pos.events[i];
+                const MidiEvent &e = m_eventsBank[i];
                 if((e.type == MidiEvent::T_SPECIAL) && (e.subtype == MidiEvent::ST_MARKER))
                 {
                     MIDI_MarkerEntry marker;
-                    marker.label = std::string((char *)e.data.data(), e.data.size());
+                    marker.label = std::string((const char *)getEventData(e), e.dataSize);
                     marker.pos_ticks = pos.absPos;
                     marker.pos_time = pos.time;
                     m_musMarkers.push_back(marker);
@@ -951,75 +1252,42 @@ void BW_MidiSequencer::buildTimeLine(const std::vector<MidiEvent> &tempos,
     /********************************************************************************/
     // Find and set proper loop points
     /********************************************************************************/
-    if(!m_loop.invalidLoop && !m_currentPosition.track.empty())
+    if(!m_loop.invalidLoop && !m_schedule.empty())
     {
-        unsigned caughLoopStart = 0;
-        bool scanDone = false;
-        const size_t  trackCount = m_currentPosition.track.size();
-        Position      rowPosition(m_currentPosition);
+        const size_t scheduleSize = m_schedule.size();
+        size_t   stepBegin = 0;
+        uint64_t stepTick = 0;
+        uint32_t prevTrack = 0;
 
-        while(!scanDone)
+        for(size_t pos = 0; pos < scheduleSize; ++pos)
         {
-            const Position      rowBeginPosition(rowPosition);
-
-            for(size_t tk = 0; tk < trackCount; ++tk)
+            const ScheduledRow &entry = m_schedule[pos];
+            const MidiTrackRow &row = m_trackData[entry.track][entry.row];
+            if((pos == 0) || (row.absPos != stepTick) || (entry.track <= prevTrack))
             {
-                Position::TrackInfo &track = rowPosition.track[tk];
-                if((track.lastHandledEvent >= 0) && (track.delay <= 0))
-                {
-                    // Check is an end of track has been reached
-                    if(track.pos == m_trackData[tk].end())
-                    {
-                        track.lastHandledEvent = -1;
-                        continue;
-                    }
-
-                    for(size_t i = 0; i < track.pos->events.size(); i++)
-                    {
-                        const MidiEvent &evt = track.pos->events[i];
-                        if(evt.type == MidiEvent::T_SPECIAL && evt.subtype == MidiEvent::ST_LOOPSTART)
-                        {
-                            caughLoopStart++;
-                            scanDone = true;
-                            break;
-                        }
-                    }
-
-                    if(track.lastHandledEvent >= 0)
-                    {
-                        track.delay += track.pos->delay;
-                        track.pos++;
-                    }
-                }
+                stepBegin = pos;
+                stepTick = row.absPos;
             }
+            prevTrack = entry.track;
 
-            // Find a shortest delay from all track
-            uint64_t shortestDelay = 0;
-            bool     shortestDelayNotFound = true;
-
-            for(size_t tk = 0; tk < trackCount; ++tk)
+            bool caughLoopStart = false;
+            for(size_t i = row.eventsBegin; i < row.eventsEnd; i++)
             {
-                Position::TrackInfo &track = rowPosition.track[tk];
-                if((track.lastHandledEvent >= 0) && (shortestDelayNotFound || track.delay < shortestDelay))
+                const MidiEvent &evt = m_eventsBank[i];
+                if(evt.type == MidiEvent::T_SPECIAL && evt.subtype == MidiEvent::ST_LOOPSTART)
                 {
-                    shortestDelay = track.delay;
-                    shortestDelayNotFound = false;
+                    caughLoopStart = true;
+                    break;
                 }
             }
 
-            // Schedule the next playevent to be processed after that delay
-            for(size_t tk = 0; tk < trackCount; ++tk)
-                rowPosition.track[tk].delay -= shortestDelay;
-
-            if(caughLoopStart > 0)
+            if(caughLoopStart)
             {
-                m_loopBeginPosition = rowBeginPosition;
+                m_loopBeginPosition = m_currentPosition;
+                m_loopBeginPosition.schedulePos = stepBegin;
                 m_loopBeginPosition.absTimePosition = m_loopStartTime;
-                scanDone = true;
-            }
-
-            if(shortestDelayNotFound)
                 break;
+            }
         }
     }
 
@@ -1147,14 +1415,17 @@ void BW_MidiSequencer::buildTimeLine(const std::vector<MidiEvent> &tempos,
 
 bool BW_MidiSequencer::processEvents(bool isSeek)
 {
-    if(m_currentPosition.track.size() == 0)
+    if(m_schedule.empty())
         m_atEnd = true; // No MIDI track data to play
     if(m_atEnd)
         return false;   // No more events in the queue
 
     m_loop.caughtEnd = false;
-    const size_t        trackCount = m_currentPosition.track.size();
+    const size_t        scheduleSize = m_schedule.size();
     const Position      rowBeginPosition(m_currentPosition);
+    size_t   pos = m_currentPosition.schedulePos;
+    uint64_t stepTick = 0;
+    uint32_t prevTrack = 0;
     bool     doLoopJump = false;
     unsigned caughLoopStart = 0;
     unsigned caughLoopStackStart = 0;
@@ -1166,106 +1437,94 @@ bool BW_MidiSequencer::processEvents(bool isSeek)
     double maxTime = 0.0;
 #endif
 
-    for(size_t tk = 0; tk < trackCount; ++tk)
+    if(pos < scheduleSize)
+        stepTick = m_trackData[m_schedule[pos].track][m_schedule[pos].row].absPos;
+
+    // Handle rows of all tracks scheduled at this step
+    while(pos < scheduleSize)
     {
-        Position::TrackInfo &track = m_currentPosition.track[tk];
-        if((track.lastHandledEvent >= 0) && (track.delay <= 0))
-        {
-            // Check is an end of track has been reached
-            if(track.pos == m_trackData[tk].end())
-            {
-                track.lastHandledEvent = -1;
-                break;
-            }
+        const ScheduledRow &entry = m_schedule[pos];
+        const MidiTrackRow &row = m_trackData[entry.track][entry.row];
 
-            // Handle event
-            for(size_t i = 0; i < track.pos->events.size(); i++)
-            {
-                const MidiEvent &evt = track.pos->events[i];
+        if((pos != rowBeginPosition.schedulePos) && ((row.absPos != stepTick) || (entry.track <= prevTrack)))
+            break; // The next step has been reached
+        prevTrack = entry.track;
+
+        int32_t status = 0;
+
+        // Handle event
+        for(size_t i = row.eventsBegin; i < row.eventsEnd; i++)
+        {
+            const MidiEvent &evt = m_eventsBank[i];
 #ifdef ENABLE_BEGIN_SILENCE_SKIPPING
-                if(!m_currentPosition.began && (evt.type == MidiEvent::T_NOTEON))
-                    m_currentPosition.began = true;
+            if(!m_currentPosition.began && (evt.type == MidiEvent::T_NOTEON))
+                m_currentPosition.began = true;
 #endif
-                if(isSeek && (evt.type == MidiEvent::T_NOTEON))
-                    continue;
-                handleEvent(tk, evt, track.lastHandledEvent);
+            if(isSeek && (evt.type == MidiEvent::T_NOTEON))
+                continue;
+            handleEvent(entry.track, evt, status);
 
-                if(m_loop.caughtStart)
-                {
-                    if(m_interface->onloopStart) // Loop Start hook
-                        m_interface->onloopStart(m_interface->onloopStart_userData);
+            if(m_loop.caughtStart)
+            {
+                if(m_interface->onloopStart) // Loop Start hook
+                    m_interface->onloopStart(m_interface->onloopStart_userData);
 
-                    caughLoopStart++;
-                    m_loop.caughtStart = false;
-                }
+                caughLoopStart++;
+                m_loop.caughtStart = false;
+            }
 
-                if(m_loop.caughtStackStart)
-                {
-                    if(m_interface->onloopStart && (m_loopStartTime >= track.pos->time)) // Loop Start hook
-                        m_interface->onloopStart(m_interface->onloopStart_userData);
+            if(m_loop.caughtStackStart)
+            {
+                if(m_interface->onloopStart && (m_loopStartTime >= row.time)) // Loop Start hook
+                    m_interface->onloopStart(m_interface->onloopStart_userData);
 
-                    caughLoopStackStart++;
-                    m_loop.caughtStackStart = false;
-                }
+                caughLoopStackStart++;
+                m_loop.caughtStackStart = false;
+            }
 
-                if(m_loop.caughtStackBreak)
-                {
-                    caughLoopStackBreaks++;
-                    m_loop.caughtStackBreak = false;
-                }
+            if(m_loop.caughtStackBreak)
+            {
+                caughLoopStackBreaks++;
+                m_loop.caughtStackBreak = false;
+            }
 
-                if(m_loop.caughtEnd || m_loop.isStackEnd())
+            if(m_loop.caughtEnd || m_loop.isStackEnd())
+            {
+                if(m_loop.caughtStackEnd)
                 {
-                    if(m_loop.caughtStackEnd)
-                    {
-                        m_loop.caughtStackEnd = false;
-                        caughLoopStackEnds++;
-                        caughLoopStackEndsTime = track.pos->time;
-                    }
-                    doLoopJump = true;
-                    break; // Stop event handling on catching loopEnd event!
+                    m_loop.caughtStackEnd = false;
+                    caughLoopStackEnds++;
+                    caughLoopStackEndsTime = row.time;
                 }
+                doLoopJump = true;
+                break; // Stop event handling on catching loopEnd event!
             }
+        }
 
 #ifdef DEBUG_TIME_CALCULATION
-            if(maxTime < track.pos->time)
-                maxTime = track.pos->time;
+        if(maxTime < row.time)
+            maxTime = row.time;
 #endif
-            // Read next event time (unless the track just ended)
-            if(track.lastHandledEvent >= 0)
-            {
-                track.delay += track.pos->delay;
-                track.pos++;
-            }
+        pos++;
 
-            if(doLoopJump)
-                break;
-        }
+        if(doLoopJump)
+            break;
     }
 
+    m_currentPosition.schedulePos = pos;
+
 #ifdef DEBUG_TIME_CALCULATION
     std::fprintf(stdout, "                              \r");
     std::fprintf(stdout, "Time: %10f; Audio: %10f\r", maxTime, m_currentPosition.absTimePosition);
     std::fflush(stdout);
 #endif
 
-    // Find a shortest delay from all track
+    // Find a delay until the next step
     uint64_t shortestDelay = 0;
-    bool     shortestDelayNotFound = true;
-
-    for(size_t tk = 0; tk < trackCount; ++tk)
-    {
-        Position::TrackInfo &track = m_currentPosition.track[tk];
-        if((track.lastHandledEvent >= 0) && (shortestDelayNotFound || track.delay < shortestDelay))
-        {
-            shortestDelay = track.delay;
-            shortestDelayNotFound = false;
-        }
-    }
+    bool     shortestDelayNotFound = (pos >= scheduleSize);
 
-    // Schedule the next playevent to be processed after that delay
-    for(size_t tk = 0; tk < trackCount; ++tk)
-        m_currentPosition.track[tk].delay -= shortestDelay;
+    if(!shortestDelayNotFound)
+        shortestDelay = m_trackData[m_schedule[pos].track][m_schedule[pos].row].absPos - stepTick;
 
     fraction<uint64_t> t = shortestDelay * m_tempo;
 
@@ -1419,9 +1678,10 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::parseEvent(const uint8_t **pptr, c
             return evt;
         }
         evt.type = MidiEvent::T_SYSEX;
-        evt.data.clear();
-        evt.data.push_back(byte);
-        std::copy(ptr, ptr + length, std::back_inserter(evt.data));
+        uint8_t *sysExData = setEventData(evt, NULL, (size_t)length + 1);
+        sysExData[0] = byte;
+        if(length > 0)
+            std::memcpy(sysExData + 1, ptr, (size_t)length);
         ptr += (size_t)length;
         return evt;
     }
@@ -1437,18 +1697,18 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::parseEvent(const uint8_t **pptr, c
             evt.isValid = 0;
             return evt;
         }
+        const uint8_t *rawData = ptr;
         std::string data(length ? (const char *)ptr : NULL, (size_t)length);
         ptr += (size_t)length;
 
         evt.type = byte;
         evt.subtype = evtype;
-        evt.data.insert(evt.data.begin(), data.begin(), data.end());
 
 #if 0 /* Print all tempo events */
         if(evt.subtype == MidiEvent::ST_TEMPOCHANGE)
         {
             if(hooks.onDebugMessage)
-                hooks.onDebugMessage(hooks.onDebugMessage_userData, "Temp Change: %02X%02X%02X", evt.data[0], evt.data[1], evt.data[2]);
+                hooks.onDebugMessage(hooks.onDebugMessage_userData, "Temp Change: %02X%02X%02X", rawData[0], rawData[1], rawData[2]);
         }
 #endif
 
@@ -1458,14 +1718,14 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::parseEvent(const uint8_t **pptr, c
         {
             if(m_musCopyright.empty())
             {
-                m_musCopyright = std::string((const char *)evt.data.data(), evt.data.size());
+                m_musCopyright = data;
                 m_musCopyright.push_back('\0'); /* ending fix for UTF16 strings */
                 if(m_interface->onDebugMessage)
                     m_interface->onDebugMessage(m_interface->onDebugMessage_userData, "Music copyright: %s", m_musCopyright.c_str());
             }
             else if(m_interface->onDebugMessage)
             {
-                std::string str((const char *)evt.data.data(), evt.data.size());
+                std::string str(data);
                 str.push_back('\0'); /* ending fix for UTF16 strings */
                 m_interface->onDebugMessage(m_interface->onDebugMessage_userData, "Extra copyright event: %s", str.c_str());
             }
@@ -1474,14 +1734,14 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::parseEvent(const uint8_t **pptr, c
         {
             if(m_musTitle.empty())
             {
-                m_musTitle = std::string((const char *)evt.data.data(), evt.data.size());
+                m_musTitle = data;
                 m_musTitle.push_back('\0'); /* ending fix for UTF16 strings */
                 if(m_interface->onDebugMessage)
                     m_interface->onDebugMessage(m_interface->onDebugMessage_userData, "Music title: %s", m_musTitle.c_str());
             }
             else
             {
-                std::string str((const char *)evt.data.data(), evt.data.size());
+                std::string str(data);
                 str.push_back('\0'); /* ending fix for UTF16 strings */
                 m_musTrackTitles.push_back(str);
                 if(m_interface->onDebugMessage)
@@ -1492,7 +1752,7 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::parseEvent(const uint8_t **pptr, c
         {
             if(m_interface->onDebugMessage)
             {
-                std::string str((const char *)evt.data.data(), evt.data.size());
+                std::string str(data);
                 str.push_back('\0'); /* ending fix for UTF16 strings */
                 m_interface->onDebugMessage(m_interface->onDebugMessage_userData, "Instrument: %s", str.c_str());
             }
@@ -1510,16 +1770,14 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::parseEvent(const uint8_t **pptr, c
             {
                 // Return a custom Loop Start event instead of Marker
                 evt.subtype = MidiEvent::ST_LOOPSTART;
-                evt.data.clear(); // Data is not needed
-                return evt;
+                return evt; // Data is not needed
             }
 
             if(data == "loopend")
             {
                 // Return a custom Loop End event instead of Marker
                 evt.subtype = MidiEvent::ST_LOOPEND;
-                evt.data.clear(); // Data is not needed
-                return evt;
+                return evt; // Data is not needed
             }
 
             if(data.substr(0, 10) == "loopstart=")
@@ -1527,8 +1785,7 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::parseEvent(const uint8_t **pptr, c
                 evt.type = MidiEvent::T_SPECIAL;
                 evt.subtype = MidiEvent::ST_LOOPSTACK_BEGIN;
                 uint8_t loops = static_cast<uint8_t>(atoi(data.substr(10).c_str()));
-                evt.data.clear();
-                evt.data.push_back(loops);
+                setEventData(evt, &loops, 1);
 
                 if(m_interface->onDebugMessage)
                 {
@@ -1547,7 +1804,6 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::parseEvent(const uint8_t **pptr, c
             {
                 evt.type = MidiEvent::T_SPECIAL;
                 evt.subtype = MidiEvent::ST_LOOPSTACK_END;
-                evt.data.clear();
 
                 if(m_interface->onDebugMessage)
                 {
@@ -1563,6 +1819,8 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::parseEvent(const uint8_t **pptr, c
             }
         }
 
+        setEventData(evt, rawData, (size_t)length);
+
         if(evtype == MidiEvent::ST_ENDTRACK)
             status = -1; // Finalize track
 
@@ -1586,7 +1844,8 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::parseEvent(const uint8_t **pptr, c
             return evt;
         }
         evt.type = byte;
-        evt.data.push_back(*(ptr++));
+        evt.data[0] = *(ptr++);
+        evt.dataSize = 1;
         return evt;
     }
 
@@ -1600,8 +1859,9 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::parseEvent(const uint8_t **pptr, c
             return evt;
         }
         evt.type = byte;
-        evt.data.push_back(*(ptr++));
-        evt.data.push_back(*(ptr++));
+        evt.data[0] = *(ptr++);
+        evt.data[1] = *(ptr++);
+        evt.dataSize = 2;
         return evt;
     }
 
@@ -1624,8 +1884,9 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::parseEvent(const uint8_t **pptr, c
             return evt;
         }
 
-        evt.data.push_back(*(ptr++));
-        evt.data.push_back(*(ptr++));
+        evt.data[0] = *(ptr++);
+        evt.data[1] = *(ptr++);
+        evt.dataSize = 2;
 
         if((evType == MidiEvent::T_NOTEON) && (evt.data[1] == 0))
         {
@@ -1645,7 +1906,7 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::parseEvent(const uint8_t **pptr, c
                         // Change event type to custom Loop Start event and clear data
                         evt.type = MidiEvent::T_SPECIAL;
                         evt.subtype = MidiEvent::ST_LOOPSTART;
-                        evt.data.clear();
+                        evt.dataSize = 0;
                         m_loopFormat = Loop_HMI;
                     }
                     else if(m_loopFormat == Loop_HMI)
@@ -1661,14 +1922,14 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::parseEvent(const uint8_t **pptr, c
                         // Change event type to custom Loop End event and clear data
                         evt.type = MidiEvent::T_SPECIAL;
                         evt.subtype = MidiEvent::ST_LOOPEND;
-                        evt.data.clear();
+                        evt.dataSize = 0;
                     }
                     else if(m_loopFormat != Loop_EMIDI)
                     {
                         // Change event type to custom Loop Start event and clear data
                         evt.type = MidiEvent::T_SPECIAL;
                         evt.subtype = MidiEvent::ST_LOOPSTART;
-                        evt.data.clear();
+                        evt.dataSize = 0;
                     }
                     break;
 
@@ -1686,7 +1947,7 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::parseEvent(const uint8_t **pptr, c
                         evt.type = MidiEvent::T_SPECIAL;
                         evt.subtype = MidiEvent::ST_LOOPSTACK_BEGIN;
                         evt.data[0] = evt.data[1];
-                        evt.data.pop_back();
+                        evt.dataSize = 1;
 
                         if(m_interface->onDebugMessage)
                         {
@@ -1706,7 +1967,7 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::parseEvent(const uint8_t **pptr, c
                     {
                         evt.type = MidiEvent::T_SPECIAL;
                         evt.subtype = MidiEvent::ST_LOOPSTACK_END;
-                        evt.data.clear();
+                        evt.dataSize = 0;
 
                         if(m_interface->onDebugMessage)
                         {
@@ -1731,7 +1992,7 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::parseEvent(const uint8_t **pptr, c
                     evt.type = MidiEvent::T_SPECIAL;
                     evt.subtype = MidiEvent::ST_LOOPSTACK_BEGIN;
                     evt.data[0] = evt.data[1];
-                    evt.data.pop_back();
+                    evt.dataSize = 1;
 
                     if(m_interface->onDebugMessage)
                     {
@@ -1750,7 +2011,7 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::parseEvent(const uint8_t **pptr, c
                     evt.subtype = evt.data[1] < 64 ?
                                 MidiEvent::ST_LOOPSTACK_BREAK :
                                 MidiEvent::ST_LOOPSTACK_END;
-                    evt.data.clear();
+                    evt.dataSize = 0;
 
                     if(m_interface->onDebugMessage)
                     {
@@ -1767,7 +2028,8 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::parseEvent(const uint8_t **pptr, c
                 case 119:  // Callback Trigger
                     evt.type = MidiEvent::T_SPECIAL;
                     evt.subtype = MidiEvent::ST_CALLBACK_TRIGGER;
-                    evt.data.assign(1, evt.data[1]);
+                    evt.data[0] = evt.data[1];
+                    evt.dataSize = 1;
                     break;
                 }
             }
@@ -1782,7 +2044,8 @@ BW_MidiSequencer::MidiEvent BW_MidiSequencer::parseEvent(const uint8_t **pptr, c
             evt.isValid = 0;
             return evt;
         }
-        evt.data.push_back(*(ptr++));
+        evt.data[0] = *(ptr++);
+        evt.dataSize = 1;
         return evt;
     default:
         break;
@@ -1811,12 +2074,12 @@ void BW_MidiSequencer::handleEvent(size_t track, const BW_MidiSequencer::MidiEve
     {
         m_interface->onEvent(m_interface->onEvent_userData,
                              evt.type, evt.subtype, evt.channel,
-                             evt.data.data(), evt.data.size());
+                             getEventData(evt), evt.dataSize);
     }
 
     if(evt.type == MidiEvent::T_SYSEX || evt.type == MidiEvent::T_SYSEX2) // Ignore SysEx
     {
-        m_interface->rt_systemExclusive(m_interface->rtUserData, evt.data.data(), evt.data.size());
+        m_interface->rt_systemExclusive(m_interface->rtUserData, getEventData(evt), evt.dataSize);
         return;
     }
 
@@ -1824,8 +2087,8 @@ void BW_MidiSequencer::handleEvent(size_t track, const BW_MidiSequencer::MidiEve
     {
         // Special event FF
         uint_fast16_t  evtype = evt.subtype;
-        uint64_t length = static_cast<uint64_t>(evt.data.size());
-        const char *data(length ? reinterpret_cast<const char *>(evt.data.data()) : "\0\0\0\0\0\0\0\0");
+        uint64_t length = static_cast<uint64_t>(evt.dataSize);
+        const char *data(length ? reinterpret_cast<const char *>(getEventData(evt)) : "\0\0\0\0\0\0\0\0");
 
         if(m_interface->rt_metaEvent) // Meta event hook
             m_interface->rt_metaEvent(m_interface->rtUserData, evtype, reinterpret_cast<const uint8_t*>(data), size_t(length));
@@ -1838,7 +2101,7 @@ void BW_MidiSequencer::handleEvent(size_t track, const BW_MidiSequencer::MidiEve
 
         if(evtype == MidiEvent::ST_TEMPOCHANGE) // Tempo change
         {
-            m_tempo = m_invDeltaTicks * fraction<uint64_t>(readBEint(evt.data.data(), evt.data.size()));
+            m_tempo = m_invDeltaTicks * fraction<uint64_t>(readBEint(data, evt.dataSize));
             return;
         }
 
@@ -2047,83 +2310,480 @@ double BW_MidiSequencer::Tick(double s, double granularity)
 }
 
 
-double BW_MidiSequencer::seek(double seconds, const double granularity)
-{
-    if(seconds < 0.0)
-        return 0.0; // Seeking negative position is forbidden! :-P
-    const double granualityHalf = granularity * 0.5,
-                 s = seconds; // m_setup.delay < m_setup.maxdelay ? m_setup.delay : m_setup.maxdelay;
-
-    /* Attempt to go away out of song end must rewind position to begin */
-    if(seconds > m_fullSongTimeLength)
-    {
-        this->rewind();
-        return 0.0;
-    }
+void BW_MidiSequencer::seekRtNoteOn(void *, uint8_t, uint8_t, uint8_t)
+{}
 
-    bool loopFlagState = m_loopEnabled;
-    // Turn loop pooints off because it causes wrong position rememberin on a quick seek
-    m_loopEnabled = false;
+void BW_MidiSequencer::seekRtNoteOff(void *, uint8_t, uint8_t)
+{}
 
-    /*
-     * Seeking search is similar to regular ticking, except of next things:
-     * - We don't processsing arpeggio and vibrato
-     * - To keep correctness of the state after seek, begin every search from begin
-     * - All sustaining notes must be killed
-     * - Ignore Note-On events
-     */
-    this->rewind();
+void BW_MidiSequencer::seekRtNoteAfterTouch(void *, uint8_t, uint8_t, uint8_t)
+{}
 
-    /*
-     * Set "loop Start" to false to prevent overwrite of loopStart position with
-     * seek destinition position
-     *
-     * TODO: Detect & set loopStart position on load time to don't break loop while seeking
-     */
-    m_loop.caughtStart   = false;
+void BW_MidiSequencer::seekRtChannelAfterTouch(void *userdata, uint8_t channel, uint8_t atVal)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+    SeekChannelState &ch = self->m_seekState.channels[channel & 0x0F];
+    self->m_seekChannelsChanged = true;
+    ch.afterTouch = atVal;
+    ch.flags |= SeekChannelState::F_AFTERTOUCH;
+}
 
-    m_loop.temporaryBroken = (seconds >= m_loopEndTime);
+void BW_MidiSequencer::seekRtControllerChange(void *userdata, uint8_t channel, uint8_t type, uint8_t value)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+    SeekChannelState &ch = self->m_seekState.channels[channel & 0x0F];
+    self->m_seekChannelsChanged = true;
+    type &= 0x7F;
 
-    while((m_currentPosition.absTimePosition < seconds) &&
-          (m_currentPosition.absTimePosition < m_fullSongTimeLength))
+    switch(type)
     {
-        m_currentPosition.wait -= s;
-        m_currentPosition.absTimePosition += s;
-        int antiFreezeCounter = 10000; // Limit 10000 loops to avoid freezing
-        double dstWait = m_currentPosition.wait + granualityHalf;
-        while((m_currentPosition.wait <= granualityHalf)/*&& (antiFreezeCounter > 0)*/)
+    case 6:  // Data entry MSB
+    case 38: // Data entry LSB
+    {
+        // Only the values of registered parameters are kept, the data of
+        // non-registered ones is synthesizer-specific and never restored
+        const uint16_t selected = SeekChannelState::F_PARAM_MSB | SeekChannelState::F_PARAM_LSB;
+        const bool rpnSelected = !(ch.flags & SeekChannelState::F_NRPN) && (ch.flags & selected) == selected;
+        if(rpnSelected && ch.param[0] == 0 && ch.param[1] < SeekChannelState::RPN_COUNT)
         {
-            // std::fprintf(stderr, "wait = %g...\n", CurrentPosition.wait);
-            if(!processEvents(true))
-                break;
-            // Avoid freeze because of no waiting increasing in more than 10000 cycles
-            if(m_currentPosition.wait <= dstWait)
-                antiFreezeCounter--;
-            else
-            {
-                dstWait = m_currentPosition.wait + granualityHalf;
-                antiFreezeCounter = 10000;
-            }
+            const size_t rpn = ch.param[1];
+            const size_t part = (type == 6) ? 0 : 1;
+            ch.rpnData[rpn][part] = value;
+            ch.rpnSet[rpn] |= static_cast<uint8_t>(1 << part);
         }
-        if(antiFreezeCounter <= 0)
-            m_currentPosition.wait += 1.0;/* Add extra 1 second when over 10000 events
-                                             with zero delay are been detected */
+        return;
     }
 
-    if(m_currentPosition.wait < 0.0)
-        m_currentPosition.wait = 0.0;
+    case 96: // Data increment
+    case 97: // Data decrement
+        return;
 
-    if(m_atEnd)
+    // Both kinds of selectors share the same selection, like synthesizers do
+    case 98: // NRPN LSB
+    case 100: // RPN LSB
+        ch.param[1] = value;
+        ch.flags |= SeekChannelState::F_PARAM_LSB;
+        if(type == 98)
+            ch.flags |= SeekChannelState::F_NRPN;
+        else
+            ch.flags &= ~SeekChannelState::F_NRPN;
+        return;
+
+    case 99: // NRPN MSB
+    case 101: // RPN MSB
+        ch.param[0] = value;
+        ch.flags |= SeekChannelState::F_PARAM_MSB;
+        if(type == 99)
+            ch.flags |= SeekChannelState::F_NRPN;
+        else
+            ch.flags &= ~SeekChannelState::F_NRPN;
+        return;
+
+    case 121: // Reset all controllers
     {
-        this->rewind();
-        m_loopEnabled = loopFlagState;
-        return 0.0;
+        // Synthesizers are resetting different things: keep the state set
+        // before to send it before the reset
+        SeekChannelState &before = self->m_seekState.channelsBeforeReset[channel & 0x0F];
+        mergeSeekChannel(before, ch);
+        std::memset(&ch, 0, sizeof(ch));
+        ch.flags = SeekChannelState::F_RESET;
+        return;
     }
 
-    m_time.reset();
-    m_time.delay = m_currentPosition.wait;
+    default:
+        if(type >= 120) // Channel mode messages
+            return;
+        break;
+    }
 
-    m_loopEnabled = loopFlagState;
+    ch.controllers[type] = value;
+    ch.controllersSet[type / 8] |= static_cast<uint8_t>(1 << (type % 8));
+}
+
+void BW_MidiSequencer::seekRtPatchChange(void *userdata, uint8_t channel, uint8_t patch)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+    SeekChannelState &ch = self->m_seekState.channels[channel & 0x0F];
+    self->m_seekChannelsChanged = true;
+    ch.patch = patch;
+    ch.patchBank[0] = ch.controllers[0];
+    ch.patchBank[1] = ch.controllers[32];
+    ch.flags &= ~(SeekChannelState::F_PATCH_MSB | SeekChannelState::F_PATCH_LSB);
+    ch.flags |= SeekChannelState::F_PATCH;
+    if(ch.controllersSet[0] & 0x01)
+        ch.flags |= SeekChannelState::F_PATCH_MSB;
+    if(ch.controllersSet[32 / 8] & 0x01)
+        ch.flags |= SeekChannelState::F_PATCH_LSB;
+}
+
+void BW_MidiSequencer::seekRtPitchBend(void *userdata, uint8_t channel, uint8_t msb, uint8_t lsb)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+    SeekChannelState &ch = self->m_seekState.channels[channel & 0x0F];
+    self->m_seekChannelsChanged = true;
+    ch.bend[0] = msb;
+    ch.bend[1] = lsb;
+    ch.flags |= SeekChannelState::F_BEND;
+}
+
+void BW_MidiSequencer::seekRtSysEx(void *userdata, const uint8_t *msg, size_t size)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+    if(self->m_seekChannelsChanged)
+    {
+        // The restore sends SysEx messages before the channel state: a message
+        // like GM reset must not come after the channel state it resets
+        self->m_seekSysExAfterChannels = true;
+        return;
+    }
+    self->m_seekSysExData.insert(self->m_seekSysExData.end(), msg, msg + size);
+    self->m_seekSysExSizes.push_back(size);
+    self->m_seekState.sysExCount++;
+}
+
+void BW_MidiSequencer::seekMetaEvent(void *userdata, uint8_t type, const uint8_t *, size_t)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+    if(type == MidiEvent::ST_TEMPOCHANGE)
+        self->m_seekState.tempoKnown = true;
+}
+
+void BW_MidiSequencer::seekRtDeviceSwitch(void *userdata, size_t, const char *, size_t)
+{
+    // Multi-device songs are using more than 16 channels
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+    self->m_seekCheckpointsUnusable = true;
+}
+
+void BW_MidiSequencer::seekRtRawOPL(void *userdata, uint8_t, uint8_t)
+{
+    // The state of the chip is not tracked
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+    self->m_seekCheckpointsUnusable = true;
+}
+
+void BW_MidiSequencer::seekSongStart(void *userdata)
+{
+    BW_MidiSequencer *self = reinterpret_cast<BW_MidiSequencer *>(userdata);
+    self->m_seekState.songStarted = true;
+}
+
+void BW_MidiSequencer::resetSeekCheckpoints()
+{
+    m_seekCheckpoints.clear();
+    m_seekSysExData.clear();
+    m_seekSysExSizes.clear();
+    m_seekCheckpointsReady = false;
+}
+
+void BW_MidiSequencer::buildSeekCheckpoints()
+{
+    BW_MidiRtInterface seekInterface;
+    const BW_MidiRtInterface *realInterface = m_interface;
+    const TriggerHandler realTriggerHandler = m_triggerHandler;
+    const fraction<uint64_t> realTempo = m_tempo;
+    const bool loopFlagState = m_loopEnabled;
+    size_t steps = 0;
+
+    resetSeekCheckpoints();
+    m_seekCheckpointsReady = true;
+
+    std::memset(&seekInterface, 0, sizeof(seekInterface));
+    seekInterface.rtUserData = this;
+    seekInterface.onSongStart = seekSongStart;
+    seekInterface.onSongStart_userData = this;
+    seekInterface.rt_noteOn = seekRtNoteOn;
+    seekInterface.rt_noteOff = seekRtNoteOff;
+    seekInterface.rt_noteAfterTouch = seekRtNoteAfterTouch;
+    seekInterface.rt_channelAfterTouch = seekRtChannelAfterTouch;
+    seekInterface.rt_controllerChange = seekRtControllerChange;
+    seekInterface.rt_patchChange = seekRtPatchChange;
+    seekInterface.rt_pitchBend = seekRtPitchBend;
+    seekInterface.rt_systemExclusive = seekRtSysEx;
+    seekInterface.rt_metaEvent = seekMetaEvent;
+    seekInterface.rt_deviceSwitch = seekRtDeviceSwitch;
+    seekInterface.rt_rawOPL = seekRtRawOPL;
+
+    // Walk through the whole song in the same way as seek does, but silently
+    m_interface = &seekInterface;
+    m_triggerHandler = NULL;
+    m_loopEnabled = false;
+
+    std::memset(m_seekState.channels, 0, sizeof(m_seekState.channels));
+    std::memset(m_seekState.channelsBeforeReset, 0, sizeof(m_seekState.channelsBeforeReset));
+    m_seekState.tempo = m_tempo;
+    m_seekState.tempoKnown = false;
+    m_seekState.songStarted = false;
+    m_seekState.sysExCount = 0;
+    m_seekChannelsChanged = false;
+    m_seekSysExAfterChannels = false;
+
+    this->rewind();
+    m_loop.caughtStart = false;
+
+    // Seeking past the last checkpoint replays the rest of the song in full
+    while(!m_seekCheckpointsUnusable && !m_atEnd && processEvents(true))
+    {
+        if(m_seekSysExAfterChannels)
+            break;
+
+        if(++steps < SEEK_CHECKPOINT_STEPS || m_atEnd)
+            continue;
+
+        steps = 0;
+        m_seekState.tempo = m_tempo;
+        m_seekCheckpoints.push_back(SeekCheckpoint());
+        m_seekCheckpoints.back().position = m_currentPosition;
+        m_seekCheckpoints.back().state = m_seekState;
+    }
+
+    if(m_seekCheckpointsUnusable)
+        resetSeekCheckpoints();
+
+    m_interface = realInterface;
+    m_triggerHandler = realTriggerHandler;
+    m_tempo = realTempo;
+    m_loopEnabled = loopFlagState;
+    this->rewind();
+}
+
+void BW_MidiSequencer::restoreSeekCheckpoint(const SeekCheckpoint &cp)
+{
+    const SeekState &st = cp.state;
+    void *ud = m_interface->rtUserData;
+    const uint8_t *sysEx = m_seekSysExData.empty() ? NULL : &m_seekSysExData[0];
+
+    m_currentPosition = cp.position;
+    if(st.tempoKnown)
+        m_tempo = st.tempo;
+
+    if(st.songStarted && m_interface->onSongStart)
+        m_interface->onSongStart(m_interface->onSongStart_userData);
+
+    for(size_t i = 0; i < st.sysExCount; ++i)
+    {
+        m_interface->rt_systemExclusive(ud, sysEx, m_seekSysExSizes[i]);
+        sysEx += m_seekSysExSizes[i];
+    }
+
+    for(uint8_t c = 0; c < 16; ++c)
+    {
+        const SeekChannelState &ch = st.channels[c];
+        if(ch.flags & SeekChannelState::F_RESET)
+        {
+            restoreSeekChannel(c, st.channelsBeforeReset[c]);
+            m_interface->rt_controllerChange(ud, c, 121, 0);
+        }
+        restoreSeekChannel(c, ch);
+    }
+}
+
+void BW_MidiSequencer::mergeSeekChannel(SeekChannelState &dst, const SeekChannelState &src)
+{
+    const uint16_t selected = SeekChannelState::F_PARAM_MSB | SeekChannelState::F_PARAM_LSB;
+
+    for(size_t ctl = 0; ctl < 128; ++ctl)
+    {
+        if(src.controllersSet[ctl / 8] & (1 << (ctl % 8)))
+        {
+            dst.controllers[ctl] = src.controllers[ctl];
+            dst.controllersSet[ctl / 8] |= static_cast<uint8_t>(1 << (ctl % 8));
+        }
+    }
+
+    for(size_t rpn = 0; rpn < SeekChannelState::RPN_COUNT; ++rpn)
+    {
+        for(size_t part = 0; part < 2; ++part)
+        {
+            if(src.rpnSet[rpn] & (1 << part))
+                dst.rpnData[rpn][part] = src.rpnData[rpn][part];
+        }
+        dst.rpnSet[rpn] |= src.rpnSet[rpn];
+    }
+
+    if(src.flags & SeekChannelState::F_PATCH)
+    {
+        dst.patch = src.patch;
+        dst.patchBank[0] = src.patchBank[0];
+        dst.patchBank[1] = src.patchBank[1];
+        dst.flags &= ~(SeekChannelState::F_PATCH_MSB | SeekChannelState::F_PATCH_LSB);
+        dst.flags |= src.flags & (SeekChannelState::F_PATCH | SeekChannelState::F_PATCH_MSB | SeekChannelState::F_PATCH_LSB);
+    }
+
+    if(src.flags & SeekChannelState::F_BEND)
+    {
+        dst.bend[0] = src.bend[0];
+        dst.bend[1] = src.bend[1];
+        dst.flags |= SeekChannelState::F_BEND;
+    }
+
+    if(src.flags & SeekChannelState::F_AFTERTOUCH)
+    {
+        dst.afterTouch = src.afterTouch;
+        dst.flags |= SeekChannelState::F_AFTERTOUCH;
+    }
+
+    // The last selector decides the kind of the selected parameter
+    if(src.flags & selected)
+    {
+        if(src.flags & SeekChannelState::F_PARAM_MSB)
+            dst.param[0] = src.param[0];
+        if(src.flags & SeekChannelState::F_PARAM_LSB)
+            dst.param[1] = src.param[1];
+        dst.flags &= ~SeekChannelState::F_NRPN;
+        dst.flags |= src.flags & (selected | SeekChannelState::F_NRPN);
+    }
+
+    dst.flags |= src.flags & SeekChannelState::F_RESET;
+}
+
+void BW_MidiSequencer::restoreSeekChannel(uint8_t c, const SeekChannelState &ch)
+{
+    void *ud = m_interface->rtUserData;
+
+    if(ch.flags & SeekChannelState::F_PATCH)
+    {
+        if(ch.flags & SeekChannelState::F_PATCH_MSB)
+            m_interface->rt_controllerChange(ud, c, 0, ch.patchBank[0]);
+        if(ch.flags & SeekChannelState::F_PATCH_LSB)
+            m_interface->rt_controllerChange(ud, c, 32, ch.patchBank[1]);
+        m_interface->rt_patchChange(ud, c, ch.patch);
+    }
+
+    // Registered parameters were set with both parts of the selection sent
+    // in this state, so these are restored by the selection below
+    for(uint8_t rpn = 0; rpn < SeekChannelState::RPN_COUNT; ++rpn)
+    {
+        if(!ch.rpnSet[rpn])
+            continue;
+        m_interface->rt_controllerChange(ud, c, 101, 0);
+        m_interface->rt_controllerChange(ud, c, 100, rpn);
+        if(ch.rpnSet[rpn] & 1)
+            m_interface->rt_controllerChange(ud, c, 6, ch.rpnData[rpn][0]);
+        if(ch.rpnSet[rpn] & 2)
+            m_interface->rt_controllerChange(ud, c, 38, ch.rpnData[rpn][1]);
+    }
+
+    for(uint8_t ctl = 0; ctl < 120; ++ctl)
+    {
+        if(ctl == 6 || ctl == 38 || (ctl >= 96 && ctl <= 101))
+            continue; // Data entries and parameter selectors are restored separately
+        if(ch.controllersSet[ctl / 8] & (1 << (ctl % 8)))
+            m_interface->rt_controllerChange(ud, c, ctl, ch.controllers[ctl]);
+    }
+
+    // Restore the parameter selection, without any data for it
+    {
+        const bool nrpn = (ch.flags & SeekChannelState::F_NRPN) != 0;
+        if(ch.flags & SeekChannelState::F_PARAM_MSB)
+            m_interface->rt_controllerChange(ud, c, nrpn ? 99 : 101, ch.param[0]);
+        if(ch.flags & SeekChannelState::F_PARAM_LSB)
+            m_interface->rt_controllerChange(ud, c, nrpn ? 98 : 100, ch.param[1]);
+    }
+
+    if(ch.flags & SeekChannelState::F_BEND)
+        m_interface->rt_pitchBend(ud, c, ch.bend[0], ch.bend[1]);
+
+    if(ch.flags & SeekChannelState::F_AFTERTOUCH)
+        m_interface->rt_channelAfterTouch(ud, c, ch.afterTouch);
+}
+
+double BW_MidiSequencer::seek(double seconds, const double granularity)
+{
+    if(seconds < 0.0)
+        return 0.0; // Seeking negative position is forbidden! :-P
+    const double granualityHalf = granularity * 0.5,
+                 s = seconds; // m_setup.delay < m_setup.maxdelay ? m_setup.delay : m_setup.maxdelay;
+
+    /* Attempt to go away out of song end must rewind position to begin */
+    if(seconds > m_fullSongTimeLength)
+    {
+        this->rewind();
+        return 0.0;
+    }
+
+    bool loopFlagState = m_loopEnabled;
+    // Turn loop pooints off because it causes wrong position rememberin on a quick seek
+    m_loopEnabled = false;
+
+    /*
+     * Seeking search is similar to regular ticking, except of next things:
+     * - We don't processsing arpeggio and vibrato
+     * - To keep correctness of the state after seek, begin every search from begin
+     * - All sustaining notes must be killed
+     * - Ignore Note-On events
+     * - Begin from the nearest checkpoint to skip most of the song
+     */
+    if(!m_seekCheckpointsReady)
+        buildSeekCheckpoints();
+
+    this->rewind();
+
+    /*
+     * Set "loop Start" to false to prevent overwrite of loopStart position with
+     * seek destinition position
+     *
+     * TODO: Detect & set loopStart position on load time to don't break loop while seeking
+     */
+    m_loop.caughtStart   = false;
+
+    m_loop.temporaryBroken = (seconds >= m_loopEndTime);
+
+    if(!m_seekCheckpoints.empty() && m_seekCheckpoints.front().position.wait <= seconds)
+    {
+        // Find the last checkpoint placed before the destination
+        size_t lo = 0, hi = m_seekCheckpoints.size();
+        while(hi - lo > 1)
+        {
+            size_t mid = lo + (hi - lo) / 2;
+            if(m_seekCheckpoints[mid].position.wait <= seconds)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        restoreSeekCheckpoint(m_seekCheckpoints[lo]);
+    }
+
+    while((m_currentPosition.absTimePosition < seconds) &&
+          (m_currentPosition.absTimePosition < m_fullSongTimeLength))
+    {
+        m_currentPosition.wait -= s;
+        m_currentPosition.absTimePosition += s;
+        int antiFreezeCounter = 10000; // Limit 10000 loops to avoid freezing
+        double dstWait = m_currentPosition.wait + granualityHalf;
+        while((m_currentPosition.wait <= granualityHalf)/*&& (antiFreezeCounter > 0)*/)
+        {
+            // std::fprintf(stderr, "wait = %g...\n", CurrentPosition.wait);
+            if(!processEvents(true))
+                break;
+            // Avoid freeze because of no waiting increasing in more than 10000 cycles
+            if(m_currentPosition.wait <= dstWait)
+                antiFreezeCounter--;
+            else
+            {
+                dstWait = m_currentPosition.wait + granualityHalf;
+                antiFreezeCounter = 10000;
+            }
+        }
+        if(antiFreezeCounter <= 0)
+            m_currentPosition.wait += 1.0;/* Add extra 1 second when over 10000 events
+                                             with zero delay are been detected */
+    }
+
+    if(m_currentPosition.wait < 0.0)
+        m_currentPosition.wait = 0.0;
+
+    if(m_atEnd)
+    {
+        this->rewind();
+        m_loopEnabled = loopFlagState;
+        return 0.0;
+    }
+
+    m_time.reset();
+    m_time.delay = m_currentPosition.wait;
+
+    m_loopEnabled = loopFlagState;
     return m_currentPosition.wait;
 }
 
@@ -2225,6 +2885,432 @@ static bool detectRSXX(const char *head, FileAndMemReader &fr)
     return ret;
 }
 
+/*
+ * Song cache: the built timeline of the song stored as the sequence of
+ * little-endian values. Once the format changes, the version must be bumped
+ * to make the old caches being rejected.
+ */
+static const char       s_songCacheMagic[] = "BWSQCACH";
+static const uint32_t   s_songCacheVersion = 1;
+
+static void songCacheWriteU8(std::vector<uint8_t> &out, uint8_t value)
+{
+    out.push_back(value);
+}
+
+static void songCacheWriteU16(std::vector<uint8_t> &out, uint16_t value)
+{
+    out.push_back(static_cast<uint8_t>(value & 0xFF));
+    out.push_back(static_cast<uint8_t>((value >> 8) & 0xFF));
+}
+
+static void songCacheWriteU32(std::vector<uint8_t> &out, uint32_t value)
+{
+    for(size_t i = 0; i < 4; ++i)
+        out.push_back(static_cast<uint8_t>((value >> (i * 8)) & 0xFF));
+}
+
+static void songCacheWriteU64(std::vector<uint8_t> &out, uint64_t value)
+{
+    for(size_t i = 0; i < 8; ++i)
+        out.push_back(static_cast<uint8_t>((value >> (i * 8)) & 0xFF));
+}
+
+static void songCacheWriteDouble(std::vector<uint8_t> &out, double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    songCacheWriteU64(out, bits);
+}
+
+static void songCacheWriteString(std::vector<uint8_t> &out, const std::string &str)
+{
+    songCacheWriteU32(out, static_cast<uint32_t>(str.size()));
+    out.insert(out.end(), str.begin(), str.end());
+}
+
+static inline uint16_t songCacheGetU16(const uint8_t *p)
+{
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t songCacheGetU32(const uint8_t *p)
+{
+    return static_cast<uint32_t>(p[0]) |
+           (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) |
+           (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static inline uint64_t songCacheGetU64(const uint8_t *p)
+{
+    return static_cast<uint64_t>(songCacheGetU32(p)) |
+           (static_cast<uint64_t>(songCacheGetU32(p + 4)) << 32);
+}
+
+static inline double songCacheGetDouble(const uint8_t *p)
+{
+    uint64_t bits = songCacheGetU64(p);
+    double ret;
+    std::memcpy(&ret, &bits, sizeof(ret));
+    return ret;
+}
+
+/**
+ * @brief Bounds-checked reader of the song cache data
+ */
+struct BW_MidiSongCacheReader
+{
+    const uint8_t *ptr;
+    const uint8_t *end;
+    //! Turns false once the data end was passed
+    bool ok;
+
+    BW_MidiSongCacheReader(const uint8_t *data, size_t size) :
+        ptr(data), end(data + size), ok(true)
+    {}
+
+    //! Checks that the given count of records can be read yet
+    bool fits(uint64_t count, size_t recordSize) const
+    {
+        return ok && (recordSize == 0 || count <= static_cast<uint64_t>(end - ptr) / recordSize);
+    }
+
+    /**
+     * @brief Take the block of given count of records
+     * @return Pointer to the block begin, or NULL if there is no enough data left
+     */
+    const uint8_t *take(uint64_t count, size_t recordSize)
+    {
+        const uint8_t *ret = ptr;
+        if(!fits(count, recordSize))
+        {
+            ok = false;
+            return NULL;
+        }
+        ptr += static_cast<size_t>(count) * recordSize;
+        return ret;
+    }
+
+    uint8_t u8()    { const uint8_t *p = take(1, 1); return p ? p[0] : 0; }
+    uint32_t u32()  { const uint8_t *p = take(1, 4); return p ? songCacheGetU32(p) : 0; }
+    uint64_t u64()  { const uint8_t *p = take(1, 8); return p ? songCacheGetU64(p) : 0; }
+    double f64()    { const uint8_t *p = take(1, 8); return p ? songCacheGetDouble(p) : 0.0; }
+
+    void string(std::string &str)
+    {
+        uint32_t size = u32();
+        const uint8_t *p = take(size, 1);
+        if(p)
+            str.assign(reinterpret_cast<const char *>(p), size);
+    }
+};
+
+bool BW_MidiSequencer::saveSongCache(std::vector<uint8_t> &out) const
+{
+    if(m_trackData.empty())
+        return false;
+
+    out.clear();
+    out.reserve(64 + m_eventsBank.size() * 32 + m_schedule.size() * 8 + m_dataBank.size());
+    out.insert(out.end(), s_songCacheMagic, s_songCacheMagic + 8);
+    songCacheWriteU32(out, s_songCacheVersion);
+
+    songCacheWriteU8(out, static_cast<uint8_t>(m_format));
+    songCacheWriteU32(out, m_smfFormat);
+    songCacheWriteU8(out, static_cast<uint8_t>(m_loopFormat));
+    songCacheWriteU64(out, m_invDeltaTicks.nom());
+    songCacheWriteU64(out, m_invDeltaTicks.denom());
+    songCacheWriteU64(out, m_tempo.nom());
+    songCacheWriteU64(out, m_tempo.denom());
+    songCacheWriteDouble(out, m_fullSongTimeLength);
+
+    // Loop points
+    songCacheWriteU8(out, m_loop.invalidLoop ? 1 : 0);
+    songCacheWriteDouble(out, m_loopStartTime);
+    songCacheWriteDouble(out, m_loopEndTime);
+    songCacheWriteU64(out, m_loopBeginPosition.schedulePos);
+    songCacheWriteDouble(out, m_loopBeginPosition.absTimePosition);
+    songCacheWriteU32(out, static_cast<uint32_t>(m_loop.stack.size()));
+    for(size_t i = 0; i < m_loop.stack.size(); ++i)
+    {
+        const LoopStackEntry &e = m_loop.stack[i];
+        songCacheWriteU8(out, e.infinity ? 1 : 0);
+        songCacheWriteU32(out, static_cast<uint32_t>(e.loops));
+        songCacheWriteU64(out, e.start);
+        songCacheWriteU64(out, e.end);
+    }
+
+    // Tracks
+    songCacheWriteU32(out, static_cast<uint32_t>(m_trackData.size()));
+    for(size_t tk = 0; tk < m_trackData.size(); ++tk)
+    {
+        const MidiTrackQueue &track = m_trackData[tk];
+        songCacheWriteU64(out, track.size());
+        for(size_t i = 0; i < track.size(); ++i)
+        {
+            const MidiTrackRow &row = track[i];
+            songCacheWriteDouble(out, row.time);
+            songCacheWriteU64(out, row.delay);
+            songCacheWriteU64(out, row.absPos);
+            songCacheWriteDouble(out, row.timeDelay);
+            songCacheWriteU64(out, row.eventsBegin);
+            songCacheWriteU64(out, row.eventsEnd);
+        }
+    }
+
+    songCacheWriteU64(out, m_schedule.size());
+    for(size_t i = 0; i < m_schedule.size(); ++i)
+    {
+        songCacheWriteU32(out, m_schedule[i].track);
+        songCacheWriteU32(out, m_schedule[i].row);
+    }
+
+    // Events
+    songCacheWriteU64(out, m_eventsBank.size());
+    for(size_t i = 0; i < m_eventsBank.size(); ++i)
+    {
+        const MidiEvent &e = m_eventsBank[i];
+        songCacheWriteU64(out, e.absPosition);
+        songCacheWriteU32(out, e.dataSize);
+        songCacheWriteU32(out, e.dataLoc);
+        songCacheWriteU16(out, e.type);
+        songCacheWriteU16(out, e.subtype);
+        songCacheWriteU8(out, e.channel);
+        songCacheWriteU8(out, e.isValid);
+        out.insert(out.end(), e.data, e.data + MidiEvent::INLINE_DATA_SIZE);
+    }
+
+    songCacheWriteU64(out, m_dataBank.size());
+    out.insert(out.end(), m_dataBank.begin(), m_dataBank.end());
+
+    songCacheWriteU32(out, static_cast<uint32_t>(m_cmfInstruments.size()));
+    for(size_t i = 0; i < m_cmfInstruments.size(); ++i)
+        out.insert(out.end(), m_cmfInstruments[i].data, m_cmfInstruments[i].data + 16);
+
+    // Meta-data
+    songCacheWriteString(out, m_musTitle);
+    songCacheWriteString(out, m_musCopyright);
+    songCacheWriteU32(out, static_cast<uint32_t>(m_musTrackTitles.size()));
+    for(size_t i = 0; i < m_musTrackTitles.size(); ++i)
+        songCacheWriteString(out, m_musTrackTitles[i]);
+    songCacheWriteU32(out, static_cast<uint32_t>(m_musMarkers.size()));
+    for(size_t i = 0; i < m_musMarkers.size(); ++i)
+    {
+        songCacheWriteString(out, m_musMarkers[i].label);
+        songCacheWriteDouble(out, m_musMarkers[i].pos_time);
+        songCacheWriteU64(out, m_musMarkers[i].pos_ticks);
+    }
+
+    return true;
+}
+
+bool BW_MidiSequencer::parseSongCache(FileAndMemReader &fr)
+{
+    const size_t headerSize = 12;
+    uint8_t header[headerSize];
+    std::vector<uint8_t> data;
+
+    if(fr.read(header, 1, headerSize) != headerSize ||
+       std::memcmp(header, s_songCacheMagic, 8) != 0)
+    {
+        m_errorString = "Invalid song cache header!\n";
+        return false;
+    }
+
+    if(readLEint(header + 8, 4) != s_songCacheVersion)
+    {
+        m_errorString = "Unsupported version of the song cache!\n";
+        return false;
+    }
+
+    data.resize(fr.fileSize() > headerSize ? fr.fileSize() - headerSize : 0);
+    if(data.empty() || fr.read(data.data(), 1, data.size()) != data.size())
+    {
+        m_errorString = "Failed to read the song cache data!\n";
+        return false;
+    }
+
+    BW_MidiSongCacheReader in(data.data(), data.size());
+
+    FileFormat format = static_cast<FileFormat>(in.u8());
+    unsigned smfFormat = in.u32();
+    LoopFormat loopFormat = static_cast<LoopFormat>(in.u8());
+    uint64_t invDeltaNom = in.u64(), invDeltaDenom = in.u64();
+    uint64_t tempoNom = in.u64(), tempoDenom = in.u64();
+    double songLength = in.f64();
+    bool invalidLoop = (in.u8() != 0);
+    double loopStartTime = in.f64();
+    double loopEndTime = in.f64();
+    uint64_t loopBeginPos = in.u64();
+    double loopBeginTime = in.f64();
+
+    if(!in.ok || (invDeltaDenom == 0) || (tempoDenom == 0) || (format > Format_XMIDI))
+    {
+        m_errorString = "Invalid song cache data!\n";
+        return false;
+    }
+
+    uint32_t stackSize = in.u32();
+    std::vector<LoopStackEntry> loopStack;
+    const uint8_t *p = in.take(stackSize, 21);
+    if(p)
+    {
+        loopStack.resize(stackSize);
+        for(size_t i = 0; i < stackSize; ++i, p += 21)
+        {
+            LoopStackEntry &e = loopStack[i];
+            e.infinity = (p[0] != 0);
+            e.loops = static_cast<int>(songCacheGetU32(p + 1));
+            e.start = songCacheGetU64(p + 5);
+            e.end = songCacheGetU64(p + 13);
+        }
+    }
+
+    // Every track has at least the 8-byte count of rows
+    uint32_t trackCount = in.u32();
+    if(!in.fits(trackCount, 8) || trackCount == 0)
+    {
+        m_errorString = "Invalid song cache data!\n";
+        return false;
+    }
+
+    buildSmfSetupReset(trackCount);
+
+    m_format = format;
+    m_smfFormat = smfFormat;
+    m_loopFormat = loopFormat;
+    m_invDeltaTicks = fraction<uint64_t>(invDeltaNom, invDeltaDenom);
+    m_tempo = fraction<uint64_t>(tempoNom, tempoDenom);
+    m_fullSongTimeLength = songLength;
+    m_loop.invalidLoop = invalidLoop;
+    m_loop.stack = loopStack;
+    m_loopStartTime = loopStartTime;
+    m_loopEndTime = loopEndTime;
+
+    for(size_t tk = 0; tk < trackCount && in.ok; ++tk)
+    {
+        uint64_t rowsCount = in.u64();
+        if(!(p = in.take(rowsCount, 48)))
+            break;
+        MidiTrackQueue &track = m_trackData[tk];
+        track.resize(static_cast<size_t>(rowsCount));
+        for(size_t i = 0; i < track.size(); ++i, p += 48)
+        {
+            MidiTrackRow &row = track[i];
+            row.time = songCacheGetDouble(p);
+            row.delay = songCacheGetU64(p + 8);
+            row.absPos = songCacheGetU64(p + 16);
+            row.timeDelay = songCacheGetDouble(p + 24);
+            row.eventsBegin = static_cast<size_t>(songCacheGetU64(p + 32));
+            row.eventsEnd = static_cast<size_t>(songCacheGetU64(p + 40));
+        }
+    }
+
+    uint64_t scheduleSize = in.u64();
+    if((p = in.take(scheduleSize, 8)) != NULL)
+    {
+        m_schedule.resize(static_cast<size_t>(scheduleSize));
+        for(size_t i = 0; i < m_schedule.size(); ++i, p += 8)
+        {
+            m_schedule[i].track = songCacheGetU32(p);
+            m_schedule[i].row = songCacheGetU32(p + 4);
+        }
+    }
+
+    uint64_t eventsCount = in.u64();
+    if((p = in.take(eventsCount, 32)) != NULL)
+    {
+        m_eventsBank.resize(static_cast<size_t>(eventsCount));
+        for(size_t i = 0; i < m_eventsBank.size(); ++i, p += 32)
+        {
+            MidiEvent &e = m_eventsBank[i];
+            e.absPosition = songCacheGetU64(p);
+            e.dataSize = songCacheGetU32(p + 8);
+            e.dataLoc = songCacheGetU32(p + 12);
+            e.type = songCacheGetU16(p + 16);
+            e.subtype = songCacheGetU16(p + 18);
+            e.channel = p[20];
+            e.isValid = p[21];
+            std::memcpy(e.data, p + 22, MidiEvent::INLINE_DATA_SIZE);
+        }
+    }
+
+    uint64_t dataBankSize = in.u64();
+    if((p = in.take(dataBankSize, 1)) != NULL)
+        m_dataBank.assign(p, p + static_cast<size_t>(dataBankSize));
+
+    uint32_t cmfCount = in.u32();
+    if((p = in.take(cmfCount, 16)) != NULL)
+    {
+        m_cmfInstruments.resize(cmfCount);
+        for(size_t i = 0; i < cmfCount; ++i, p += 16)
+            std::memcpy(m_cmfInstruments[i].data, p, 16);
+    }
+
+    in.string(m_musTitle);
+    in.string(m_musCopyright);
+
+    // Every string has at least the 4-byte length field
+    uint32_t titlesCount = in.u32();
+    if(in.fits(titlesCount, 4))
+    {
+        m_musTrackTitles.resize(titlesCount);
+        for(size_t i = 0; i < titlesCount; ++i)
+            in.string(m_musTrackTitles[i]);
+    }
+
+    uint32_t markersCount = in.u32();
+    if(in.fits(markersCount, 20))
+    {
+        m_musMarkers.resize(markersCount);
+        for(size_t i = 0; i < markersCount; ++i)
+        {
+            in.string(m_musMarkers[i].label);
+            m_musMarkers[i].pos_time = in.f64();
+            m_musMarkers[i].pos_ticks = in.u64();
+        }
+    }
+
+    // Make sure all references are staying inside of the loaded data
+    bool valid = in.ok && (loopBeginPos <= m_schedule.size());
+
+    for(size_t tk = 0; valid && tk < trackCount; ++tk)
+    {
+        const MidiTrackQueue &track = m_trackData[tk];
+        for(size_t i = 0; valid && i < track.size(); ++i)
+            valid = (track[i].eventsBegin <= track[i].eventsEnd) && (track[i].eventsEnd <= m_eventsBank.size());
+    }
+
+    for(size_t i = 0; valid && i < m_schedule.size(); ++i)
+        valid = (m_schedule[i].track < trackCount) && (m_schedule[i].row < m_trackData[m_schedule[i].track].size());
+
+    for(size_t i = 0; valid && i < m_eventsBank.size(); ++i)
+    {
+        const MidiEvent &e = m_eventsBank[i];
+        if(e.dataSize > MidiEvent::INLINE_DATA_SIZE)
+            valid = (e.dataLoc <= m_dataBank.size()) && (e.dataSize <= m_dataBank.size() - e.dataLoc);
+    }
+
+    if(!valid)
+    {
+        buildSmfSetupReset(0);
+        m_errorString = "Invalid song cache data!\n";
+        return false;
+    }
+
+    // Set begin of the music
+    m_trackBeginPosition = m_currentPosition;
+    m_loopBeginPosition  = m_currentPosition;
+    m_loopBeginPosition.schedulePos = static_cast<size_t>(loopBeginPos);
+    m_loopBeginPosition.absTimePosition = loopBeginTime;
+    m_loop.stackLevel = -1;
+    m_loop.loopsCount = m_loopCount;
+    m_loop.loopsLeft = m_loopCount;
+
+    return true;
+}
+
 /**
  * @brief Detect the Id-software Music File format
  * @param head Header part
@@ -2337,6 +3423,12 @@ bool BW_MidiSequencer::loadMIDI(FileAndMemReader &fr)
         return parseCMF(fr);
     }
 
+    if(std::memcmp(headerBuf, s_songCacheMagic, 8) == 0)
+    {
+        fr.seek(0, FileAndMemReader::SET);
+        return parseSongCache(fr);
+    }
+
     if(detectIMF(headerBuf, fr))
     {
         fr.seek(0, FileAndMemReader::SET);
@@ -2388,19 +3480,19 @@ bool BW_MidiSequencer::parseIMF(FileAndMemReader &fr)
     event.type = MidiEvent::T_SPECIAL;
     event.subtype = MidiEvent::ST_TEMPOCHANGE;
     event.absPosition = 0;
-    event.data.resize(4);
+    event.dataSize = 4;
     event.data[0] = static_cast<uint8_t>((imfTempo >> 24) & 0xFF);
     event.data[1] = static_cast<uint8_t>((imfTempo >> 16) & 0xFF);
     event.data[2] = static_cast<uint8_t>((imfTempo >> 8) & 0xFF);
     event.data[3] = static_cast<uint8_t>((imfTempo & 0xFF));
-    evtPos.events.push_back(event);
+    addRowEvent(evtPos, event);
     temposList.push_back(event);
 
     // Define the draft for IMF events
     event.type = MidiEvent::T_SPECIAL;
     event.subtype = MidiEvent::ST_RAWOPL;
     event.absPosition = 0;
-    event.data.resize(2);
+    event.dataSize = 2;
 
     fr.seek((imfEnd > 0) ? 2 : 0, FileAndMemReader::SET);
 
@@ -2417,7 +3509,7 @@ bool BW_MidiSequencer::parseIMF(FileAndMemReader &fr)
         event.absPosition = abs_position;
         event.isValid = 1;
 
-        evtPos.events.push_back(event);
+        addRowEvent(evtPos, event);
         evtPos.delay = static_cast<uint64_t>(imfRaw[2]) + 256 * static_cast<uint64_t>(imfRaw[3]);
 
         if(evtPos.delay > 0)
@@ -2434,9 +3526,6 @@ bool BW_MidiSequencer::parseIMF(FileAndMemReader &fr)
     abs_position += evtPos.delay;
     m_trackData[0].push_back(evtPos);
 
-    if(!m_trackData[0].empty())
-        m_currentPosition.track[0].pos = m_trackData[0].begin();
-
     buildTimeLine(temposList);
 
     return true;
@@ -2821,6 +3910,37 @@ bool BW_MidiSequencer::parseRMI(FileAndMemReader &fr)
     return parseSMF(fr);
 }
 
+bool BW_MidiSequencer::buildConvertedTrackData(FileAndMemReader &fr,
+                                               const std::vector<RawTrackData> &trackData,
+                                               unsigned smfFormat, size_t deltaTicks)
+{
+    size_t totalGotten = 0;
+
+    for(size_t tk = 0; tk < trackData.size(); ++tk)
+        totalGotten += static_cast<size_t>(trackData[tk].end - trackData[tk].begin);
+
+    if(totalGotten == 0)
+    {
+        m_errorString = fr.fileName() + ": Empty track data";
+        return false;
+    }
+
+    m_invDeltaTicks = fraction<uint64_t>(1, 1000000l * static_cast<uint64_t>(deltaTicks));
+    m_tempo         = fraction<uint64_t>(1,            static_cast<uint64_t>(deltaTicks) * 2);
+
+    // Build new MIDI events table
+    if(!buildSmfTrackData(trackData))
+    {
+        m_errorString = fr.fileName() + ": MIDI data parsing error has occouped!\n" + m_parsingErrorsString;
+        return false;
+    }
+
+    m_smfFormat = smfFormat;
+    m_loop.stackLevel   = -1;
+
+    return true;
+}
+
 #ifndef BWMIDI_DISABLE_MUS_SUPPORT
 bool BW_MidiSequencer::parseMUS(FileAndMemReader &fr)
 {
@@ -2828,6 +3948,7 @@ bool BW_MidiSequencer::parseMUS(FileAndMemReader &fr)
     char headerBuf[headerSize] = "";
     size_t fsize = 0;
     BufferGuard<uint8_t> cvt_buf;
+    std::vector<uint8_t> musFile;
 
     fsize = fr.read(headerBuf, 1, headerSize);
     if(fsize < headerSize)
@@ -2844,29 +3965,28 @@ bool BW_MidiSequencer::parseMUS(FileAndMemReader &fr)
 
     size_t mus_len = fr.fileSize();
 
-    fr.seek(0, FileAndMemReader::SET);
-    uint8_t *mus = (uint8_t *)malloc(mus_len);
+    // A memory block gets converted in place, a file from a disk gets read first
+    const uint8_t *mus = reinterpret_cast<const uint8_t *>(fr.memoryData());
     if(!mus)
     {
-        m_errorString = "Out of memory!";
-        return false;
-    }
-    fsize = fr.read(mus, 1, mus_len);
-    if(fsize < mus_len)
-    {
-        m_errorString = "Failed to read MUS file data!\n";
-        return false;
+        fr.seek(0, FileAndMemReader::SET);
+        musFile.resize(mus_len);
+        fsize = fr.read(musFile.data(), 1, mus_len);
+        if(fsize < mus_len)
+        {
+            m_errorString = "Failed to read MUS file data!\n";
+            return false;
+        }
+        mus = musFile.data();
     }
 
-    // Close source stream
-    fr.close();
-
     uint8_t *mid = NULL;
     uint32_t mid_len = 0;
-    int m2mret = Convert_mus2midi(mus, static_cast<uint32_t>(mus_len),
-                                  &mid, &mid_len, 0);
-    if(mus)
-        free(mus);
+    int m2mret = Convert_mus2midi_track(mus, static_cast<uint32_t>(mus_len),
+                                        &mid, &mid_len, 0);
+
+    // Close source stream
+    fr.close();
 
     if(m2mret < 0)
     {
@@ -2875,10 +3995,12 @@ bool BW_MidiSequencer::parseMUS(FileAndMemReader &fr)
     }
     cvt_buf.set(mid);
 
-    // Open converted MIDI file
-    fr.openData(mid, static_cast<size_t>(mid_len));
+    // Converted events are built directly, without making of a Standard MIDI File
+    std::vector<RawTrackData> tracks(1);
+    tracks[0].begin = mid;
+    tracks[0].end = mid + mid_len;
 
-    return parseSMF(fr);
+    return buildConvertedTrackData(fr, tracks, 0, MUS_DIVISION);
 }
 #endif // BWMIDI_DISABLE_MUS_SUPPORT
 
@@ -2889,6 +4011,8 @@ bool BW_MidiSequencer::parseXMI(FileAndMemReader &fr)
     char headerBuf[headerSize] = "";
     size_t fsize = 0;
     BufferGuard<uint8_t> cvt_buf;
+    BufferGuard<uint32_t> cvt_offsets;
+    std::vector<uint8_t> xmiFile;
 
     fsize = fr.read(headerBuf, 1, headerSize);
     if(fsize < headerSize)
@@ -2909,46 +4033,50 @@ bool BW_MidiSequencer::parseXMI(FileAndMemReader &fr)
         return false;
     }
 
-    size_t mus_len = fr.fileSize();
-    fr.seek(0, FileAndMemReader::SET);
+    size_t xmi_len = fr.fileSize();
 
-    uint8_t *mus = (uint8_t*)std::malloc(mus_len + 20);
-    if(!mus)
+    // A memory block gets converted in place, a file from a disk gets read first
+    const uint8_t *xmi = reinterpret_cast<const uint8_t *>(fr.memoryData());
+    if(!xmi)
     {
-        m_errorString = "Out of memory!";
-        return false;
+        fr.seek(0, FileAndMemReader::SET);
+        xmiFile.resize(xmi_len);
+        fsize = fr.read(xmiFile.data(), 1, xmi_len);
+        if(fsize < xmi_len)
+        {
+            m_errorString = "Failed to read XMI file data!\n";
+            return false;
+        }
+        xmi = xmiFile.data();
     }
 
-    std::memset(mus, 0, mus_len + 20);
-
-    fsize = fr.read(mus, 1, mus_len);
-    if(fsize < mus_len)
-    {
-        m_errorString = "Failed to read XMI file data!\n";
-        return false;
-    }
+    xmi2mid_tracks mid;
+    int m2mret = Convert_xmi2midi_tracks(xmi, static_cast<uint32_t>(xmi_len),
+                                         &mid, XMIDI_CONVERT_NOCONVERSION);
 
     // Close source stream
     fr.close();
 
-    uint8_t *mid = NULL;
-    uint32_t mid_len = 0;
-    int m2mret = Convert_xmi2midi(mus, static_cast<uint32_t>(mus_len + 20),
-                                  &mid, &mid_len, XMIDI_CONVERT_NOCONVERSION);
-    if(mus)
-        free(mus);
     if(m2mret < 0)
     {
         m_errorString = "Invalid XMI data format!";
         return false;
     }
 
-    cvt_buf.set(mid);
-    // Open converted MIDI file
-    fr.openData(mid, static_cast<size_t>(mid_len));
+    cvt_buf.set(mid.data);
+    cvt_offsets.set(mid.offsets);
+
+    // Converted events are built directly, without making of a Standard MIDI File
+    std::vector<RawTrackData> tracks(mid.count);
+    for(size_t tk = 0; tk < tracks.size(); ++tk)
+    {
+        tracks[tk].begin = mid.data + mid.offsets[tk];
+        tracks[tk].end = mid.data + mid.offsets[tk + 1];
+    }
+
     // Set format as XMIDI
     m_format = Format_XMIDI;
 
-    return parseSMF(fr);
+    return buildConvertedTrackData(fr, tracks, mid.type, mid.division);
 }
 #endif
@@ -23,6 +23,7 @@
 
 #include <cassert>
 #include "SDL_assert.h"
+#include "SDL_stdinc.h"
 
 #define FLAC__ASSERT_H // WORKAROUND
 #ifdef assert
@@ -67,6 +68,32 @@ void *midi_seq_init_interface(BW_MidiRtInterface *iface)
 }
 
 
+/* No-op hooks for the sequencer that only loads songs */
+static void silent_noteOn(void *, uint8_t, uint8_t, uint8_t) {}
+static void silent_noteOff(void *, uint8_t, uint8_t) {}
+static void silent_noteAfterTouch(void *, uint8_t, uint8_t, uint8_t) {}
+static void silent_channelAfterTouch(void *, uint8_t, uint8_t) {}
+static void silent_controllerChange(void *, uint8_t, uint8_t, uint8_t) {}
+static void silent_patchChange(void *, uint8_t, uint8_t) {}
+static void silent_pitchBend(void *, uint8_t, uint8_t, uint8_t) {}
+static void silent_systemExclusive(void *, const uint8_t *, size_t) {}
+
+void *midi_seq_init_silent(void)
+{
+    BW_MidiRtInterface iface;
+    std::memset(&iface, 0, sizeof(BW_MidiRtInterface));
+    iface.rt_noteOn = silent_noteOn;
+    iface.rt_noteOff = silent_noteOff;
+    iface.rt_noteAfterTouch = silent_noteAfterTouch;
+    iface.rt_channelAfterTouch = silent_channelAfterTouch;
+    iface.rt_controllerChange = silent_controllerChange;
+    iface.rt_patchChange = silent_patchChange;
+    iface.rt_pitchBend = silent_pitchBend;
+    iface.rt_systemExclusive = silent_systemExclusive;
+    return midi_seq_init_interface(&iface);
+}
+
+
 void midi_seq_free(void *seq)
 {
     MixerSeqInternal *seqi = reinterpret_cast<MixerSeqInternal*>(seq);
@@ -88,6 +115,23 @@ int midi_seq_openFile(void *seq, const char *path)
 }
 
 
+int midi_seq_save_cache(void *seq, void **data, size_t *size)
+{
+    MixerSeqInternal *seqi = reinterpret_cast<MixerSeqInternal*>(seq);
+    std::vector<uint8_t> cache;
+
+    if(!seqi->seq.saveSongCache(cache))
+        return -1;
+
+    *data = SDL_malloc(cache.size());
+    if(!*data)
+        return -1;
+    SDL_memcpy(*data, cache.data(), cache.size());
+    *size = cache.size();
+    return 0;
+}
+
+
 const char *midi_seq_meta_title(void *seq)
 {
     MixerSeqInternal *seqi = reinterpret_cast<MixerSeqInternal*>(seq);
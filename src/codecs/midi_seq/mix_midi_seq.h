@@ -31,11 +31,16 @@ extern "C" {
 #endif
 
 extern void *midi_seq_init_interface(BW_MidiRtInterface *iface);
+/* Sequencer with no output, to load and convert songs only */
+extern void *midi_seq_init_silent(void);
 extern void midi_seq_free(void *seq);
 
 extern int midi_seq_openData(void *seq, void *bytes, unsigned long len);
 extern int midi_seq_openFile(void *seq, const char *path);
 
+/* Save the loaded song as the song cache (free the data with SDL_free()) */
+extern int midi_seq_save_cache(void *seq, void **data, size_t *size);
+
 extern const char *midi_seq_meta_title(void *seq);
 extern const char *midi_seq_meta_copyright(void *seq);
 
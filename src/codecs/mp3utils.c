@@ -32,6 +32,7 @@
 #include "SDL_rwops.h"
 
 #include "mp3utils.h"
+#include "../mixer.h"
 
 #include "SDL_log.h"
 
@@ -84,6 +85,43 @@ Sint64 MP3_RWtell(struct mp3file_t *fil)
 {
     return fil->pos;
 }
+
+/* The audio lock keeps the playback away from the stream while it reads
+ * at the position of the cursor */
+size_t MP3_RWcursor_read(struct mp3file_cursor_t *cur, void *ptr, size_t size)
+{
+    struct mp3file_t *fil = cur->fil;
+    Sint64 pos;
+    size_t ret = 0;
+
+    Mix_LockAudio();
+    pos = fil->pos;
+    if (MP3_RWseek(fil, cur->pos, RW_SEEK_SET) >= 0) {
+        ret = MP3_RWread(fil, ptr, 1, size);
+    }
+    MP3_RWseek(fil, pos, RW_SEEK_SET);
+    Mix_UnlockAudio();
+
+    cur->pos += (Sint64)ret;
+    return ret;
+}
+
+Sint64 MP3_RWcursor_seek(struct mp3file_cursor_t *cur, Sint64 offset, int whence)
+{
+    switch (whence) {
+    case RW_SEEK_CUR:
+        offset += cur->pos;
+        break;
+    case RW_SEEK_END:
+        offset += cur->fil->length;
+        break;
+    }
+    if (offset < 0) return -1;
+    if (offset > cur->fil->length)
+        offset = cur->fil->length;
+    cur->pos = offset;
+    return offset;
+}
 #endif /* ENABLE_ID3V2_TAG */
 
 #ifdef ENABLE_ALL_MP3_TAGS
@@ -34,6 +34,13 @@ struct mp3file_t {
     SDL_RWops *src;
     Sint64 start, length, pos;
 };
+
+/* MIXER-X: Own read position over the stream of the playing music, for
+ * the scans made outside of the audio lock */
+struct mp3file_cursor_t {
+    struct mp3file_t *fil;
+    Sint64 pos;
+};
 #endif
 
 #ifdef ENABLE_ALL_MP3_TAGS
@@ -49,6 +56,8 @@ extern int MP3_RWinit(struct mp3file_t *fil, SDL_RWops *src);
 extern size_t MP3_RWread(struct mp3file_t *fil, void *ptr, size_t size, size_t maxnum);
 extern Sint64 MP3_RWseek(struct mp3file_t *fil, Sint64 offset, int whence);
 extern Sint64 MP3_RWtell(struct mp3file_t *fil);
+extern size_t MP3_RWcursor_read(struct mp3file_cursor_t *cur, void *ptr, size_t size);
+extern Sint64 MP3_RWcursor_seek(struct mp3file_cursor_t *cur, Sint64 offset, int whence);
 #endif /* ENABLE_ALL_MP3_TAGS */
 
 #endif /* MIX_MP3UTILS_H */
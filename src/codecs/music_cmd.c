@@ -298,6 +298,11 @@ Mix_MusicInterface Mix_MusicInterface_CMD =
     NULL,   /* LoopStart */
     NULL,   /* LoopEnd */
     NULL,   /* LoopLength */
+    NULL,   /* BuildSeekIndex [MIXER-X] */
+    NULL,   /* GetSeekIndex [MIXER-X] */
+    NULL,   /* SetSeekIndex [MIXER-X] */
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     NULL,   /* GetMetaTag */
     MusicCMD_Pause,
     MusicCMD_Resume,
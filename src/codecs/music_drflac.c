@@ -24,6 +24,7 @@
 #include "music_drflac.h"
 #include "mp3utils.h"
 #include "../utils.h"
+#include "../mixer.h"
 
 #include "SDL.h"
 
@@ -56,14 +57,17 @@ typedef struct {
     int status;
     int sample_rate;
     int channels;
-    SDL_AudioStream *stream;
-    drflac_int16 *buffer;
+    Mix_MusicStream *stream;
+    void *buffer;
     int buffer_size;
+    int sample_size; /* drflac_int16, or float when the mixer works with floats */
     int loop;
     SDL_bool loop_flag;
     Sint64 loop_start;
     Sint64 loop_end;
     Sint64 loop_len;
+    Mix_MusicLoopCache loop_cache;
+    drflac_seekpoint *seek_points; /* Bound to the decoder, freed after drflac_close() */
     Mix_MusicMetaTags tags;
 } DRFLAC_Music;
 
@@ -157,6 +161,14 @@ static void DRFLAC_MetaCB(void *context, drflac_metadata *metadata)
 }
 
 static int DRFLAC_Seek(void *context, double position);
+static void DRFLAC_Delete(void *context);
+
+/* Runs at the worker thread of the loop cache */
+static int DRFLAC_SeekLoopCache(void *context, Sint64 frame)
+{
+    DRFLAC_Music *music = (DRFLAC_Music *)context;
+    return drflac_seek_to_pcm_frame(music->dec, (drflac_uint64)frame) ? 0 : -1;
+}
 
 static void *DRFLAC_CreateFromRW(SDL_RWops *src, int freesrc)
 {
@@ -184,7 +196,8 @@ static void *DRFLAC_CreateFromRW(SDL_RWops *src, int freesrc)
     }
 
     /* We should have channels and sample rate set up here */
-    music->stream = SDL_NewAudioStream(AUDIO_S16SYS,
+    music->sample_size = SDL_AUDIO_ISFLOAT(music_spec.format) ? (int)sizeof(float) : (int)sizeof(drflac_int16);
+    music->stream = music_stream_new((music->sample_size == (int)sizeof(float)) ? AUDIO_F32SYS : AUDIO_S16SYS,
                                        (Uint8)music->channels,
                                        music->sample_rate,
                                        music_spec.format,
@@ -197,8 +210,8 @@ static void *DRFLAC_CreateFromRW(SDL_RWops *src, int freesrc)
         return NULL;
     }
 
-    music->buffer_size = music_spec.samples * sizeof(drflac_int16) * music->channels;
-    music->buffer = (drflac_int16*)SDL_calloc(1, music->buffer_size);
+    music->buffer_size = music_spec.samples * music->sample_size * music->channels;
+    music->buffer = SDL_calloc(1, music->buffer_size);
     if (!music->buffer) {
         drflac_close(music->dec);
         SDL_OutOfMemory();
@@ -212,6 +225,12 @@ static void *DRFLAC_CreateFromRW(SDL_RWops *src, int freesrc)
     if ((music->loop_end > 0) && (music->loop_end <= (Sint64)music->dec->totalPCMFrameCount) &&
         (music->loop_start < music->loop_end)) {
         music->loop = 1;
+        if (music_loop_cache_setup(&music->loop_cache, music->loop_start, music->loop_len,
+                                   music->channels * music->sample_size, music->sample_rate,
+                                   DRFLAC_SeekLoopCache, music) < 0) {
+            DRFLAC_Delete(music);
+            return NULL;
+        }
     }
 
     music->freesrc = freesrc;
@@ -241,7 +260,7 @@ static int DRFLAC_Play(void *context, int play_count)
 static void DRFLAC_Stop(void *context)
 {
     DRFLAC_Music *music = (DRFLAC_Music *)context;
-    SDL_AudioStreamClear(music->stream);
+    music_stream_clear(music->stream);
 }
 
 static int DRFLAC_GetSome(void *context, void *data, int bytes, SDL_bool *done)
@@ -249,9 +268,10 @@ static int DRFLAC_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     DRFLAC_Music *music = (DRFLAC_Music *)context;
     int filled;
     drflac_uint64 amount;
+    Sint64 pos;
 
     if (music->stream) {
-        filled = SDL_AudioStreamGet(music->stream, data, bytes);
+        filled = music_stream_get(music->stream, data, bytes);
         if (filled != 0) {
             return filled;
         }
@@ -263,8 +283,19 @@ static int DRFLAC_GetSome(void *context, void *data, int bytes, SDL_bool *done)
         return 0;
     }
 
+    filled = music_loop_cache_feed(&music->loop_cache, music->stream, music->buffer_size);
+    if (filled != 0) {
+        return (filled < 0) ? -1 : 0;
+    }
+    /* Continue after the cached PCM */
+    if (music_loop_cache_sync(&music->loop_cache) < 0) {
+        return -1;
+    }
+
     if (music->loop_flag) {
-        if (!drflac_seek_to_pcm_frame(music->dec, music->loop_start)) {
+        /* Play the cached loop start while the worker seeks */
+        if (!music_loop_cache_wrap(&music->loop_cache) &&
+            !drflac_seek_to_pcm_frame(music->dec, music->loop_start)) {
             SDL_SetError("drflac_seek_to_pcm_frame() failed");
             return -1;
         } else {
@@ -277,20 +308,27 @@ static int DRFLAC_GetSome(void *context, void *data, int bytes, SDL_bool *done)
         }
     }
 
-    amount = drflac_read_pcm_frames_s16(music->dec, music_spec.samples, music->buffer);
+    if (music->sample_size == (int)sizeof(float)) {
+        amount = drflac_read_pcm_frames_f32(music->dec, music_spec.samples, (float *)music->buffer);
+    } else {
+        amount = drflac_read_pcm_frames_s16(music->dec, music_spec.samples, (drflac_int16 *)music->buffer);
+    }
     if (amount > 0) {
+        pos = (Sint64)(music->dec->currentPCMFrame - amount);
+        music_loop_cache_capture(&music->loop_cache, pos, music->buffer,
+                                 (int)amount * music->sample_size * music->channels);
         if (music->loop && (music->play_count != 1) &&
             ((Sint64)music->dec->currentPCMFrame >= music->loop_end)) {
-            amount -= (music->dec->currentPCMFrame - music->loop_end) * sizeof(drflac_int16) * music->channels;
+            amount -= (music->dec->currentPCMFrame - music->loop_end);
             music->loop_flag = SDL_TRUE;
         }
-        if (SDL_AudioStreamPut(music->stream, music->buffer, (int)amount * sizeof(drflac_int16) * music->channels) < 0) {
+        if (music_stream_put(music->stream, music->buffer, (int)amount * music->sample_size * music->channels) < 0) {
             return -1;
         }
     } else {
         if (music->play_count == 1) {
             music->play_count = 0;
-            SDL_AudioStreamFlush(music->stream);
+            music_stream_flush(music->stream);
         } else {
             int play_count = -1;
             if (music->play_count > 0) {
@@ -315,6 +353,7 @@ static int DRFLAC_Seek(void *context, double position)
 {
     DRFLAC_Music *music = (DRFLAC_Music *)context;
     drflac_uint64 destpos = (drflac_uint64)(position * music->sample_rate);
+    music_loop_cache_stop(&music->loop_cache);
     drflac_seek_to_pcm_frame(music->dec, destpos);
     return 0;
 }
@@ -322,6 +361,10 @@ static int DRFLAC_Seek(void *context, double position)
 static double DRFLAC_Tell(void *context)
 {
     DRFLAC_Music *music = (DRFLAC_Music *)context;
+    Sint64 pos = music_loop_cache_tell(&music->loop_cache);
+    if (pos >= 0) {
+        return (double)pos / music->sample_rate;
+    }
     return (double)music->dec->currentPCMFrame / music->sample_rate;
 }
 
@@ -359,6 +402,331 @@ static double DRFLAC_LoopLength(void *context)
     return -1.0;
 }
 
+/* Seek points per second of the seek index */
+#define DRFLAC_SEEK_POINTS_PER_SEC  4
+/* Size of a seek point at the exported seek index */
+#define DRFLAC_SEEK_POINT_SIZE      (8 + 8 + 2)
+/* Longest possible frame header */
+#define DRFLAC_MAX_HEADER_SIZE      16
+
+static drflac_uint8 DRFLAC_HeaderCRC8(const drflac_uint8 *data, size_t size)
+{
+    drflac_uint8 crc = 0;
+    size_t i;
+    int b;
+    for (i = 0; i < size; ++i) {
+        crc ^= data[i];
+        for (b = 0; b < 8; ++b) {
+            crc = (drflac_uint8)((crc & 0x80) ? ((crc << 1) ^ 0x07) : (crc << 1));
+        }
+    }
+    return crc;
+}
+
+/* Parses the frame header at the given bytes, returns the header size, or 0
+ * if these bytes are not a valid frame header */
+static size_t DRFLAC_ParseFrameHeader(const drflac_uint8 *h, size_t avail,
+                                      drflac_uint64 *number, drflac_uint32 *block_size)
+{
+    drflac_uint8 block_code, rate_code;
+    size_t pos = 4, extra, i;
+    drflac_uint64 num;
+
+    if (avail < 6 || h[0] != 0xFF || (h[1] & 0xFE) != 0xF8) {
+        return 0;
+    }
+
+    block_code = h[2] >> 4;
+    rate_code = h[2] & 0x0F;
+    if (block_code == 0 || rate_code == 15 || (h[3] >> 4) > 10 || (h[3] & 0x01)) {
+        return 0;
+    }
+
+    /* UTF-8 coded frame or sample number */
+    if (!(h[pos] & 0x80)) {
+        num = h[pos];
+        extra = 0;
+    } else if ((h[pos] & 0xE0) == 0xC0) {
+        num = h[pos] & 0x1F;
+        extra = 1;
+    } else if ((h[pos] & 0xF0) == 0xE0) {
+        num = h[pos] & 0x0F;
+        extra = 2;
+    } else if ((h[pos] & 0xF8) == 0xF0) {
+        num = h[pos] & 0x07;
+        extra = 3;
+    } else if ((h[pos] & 0xFC) == 0xF8) {
+        num = h[pos] & 0x03;
+        extra = 4;
+    } else if ((h[pos] & 0xFE) == 0xFC) {
+        num = h[pos] & 0x01;
+        extra = 5;
+    } else if (h[pos] == 0xFE) {
+        num = 0;
+        extra = 6;
+    } else {
+        return 0;
+    }
+    ++pos;
+
+    if (avail < pos + extra + 3) {
+        return 0;
+    }
+    for (i = 0; i < extra; ++i, ++pos) {
+        if ((h[pos] & 0xC0) != 0x80) {
+            return 0;
+        }
+        num = (num << 6) | (h[pos] & 0x3F);
+    }
+
+    if (block_code == 1) {
+        *block_size = 192;
+    } else if (block_code <= 5) {
+        *block_size = 576u << (block_code - 2);
+    } else if (block_code == 6) {
+        *block_size = (drflac_uint32)h[pos] + 1;
+        pos += 1;
+    } else if (block_code == 7) {
+        *block_size = (((drflac_uint32)h[pos] << 8) | h[pos + 1]) + 1;
+        pos += 2;
+    } else {
+        *block_size = 256u << (block_code - 8);
+    }
+
+    if (rate_code == 12) {
+        pos += 1;
+    } else if (rate_code == 13 || rate_code == 14) {
+        pos += 2;
+    }
+
+    if (avail < pos + 1 || DRFLAC_HeaderCRC8(h, pos) != h[pos]) {
+        return 0;
+    }
+
+    *number = num;
+    return pos + 1;
+}
+
+static size_t DRFLAC_IndexRead(DRFLAC_Music *music, struct mp3file_cursor_t *cursor, void *buf, size_t size)
+{
+    size_t got;
+
+    /* The loop cache worker uses the file without the audio lock */
+    Mix_LockAudio();
+    music_loop_cache_wait(&music->loop_cache);
+    got = MP3_RWcursor_read(cursor, buf, size);
+    Mix_UnlockAudio();
+    return got;
+}
+
+/* dr_flac only seeks fast when the file has a seek table, otherwise it does
+ * a binary search over the stream on every seek. Scan the frame headers once
+ * and give dr_flac a complete seek table. The scan reads the stream at its
+ * own position, so only the reads and putting the table in place take the
+ * audio lock. */
+static int DRFLAC_BuildSeekIndex(void *context)
+{
+    DRFLAC_Music *music = (DRFLAC_Music *)context;
+    drflac *dec = music->dec;
+    drflac_seekpoint *points = NULL, *new_points;
+    drflac_uint32 count = 0, capacity = 0, block_size = 0;
+    drflac_uint64 next_frame = 0, next_sample = 0, last_point = 0, number;
+    drflac_uint64 step = (drflac_uint64)music->sample_rate / DRFLAC_SEEK_POINTS_PER_SEC;
+    drflac_uint8 *buffer;
+    size_t filled = 0, pos = 0, got, hdr;
+    struct mp3file_cursor_t cursor;
+    Sint64 buffer_offset;
+    SDL_bool eof = SDL_FALSE, indexed;
+    int ret = 0;
+
+    Mix_LockAudio();
+    indexed = (music->seek_points || (dec->pSeekpoints && dec->seekpointCount > 0));
+    Mix_UnlockAudio();
+    if (indexed) {
+        return 0;
+    }
+    if (dec->container == drflac_container_ogg) {
+        Mix_SetError("music_drflac: seek index is not supported for Ogg FLAC");
+        return -1;
+    }
+
+    buffer = (drflac_uint8 *)SDL_malloc(65536);
+    if (!buffer) {
+        return Mix_OutOfMemory();
+    }
+
+    buffer_offset = (Sint64)dec->firstFLACFramePosInBytes;
+    cursor.fil = &music->file;
+    cursor.pos = buffer_offset;
+
+    for (;;) {
+        if (filled - pos < DRFLAC_MAX_HEADER_SIZE && !eof) {
+            SDL_memmove(buffer, buffer + pos, filled - pos);
+            buffer_offset += (Sint64)pos;
+            filled -= pos;
+            pos = 0;
+            got = DRFLAC_IndexRead(music, &cursor, buffer + filled, 65536 - filled);
+            if (got == 0) {
+                eof = SDL_TRUE;
+            }
+            filled += got;
+        }
+        if (pos >= filled) {
+            break;
+        }
+
+        hdr = DRFLAC_ParseFrameHeader(buffer + pos, filled - pos, &number, &block_size);
+        /* Frame numbers must go in order, that filters out the false sync codes
+         * inside of the audio data */
+        if (hdr == 0 || number != ((buffer[pos + 1] & 0x01) ? next_sample : next_frame)) {
+            ++pos;
+            continue;
+        }
+
+        if (count == 0 || next_sample - last_point >= step) {
+            if (count == capacity) {
+                capacity = capacity ? capacity * 2 : 256;
+                new_points = (drflac_seekpoint *)SDL_realloc(points, sizeof(drflac_seekpoint) * capacity);
+                if (!new_points) {
+                    ret = Mix_OutOfMemory();
+                    break;
+                }
+                points = new_points;
+            }
+            points[count].firstPCMFrame = next_sample;
+            points[count].flacFrameOffset = (drflac_uint64)(buffer_offset + (Sint64)pos) - dec->firstFLACFramePosInBytes;
+            points[count].pcmFrameCount = (drflac_uint16)block_size;
+            last_point = next_sample;
+            ++count;
+        }
+
+        ++next_frame;
+        next_sample += block_size;
+        pos += hdr;
+
+        if (dec->totalPCMFrameCount > 0 && next_sample >= dec->totalPCMFrameCount) {
+            break;
+        }
+    }
+
+    SDL_free(buffer);
+
+    if (ret < 0) {
+        SDL_free(points);
+        return ret;
+    }
+    if (count == 0) {
+        Mix_SetError("music_drflac: no frames found in the stream");
+        return -1;
+    }
+
+    Mix_LockAudio();
+    music_loop_cache_wait(&music->loop_cache);
+    if (music->seek_points) {
+        /* Loaded by Mix_LoadMusicSeekIndex() meanwhile */
+        SDL_free(points);
+    } else {
+        /* The table stays ours, it's freed after drflac_close() */
+        music->seek_points = points;
+        drflac_bind_seek_table(dec, count, points);
+    }
+    Mix_UnlockAudio();
+    return 0;
+}
+
+static int DRFLAC_GetSeekIndex(void *context, void **data, size_t *size)
+{
+    DRFLAC_Music *music = (DRFLAC_Music *)context;
+    SDL_RWops *dst;
+    drflac_uint32 i;
+
+    /* Either the built index or the seek table of the file */
+    if (!music->dec->pSeekpoints || music->dec->seekpointCount == 0) {
+        Mix_SetError("music_drflac: seek index is not built");
+        return -1;
+    }
+
+    *size = 8 + 4 + (size_t)music->dec->seekpointCount * DRFLAC_SEEK_POINT_SIZE;
+    *data = SDL_malloc(*size);
+    if (!*data) {
+        return Mix_OutOfMemory();
+    }
+
+    dst = SDL_RWFromMem(*data, (int)*size);
+    if (!dst) {
+        SDL_free(*data);
+        *data = NULL;
+        return -1;
+    }
+
+    /* The length makes sure the index matches the file */
+    SDL_WriteLE64(dst, music->dec->totalPCMFrameCount);
+    SDL_WriteLE32(dst, music->dec->seekpointCount);
+    for (i = 0; i < music->dec->seekpointCount; ++i) {
+        const drflac_seekpoint *p = &music->dec->pSeekpoints[i];
+        SDL_WriteLE64(dst, p->firstPCMFrame);
+        SDL_WriteLE64(dst, p->flacFrameOffset);
+        SDL_WriteLE16(dst, p->pcmFrameCount);
+    }
+    SDL_RWclose(dst);
+
+    return 0;
+}
+
+static int DRFLAC_SetSeekIndex(void *context, const void *data, size_t size)
+{
+    DRFLAC_Music *music = (DRFLAC_Music *)context;
+    drflac_seekpoint *points;
+    drflac_uint32 count, i;
+    SDL_RWops *src;
+
+    if (music->dec->container == drflac_container_ogg) {
+        Mix_SetError("music_drflac: seek index is not supported for Ogg FLAC");
+        return -1;
+    }
+
+    src = SDL_RWFromConstMem(data, (int)size);
+    if (!src) {
+        return -1;
+    }
+
+    if (size < 8 + 4 || SDL_ReadLE64(src) != music->dec->totalPCMFrameCount) {
+        SDL_RWclose(src);
+        Mix_SetError("music_drflac: seek index doesn't match the stream");
+        return -1;
+    }
+
+    count = SDL_ReadLE32(src);
+    if (count == 0 || (size - (8 + 4)) / DRFLAC_SEEK_POINT_SIZE != count) {
+        SDL_RWclose(src);
+        Mix_SetError("music_drflac: seek index is corrupted");
+        return -1;
+    }
+
+    points = (drflac_seekpoint *)SDL_malloc(sizeof(drflac_seekpoint) * count);
+    if (!points) {
+        SDL_RWclose(src);
+        return Mix_OutOfMemory();
+    }
+
+    for (i = 0; i < count; ++i) {
+        drflac_seekpoint *p = &points[i];
+        p->firstPCMFrame = SDL_ReadLE64(src);
+        p->flacFrameOffset = SDL_ReadLE64(src);
+        p->pcmFrameCount = SDL_ReadLE16(src);
+    }
+    SDL_RWclose(src);
+
+    music_loop_cache_wait(&music->loop_cache);
+    drflac_bind_seek_table(music->dec, count, points);
+    if (music->seek_points) {
+        SDL_free(music->seek_points);
+    }
+    music->seek_points = points;
+
+    return 0;
+}
+
 static const char* DRFLAC_GetMetaTag(void *context, Mix_MusicMetaTag tag_type)
 {
     DRFLAC_Music *music = (DRFLAC_Music *)context;
@@ -369,11 +737,16 @@ static void DRFLAC_Delete(void *context)
 {
     DRFLAC_Music *music = (DRFLAC_Music *)context;
 
+    music_loop_cache_free(&music->loop_cache);
     drflac_close(music->dec);
     meta_tags_clear(&music->tags);
 
+    if (music->seek_points) {
+        SDL_free(music->seek_points);
+    }
+
     if (music->stream) {
-        SDL_FreeAudioStream(music->stream);
+        music_stream_free(music->stream);
     }
     if (music->buffer) {
         SDL_free(music->buffer);
@@ -414,6 +787,11 @@ Mix_MusicInterface Mix_MusicInterface_DRFLAC =
     DRFLAC_LoopStart,
     DRFLAC_LoopEnd,
     DRFLAC_LoopLength,
+    DRFLAC_BuildSeekIndex,
+    DRFLAC_GetSeekIndex,
+    DRFLAC_SetSeekIndex,
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     DRFLAC_GetMetaTag,
     NULL,   /* Pause */
     NULL,   /* Resume */
@@ -23,6 +23,7 @@
 
 #include "music_drmp3.h"
 #include "mp3utils.h"
+#include "../mixer.h"
 #include "SDL.h"
 
 #define DR_MP3_IMPLEMENTATION
@@ -52,10 +53,16 @@ typedef struct {
     int freesrc;
     int volume;
     int status;
-    SDL_AudioStream *stream;
-    drmp3_int16 *buffer;
+    Mix_MusicStream *stream;
+    void *buffer;
     int buffer_size;
+    int sample_size; /* drmp3_int16, or float when the mixer works with floats */
     int channels;
+    drmp3_seek_point *seek_points;
+    drmp3_uint32 seek_points_count;
+    drmp3_uint64 total_frames;
+    SDL_Thread *index_thread;   /* Builds the index after the first seek */
+    SDL_bool index_cancel;
 
     Mix_MusicMetaTags tags;
 } DRMP3_Music;
@@ -111,7 +118,8 @@ static void *DRMP3_CreateFromRW(SDL_RWops *src, int freesrc)
     }
 
     music->channels = music->dec.channels;
-    music->stream = SDL_NewAudioStream(AUDIO_S16SYS,
+    music->sample_size = SDL_AUDIO_ISFLOAT(music_spec.format) ? (int)sizeof(float) : (int)sizeof(drmp3_int16);
+    music->stream = music_stream_new((music->sample_size == (int)sizeof(float)) ? AUDIO_F32SYS : AUDIO_S16SYS,
                                        (Uint8)music->channels,
                                        (int)music->dec.sampleRate,
                                        music_spec.format,
@@ -124,8 +132,8 @@ static void *DRMP3_CreateFromRW(SDL_RWops *src, int freesrc)
         return NULL;
     }
 
-    music->buffer_size = music_spec.samples * sizeof(drmp3_int16) * music->channels;
-    music->buffer = (drmp3_int16*)SDL_calloc(1, music->buffer_size);
+    music->buffer_size = music_spec.samples * music->sample_size * music->channels;
+    music->buffer = SDL_calloc(1, music->buffer_size);
     if (!music->buffer) {
         drmp3_uninit(&music->dec);
         SDL_OutOfMemory();
@@ -160,7 +168,7 @@ static int DRMP3_Play(void *context, int play_count)
 static void DRMP3_Stop(void *context)
 {
     DRMP3_Music *music = (DRMP3_Music *)context;
-    SDL_AudioStreamClear(music->stream);
+    music_stream_clear(music->stream);
 }
 
 static int DRMP3_GetSome(void *context, void *data, int bytes, SDL_bool *done)
@@ -170,7 +178,7 @@ static int DRMP3_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     drmp3_uint64 amount;
 
     if (music->stream) {
-        filled = SDL_AudioStreamGet(music->stream, data, bytes);
+        filled = music_stream_get(music->stream, data, bytes);
         if (filled != 0) {
             return filled;
         }
@@ -182,15 +190,19 @@ static int DRMP3_GetSome(void *context, void *data, int bytes, SDL_bool *done)
         return 0;
     }
 
-    amount = drmp3_read_pcm_frames_s16(&music->dec, music_spec.samples, music->buffer);
+    if (music->sample_size == (int)sizeof(float)) {
+        amount = drmp3_read_pcm_frames_f32(&music->dec, music_spec.samples, (float *)music->buffer);
+    } else {
+        amount = drmp3_read_pcm_frames_s16(&music->dec, music_spec.samples, (drmp3_int16 *)music->buffer);
+    }
     if (amount > 0) {
-        if (SDL_AudioStreamPut(music->stream, music->buffer, (int)amount * sizeof(drmp3_int16) * music->channels) < 0) {
+        if (music_stream_put(music->stream, music->buffer, (int)amount * music->sample_size * music->channels) < 0) {
             return -1;
         }
     } else {
         if (music->play_count == 1) {
             music->play_count = 0;
-            SDL_AudioStreamFlush(music->stream);
+            music_stream_flush(music->stream);
         } else {
             int play_count = -1;
             if (music->play_count > 0) {
@@ -211,10 +223,18 @@ static int DRMP3_GetAudio(void *context, void *data, int bytes)
     return music_pcm_getaudio(context, data, bytes, music->volume, DRMP3_GetSome);
 }
 
+static int SDLCALL DRMP3_IndexThread(void *context);
+
 static int DRMP3_Seek(void *context, double position)
 {
     DRMP3_Music *music = (DRMP3_Music *)context;
     drmp3_uint64 destpos = (drmp3_uint64)(position * music->dec.sampleRate);
+    /* Without the index every seek decodes the stream from its start, so
+     * build the index in the background after the first seek. The seek is
+     * made under the audio lock, and the scan waits for it. */
+    if (destpos > 0 && !music->seek_points && !music->index_thread) {
+        music->index_thread = SDL_CreateThread(DRMP3_IndexThread, "Mix_DRMP3Index", music);
+    }
     drmp3_seek_to_pcm_frame(&music->dec, destpos);
     return 0;
 }
@@ -228,10 +248,230 @@ static double DRMP3_Tell(void *context)
 static double DRMP3_Duration(void *context)
 {
     DRMP3_Music *music = (DRMP3_Music *)context;
-    drmp3_uint64 samples = drmp3_get_pcm_frame_count(&music->dec);
+    drmp3_uint64 samples = music->total_frames;
+    if (!music->seek_points) {
+        samples = drmp3_get_pcm_frame_count(&music->dec);
+    }
     return (double)samples / music->dec.sampleRate;
 }
 
+/* Seek points per second of the seek index */
+#define DRMP3_SEEK_POINTS_PER_SEC   4
+/* Size of a seek point at the exported seek index */
+#define DRMP3_SEEK_POINT_SIZE       (8 + 8 + 2 + 2)
+
+typedef struct {
+    struct mp3file_cursor_t cursor;
+    DRMP3_Music *music;
+} DRMP3_IndexScan;
+
+static size_t DRMP3_IndexReadCB(void *context, void *buf, size_t size)
+{
+    DRMP3_IndexScan *scan = (DRMP3_IndexScan *)context;
+    if (scan->music->index_cancel) {
+        return 0;
+    }
+    return MP3_RWcursor_read(&scan->cursor, buf, size);
+}
+
+static drmp3_bool32 DRMP3_IndexSeekCB(void *context, int offset, drmp3_seek_origin origin)
+{
+    DRMP3_IndexScan *scan = (DRMP3_IndexScan *)context;
+    int whence = (origin == drmp3_seek_origin_start) ? RW_SEEK_SET : RW_SEEK_CUR;
+    if (MP3_RWcursor_seek(&scan->cursor, offset, whence) < 0) {
+        return DRMP3_FALSE;
+    }
+    return DRMP3_TRUE;
+}
+
+/* The scan goes through a decoder of its own, so only the reads of the
+ * stream and putting the index in place take the audio lock */
+static int DRMP3_ScanSeekIndex(DRMP3_Music *music)
+{
+    DRMP3_IndexScan scan;
+    drmp3 dec;
+    drmp3_uint64 mp3_frames, pcm_frames;
+    drmp3_seek_point *points;
+    drmp3_uint32 count;
+    SDL_bool indexed;
+
+    Mix_LockAudio();
+    indexed = (music->seek_points != NULL);
+    Mix_UnlockAudio();
+    if (indexed) {
+        return 0;
+    }
+
+    scan.cursor.fil = &music->file;
+    scan.cursor.pos = 0;
+    scan.music = music;
+    if (!drmp3_init(&dec, DRMP3_IndexReadCB, DRMP3_IndexSeekCB, &scan, NULL)) {
+        Mix_SetError("music_drmp3: failed to scan the stream");
+        return -1;
+    }
+
+    if (!drmp3_get_mp3_and_pcm_frame_count(&dec, &mp3_frames, &pcm_frames)) {
+        drmp3_uninit(&dec);
+        Mix_SetError("music_drmp3: failed to scan the stream");
+        return -1;
+    }
+
+    count = (drmp3_uint32)(pcm_frames / (dec.sampleRate / DRMP3_SEEK_POINTS_PER_SEC)) + 1;
+    points = (drmp3_seek_point *)SDL_malloc(sizeof(drmp3_seek_point) * count);
+    if (!points) {
+        drmp3_uninit(&dec);
+        return Mix_OutOfMemory();
+    }
+
+    if (!drmp3_calculate_seek_points(&dec, &count, points)) {
+        SDL_free(points);
+        drmp3_uninit(&dec);
+        Mix_SetError("music_drmp3: failed to calculate seek points");
+        return -1;
+    }
+    drmp3_uninit(&dec);
+
+    if (music->index_cancel) {
+        /* The scan has stopped halfway */
+        SDL_free(points);
+        Mix_SetError("music_drmp3: the scan was cancelled");
+        return -1;
+    }
+
+    Mix_LockAudio();
+    if (music->seek_points) {
+        /* Loaded by Mix_LoadMusicSeekIndex() meanwhile */
+        SDL_free(points);
+    } else {
+        music->seek_points = points;
+        music->seek_points_count = count;
+        music->total_frames = pcm_frames;
+        drmp3_bind_seek_table(&music->dec, count, points);
+    }
+    Mix_UnlockAudio();
+
+    return 0;
+}
+
+static int SDLCALL DRMP3_IndexThread(void *context)
+{
+    DRMP3_ScanSeekIndex((DRMP3_Music *)context);
+    return 0;
+}
+
+static void DRMP3_WaitIndexThread(DRMP3_Music *music)
+{
+    SDL_Thread *thread;
+
+    Mix_LockAudio();
+    thread = music->index_thread;
+    music->index_thread = NULL;
+    Mix_UnlockAudio();
+    if (thread) {
+        SDL_WaitThread(thread, NULL);
+    }
+}
+
+static int DRMP3_BuildSeekIndex(void *context)
+{
+    DRMP3_Music *music = (DRMP3_Music *)context;
+    DRMP3_WaitIndexThread(music);
+    return DRMP3_ScanSeekIndex(music);
+}
+
+static int DRMP3_GetSeekIndex(void *context, void **data, size_t *size)
+{
+    DRMP3_Music *music = (DRMP3_Music *)context;
+    SDL_RWops *dst;
+    drmp3_uint32 i;
+
+    if (!music->seek_points) {
+        Mix_SetError("music_drmp3: seek index is not built");
+        return -1;
+    }
+
+    *size = 8 + 8 + 4 + (size_t)music->seek_points_count * DRMP3_SEEK_POINT_SIZE;
+    *data = SDL_malloc(*size);
+    if (!*data) {
+        return Mix_OutOfMemory();
+    }
+
+    dst = SDL_RWFromMem(*data, (int)*size);
+    if (!dst) {
+        SDL_free(*data);
+        *data = NULL;
+        return -1;
+    }
+
+    /* The stream size makes sure the index matches the file */
+    SDL_WriteLE64(dst, (Uint64)music->file.length);
+    SDL_WriteLE64(dst, music->total_frames);
+    SDL_WriteLE32(dst, music->seek_points_count);
+    for (i = 0; i < music->seek_points_count; ++i) {
+        const drmp3_seek_point *p = &music->seek_points[i];
+        SDL_WriteLE64(dst, p->seekPosInBytes);
+        SDL_WriteLE64(dst, p->pcmFrameIndex);
+        SDL_WriteLE16(dst, p->mp3FramesToDiscard);
+        SDL_WriteLE16(dst, p->pcmFramesToDiscard);
+    }
+    SDL_RWclose(dst);
+
+    return 0;
+}
+
+static int DRMP3_SetSeekIndex(void *context, const void *data, size_t size)
+{
+    DRMP3_Music *music = (DRMP3_Music *)context;
+    drmp3_seek_point *points;
+    drmp3_uint64 total_frames;
+    drmp3_uint32 count, i;
+    SDL_RWops *src;
+
+    src = SDL_RWFromConstMem(data, (int)size);
+    if (!src) {
+        return -1;
+    }
+
+    if (size < 8 + 8 + 4 || SDL_ReadLE64(src) != (Uint64)music->file.length) {
+        SDL_RWclose(src);
+        Mix_SetError("music_drmp3: seek index doesn't match the stream");
+        return -1;
+    }
+
+    total_frames = SDL_ReadLE64(src);
+    count = SDL_ReadLE32(src);
+    if (count == 0 || (size - (8 + 8 + 4)) / DRMP3_SEEK_POINT_SIZE != count) {
+        SDL_RWclose(src);
+        Mix_SetError("music_drmp3: seek index is corrupted");
+        return -1;
+    }
+
+    points = (drmp3_seek_point *)SDL_malloc(sizeof(drmp3_seek_point) * count);
+    if (!points) {
+        SDL_RWclose(src);
+        return Mix_OutOfMemory();
+    }
+
+    for (i = 0; i < count; ++i) {
+        drmp3_seek_point *p = &points[i];
+        p->seekPosInBytes = SDL_ReadLE64(src);
+        p->pcmFrameIndex = SDL_ReadLE64(src);
+        p->mp3FramesToDiscard = SDL_ReadLE16(src);
+        p->pcmFramesToDiscard = SDL_ReadLE16(src);
+    }
+    SDL_RWclose(src);
+
+    if (music->seek_points) {
+        SDL_free(music->seek_points);
+    }
+    music->seek_points = points;
+    music->seek_points_count = count;
+    music->total_frames = total_frames;
+    drmp3_bind_seek_table(&music->dec, count, points);
+
+    return 0;
+}
+
 static const char* DRMP3_GetMetaTag(void *context, Mix_MusicMetaTag tag_type)
 {
     DRMP3_Music *music = (DRMP3_Music *)context;
@@ -242,11 +482,17 @@ static void DRMP3_Delete(void *context)
 {
     DRMP3_Music *music = (DRMP3_Music *)context;
 
+    music->index_cancel = SDL_TRUE;
+    DRMP3_WaitIndexThread(music);
     drmp3_uninit(&music->dec);
     meta_tags_clear(&music->tags);
 
+    if (music->seek_points) {
+        SDL_free(music->seek_points);
+    }
+
     if (music->stream) {
-        SDL_FreeAudioStream(music->stream);
+        music_stream_free(music->stream);
     }
     if (music->buffer) {
         SDL_free(music->buffer);
@@ -287,6 +533,11 @@ Mix_MusicInterface Mix_MusicInterface_DRMP3 =
     NULL,   /* LoopStart */
     NULL,   /* LoopEnd */
     NULL,   /* LoopLength */
+    DRMP3_BuildSeekIndex,
+    DRMP3_GetSeekIndex,
+    DRMP3_SetSeekIndex,
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     DRMP3_GetMetaTag,
     NULL,   /* Pause */
     NULL,   /* Resume */
@@ -145,7 +145,7 @@ typedef struct {
     unsigned bits_per_sample;
     SDL_RWops *src;
     int freesrc;
-    SDL_AudioStream *stream;
+    Mix_MusicStream *stream;
     int loop;
     FLAC__int64 pcm_pos;
     FLAC__int64 full_length;
@@ -153,11 +153,34 @@ typedef struct {
     FLAC__int64 loop_start;
     FLAC__int64 loop_end;
     FLAC__int64 loop_len;
+    Mix_MusicLoopCache loop_cache;
+    SDL_bool seek_hold;     /* The loop cache worker seeks, keep the decoded frame */
+    Uint8 *seek_frame;
+    int seek_frame_size;
+    int seek_held;
     Mix_MusicMetaTags tags;
 } FLAC_Music;
 
 
 static int FLAC_Seek(void *context, double position);
+static void FLAC_Delete(void *context);
+
+/* Runs at the worker thread of the loop cache */
+static int FLAC_SeekLoopCache(void *context, Sint64 frame)
+{
+    FLAC_Music *music = (FLAC_Music *)context;
+    FLAC__bool result;
+
+    music->pcm_pos = frame;
+    music->seek_hold = SDL_TRUE;
+    result = flac.FLAC__stream_decoder_seek_absolute(music->flac_decoder, (FLAC__uint64)frame);
+    music->seek_hold = SDL_FALSE;
+    if (!result) {
+        flac.FLAC__stream_decoder_flush(music->flac_decoder);
+        return -1;
+    }
+    return 0;
+}
 
 static FLAC__StreamDecoderReadStatus flac_read_music_cb(
                                     const FLAC__StreamDecoder *decoder,
@@ -344,6 +367,7 @@ static FLAC__StreamDecoderWriteStatus flac_write_music_cb(
         }
     }
     amount = (int)(frame->header.blocksize * channels * sizeof(*data));
+    music_loop_cache_capture(&music->loop_cache, music->pcm_pos, data, amount);
     music->pcm_pos += (FLAC__int64) frame->header.blocksize;
     if (music->loop && (music->play_count != 1) &&
         (music->pcm_pos >= music->loop_end)) {
@@ -351,7 +375,24 @@ static FLAC__StreamDecoderWriteStatus flac_write_music_cb(
         music->loop_flag = SDL_TRUE;
     }
 
-    SDL_AudioStreamPut(music->stream, data, amount);
+    if (music->seek_hold) {
+        /* The output stream is in use by the audio thread */
+        if (amount > music->seek_frame_size) {
+            Uint8 *seek_frame = (Uint8 *)SDL_realloc(music->seek_frame, (size_t)amount);
+            if (!seek_frame) {
+                SDL_stack_free(data);
+                return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+            }
+            music->seek_frame = seek_frame;
+            music->seek_frame_size = amount;
+        }
+        SDL_memcpy(music->seek_frame, data, (size_t)amount);
+        music->seek_held = amount;
+        SDL_stack_free(data);
+        return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+    }
+
+    music_stream_put(music->stream, data, amount);
     SDL_stack_free(data);
 
     return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
@@ -388,7 +429,7 @@ static void flac_metadata_music_cb(
 
         /* We check for NULL stream later when we get data */
         SDL_assert(!music->stream);
-        music->stream = SDL_NewAudioStream(AUDIO_S16SYS, (Uint8)channels, (int)music->sample_rate,
+        music->stream = music_stream_new(AUDIO_S16SYS, (Uint8)channels, (int)music->sample_rate,
                                           music_spec.format, music_spec.channels, music_spec.freq);
     } else if (metadata->type == FLAC__METADATA_TYPE_VORBIS_COMMENT) {
         FLAC__uint32 i;
@@ -539,6 +580,12 @@ static void *FLAC_CreateFromRW(SDL_RWops *src, int freesrc)
     if ((music->loop_end > 0) && (music->loop_end <= full_length) &&
         (music->loop_start < music->loop_end)) {
         music->loop = 1;
+        if (music_loop_cache_setup(&music->loop_cache, music->loop_start, music->loop_len,
+                                   (music->channels == 3 ? 2 : (int)music->channels) * (int)sizeof(Sint16),
+                                   (int)music->sample_rate, FLAC_SeekLoopCache, music) < 0) {
+            FLAC_Delete(music);
+            return NULL;
+        }
     }
 
     music->full_length = full_length;
@@ -578,7 +625,7 @@ static int FLAC_Play(void *context, int play_count)
 static void FLAC_Stop(void *context)
 {
     FLAC_Music *music = (FLAC_Music *)context;
-    SDL_AudioStreamClear(music->stream);
+    music_stream_clear(music->stream);
 }
 
 /* Read some FLAC stream data and convert it for output */
@@ -587,7 +634,7 @@ static int FLAC_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     FLAC_Music *music = (FLAC_Music *)context;
     int filled;
 
-    filled = SDL_AudioStreamGet(music->stream, data, bytes);
+    filled = music_stream_get(music->stream, data, bytes);
     if (filled != 0) {
         return filled;
     }
@@ -598,14 +645,32 @@ static int FLAC_GetSome(void *context, void *data, int bytes, SDL_bool *done)
         return 0;
     }
 
-    if (!flac.FLAC__stream_decoder_process_single(music->flac_decoder)) {
+    filled = music_loop_cache_feed(&music->loop_cache, music->stream, bytes);
+    if (filled != 0) {
+        return (filled < 0) ? -1 : 0;
+    }
+    /* Continue after the cached PCM, the frame decoded by the seek goes after it */
+    if (music_loop_cache_sync(&music->loop_cache) < 0) {
+        return -1;
+    }
+    if (music->seek_held > 0) {
+        filled = music_stream_put(music->stream, music->seek_frame, music->seek_held);
+        music->seek_held = 0;
+        if (filled < 0) {
+            return -1;
+        }
+    }
+
+    if (!music->loop_flag && !flac.FLAC__stream_decoder_process_single(music->flac_decoder)) {
         SDL_SetError("FLAC__stream_decoder_process_single() failed");
         return -1;
     }
 
     if (music->loop_flag) {
         music->pcm_pos = music->loop_start;
-        if (flac.FLAC__stream_decoder_seek_absolute(music->flac_decoder, (FLAC__uint64)music->loop_start) ==
+        /* With the cached loop start, the seek happens once it was played */
+        if (!music_loop_cache_wrap(&music->loop_cache) &&
+            flac.FLAC__stream_decoder_seek_absolute(music->flac_decoder, (FLAC__uint64)music->loop_start) ==
                 FLAC__STREAM_DECODER_SEEK_ERROR) {
             SDL_SetError("FLAC__stream_decoder_seek_absolute() failed");
             flac.FLAC__stream_decoder_flush(music->flac_decoder);
@@ -623,7 +688,7 @@ static int FLAC_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     if (flac.FLAC__stream_decoder_get_state(music->flac_decoder) == FLAC__STREAM_DECODER_END_OF_STREAM) {
         if (music->play_count == 1) {
             music->play_count = 0;
-            SDL_AudioStreamFlush(music->stream);
+            music_stream_flush(music->stream);
         } else {
             int play_count = -1;
             if (music->play_count > 0) {
@@ -650,7 +715,9 @@ static int FLAC_Seek(void *context, double position)
     FLAC_Music *music = (FLAC_Music *)context;
     FLAC__uint64 seek_sample = (FLAC__uint64) (music->sample_rate * position);
 
-    SDL_AudioStreamClear(music->stream);
+    music_stream_clear(music->stream);
+    music_loop_cache_stop(&music->loop_cache);
+    music->seek_held = 0;
 
     music->pcm_pos = (FLAC__int64) seek_sample;
     if (!flac.FLAC__stream_decoder_seek_absolute(music->flac_decoder, seek_sample)) {
@@ -667,6 +734,10 @@ static int FLAC_Seek(void *context, double position)
 static double FLAC_Tell(void *context)
 {
     FLAC_Music *music = (FLAC_Music *)context;
+    Sint64 pos = music_loop_cache_tell(&music->loop_cache);
+    if (pos >= 0) {
+        return (double)pos / music->sample_rate;
+    }
     return (double)music->pcm_pos / music->sample_rate;
 }
 
@@ -710,12 +781,16 @@ static void FLAC_Delete(void *context)
     FLAC_Music *music = (FLAC_Music *)context;
     if (music) {
         meta_tags_clear(&music->tags);
+        music_loop_cache_free(&music->loop_cache);
+        if (music->seek_frame) {
+            SDL_free(music->seek_frame);
+        }
         if (music->flac_decoder) {
             flac.FLAC__stream_decoder_finish(music->flac_decoder);
             flac.FLAC__stream_decoder_delete(music->flac_decoder);
         }
         if (music->stream) {
-            SDL_FreeAudioStream(music->stream);
+            music_stream_free(music->stream);
         }
         if (music->freesrc) {
             SDL_RWclose(music->src);
@@ -754,6 +829,11 @@ Mix_MusicInterface Mix_MusicInterface_FLAC =
     FLAC_LoopStart,
     FLAC_LoopEnd,
     FLAC_LoopLength,
+    NULL,   /* BuildSeekIndex [MIXER-X] */
+    NULL,   /* GetSeekIndex [MIXER-X] */
+    NULL,   /* SetSeekIndex [MIXER-X] */
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     FLAC_GetMetaTag,/* GetMetaTag */
     NULL,   /* Pause */
     NULL,   /* Resume */
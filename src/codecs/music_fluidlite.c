@@ -61,6 +61,9 @@ typedef struct {
     void (*fluid_synth_set_chorus_on)(fluid_synth_t*, int);
     void (*fluid_synth_set_chorus)(fluid_synth_t*, int, double, double, double, int);
     int (*fluid_synth_set_polyphony)(fluid_synth_t*, int);
+    fluid_sfont_t* (*fluid_synth_get_sfont_by_id)(fluid_synth_t*, unsigned int);
+    int (*fluid_synth_add_sfont)(fluid_synth_t*, fluid_sfont_t*);
+    void (*fluid_synth_remove_sfont)(fluid_synth_t*, fluid_sfont_t*);
 } fluidsynth_loader;
 
 static fluidsynth_loader fluidsynth;
@@ -75,6 +78,203 @@ static fluidsynth_loader fluidsynth;
     if (fluidsynth.FUNC == NULL) { Mix_SetError("Missing fluidlite.framework"); return -1; }
 #endif
 
+/* MIXER-X: Process-wide cache of loaded SoundFonts.
+ *
+ * Every SoundFont is loaded once by the path and shared between synths of all
+ * songs. The unused ones are kept loaded for the next songs until the flush.
+ *
+ * A synth never gets the shared SoundFont itself: fluid_synth_add_sfont()
+ * writes the synth's own ID into the given SoundFont, and the synth looks the
+ * presets up by that ID later. Each synth gets a small view instead which has
+ * its own ID and forwards everything else to the shared SoundFont. */
+
+typedef struct FluidSynth_SoundFont {
+    char *path;
+    fluid_sfont_t *sfont;
+    int refcount;
+    struct FluidSynth_SoundFont *next;
+} FluidSynth_SoundFont;
+
+static struct {
+    SDL_mutex *lock;
+    /* Synth which loads SoundFonts for the cache */
+    fluid_settings_t *loader_settings;
+    fluid_synth_t *loader;
+    FluidSynth_SoundFont *fonts;
+} soundfont_cache;
+
+static FluidSynth_SoundFont *soundfont_cache_acquire(const char *path)
+{
+    FluidSynth_SoundFont *font;
+    fluid_sfont_t *sfont = NULL;
+    int id;
+
+    SDL_LockMutex(soundfont_cache.lock);
+
+    for (font = soundfont_cache.fonts; font; font = font->next) {
+        if (SDL_strcmp(font->path, path) == 0) {
+            font->refcount++;
+            SDL_UnlockMutex(soundfont_cache.lock);
+            return font;
+        }
+    }
+
+    if (!soundfont_cache.loader) {
+        soundfont_cache.loader_settings = fluidsynth.new_fluid_settings();
+        if (soundfont_cache.loader_settings) {
+            soundfont_cache.loader = fluidsynth.new_fluid_synth(soundfont_cache.loader_settings);
+        }
+        if (!soundfont_cache.loader) {
+            if (soundfont_cache.loader_settings) {
+                fluidsynth.delete_fluid_settings(soundfont_cache.loader_settings);
+                soundfont_cache.loader_settings = NULL;
+            }
+            SDL_UnlockMutex(soundfont_cache.lock);
+            Mix_SetError("Failed to create FluidSynth synthesizer");
+            return NULL;
+        }
+    }
+
+    /* Take the SoundFont away from the loader: it's owned by the cache now */
+    id = fluidsynth.fluid_synth_sfload(soundfont_cache.loader, path, 0);
+    if (id >= 0) {
+        sfont = fluidsynth.fluid_synth_get_sfont_by_id(soundfont_cache.loader, (unsigned int)id);
+    }
+    if (sfont) {
+        fluidsynth.fluid_synth_remove_sfont(soundfont_cache.loader, sfont);
+    }
+    if (!sfont) {
+        SDL_UnlockMutex(soundfont_cache.lock);
+        Mix_SetError("Failed to load the SoundFont %s", path);
+        return NULL;
+    }
+
+    font = (FluidSynth_SoundFont *)SDL_calloc(1, sizeof(FluidSynth_SoundFont));
+    if (!font || !(font->path = SDL_strdup(path))) {
+        if (font) {
+            SDL_free(font);
+        }
+        if (sfont->free) {
+            sfont->free(sfont);
+        }
+        SDL_UnlockMutex(soundfont_cache.lock);
+        SDL_OutOfMemory();
+        return NULL;
+    }
+
+    font->sfont = sfont;
+    font->refcount = 1;
+    font->next = soundfont_cache.fonts;
+    soundfont_cache.fonts = font;
+
+    SDL_UnlockMutex(soundfont_cache.lock);
+    return font;
+}
+
+static void soundfont_cache_release(FluidSynth_SoundFont *font)
+{
+    SDL_LockMutex(soundfont_cache.lock);
+    font->refcount--;
+    SDL_UnlockMutex(soundfont_cache.lock);
+}
+
+static int soundfont_view_free(fluid_sfont_t *view)
+{
+    SDL_free(view);
+    return 0;
+}
+
+static char *soundfont_view_get_name(fluid_sfont_t *view)
+{
+    fluid_sfont_t *sfont = ((FluidSynth_SoundFont *)view->data)->sfont;
+    return sfont->get_name(sfont);
+}
+
+static fluid_preset_t *soundfont_view_get_preset(fluid_sfont_t *view, unsigned int bank, unsigned int prenum)
+{
+    fluid_sfont_t *sfont = ((FluidSynth_SoundFont *)view->data)->sfont;
+    fluid_preset_t *preset = sfont->get_preset(sfont, bank, prenum);
+    /* The synth takes the SoundFont ID of the preset through this pointer */
+    if (preset) {
+        preset->sfont = view;
+    }
+    return preset;
+}
+
+static void soundfont_view_iteration_start(fluid_sfont_t *view)
+{
+    fluid_sfont_t *sfont = ((FluidSynth_SoundFont *)view->data)->sfont;
+    sfont->iteration_start(sfont);
+}
+
+static int soundfont_view_iteration_next(fluid_sfont_t *view, fluid_preset_t *preset)
+{
+    fluid_sfont_t *sfont = ((FluidSynth_SoundFont *)view->data)->sfont;
+    int ret = sfont->iteration_next(sfont, preset);
+    preset->sfont = view;
+    return ret;
+}
+
+/* Make a view of the cached SoundFont for one synth */
+static fluid_sfont_t *soundfont_view_new(FluidSynth_SoundFont *font)
+{
+    fluid_sfont_t *view = (fluid_sfont_t *)SDL_calloc(1, sizeof(fluid_sfont_t));
+    if (!view) {
+        SDL_OutOfMemory();
+        return NULL;
+    }
+    view->data = font;
+    view->free = soundfont_view_free;
+    view->get_name = soundfont_view_get_name;
+    view->get_preset = soundfont_view_get_preset;
+    view->iteration_start = soundfont_view_iteration_start;
+    view->iteration_next = soundfont_view_iteration_next;
+    return view;
+}
+
+/* Free all SoundFonts which are not used by any song, returns the count of freed */
+static int soundfont_cache_flush(void)
+{
+    FluidSynth_SoundFont **link, *font;
+    int freed = 0;
+
+    if (!soundfont_cache.lock) {
+        return 0;
+    }
+
+    SDL_LockMutex(soundfont_cache.lock);
+
+    link = &soundfont_cache.fonts;
+    while ((font = *link) != NULL) {
+        if (font->refcount > 0) {
+            link = &font->next;
+            continue;
+        }
+        *link = font->next;
+        if (font->sfont->free) {
+            font->sfont->free(font->sfont);
+        }
+        SDL_free(font->path);
+        SDL_free(font);
+        freed++;
+    }
+
+    if (!soundfont_cache.fonts && soundfont_cache.loader) {
+        fluidsynth.delete_fluid_synth(soundfont_cache.loader);
+        fluidsynth.delete_fluid_settings(soundfont_cache.loader_settings);
+        soundfont_cache.loader = NULL;
+        soundfont_cache.loader_settings = NULL;
+    }
+
+    SDL_UnlockMutex(soundfont_cache.lock);
+    return freed;
+}
+
+int _Mix_FLUIDSYNTH_FlushSoundFonts(void)
+{
+    return soundfont_cache_flush();
+}
+
 static int FLUIDSYNTH_Load()
 {
     if (fluidsynth.loaded == 0) {
@@ -108,6 +308,10 @@ static int FLUIDSYNTH_Load()
         FUNCTION_LOADER(fluid_synth_set_chorus_on, void (*)(fluid_synth_t*, int))
         FUNCTION_LOADER(fluid_synth_set_chorus, void (*)(fluid_synth_t*, int, double, double, double, int))
         FUNCTION_LOADER(fluid_synth_set_polyphony, int (*)(fluid_synth_t*, int))
+        FUNCTION_LOADER(fluid_synth_get_sfont_by_id, fluid_sfont_t* (*)(fluid_synth_t*, unsigned int))
+        FUNCTION_LOADER(fluid_synth_add_sfont, int (*)(fluid_synth_t*, fluid_sfont_t*))
+        FUNCTION_LOADER(fluid_synth_remove_sfont, void (*)(fluid_synth_t*, fluid_sfont_t*))
+        soundfont_cache.lock = SDL_CreateMutex();
     }
     ++fluidsynth.loaded;
 
@@ -120,6 +324,12 @@ static void FLUIDSYNTH_Unload()
         return;
     }
     if (fluidsynth.loaded == 1) {
+        /* SoundFonts are freed by the library code, drop them before unloading it */
+        soundfont_cache_flush();
+        if (soundfont_cache.lock) {
+            SDL_DestroyMutex(soundfont_cache.lock);
+            soundfont_cache.lock = NULL;
+        }
 #ifdef FLUIDSYNTH_DYNAMIC
         SDL_UnloadObject(fluidsynth.handle);
 #endif
@@ -186,7 +396,7 @@ typedef struct {
     int (*synth_write)(fluid_synth_t*, int, void*, int, int, void*, int, int);
     int synth_write_ret;
     void *player;
-    SDL_AudioStream *stream;
+    Mix_MusicStream *stream;
     void *buffer;
     int buffer_size;
     int sample_size;
@@ -194,6 +404,9 @@ typedef struct {
     int play_count;
     double tempo;
     float gain;
+    /* Views of the cached SoundFonts added to the synth */
+    fluid_sfont_t **soundfonts;
+    int soundfonts_count;
 
     Mix_MusicMetaTags tags;
 } FLUIDSYNTH_Music;
@@ -252,16 +465,68 @@ static void rtSysEx(void *userdata, const uint8_t *msg, size_t size)
     fluidsynth.fluid_synth_sysex(music->synth, (const char*)(msg), (int)(size), NULL, NULL, NULL, 0);
 }
 
-static void playSynthBuffer(void *userdata, uint8_t *stream, size_t length)
+static void applyTimedEvent(FLUIDSYNTH_Music *music, const BW_MidiTimedEvent *e)
+{
+    switch (e->type) {
+    case BW_MIDI_TIMED_NOTE_ON:
+        rtNoteOn(music, e->channel, e->data[0], e->data[1]);
+        break;
+    case BW_MIDI_TIMED_NOTE_OFF:
+        rtNoteOff(music, e->channel, e->data[0]);
+        break;
+    case BW_MIDI_TIMED_NOTE_AFTERTOUCH:
+        rtNoteAfterTouch(music, e->channel, e->data[0], e->data[1]);
+        break;
+    case BW_MIDI_TIMED_CHANNEL_AFTERTOUCH:
+        rtChannelAfterTouch(music, e->channel, e->data[0]);
+        break;
+    case BW_MIDI_TIMED_CONTROLLER:
+        rtControllerChange(music, e->channel, e->data[0], e->data[1]);
+        break;
+    case BW_MIDI_TIMED_PATCH:
+        rtPatchChange(music, e->channel, e->data[0]);
+        break;
+    case BW_MIDI_TIMED_PITCH_BEND:
+        rtPitchBend(music, e->channel, e->data[0], e->data[1]);
+        break;
+    case BW_MIDI_TIMED_SYSEX:
+        rtSysEx(music, e->sysex, e->sysex_size);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Renders the whole block, the synth is only stopped at frames where events are */
+static void playSynthBlock(void *userdata, uint8_t *stream, size_t length,
+                           const BW_MidiTimedEvent *events, size_t eventsCount)
 {
     FLUIDSYNTH_Music *music = (FLUIDSYNTH_Music*)(userdata);
-    int samples = (int)length / (music->sample_size * 2);
+    int frame_size = music->sample_size * 2;
+    int frames = (int)length / frame_size;
+    int done = 0, next;
+    size_t i = 0;
+
+    while (done < frames) {
+        while (i < eventsCount && (int)events[i].frame <= done) {
+            applyTimedEvent(music, &events[i++]);
+        }
 
-    if (music->synth_write_ret < 0) {
-        return;
+        next = frames;
+        if (i < eventsCount && (int)events[i].frame < next) {
+            next = (int)events[i].frame;
+        }
+
+        if (music->synth_write_ret >= 0) {
+            uint8_t *out = stream + (done * frame_size);
+            music->synth_write_ret = music->synth_write(music->synth, next - done, out, 0, 2, out, 1, 2);
+        }
+        done = next;
     }
 
-    music->synth_write_ret = music->synth_write(music->synth, samples, stream, 0, 2, stream, 1, 2);
+    while (i < eventsCount) {
+        applyTimedEvent(music, &events[i++]);
+    }
 }
 
 static int init_interface(FLUIDSYNTH_Music *music)
@@ -283,13 +548,13 @@ static int init_interface(FLUIDSYNTH_Music *music)
     music->seq_if.rt_pitchBend = rtPitchBend;
     music->seq_if.rt_systemExclusive = rtSysEx;
 
-    music->seq_if.onPcmRender = playSynthBuffer;
+    music->seq_if.onPcmRenderBlock = playSynthBlock;
     music->seq_if.pcmSampleRate = music_spec.freq;
 
     music->synth_write = fluidsynth.fluid_synth_write_s16;
     music->sample_size = sizeof(Sint16);
     music->seq_if.pcmFrameSize = 2 * music->sample_size;
-    music->seq_if.onPcmRender_userData = music;
+    music->seq_if.onPcmRenderBlock_userData = music;
 
     if (music_spec.format & 0x0020) { /* 32 bit. */
         music->synth_write = fluidsynth.fluid_synth_write_float;
@@ -335,8 +600,31 @@ static int SDLCALL fluidsynth_check_soundfont(const char *path, void *data)
 
 static int SDLCALL fluidsynth_load_soundfont(const char *path, void *data)
 {
+    FLUIDSYNTH_Music *music = (FLUIDSYNTH_Music *)data;
+    fluid_sfont_t **list;
+    fluid_sfont_t *view;
+    FluidSynth_SoundFont *font;
+
     /* If this fails, it's too late to try Timidity so pray that at least one works. */
-    fluidsynth.fluid_synth_sfload((fluid_synth_t*) data, path, 1);
+    if (!(font = soundfont_cache_acquire(path))) {
+        return 1;
+    }
+
+    list = (fluid_sfont_t **)SDL_realloc(music->soundfonts, sizeof(fluid_sfont_t *) * (size_t)(music->soundfonts_count + 1));
+    if (!list) {
+        soundfont_cache_release(font);
+        SDL_OutOfMemory();
+        return 1;
+    }
+    music->soundfonts = list;
+
+    if (!(view = soundfont_view_new(font))) {
+        soundfont_cache_release(font);
+        return 1;
+    }
+
+    music->soundfonts[music->soundfonts_count++] = view;
+    fluidsynth.fluid_synth_add_sfont(music->synth, view);
     return 1;
 }
 
@@ -522,7 +810,8 @@ static FLUIDSYNTH_Music *FLUIDSYNTH_LoadMusicArg(void *data, const char *args)
     double samplerate; /* as set by the lib. */
     int src_format = AUDIO_S16SYS;
     const Uint8 channels = 2;
-    void *rw_mem;
+    const void *rw_mem;
+    void *rw_free;
     size_t rw_size;
     int ret;
 
@@ -562,9 +851,9 @@ static FLUIDSYNTH_Music *FLUIDSYNTH_LoadMusicArg(void *data, const char *args)
 
 
     if (setup.custom_soundfonts[0]) {
-        ret = Mix_EachSoundFontEx(setup.custom_soundfonts, fluidsynth_load_soundfont, music->synth);
+        ret = Mix_EachSoundFontEx(setup.custom_soundfonts, fluidsynth_load_soundfont, music);
     } else {
-        ret = Mix_EachSoundFont(fluidsynth_load_soundfont, music->synth);
+        ret = Mix_EachSoundFont(fluidsynth_load_soundfont, music);
     }
 
     if (!ret) {
@@ -587,14 +876,13 @@ static FLUIDSYNTH_Music *FLUIDSYNTH_LoadMusicArg(void *data, const char *args)
         goto fail;
     }
 
-    rw_mem = SDL_LoadFile_RW(src, &rw_size, SDL_FALSE);
+    rw_mem = _Mix_LoadRWData(src, &rw_size, &rw_free);
     if (!rw_mem) {
-        SDL_OutOfMemory();
         goto fail;
     }
 
-    ret = midi_seq_openData(music->player, rw_mem, rw_size);
-    SDL_free(rw_mem);
+    ret = midi_seq_openData(music->player, (void *)rw_mem, rw_size);
+    SDL_free(rw_free);
 
     if (ret < 0) {
         Mix_SetError("FluidSynth failed to load in-memory song: %s", midi_seq_get_error(music->player));
@@ -603,7 +891,7 @@ static FLUIDSYNTH_Music *FLUIDSYNTH_LoadMusicArg(void *data, const char *args)
 
     midi_seq_set_tempo_multiplier(music->player, music->tempo);
 
-    if (!(music->stream = SDL_NewAudioStream(src_format, channels, (int) samplerate,
+    if (!(music->stream = music_stream_new(src_format, channels, (int) samplerate,
                           music_spec.format, music_spec.channels, music_spec.freq))) {
         goto fail;
     }
@@ -654,7 +942,7 @@ static int FLUIDSYNTH_GetVolume(void *context)
 static int FLUIDSYNTH_Play(void *context, int play_count)
 {
     FLUIDSYNTH_Music *music = (FLUIDSYNTH_Music *)context;
-    SDL_AudioStreamClear(music->stream);
+    music_stream_clear(music->stream);
     midi_seq_set_loop_enabled(music->player, 1);
     midi_seq_set_loop_count(music->player, play_count);
     midi_seq_rewind(music->player);
@@ -762,7 +1050,7 @@ static int FLUIDSYNTH_GetSome(void *context, void *data, int bytes, SDL_bool *do
     FLUIDSYNTH_Music *music = (FLUIDSYNTH_Music *)context;
     int filled, gotten_len, amount;
 
-    filled = SDL_AudioStreamGet(music->stream, data, bytes);
+    filled = music_stream_get(music->stream, data, bytes);
     if (filled != 0) {
         return filled;
     }
@@ -789,13 +1077,13 @@ static int FLUIDSYNTH_GetSome(void *context, void *data, int bytes, SDL_bool *do
 
     amount = gotten_len;
     if (amount > 0) {
-        if (SDL_AudioStreamPut(music->stream, music->buffer, amount) < 0) {
+        if (music_stream_put(music->stream, music->buffer, amount) < 0) {
             return -1;
         }
     } else {
         if (music->play_count == 1) {
             music->play_count = 0;
-            SDL_AudioStreamFlush(music->stream);
+            music_stream_flush(music->stream);
         } else {
             int play_count = -1;
             if (music->play_count > 0) {
@@ -825,13 +1113,27 @@ static void FLUIDSYNTH_Delete(void *context)
     meta_tags_clear(&music->tags);
 
     if (music->synth) {
+        int i;
+        /* Views are freed here, keep the synth from freeing them too */
+        for (i = 0; i < music->soundfonts_count; i++) {
+            fluidsynth.fluid_synth_remove_sfont(music->synth, music->soundfonts[i]);
+        }
         fluidsynth.delete_fluid_synth(music->synth);
     }
+    if (music->soundfonts) {
+        int i;
+        /* Release after the synth is gone: its voices may use the sample data until then */
+        for (i = 0; i < music->soundfonts_count; i++) {
+            soundfont_cache_release((FluidSynth_SoundFont *)music->soundfonts[i]->data);
+            soundfont_view_free(music->soundfonts[i]);
+        }
+        SDL_free(music->soundfonts);
+    }
     if (music->settings) {
         fluidsynth.delete_fluid_settings(music->settings);
     }
     if (music->stream) {
-        SDL_FreeAudioStream(music->stream);
+        music_stream_free(music->stream);
     }
     if (music->buffer) {
         SDL_free(music->buffer);
@@ -869,6 +1171,11 @@ Mix_MusicInterface Mix_MusicInterface_FLUIDSYNTH =
     FLUIDSYNTH_LoopStart,
     FLUIDSYNTH_LoopEnd,
     FLUIDSYNTH_LoopLength,
+    NULL,   /* BuildSeekIndex [MIXER-X] */
+    NULL,   /* GetSeekIndex [MIXER-X] */
+    NULL,   /* SetSeekIndex [MIXER-X] */
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     FLUIDSYNTH_GetMetaTag,
     NULL,   /* Pause */
     NULL,   /* Resume */
@@ -909,6 +1216,11 @@ Mix_MusicInterface Mix_MusicInterface_FLUIDXMI =
     FLUIDSYNTH_LoopStart,
     FLUIDSYNTH_LoopEnd,
     FLUIDSYNTH_LoopLength,
+    NULL,   /* BuildSeekIndex [MIXER-X] */
+    NULL,   /* GetSeekIndex [MIXER-X] */
+    NULL,   /* SetSeekIndex [MIXER-X] */
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     FLUIDSYNTH_GetMetaTag,
     NULL,   /* Pause */
     NULL,   /* Resume */
@@ -28,6 +28,7 @@
 #include "SDL_rwops.h"
 
 #include "music_fluidsynth.h"
+#include "utils.h"
 
 #include <fluidsynth.h>
 
@@ -132,7 +133,7 @@ typedef struct {
     fluid_settings_t *settings;
     fluid_player_t *player;
     int (*synth_write)(fluid_synth_t*, int, void*, int, int, void*, int, int);
-    SDL_AudioStream *stream;
+    Mix_MusicStream *stream;
     void *buffer;
     int buffer_size;
     int volume;
@@ -177,7 +178,8 @@ static FLUIDSYNTH_Music *FLUIDSYNTH_LoadMusic(void *data)
     double samplerate; /* as set by the lib. */
     const Uint8 channels = 2;
     int src_format = AUDIO_S16SYS;
-    void *rw_mem;
+    const void *rw_mem;
+    void *rw_free;
     size_t rw_size;
     int ret;
 
@@ -222,21 +224,20 @@ static FLUIDSYNTH_Music *FLUIDSYNTH_LoadMusic(void *data)
         goto fail;
     }
 
-    rw_mem = SDL_LoadFile_RW(src, &rw_size, SDL_FALSE);
+    rw_mem = _Mix_LoadRWData(src, &rw_size, &rw_free);
     if (!rw_mem) {
-        SDL_OutOfMemory();
         goto fail;
     }
 
     ret = fluidsynth.fluid_player_add_mem(music->player, rw_mem, rw_size);
-    SDL_free(rw_mem);
+    SDL_free(rw_free);
 
     if (ret != FLUID_OK) {
         Mix_SetError("FluidSynth failed to load in-memory song");
         goto fail;
     }
 
-    if (!(music->stream = SDL_NewAudioStream(src_format, channels, (int) samplerate,
+    if (!(music->stream = music_stream_new(src_format, channels, (int) samplerate,
                           music_spec.format, music_spec.channels, music_spec.freq))) {
         goto fail;
     }
@@ -294,7 +295,7 @@ static int FLUIDSYNTH_GetSome(void *context, void *data, int bytes, SDL_bool *do
 
     (void)done;
 
-    filled = SDL_AudioStreamGet(music->stream, data, bytes);
+    filled = music_stream_get(music->stream, data, bytes);
     if (filled != 0) {
         return filled;
     }
@@ -303,7 +304,7 @@ static int FLUIDSYNTH_GetSome(void *context, void *data, int bytes, SDL_bool *do
         Mix_SetError("Error generating FluidSynth audio");
         return -1;
     }
-    if (SDL_AudioStreamPut(music->stream, music->buffer, music->buffer_size) < 0) {
+    if (music_stream_put(music->stream, music->buffer, music->buffer_size) < 0) {
         return -1;
     }
     return 0;
@@ -333,7 +334,7 @@ static void FLUIDSYNTH_Delete(void *context)
         fluidsynth.delete_fluid_settings(music->settings);
     }
     if (music->stream) {
-        SDL_FreeAudioStream(music->stream);
+        music_stream_free(music->stream);
     }
     if (music->buffer) {
         SDL_free(music->buffer);
@@ -371,6 +372,11 @@ Mix_MusicInterface Mix_MusicInterface_FLUIDSYNTH =
     NULL,   /* LoopStart */
     NULL,   /* LoopEnd */
     NULL,   /* LoopLength */
+    NULL,   /* BuildSeekIndex [MIXER-X] */
+    NULL,   /* GetSeekIndex [MIXER-X] */
+    NULL,   /* SetSeekIndex [MIXER-X] */
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     NULL,   /* GetMetaTag */
     NULL,   /* Pause */
     NULL,   /* Resume */
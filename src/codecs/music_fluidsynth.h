@@ -29,6 +29,9 @@
 extern Mix_MusicInterface Mix_MusicInterface_FLUIDSYNTH;
 #if defined(MUSIC_MID_FLUIDLITE)
 extern Mix_MusicInterface Mix_MusicInterface_FLUIDXMI;
+
+/* MIXER-X: Free SoundFonts which are not used by any loaded song */
+extern int _Mix_FLUIDSYNTH_FlushSoundFonts(void);
 #endif
 
 /* vi: set ts=4 sw=4 expandtab: */
@@ -24,6 +24,7 @@
 #include "SDL_loadso.h"
 
 #include "music_gme.h"
+#include "utils.h"
 
 #include <gme.h>
 
@@ -160,7 +161,7 @@ typedef struct
     int volume;
     double tempo;
     double gain;
-    SDL_AudioStream *stream;
+    Mix_MusicStream *stream;
     void *buffer;
     size_t buffer_size;
     Mix_MusicMetaTags tags;
@@ -329,7 +330,8 @@ static int initialize_from_track_info(GME_Music *music, int track)
 
 static GME_Music *GME_CreateFromRW(SDL_RWops *src, const char *args)
 {
-    void *mem = 0;
+    const void *mem;
+    void *mem_free;
     size_t size;
     GME_Music *music;
     Gme_Setup setup = gme_setup;
@@ -347,7 +349,7 @@ static GME_Music *GME_CreateFromRW(SDL_RWops *src, const char *args)
     music->tempo = setup.tempo;
     music->gain = setup.gain;
 
-    music->stream = SDL_NewAudioStream(AUDIO_S16SYS, 2, music_spec.freq,
+    music->stream = music_stream_new(AUDIO_S16SYS, 2, music_spec.freq,
                                        music_spec.format, music_spec.channels, music_spec.freq);
     if (!music->stream) {
         GME_Delete(music);
@@ -363,17 +365,16 @@ static GME_Music *GME_CreateFromRW(SDL_RWops *src, const char *args)
     }
 
     SDL_RWseek(src, 0, RW_SEEK_SET);
-    mem = SDL_LoadFile_RW(src, &size, SDL_FALSE);
+    mem = _Mix_LoadRWData(src, &size, &mem_free);
     if (mem) {
-        err = gme.gme_open_data(mem, size, &music->game_emu, music_spec.freq);
-        SDL_free(mem);
+        err = gme.gme_open_data(mem, (long)size, &music->game_emu, music_spec.freq);
+        SDL_free(mem_free);
         if (err != 0) {
             GME_Delete(music);
             Mix_SetError("GME: %s", err);
             return NULL;
         }
     } else {
-        SDL_OutOfMemory();
         GME_Delete(music);
         return NULL;
     }
@@ -430,20 +431,25 @@ static void *GME_NewRW(struct SDL_RWops *src, int freesrc)
     return GME_NewRWEx(src, freesrc, "0");
 }
 
+/* Fade out the track after the requested count of loops */
+static void GME_SetFade(GME_Music *music)
+{
+    int fade_start = music->play_count > 0 ? music->intro_length + (music->loop_length * music->play_count) : -1;
+#if GME_VERSION >= 0x000700
+    gme.gme_set_fade(music->game_emu, fade_start, 8000);
+#else
+    gme.gme_set_fade(music->game_emu, fade_start);
+#endif
+}
+
 /* Start playback of a given Game Music Emulators stream */
 static int GME_Play(void *music_p, int play_count)
 {
     GME_Music *music = (GME_Music*)music_p;
-    int fade_start;
     if (music) {
-        SDL_AudioStreamClear(music->stream);
+        music_stream_clear(music->stream);
         music->play_count = play_count;
-        fade_start = play_count > 0 ? music->intro_length + (music->loop_length * play_count) : -1;
-#if GME_VERSION >= 0x000700
-        gme.gme_set_fade(music->game_emu, fade_start, 8000);
-#else
-        gme.gme_set_fade(music->game_emu, fade_start);
-#endif
+        GME_SetFade(music);
         gme.gme_seek(music->game_emu, 0);
     }
     return 0;
@@ -455,7 +461,7 @@ static int GME_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     int filled;
     const char *err = NULL;
 
-    filled = SDL_AudioStreamGet(music->stream, data, bytes);
+    filled = music_stream_get(music->stream, data, bytes);
     if (filled != 0) {
         return filled;
     }
@@ -472,7 +478,7 @@ static int GME_GetSome(void *context, void *data, int bytes, SDL_bool *done)
         return 0;
     }
 
-    if (SDL_AudioStreamPut(music->stream, music->buffer, music->buffer_size) < 0) {
+    if (music_stream_put(music->stream, music->buffer, music->buffer_size) < 0) {
         return -1;
     }
     return 0;
@@ -496,7 +502,7 @@ static void GME_Delete(void *context)
             music->game_emu = NULL;
         }
         if (music->stream) {
-            SDL_FreeAudioStream(music->stream);
+            music_stream_free(music->stream);
         }
         if (music->buffer) {
             SDL_free(music->buffer);
@@ -575,6 +581,44 @@ static int GME_SetTrackMute(void *music_p, int track, int mute)
     return -1;
 }
 
+static int GME_GetNumTracks(void *music_p)
+{
+    GME_Music *music = (GME_Music *)music_p;
+    return gme.gme_track_count(music->game_emu);
+}
+
+/* Switch the emulator to another track of the same file, the file is not
+ * parsed again and the emulator keeps its settings */
+static int GME_StartTrack(void *music_p, int track)
+{
+    GME_Music *music = (GME_Music *)music_p;
+    const char *err;
+
+    if ((track < 0) || (track >= gme.gme_track_count(music->game_emu))) {
+        Mix_SetError("GME: Track %d is out of range", track);
+        return -1;
+    }
+
+    music_stream_clear(music->stream);
+
+    err = gme.gme_start_track(music->game_emu, track);
+    if (err != 0) {
+        Mix_SetError("GME: %s", err);
+        return -1;
+    }
+
+    gme.gme_set_tempo(music->game_emu, music->tempo);
+
+    meta_tags_clear(&music->tags);
+    if (initialize_from_track_info(music, track) == -1) {
+        return -1;
+    }
+
+    /* Starting of the track resets the fade */
+    GME_SetFade(music);
+    return 0;
+}
+
 
 Mix_MusicInterface Mix_MusicInterface_GME =
 {
@@ -606,6 +650,11 @@ Mix_MusicInterface Mix_MusicInterface_GME =
     NULL,   /* LoopStart [MIXER-X]*/
     NULL,   /* LoopEnd [MIXER-X]*/
     NULL,   /* LoopLength [MIXER-X]*/
+    NULL,   /* BuildSeekIndex [MIXER-X] */
+    NULL,   /* GetSeekIndex [MIXER-X] */
+    NULL,   /* SetSeekIndex [MIXER-X] */
+    GME_GetNumTracks,  /* [MIXER-X] */
+    GME_StartTrack,    /* [MIXER-X] */
     GME_GetMetaTag,/* GetMetaTag [MIXER-X]*/
     NULL,   /* Pause */
     NULL,   /* Resume */
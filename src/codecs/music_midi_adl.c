@@ -41,6 +41,7 @@ typedef struct {
     void (*adl_setHVibrato)(struct ADL_MIDIPlayer *device, int hvibro);
     void (*adl_setHTremolo)(struct ADL_MIDIPlayer *device, int htremo);
     int (*adl_openBankFile)(struct ADL_MIDIPlayer *device, const char *filePath);
+    int (*adl_openBankData)(struct ADL_MIDIPlayer *device, const void *mem, unsigned long size);
     int (*adl_setBank)(struct ADL_MIDIPlayer *device, int bank);
     const char *(*adl_errorInfo)(struct ADL_MIDIPlayer *device);
     int (*adl_switchEmulator)(struct ADL_MIDIPlayer *device, int emulator);
@@ -59,6 +60,7 @@ typedef struct {
     const char *(*adl_metaMusicTitle)(struct ADL_MIDIPlayer *device);
     const char *(*adl_metaMusicCopyright)(struct ADL_MIDIPlayer *device);
     void (*adl_positionRewind)(struct ADL_MIDIPlayer *device);
+    void (*adl_reset)(struct ADL_MIDIPlayer *device);
     void (*adl_setLoopEnabled)(struct ADL_MIDIPlayer *device, int loopEn);
     void (*adl_setLoopCount)(struct ADL_MIDIPlayer *device, int loopCount);
     int  (*adl_playFormat)(struct ADL_MIDIPlayer *device, int sampleCount,
@@ -73,6 +75,13 @@ typedef struct {
 
 static adlmidi_loader ADLMIDI;
 
+static Mix_SynthPool adlmidi_pool;
+
+static void ADLMIDI_closeSynth(void *synth)
+{
+    ADLMIDI.adl_close((struct ADL_MIDIPlayer *)synth);
+}
+
 #ifdef ADLMIDI_DYNAMIC
 #define FUNCTION_LOADER(FUNC, SIG) \
     ADLMIDI.FUNC = (SIG) SDL_LoadFunction(ADLMIDI.handle, #FUNC); \
@@ -99,6 +108,7 @@ static int ADLMIDI_Load(void)
         FUNCTION_LOADER(adl_setHVibrato, void(*)(struct ADL_MIDIPlayer*,int))
         FUNCTION_LOADER(adl_setHTremolo, void(*)(struct ADL_MIDIPlayer*,int))
         FUNCTION_LOADER(adl_openBankFile, int(*)(struct ADL_MIDIPlayer*,const char*))
+        FUNCTION_LOADER(adl_openBankData, int(*)(struct ADL_MIDIPlayer*,const void*,unsigned long))
         FUNCTION_LOADER(adl_setBank, int(*)(struct ADL_MIDIPlayer *, int))
         FUNCTION_LOADER(adl_errorInfo, const char *(*)(struct ADL_MIDIPlayer*))
         FUNCTION_LOADER(adl_switchEmulator, int(*)(struct ADL_MIDIPlayer*,int))
@@ -117,6 +127,7 @@ static int ADLMIDI_Load(void)
         FUNCTION_LOADER(adl_metaMusicTitle, const char*(*)(struct ADL_MIDIPlayer*))
         FUNCTION_LOADER(adl_metaMusicCopyright, const char*(*)(struct ADL_MIDIPlayer*))
         FUNCTION_LOADER(adl_positionRewind, void (*)(struct ADL_MIDIPlayer*))
+        FUNCTION_LOADER(adl_reset, void (*)(struct ADL_MIDIPlayer*))
         FUNCTION_LOADER(adl_setLoopEnabled, void(*)(struct ADL_MIDIPlayer*,int))
         FUNCTION_LOADER(adl_setLoopCount, void(*)(struct ADL_MIDIPlayer*,int))
         FUNCTION_LOADER(adl_playFormat, int(*)(struct ADL_MIDIPlayer *,int,
@@ -126,6 +137,12 @@ static int ADLMIDI_Load(void)
         FUNCTION_LOADER(adl_totalTimeLength, double(*)(struct ADL_MIDIPlayer*))
         FUNCTION_LOADER(adl_loopStartTime, double(*)(struct ADL_MIDIPlayer*))
         FUNCTION_LOADER(adl_loopEndTime, double(*)(struct ADL_MIDIPlayer*))
+        if (music_synth_pool_init(&adlmidi_pool, ADLMIDI_closeSynth) < 0) {
+#ifdef ADLMIDI_DYNAMIC
+            SDL_UnloadObject(ADLMIDI.handle);
+#endif
+            return -1;
+        }
     }
     ++ADLMIDI.loaded;
 
@@ -138,6 +155,7 @@ static void ADLMIDI_Unload(void)
         return;
     }
     if (ADLMIDI.loaded == 1) {
+        music_synth_pool_quit(&adlmidi_pool);
 #ifdef ADLMIDI_DYNAMIC
         SDL_UnloadObject(ADLMIDI.handle);
 #endif
@@ -335,11 +353,13 @@ typedef struct
 {
     int play_count;
     struct ADL_MIDIPlayer *adlmidi;
+    SDL_bool adlmidi_ready; /* Fully set up, can be given to the pool */
+    char adlmidi_key[2200];
     int volume;
     double tempo;
     double gain;
 
-    SDL_AudioStream *stream;
+    Mix_MusicStream *stream;
     void *buffer;
     size_t buffer_size;
     size_t buffer_samples;
@@ -471,13 +491,20 @@ static void process_args(const char *args, AdlMidi_Setup *setup)
 
 static void ADLMIDI_delete(void *music_p);
 
+/* Synthesizers are reused by songs with the same sample rate, bank, emulator and chips setup */
+static void ADLMIDI_makeSynthKey(char *key, size_t size, const AdlMidi_Setup *setup)
+{
+    SDL_snprintf(key, size, "%d:%d:%d:%d:%d:%s", music_spec.freq,
+                 setup->bank, setup->emulator, setup->chips_count,
+                 setup->four_op_channels, setup->custom_bank_path);
+}
+
 static AdlMIDI_Music *ADLMIDI_LoadSongRW(SDL_RWops *src, const char *args)
 {
-    void *bytes = 0;
-    long filesize = 0;
+    const void *bytes = NULL;
+    void *bytes_free = NULL;
+    size_t filesize = 0;
     int err = 0;
-    Sint64 length = 0;
-    unsigned char byte[1];
     AdlMIDI_Music *music = NULL;
     AdlMidi_Setup setup = adlmidi_setup;
     unsigned short src_format = music_spec.format;
@@ -535,7 +562,7 @@ static AdlMIDI_Music *ADLMIDI_LoadSongRW(SDL_RWops *src, const char *args)
         src_format = AUDIO_F32SYS;
     }
 
-    music->stream = SDL_NewAudioStream(src_format, 2, music_spec.freq,
+    music->stream = music_stream_new(src_format, 2, music_spec.freq,
                                        music_spec.format, music_spec.channels, music_spec.freq);
 
     if (!music->stream) {
@@ -552,72 +579,74 @@ static AdlMIDI_Music *ADLMIDI_LoadSongRW(SDL_RWops *src, const char *args)
         return NULL;
     }
 
-    length = SDL_RWseek(src, 0, RW_SEEK_END);
-    if (length < 0) {
-        Mix_SetError("ADL-MIDI: wrong file\n");
-        ADLMIDI_delete(music);
-        return NULL;
-    }
-
     SDL_RWseek(src, 0, RW_SEEK_SET);
-    bytes = SDL_malloc((size_t)length);
+    bytes = _Mix_LoadRWData(src, &filesize, &bytes_free);
     if (!bytes) {
-        SDL_OutOfMemory();
+        Mix_SetError("ADL-MIDI: wrong file\n");
         ADLMIDI_delete(music);
         return NULL;
     }
 
-    filesize = 0;
-    while (SDL_RWread(src, &byte, sizeof(Uint8), 1) != 0) {
-        ((Uint8 *)bytes)[filesize] = byte[0];
-        filesize++;
-    }
+    ADLMIDI_makeSynthKey(music->adlmidi_key, sizeof(music->adlmidi_key), &setup);
+    music->adlmidi = (struct ADL_MIDIPlayer *)music_synth_pool_take(&adlmidi_pool, music->adlmidi_key);
 
-    if (filesize == 0) {
-        SDL_free(bytes);
-        ADLMIDI_delete(music);
-        Mix_SetError("ADL-MIDI: wrong file\n");
-        return NULL;
-    }
+    if (music->adlmidi) {
+        size_t channel;
+        /* Settings out of the key are applied to the reused synth again */
+        ADLMIDI.adl_setHVibrato(music->adlmidi, setup.vibrato);
+        ADLMIDI.adl_setHTremolo(music->adlmidi, setup.tremolo);
+        for (channel = 0; channel < 16; channel++) {
+            ADLMIDI.adl_setChannelEnabled(music->adlmidi, channel, 1);
+        }
+    } else {
+        music->adlmidi = ADLMIDI.adl_init(music_spec.freq);
+        if (!music->adlmidi) {
+            SDL_free(bytes_free);
+            SDL_OutOfMemory();
+            ADLMIDI_delete(music);
+            return NULL;
+        }
 
-    music->adlmidi = ADLMIDI.adl_init(music_spec.freq);
-    if (!music->adlmidi) {
-        SDL_free(bytes);
-        SDL_OutOfMemory();
-        ADLMIDI_delete(music);
-        return NULL;
-    }
+        ADLMIDI.adl_setHVibrato(music->adlmidi, setup.vibrato);
+        ADLMIDI.adl_setHTremolo(music->adlmidi, setup.tremolo);
 
-    ADLMIDI.adl_setHVibrato(music->adlmidi, setup.vibrato);
-    ADLMIDI.adl_setHTremolo(music->adlmidi, setup.tremolo);
+        if (setup.custom_bank_path[0] != '\0') {
+            size_t bank_size = 0;
+            const void *bank = music_synth_pool_bank(&adlmidi_pool, setup.custom_bank_path, &bank_size);
+            if (bank) {
+                err = ADLMIDI.adl_openBankData(music->adlmidi, bank, (unsigned long)bank_size);
+            } else {
+                err = ADLMIDI.adl_openBankFile(music->adlmidi, (char*)setup.custom_bank_path);
+            }
+        } else {
+            err = ADLMIDI.adl_setBank(music->adlmidi, setup.bank);
+        }
 
-    if (setup.custom_bank_path[0] != '\0') {
-        err = ADLMIDI.adl_openBankFile(music->adlmidi, (char*)setup.custom_bank_path);
-    } else {
-        err = ADLMIDI.adl_setBank(music->adlmidi, setup.bank);
-    }
+        if (err < 0) {
+            Mix_SetError("ADL-MIDI: %s", ADLMIDI.adl_errorInfo(music->adlmidi));
+            SDL_free(bytes_free);
+            ADLMIDI_delete(music);
+            return NULL;
+        }
 
-    if (err < 0) {
-        Mix_SetError("ADL-MIDI: %s", ADLMIDI.adl_errorInfo(music->adlmidi));
-        SDL_free(bytes);
-        ADLMIDI_delete(music);
-        return NULL;
+        ADLMIDI.adl_switchEmulator( music->adlmidi, (setup.emulator >= 0) ? setup.emulator : ADLMIDI_EMU_DOSBOX );
+        ADLMIDI.adl_setNumChips(music->adlmidi, (setup.chips_count >= 0) ? setup.chips_count : ADLMIDI_DEFAULT_CHIPS_COUNT);
+        if (setup.four_op_channels >= 0) {
+            ADLMIDI.adl_setNumFourOpsChn(music->adlmidi, setup.four_op_channels);
+        }
     }
 
-    ADLMIDI.adl_switchEmulator( music->adlmidi, (setup.emulator >= 0) ? setup.emulator : ADLMIDI_EMU_DOSBOX );
+    music->adlmidi_ready = SDL_TRUE;
+
     ADLMIDI.adl_setScaleModulators(music->adlmidi, setup.scalemod);
     ADLMIDI.adl_setVolumeRangeModel(music->adlmidi, setup.volume_model);
     ADLMIDI.adl_setFullRangeBrightness(music->adlmidi, setup.full_brightness_range);
     ADLMIDI.adl_setSoftPanEnabled(music->adlmidi, setup.soft_pan);
     ADLMIDI.adl_setAutoArpeggio(music->adlmidi, setup.auto_arpeggio);
-    ADLMIDI.adl_setNumChips(music->adlmidi, (setup.chips_count >= 0) ? setup.chips_count : ADLMIDI_DEFAULT_CHIPS_COUNT);
-    if (setup.four_op_channels >= 0) {
-        ADLMIDI.adl_setNumFourOpsChn(music->adlmidi, setup.four_op_channels);
-    }
     ADLMIDI.adl_setTempo(music->adlmidi, music->tempo);
 
     err = ADLMIDI.adl_openData(music->adlmidi, bytes, (unsigned long)filesize);
-    SDL_free(bytes);
+    SDL_free(bytes_free);
 
     if (err != 0) {
         Mix_SetError("ADL-MIDI: %s", ADLMIDI.adl_errorInfo(music->adlmidi));
@@ -665,7 +694,7 @@ static int ADLMIDI_playSome(void *context, void *data, int bytes, SDL_bool *done
     AdlMIDI_Music *music = (AdlMIDI_Music *)context;
     int filled, gottenLen, amount;
 
-    filled = SDL_AudioStreamGet(music->stream, data, bytes);
+    filled = music_stream_get(music->stream, data, bytes);
     if (filled != 0) {
         return filled;
     }
@@ -689,13 +718,13 @@ static int ADLMIDI_playSome(void *context, void *data, int bytes, SDL_bool *done
 
     amount = gottenLen * (int)music->sample_format.containerSize;
     if (amount > 0) {
-        if (SDL_AudioStreamPut(music->stream, music->buffer, amount) < 0) {
+        if (music_stream_put(music->stream, music->buffer, amount) < 0) {
             return -1;
         }
     } else {
         if (music->play_count == 1) {
             music->play_count = 0;
-            SDL_AudioStreamFlush(music->stream);
+            music_stream_flush(music->stream);
         } else {
             int play_count = -1;
             if (music->play_count > 0) {
@@ -722,11 +751,14 @@ static void ADLMIDI_delete(void *music_p)
     AdlMIDI_Music *music = (AdlMIDI_Music *)music_p;
     if (music) {
         meta_tags_clear(&music->tags);
-        if (music->adlmidi) {
+        if (music->adlmidi && music->adlmidi_ready) {
+            ADLMIDI.adl_reset(music->adlmidi);
+            music_synth_pool_give(&adlmidi_pool, music->adlmidi_key, music->adlmidi);
+        } else if (music->adlmidi) {
             ADLMIDI.adl_close(music->adlmidi);
         }
         if (music->stream) {
-            SDL_FreeAudioStream(music->stream);
+            music_stream_free(music->stream);
         }
         if (music->buffer) {
             SDL_free(music->buffer);
@@ -871,6 +903,11 @@ Mix_MusicInterface Mix_MusicInterface_ADLMIDI =
     ADLMIDI_LoopStart,   /* LoopStart [MIXER-X]*/
     ADLMIDI_LoopEnd,   /* LoopEnd [MIXER-X]*/
     ADLMIDI_LoopLength,   /* LoopLength [MIXER-X]*/
+    NULL,   /* BuildSeekIndex [MIXER-X] */
+    NULL,   /* GetSeekIndex [MIXER-X] */
+    NULL,   /* SetSeekIndex [MIXER-X] */
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     ADLMIDI_GetMetaTag,   /* GetMetaTag [MIXER-X]*/
     NULL,   /* Pause */
     NULL,   /* Resume */
@@ -911,6 +948,11 @@ Mix_MusicInterface Mix_MusicInterface_ADLIMF =
     ADLMIDI_LoopStart,   /* LoopStart [MIXER-X]*/
     ADLMIDI_LoopEnd,   /* LoopEnd [MIXER-X]*/
     ADLMIDI_LoopLength,   /* LoopLength [MIXER-X]*/
+    NULL,   /* BuildSeekIndex [MIXER-X] */
+    NULL,   /* GetSeekIndex [MIXER-X] */
+    NULL,   /* SetSeekIndex [MIXER-X] */
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     ADLMIDI_GetMetaTag,   /* GetMetaTag [MIXER-X]*/
     NULL,   /* Pause */
     NULL,   /* Resume */
@@ -46,6 +46,7 @@ typedef struct {
     const char *(*edmidi_metaMusicTitle)(struct EDMIDIPlayer *device);
     const char *(*edmidi_metaMusicCopyright)(struct EDMIDIPlayer *device);
     void (*edmidi_positionRewind)(struct EDMIDIPlayer *device);
+    void (*edmidi_reset)(struct EDMIDIPlayer *device);
     void (*edmidi_setLoopEnabled)(struct EDMIDIPlayer *device, int loopEn);
     void (*edmidi_setLoopCount)(struct EDMIDIPlayer *device, int loopCount);
     int  (*edmidi_playFormat)(struct EDMIDIPlayer *device, int sampleCount,
@@ -60,6 +61,13 @@ typedef struct {
 
 static edmidi_loader EDMIDI;
 
+static Mix_SynthPool edmidi_pool;
+
+static void EDMIDI_closeSynth(void *synth)
+{
+    EDMIDI.edmidi_close((struct EDMIDIPlayer *)synth);
+}
+
 #ifdef EDMIDI_DYNAMIC
 #define FUNCTION_LOADER(FUNC, SIG) \
     EDMIDI.FUNC = (SIG) SDL_LoadFunction(EDMIDI.handle, #FUNC); \
@@ -91,6 +99,7 @@ static int EDMIDI_Load(void)
         FUNCTION_LOADER(edmidi_metaMusicTitle, const char*(*)(struct EDMIDIPlayer*))
         FUNCTION_LOADER(edmidi_metaMusicCopyright, const char*(*)(struct EDMIDIPlayer*))
         FUNCTION_LOADER(edmidi_positionRewind, void (*)(struct EDMIDIPlayer*))
+        FUNCTION_LOADER(edmidi_reset, void (*)(struct EDMIDIPlayer*))
         FUNCTION_LOADER(edmidi_setLoopEnabled, void(*)(struct EDMIDIPlayer*,int))
         FUNCTION_LOADER(edmidi_setLoopCount, void(*)(struct EDMIDIPlayer*,int))
         FUNCTION_LOADER(edmidi_playFormat, int(*)(struct EDMIDIPlayer *,int,
@@ -100,6 +109,12 @@ static int EDMIDI_Load(void)
         FUNCTION_LOADER(edmidi_totalTimeLength, double(*)(struct EDMIDIPlayer*))
         FUNCTION_LOADER(edmidi_loopStartTime, double(*)(struct EDMIDIPlayer*))
         FUNCTION_LOADER(edmidi_loopEndTime, double(*)(struct EDMIDIPlayer*))
+        if (music_synth_pool_init(&edmidi_pool, EDMIDI_closeSynth) < 0) {
+#ifdef EDMIDI_DYNAMIC
+            SDL_UnloadObject(EDMIDI.handle);
+#endif
+            return -1;
+        }
     }
     ++EDMIDI.loaded;
 
@@ -112,6 +127,7 @@ static void EDMIDI_Unload(void)
         return;
     }
     if (EDMIDI.loaded == 1) {
+        music_synth_pool_quit(&edmidi_pool);
 #ifdef EDMIDI_DYNAMIC
         SDL_UnloadObject(EDMIDI.handle);
 #endif
@@ -149,11 +165,13 @@ typedef struct
 {
     int play_count;
     struct EDMIDIPlayer *edmidi;
+    SDL_bool edmidi_ready; /* Fully set up, can be given to the pool */
+    char edmidi_key[32];
     int volume;
     double tempo;
     double gain;
 
-    SDL_AudioStream *stream;
+    Mix_MusicStream *stream;
     void *buffer;
     size_t buffer_size;
     size_t buffer_samples;
@@ -250,11 +268,10 @@ static void EDMIDI_delete(void *music_p);
 
 static EDMIDI_Music *EDMIDI_LoadSongRW(SDL_RWops *src, const char *args)
 {
-    void *bytes = 0;
-    long filesize = 0;
+    const void *bytes = NULL;
+    void *bytes_free = NULL;
+    size_t filesize = 0;
     int err = 0;
-    Sint64 length = 0;
-    unsigned char byte[1];
     EDMIDI_Music *music = NULL;
     EDMidi_Setup setup = edmidi_setup;
     unsigned short src_format = music_spec.format;
@@ -312,7 +329,7 @@ static EDMIDI_Music *EDMIDI_LoadSongRW(SDL_RWops *src, const char *args)
         src_format = AUDIO_F32SYS;
     }
 
-    music->stream = SDL_NewAudioStream(src_format, 2, music_spec.freq,
+    music->stream = music_stream_new(src_format, 2, music_spec.freq,
                                        music_spec.format, music_spec.channels, music_spec.freq);
 
     if (!music->stream) {
@@ -329,53 +346,46 @@ static EDMIDI_Music *EDMIDI_LoadSongRW(SDL_RWops *src, const char *args)
         return NULL;
     }
 
-    length = SDL_RWseek(src, 0, RW_SEEK_END);
-    if (length < 0) {
-        Mix_SetError("ADL-MIDI: wrong file\n");
-        EDMIDI_delete(music);
-        return NULL;
-    }
-
     SDL_RWseek(src, 0, RW_SEEK_SET);
-    bytes = SDL_malloc((size_t)length);
+    bytes = _Mix_LoadRWData(src, &filesize, &bytes_free);
     if (!bytes) {
-        SDL_OutOfMemory();
+        Mix_SetError("ADL-MIDI: wrong file\n");
         EDMIDI_delete(music);
         return NULL;
     }
 
-    filesize = 0;
-    while (SDL_RWread(src, &byte, sizeof(Uint8), 1) != 0) {
-        ((Uint8 *)bytes)[filesize] = byte[0];
-        filesize++;
-    }
-
-    if (filesize == 0) {
-        SDL_free(bytes);
-        EDMIDI_delete(music);
-        Mix_SetError("ADL-MIDI: wrong file\n");
-        return NULL;
-    }
+    /* Synthesizers are reused by songs with the same sample rate and modules count */
+    SDL_snprintf(music->edmidi_key, sizeof(music->edmidi_key), "%d:%d", music_spec.freq, setup.mods_num);
+    music->edmidi = (struct EDMIDIPlayer *)music_synth_pool_take(&edmidi_pool, music->edmidi_key);
 
-    music->edmidi = EDMIDI.edmidi_initEx(music_spec.freq, setup.mods_num);
-    if (!music->edmidi) {
-        SDL_free(bytes);
-        SDL_OutOfMemory();
-        EDMIDI_delete(music);
-        return NULL;
+    if (music->edmidi) {
+        size_t channel;
+        for (channel = 0; channel < 16; channel++) {
+            EDMIDI.edmidi_setChannelEnabled(music->edmidi, channel, 1);
+        }
+    } else {
+        music->edmidi = EDMIDI.edmidi_initEx(music_spec.freq, setup.mods_num);
+        if (!music->edmidi) {
+            SDL_free(bytes_free);
+            SDL_OutOfMemory();
+            EDMIDI_delete(music);
+            return NULL;
+        }
     }
 
     if (err < 0) {
         Mix_SetError("ADL-MIDI: %s", EDMIDI.edmidi_errorInfo(music->edmidi));
-        SDL_free(bytes);
+        SDL_free(bytes_free);
         EDMIDI_delete(music);
         return NULL;
     }
 
+    music->edmidi_ready = SDL_TRUE;
+
     EDMIDI.edmidi_setTempo(music->edmidi, music->tempo);
 
     err = EDMIDI.edmidi_openData(music->edmidi, bytes, (unsigned long)filesize);
-    SDL_free(bytes);
+    SDL_free(bytes_free);
 
     if (err != 0) {
         Mix_SetError("ADL-MIDI: %s", EDMIDI.edmidi_errorInfo(music->edmidi));
@@ -423,7 +433,7 @@ static int EDMIDI_playSome(void *context, void *data, int bytes, SDL_bool *done)
     EDMIDI_Music *music = (EDMIDI_Music *)context;
     int filled, gottenLen, amount;
 
-    filled = SDL_AudioStreamGet(music->stream, data, bytes);
+    filled = music_stream_get(music->stream, data, bytes);
     if (filled != 0) {
         return filled;
     }
@@ -447,13 +457,13 @@ static int EDMIDI_playSome(void *context, void *data, int bytes, SDL_bool *done)
 
     amount = gottenLen * (int)music->sample_format.containerSize;
     if (amount > 0) {
-        if (SDL_AudioStreamPut(music->stream, music->buffer, amount) < 0) {
+        if (music_stream_put(music->stream, music->buffer, amount) < 0) {
             return -1;
         }
     } else {
         if (music->play_count == 1) {
             music->play_count = 0;
-            SDL_AudioStreamFlush(music->stream);
+            music_stream_flush(music->stream);
         } else {
             int play_count = -1;
             if (music->play_count > 0) {
@@ -480,11 +490,14 @@ static void EDMIDI_delete(void *music_p)
     EDMIDI_Music *music = (EDMIDI_Music *)music_p;
     if (music) {
         meta_tags_clear(&music->tags);
-        if (music->edmidi) {
+        if (music->edmidi && music->edmidi_ready) {
+            EDMIDI.edmidi_reset(music->edmidi);
+            music_synth_pool_give(&edmidi_pool, music->edmidi_key, music->edmidi);
+        } else if (music->edmidi) {
             EDMIDI.edmidi_close(music->edmidi);
         }
         if (music->stream) {
-            SDL_FreeAudioStream(music->stream);
+            music_stream_free(music->stream);
         }
         if (music->buffer) {
             SDL_free(music->buffer);
@@ -629,6 +642,11 @@ Mix_MusicInterface Mix_MusicInterface_EDMIDI =
     EDMIDI_LoopStart,   /* LoopStart [MIXER-X]*/
     EDMIDI_LoopEnd,   /* LoopEnd [MIXER-X]*/
     EDMIDI_LoopLength,   /* LoopLength [MIXER-X]*/
+    NULL,   /* BuildSeekIndex [MIXER-X] */
+    NULL,   /* GetSeekIndex [MIXER-X] */
+    NULL,   /* SetSeekIndex [MIXER-X] */
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     EDMIDI_GetMetaTag,   /* GetMetaTag [MIXER-X]*/
     NULL,   /* Pause */
     NULL,   /* Resume */
@@ -668,6 +686,11 @@ Mix_MusicInterface Mix_MusicInterface_EDXMI =
     EDMIDI_LoopStart,   /* LoopStart [MIXER-X]*/
     EDMIDI_LoopEnd,   /* LoopEnd [MIXER-X]*/
     EDMIDI_LoopLength,   /* LoopLength [MIXER-X]*/
+    NULL,   /* BuildSeekIndex [MIXER-X] */
+    NULL,   /* GetSeekIndex [MIXER-X] */
+    NULL,   /* SetSeekIndex [MIXER-X] */
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     EDMIDI_GetMetaTag,   /* GetMetaTag [MIXER-X]*/
     NULL,   /* Pause */
     NULL,   /* Resume */
@@ -55,6 +55,7 @@ typedef struct {
     const char *(*opn2_metaMusicTitle)(struct OPN2_MIDIPlayer *device);
     const char *(*opn2_metaMusicCopyright)(struct OPN2_MIDIPlayer *device);
     void (*opn2_positionRewind)(struct OPN2_MIDIPlayer *device);
+    void (*opn2_reset)(struct OPN2_MIDIPlayer *device);
     void (*opn2_setLoopEnabled)(struct OPN2_MIDIPlayer *device, int loopEn);
     void (*opn2_setLoopCount)(struct OPN2_MIDIPlayer *device, int loopCount);
     int  (*opn2_playFormat)(struct OPN2_MIDIPlayer *device, int sampleCount,
@@ -69,6 +70,13 @@ typedef struct {
 
 static opnmidi_loader OPNMIDI;
 
+static Mix_SynthPool opnmidi_pool;
+
+static void OPNMIDI_closeSynth(void *synth)
+{
+    OPNMIDI.opn2_close((struct OPN2_MIDIPlayer *)synth);
+}
+
 #ifdef OPNMIDI_DYNAMIC
 #define FUNCTION_LOADER(FUNC, SIG) \
     OPNMIDI.FUNC = (SIG) SDL_LoadFunction(OPNMIDI.handle, #FUNC); \
@@ -108,6 +116,7 @@ static int OPNMIDI_Load(void)
         FUNCTION_LOADER(opn2_metaMusicTitle, const char*(*)(struct OPN2_MIDIPlayer*))
         FUNCTION_LOADER(opn2_metaMusicCopyright, const char*(*)(struct OPN2_MIDIPlayer*))
         FUNCTION_LOADER(opn2_positionRewind, void (*)(struct OPN2_MIDIPlayer*))
+        FUNCTION_LOADER(opn2_reset, void (*)(struct OPN2_MIDIPlayer*))
         FUNCTION_LOADER(opn2_setLoopEnabled, void(*)(struct OPN2_MIDIPlayer*,int))
         FUNCTION_LOADER(opn2_setLoopCount, void(*)(struct OPN2_MIDIPlayer*,int))
         FUNCTION_LOADER(opn2_playFormat, int(*)(struct OPN2_MIDIPlayer *,int,
@@ -117,6 +126,12 @@ static int OPNMIDI_Load(void)
         FUNCTION_LOADER(opn2_totalTimeLength, double(*)(struct OPN2_MIDIPlayer*))
         FUNCTION_LOADER(opn2_loopStartTime, double(*)(struct OPN2_MIDIPlayer*))
         FUNCTION_LOADER(opn2_loopEndTime, double(*)(struct OPN2_MIDIPlayer*))
+        if (music_synth_pool_init(&opnmidi_pool, OPNMIDI_closeSynth) < 0) {
+#ifdef OPNMIDI_DYNAMIC
+            SDL_UnloadObject(OPNMIDI.handle);
+#endif
+            return -1;
+        }
     }
     ++OPNMIDI.loaded;
 
@@ -129,6 +144,7 @@ static void OPNMIDI_Unload(void)
         return;
     }
     if (OPNMIDI.loaded == 1) {
+        music_synth_pool_quit(&opnmidi_pool);
 #ifdef OPNMIDI_DYNAMIC
         SDL_UnloadObject(OPNMIDI.handle);
 #endif
@@ -251,12 +267,14 @@ typedef struct
 {
     int play_count;
     struct OPN2_MIDIPlayer *opnmidi;
+    SDL_bool opnmidi_ready; /* Fully set up, can be given to the pool */
+    char opnmidi_key[2200];
     int playing;
     int volume;
     double tempo;
     double gain;
 
-    SDL_AudioStream *stream;
+    Mix_MusicStream *stream;
     void *buffer;
     size_t buffer_size;
     size_t buffer_samples;
@@ -375,13 +393,19 @@ static void process_args(const char *args, OpnMidi_Setup *setup)
 
 static void OPNMIDI_delete(void *music_p);
 
+/* Synthesizers are reused by songs with the same sample rate, bank, emulator and chips count */
+static void OPNMIDI_makeSynthKey(char *key, size_t size, const OpnMidi_Setup *setup)
+{
+    SDL_snprintf(key, size, "%d:%d:%d:%s", music_spec.freq,
+                 setup->emulator, setup->chips_count, setup->custom_bank_path);
+}
+
 static OpnMIDI_Music *OPNMIDI_LoadSongRW(SDL_RWops *src, const char *args)
 {
-    void *bytes = 0;
-    long filesize = 0;
+    const void *bytes = NULL;
+    void *bytes_free = NULL;
+    size_t filesize = 0;
     int err = 0;
-    Sint64 length = 0;
-    unsigned char byte[1];
     OpnMIDI_Music *music = NULL;
     OpnMidi_Setup setup = opnmidi_setup;
     unsigned short src_format = music_spec.format;
@@ -439,7 +463,7 @@ static OpnMIDI_Music *OPNMIDI_LoadSongRW(SDL_RWops *src, const char *args)
         src_format = AUDIO_F32SYS;
     }
 
-    music->stream = SDL_NewAudioStream(src_format, 2, music_spec.freq,
+    music->stream = music_stream_new(src_format, 2, music_spec.freq,
                                        music_spec.format, music_spec.channels, music_spec.freq);
 
     if (!music->stream) {
@@ -456,67 +480,66 @@ static OpnMIDI_Music *OPNMIDI_LoadSongRW(SDL_RWops *src, const char *args)
         return NULL;
     }
 
-    length = SDL_RWseek(src, 0, RW_SEEK_END);
-    if (length < 0) {
-        Mix_SetError("OPN2-MIDI: wrong file\n");
-        OPNMIDI_delete(music);
-        return NULL;
-    }
-
     SDL_RWseek(src, 0, RW_SEEK_SET);
-    bytes = SDL_malloc((size_t)length);
+    bytes = _Mix_LoadRWData(src, &filesize, &bytes_free);
     if (!bytes) {
-        SDL_OutOfMemory();
-        OPNMIDI_delete(music);
-        return NULL;
-    }
-
-    filesize = 0;
-    while (SDL_RWread(src, &byte, sizeof(Uint8), 1) != 0) {
-        ((unsigned char*)bytes)[filesize] = byte[0];
-        filesize++;
-    }
-
-    if (filesize == 0) {
         Mix_SetError("OPN2-MIDI: wrong file\n");
-        SDL_free(bytes);
         OPNMIDI_delete(music);
         return NULL;
     }
 
-    music->opnmidi = OPNMIDI.opn2_init(music_spec.freq);
-    if (!music->opnmidi) {
-        SDL_free(bytes);
-        SDL_OutOfMemory();
-        OPNMIDI_delete(music);
-        return NULL;
-    }
+    OPNMIDI_makeSynthKey(music->opnmidi_key, sizeof(music->opnmidi_key), &setup);
+    music->opnmidi = (struct OPN2_MIDIPlayer *)music_synth_pool_take(&opnmidi_pool, music->opnmidi_key);
 
-    if (setup.custom_bank_path[0] != '\0') {
-        err = OPNMIDI.opn2_openBankFile(music->opnmidi, (char*)setup.custom_bank_path);
+    if (music->opnmidi) {
+        size_t channel;
+        for (channel = 0; channel < 16; channel++) {
+            OPNMIDI.opn2_setChannelEnabled(music->opnmidi, channel, 1);
+        }
     } else {
-        err = OPNMIDI.opn2_openBankData(music->opnmidi, g_gm_opn2_bank, sizeof(g_gm_opn2_bank));
-    }
+        music->opnmidi = OPNMIDI.opn2_init(music_spec.freq);
+        if (!music->opnmidi) {
+            SDL_free(bytes_free);
+            SDL_OutOfMemory();
+            OPNMIDI_delete(music);
+            return NULL;
+        }
 
-    if ( err < 0 ) {
-        Mix_SetError("OPN2-MIDI: %s", OPNMIDI.opn2_errorInfo(music->opnmidi));
-        SDL_free(bytes);
-        OPNMIDI_delete(music);
-        return NULL;
-    }
+        if (setup.custom_bank_path[0] != '\0') {
+            size_t bank_size = 0;
+            const void *bank = music_synth_pool_bank(&opnmidi_pool, setup.custom_bank_path, &bank_size);
+            if (bank) {
+                err = OPNMIDI.opn2_openBankData(music->opnmidi, bank, (long)bank_size);
+            } else {
+                err = OPNMIDI.opn2_openBankFile(music->opnmidi, (char*)setup.custom_bank_path);
+            }
+        } else {
+            err = OPNMIDI.opn2_openBankData(music->opnmidi, g_gm_opn2_bank, sizeof(g_gm_opn2_bank));
+        }
 
-    if (setup.emulator >= 0) {
-        OPNMIDI.opn2_switchEmulator(music->opnmidi, setup.emulator);
+        if ( err < 0 ) {
+            Mix_SetError("OPN2-MIDI: %s", OPNMIDI.opn2_errorInfo(music->opnmidi));
+            SDL_free(bytes_free);
+            OPNMIDI_delete(music);
+            return NULL;
+        }
+
+        if (setup.emulator >= 0) {
+            OPNMIDI.opn2_switchEmulator(music->opnmidi, setup.emulator);
+        }
+        OPNMIDI.opn2_setNumChips(music->opnmidi, (setup.chips_count >= 0) ? setup.chips_count : OPNMIDI_DEFAULT_CHIPS_COUNT);
     }
+
+    music->opnmidi_ready = SDL_TRUE;
+
     OPNMIDI.opn2_setVolumeRangeModel(music->opnmidi, setup.volume_model);
     OPNMIDI.opn2_setFullRangeBrightness(music->opnmidi, setup.full_brightness_range);
     OPNMIDI.opn2_setSoftPanEnabled(music->opnmidi, setup.soft_pan);
     OPNMIDI.opn2_setAutoArpeggio(music->opnmidi, setup.auto_arpeggio);
-    OPNMIDI.opn2_setNumChips(music->opnmidi, (setup.chips_count >= 0) ? setup.chips_count : OPNMIDI_DEFAULT_CHIPS_COUNT);
     OPNMIDI.opn2_setTempo(music->opnmidi, music->tempo);
 
     err = OPNMIDI.opn2_openData( music->opnmidi, bytes, (unsigned long)filesize);
-    SDL_free(bytes);
+    SDL_free(bytes_free);
 
     if (err != 0) {
         Mix_SetError("OPN2-MIDI: %s", OPNMIDI.opn2_errorInfo(music->opnmidi));
@@ -563,7 +586,7 @@ static int OPNMIDI_playSome(void *context, void *data, int bytes, SDL_bool *done
     OpnMIDI_Music *music = (OpnMIDI_Music *)context;
     int filled, gottenLen, amount;
 
-    filled = SDL_AudioStreamGet(music->stream, data, bytes);
+    filled = music_stream_get(music->stream, data, bytes);
     if (filled != 0) {
         return filled;
     }
@@ -587,13 +610,13 @@ static int OPNMIDI_playSome(void *context, void *data, int bytes, SDL_bool *done
 
     amount = gottenLen * (int)music->sample_format.containerSize;
     if (amount > 0) {
-        if (SDL_AudioStreamPut(music->stream, music->buffer, amount) < 0) {
+        if (music_stream_put(music->stream, music->buffer, amount) < 0) {
             return -1;
         }
     } else {
         if (music->play_count == 1) {
             music->play_count = 0;
-            SDL_AudioStreamFlush(music->stream);
+            music_stream_flush(music->stream);
         } else {
             int play_count = -1;
             if (music->play_count > 0) {
@@ -620,11 +643,14 @@ static void OPNMIDI_delete(void *music_p)
     OpnMIDI_Music *music = (OpnMIDI_Music*)music_p;
     if (music) {
         meta_tags_clear(&music->tags);
-        if (music->opnmidi) {
+        if (music->opnmidi && music->opnmidi_ready) {
+            OPNMIDI.opn2_reset(music->opnmidi);
+            music_synth_pool_give(&opnmidi_pool, music->opnmidi_key, music->opnmidi);
+        } else if (music->opnmidi) {
             OPNMIDI.opn2_close(music->opnmidi);
         }
         if (music->stream) {
-            SDL_FreeAudioStream(music->stream);
+            music_stream_free(music->stream);
         }
         if (music->buffer) {
             SDL_free(music->buffer);
@@ -758,6 +784,11 @@ Mix_MusicInterface Mix_MusicInterface_OPNMIDI =
     OPNMIDI_LoopStart,   /* LoopStart [MIXER-X]*/
     OPNMIDI_LoopEnd,   /* LoopEnd [MIXER-X]*/
     OPNMIDI_LoopLength,   /* LoopLength [MIXER-X]*/
+    NULL,   /* BuildSeekIndex [MIXER-X] */
+    NULL,   /* GetSeekIndex [MIXER-X] */
+    NULL,   /* SetSeekIndex [MIXER-X] */
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     OPNMIDI_GetMetaTag,   /* GetMetaTag [MIXER-X]*/
     NULL,   /* Pause */
     NULL,   /* Resume */
@@ -798,6 +829,11 @@ Mix_MusicInterface Mix_MusicInterface_OPNXMI =
     OPNMIDI_LoopStart,   /* LoopStart [MIXER-X]*/
     OPNMIDI_LoopEnd,   /* LoopEnd [MIXER-X]*/
     OPNMIDI_LoopLength,   /* LoopLength [MIXER-X]*/
+    NULL,   /* BuildSeekIndex [MIXER-X] */
+    NULL,   /* GetSeekIndex [MIXER-X] */
+    NULL,   /* SetSeekIndex [MIXER-X] */
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     OPNMIDI_GetMetaTag,   /* GetMetaTag [MIXER-X]*/
     NULL,   /* Pause */
     NULL,   /* Resume */
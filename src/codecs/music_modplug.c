@@ -24,6 +24,7 @@
 #include "SDL_loadso.h"
 
 #include "music_modplug.h"
+#include "utils.h"
 
 #ifdef MODPLUG_HEADER
 #include MODPLUG_HEADER
@@ -113,7 +114,7 @@ typedef struct
     int volume;
     int play_count;
     ModPlugFile *file;
-    SDL_AudioStream *stream;
+    Mix_MusicStream *stream;
     void *buffer;
     int buffer_size;
     Mix_MusicMetaTags tags;
@@ -161,7 +162,8 @@ static int MODPLUG_Open(const SDL_AudioSpec *spec)
 void *MODPLUG_CreateFromRW(SDL_RWops *src, int freesrc)
 {
     MODPLUG_Music *music;
-    void *buffer;
+    const void *buffer;
+    void *buffer_free;
     size_t size;
 
     music = (MODPLUG_Music *)SDL_calloc(1, sizeof(*music));
@@ -172,7 +174,7 @@ void *MODPLUG_CreateFromRW(SDL_RWops *src, int freesrc)
 
     music->volume = MIX_MAX_VOLUME;
 
-    music->stream = SDL_NewAudioStream((settings.mBits == 8) ? AUDIO_U8 : AUDIO_S16SYS, (Uint8)settings.mChannels, settings.mFrequency,
+    music->stream = music_stream_new((settings.mBits == 8) ? AUDIO_U8 : AUDIO_S16SYS, (Uint8)settings.mChannels, settings.mFrequency,
                                        music_spec.format, music_spec.channels, music_spec.freq);
     if (!music->stream) {
         MODPLUG_Delete(music);
@@ -186,13 +188,13 @@ void *MODPLUG_CreateFromRW(SDL_RWops *src, int freesrc)
         return NULL;
     }
 
-    buffer = SDL_LoadFile_RW(src, &size, SDL_FALSE);
+    buffer = _Mix_LoadRWData(src, &size, &buffer_free);
     if (buffer) {
         music->file = modplug.ModPlug_Load(buffer, (int)size);
         if (!music->file) {
             Mix_SetError("ModPlug_Load failed");
         }
-        SDL_free(buffer);
+        SDL_free(buffer_free);
     }
 
     if (!music->file) {
@@ -235,7 +237,7 @@ static int MODPLUG_Play(void *context, int play_count)
 static void MODPLUG_Stop(void *context)
 {
     MODPLUG_Music *music = (MODPLUG_Music *)context;
-    SDL_AudioStreamClear(music->stream);
+    music_stream_clear(music->stream);
 }
 
 /* Play some of a stream previously started with modplug_play() */
@@ -244,7 +246,7 @@ static int MODPLUG_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     MODPLUG_Music *music = (MODPLUG_Music *)context;
     int filled, amount;
 
-    filled = SDL_AudioStreamGet(music->stream, data, bytes);
+    filled = music_stream_get(music->stream, data, bytes);
     if (filled != 0) {
         return filled;
     }
@@ -257,13 +259,13 @@ static int MODPLUG_GetSome(void *context, void *data, int bytes, SDL_bool *done)
 
     amount = modplug.ModPlug_Read(music->file, music->buffer, music->buffer_size);
     if (amount > 0) {
-        if (SDL_AudioStreamPut(music->stream, music->buffer, amount) < 0) {
+        if (music_stream_put(music->stream, music->buffer, amount) < 0) {
             return -1;
         }
     } else {
         if (music->play_count == 1) {
             music->play_count = 0;
-            SDL_AudioStreamFlush(music->stream);
+            music_stream_flush(music->stream);
         } else {
             int play_count = -1;
             if (music->play_count > 0) {
@@ -330,7 +332,7 @@ static void MODPLUG_Delete(void *context)
         modplug.ModPlug_Unload(music->file);
     }
     if (music->stream) {
-        SDL_FreeAudioStream(music->stream);
+        music_stream_free(music->stream);
     }
     if (music->buffer) {
         SDL_free(music->buffer);
@@ -368,6 +370,11 @@ Mix_MusicInterface Mix_MusicInterface_MODPLUG =
     NULL,   /* LoopStart */
     NULL,   /* LoopEnd */
     NULL,   /* LoopLength */
+    NULL,   /* BuildSeekIndex [MIXER-X] */
+    NULL,   /* GetSeekIndex [MIXER-X] */
+    NULL,   /* SetSeekIndex [MIXER-X] */
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     MODPLUG_GetMetaTag,
     NULL,   /* Pause */
     NULL,   /* Resume */
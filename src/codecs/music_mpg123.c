@@ -28,6 +28,7 @@
 
 #include "music_mpg123.h"
 #include "mp3utils.h"
+#include "../mixer.h"
 
 #include <stdio.h>      /* For SEEK_SET */
 #ifdef MPG123_HEADER
@@ -66,6 +67,9 @@ typedef struct {
     off_t (*mpg123_seek)( mpg123_handle *mh, off_t sampleoff, int whence );
     off_t (*mpg123_tell)( mpg123_handle *mh);
     off_t (*mpg123_length)(mpg123_handle *mh);
+    int (*mpg123_scan)(mpg123_handle *mh);
+    int (*mpg123_index)(mpg123_handle *mh, off_t **offsets, off_t *step, size_t *fill);
+    int (*mpg123_set_index)(mpg123_handle *mh, off_t *offsets, off_t step, size_t fill);
     const char* (*mpg123_strerror)(mpg123_handle *mh);
 } mpg123_loader;
 
@@ -110,6 +114,9 @@ static int MPG123_Load(void)
         FUNCTION_LOADER(mpg123_seek, off_t (*)( mpg123_handle *mh, off_t sampleoff, int whence ))
         FUNCTION_LOADER(mpg123_tell, off_t (*)( mpg123_handle *mh))
         FUNCTION_LOADER(mpg123_length, off_t (*)(mpg123_handle *mh))
+        FUNCTION_LOADER(mpg123_scan, int (*)(mpg123_handle *mh))
+        FUNCTION_LOADER(mpg123_index, int (*)(mpg123_handle *mh, off_t **offsets, off_t *step, size_t *fill))
+        FUNCTION_LOADER(mpg123_set_index, int (*)(mpg123_handle *mh, off_t *offsets, off_t step, size_t fill))
         FUNCTION_LOADER(mpg123_strerror, const char* (*)(mpg123_handle *mh))
     }
     ++mpg123.loaded;
@@ -139,7 +146,7 @@ typedef struct
     int volume;
 
     mpg123_handle* handle;
-    SDL_AudioStream *stream;
+    Mix_MusicStream *stream;
     unsigned char *buffer;
     size_t buffer_size;
     long sample_rate;
@@ -212,6 +219,17 @@ static void rwops_cleanup(void* p)
     /* do nothing, we will free the file later */
 }
 
+/* the seek index scan reads the stream at a position of its own */
+static MIX_SSIZE_T cursor_read(void* p, void* dst, size_t n)
+{
+    return (MIX_SSIZE_T)MP3_RWcursor_read((struct mp3file_cursor_t *)p, dst, n);
+}
+
+static off_t cursor_seek(void* p, off_t offset, int whence)
+{
+    return (off_t)MP3_RWcursor_seek((struct mp3file_cursor_t *)p, (Sint64)offset, whence);
+}
+
 
 static int MPG123_Open(const SDL_AudioSpec *spec)
 {
@@ -317,7 +335,7 @@ static void *MPG123_CreateFromRW(SDL_RWops *src, int freesrc)
     SDL_assert(format != -1);
     music->sample_rate = rate;
 
-    music->stream = SDL_NewAudioStream((SDL_AudioFormat)format, (Uint8)channels, (int)rate,
+    music->stream = music_stream_new((SDL_AudioFormat)format, (Uint8)channels, (int)rate,
                                        music_spec.format, music_spec.channels, music_spec.freq);
     if (!music->stream) {
         MPG123_Delete(music);
@@ -352,7 +370,7 @@ static int MPG123_Play(void *context, int play_count)
 static void MPG123_Stop(void *context)
 {
     MPG123_Music *music = (MPG123_Music *)context;
-    SDL_AudioStreamClear(music->stream);
+    music_stream_clear(music->stream);
 }
 
 /* read some mp3 stream data and convert it for output */
@@ -365,7 +383,7 @@ static int MPG123_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     int channels, encoding, format;
 
     if (music->stream) {
-        filled = SDL_AudioStreamGet(music->stream, data, bytes);
+        filled = music_stream_get(music->stream, data, bytes);
         if (filled != 0) {
             return filled;
         }
@@ -380,7 +398,7 @@ static int MPG123_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     result = mpg123.mpg123_read(music->handle, music->buffer, music->buffer_size, &amount);
     switch (result) {
     case MPG123_OK:
-        if (SDL_AudioStreamPut(music->stream, music->buffer, (int)amount) < 0) {
+        if (music_stream_put(music->stream, music->buffer, (int)amount) < 0) {
             return -1;
         }
         break;
@@ -400,10 +418,10 @@ static int MPG123_GetSome(void *context, void *data, int bytes, SDL_bool *done)
         SDL_assert(format != -1);
 
         if (music->stream) {
-            SDL_FreeAudioStream(music->stream);
+            music_stream_free(music->stream);
         }
 
-        music->stream = SDL_NewAudioStream((SDL_AudioFormat)format, (Uint8)channels, (int)rate,
+        music->stream = music_stream_new((SDL_AudioFormat)format, (Uint8)channels, (int)rate,
                                            music_spec.format, music_spec.channels, music_spec.freq);
         if (!music->stream) {
             return -1;
@@ -413,14 +431,14 @@ static int MPG123_GetSome(void *context, void *data, int bytes, SDL_bool *done)
 
     case MPG123_DONE:
         if (amount > 0) {
-            if (SDL_AudioStreamPut(music->stream, music->buffer, (int)amount) < 0) {
+            if (music_stream_put(music->stream, music->buffer, (int)amount) < 0) {
                 return -1;
             }
             break;
         }
         if (music->play_count == 1) {
             music->play_count = 0;
-            SDL_AudioStreamFlush(music->stream);
+            music_stream_flush(music->stream);
         } else {
             int play_count = -1;
             if (music->play_count > 0) {
@@ -477,6 +495,150 @@ static double MPG123_Duration(void *context)
     return (double)music->total_length / music->sample_rate;
 }
 
+/* mpg123 fills its frame index while decoding, scanning the whole stream
+ * completes it at once and also gives the exact length. The scan goes
+ * through a handle of its own, so only the reads of the stream and putting
+ * the index in place take the audio lock. */
+static int MPG123_BuildSeekIndex(void *context)
+{
+    MPG123_Music *music = (MPG123_Music *)context;
+    struct mp3file_cursor_t cursor;
+    mpg123_handle *handle;
+    off_t *offsets = NULL, step = 0, length;
+    size_t fill = 0;
+    int result;
+
+    handle = mpg123.mpg123_new(0, &result);
+    if (result != MPG123_OK) {
+        return Mix_SetError("mpg123_new failed");
+    }
+
+    cursor.fil = &music->mp3file;
+    cursor.pos = 0;
+    result = mpg123.mpg123_replace_reader_handle(handle, cursor_read, cursor_seek, rwops_cleanup);
+    if (result == MPG123_OK) {
+        result = mpg123.mpg123_open_handle(handle, &cursor);
+    }
+    if (result == MPG123_OK) {
+        result = mpg123.mpg123_scan(handle);
+    }
+    if (result == MPG123_OK) {
+        result = mpg123.mpg123_index(handle, &offsets, &step, &fill);
+    }
+    if (result != MPG123_OK) {
+        Mix_SetError("mpg123_scan: %s", mpg_err(handle, result));
+        mpg123.mpg123_delete(handle);
+        return -1;
+    }
+    length = mpg123.mpg123_length(handle);
+
+    /* mpg123 copies the offsets into its own index */
+    Mix_LockAudio();
+    result = mpg123.mpg123_set_index(music->handle, offsets, step, fill);
+    if (result == MPG123_OK && length > 0) {
+        music->total_length = length;
+    }
+    Mix_UnlockAudio();
+
+    mpg123.mpg123_close(handle);
+    mpg123.mpg123_delete(handle);
+    if (result != MPG123_OK) {
+        return Mix_SetError("mpg123_set_index: %s", mpg_err(music->handle, result));
+    }
+    return 0;
+}
+
+static int MPG123_GetSeekIndex(void *context, void **data, size_t *size)
+{
+    MPG123_Music *music = (MPG123_Music *)context;
+    off_t *offsets = NULL, step = 0;
+    size_t fill = 0, i;
+    SDL_RWops *dst;
+    int result;
+
+    result = mpg123.mpg123_index(music->handle, &offsets, &step, &fill);
+    if (result != MPG123_OK) {
+        return Mix_SetError("mpg123_index: %s", mpg_err(music->handle, result));
+    }
+    if (fill == 0) {
+        return Mix_SetError("music_mpg123: seek index is not built");
+    }
+
+    *size = 8 + 8 + 8 + 4 + fill * 8;
+    *data = SDL_malloc(*size);
+    if (!*data) {
+        return Mix_OutOfMemory();
+    }
+
+    dst = SDL_RWFromMem(*data, (int)*size);
+    if (!dst) {
+        SDL_free(*data);
+        *data = NULL;
+        return -1;
+    }
+
+    /* The stream size makes sure the index matches the file */
+    SDL_WriteLE64(dst, (Uint64)music->mp3file.length);
+    SDL_WriteLE64(dst, (Uint64)(Sint64)music->total_length);
+    SDL_WriteLE64(dst, (Uint64)(Sint64)step);
+    SDL_WriteLE32(dst, (Uint32)fill);
+    for (i = 0; i < fill; ++i) {
+        SDL_WriteLE64(dst, (Uint64)(Sint64)offsets[i]);
+    }
+    SDL_RWclose(dst);
+
+    return 0;
+}
+
+static int MPG123_SetSeekIndex(void *context, const void *data, size_t size)
+{
+    MPG123_Music *music = (MPG123_Music *)context;
+    off_t *offsets, total_length, step;
+    size_t fill, i;
+    SDL_RWops *src;
+    int result;
+
+    src = SDL_RWFromConstMem(data, (int)size);
+    if (!src) {
+        return -1;
+    }
+
+    if (size < 8 + 8 + 8 + 4 || SDL_ReadLE64(src) != (Uint64)music->mp3file.length) {
+        SDL_RWclose(src);
+        return Mix_SetError("music_mpg123: seek index doesn't match the stream");
+    }
+
+    total_length = (off_t)(Sint64)SDL_ReadLE64(src);
+    step = (off_t)(Sint64)SDL_ReadLE64(src);
+    fill = SDL_ReadLE32(src);
+    if (fill == 0 || step <= 0 || (size - (8 + 8 + 8 + 4)) / 8 != fill) {
+        SDL_RWclose(src);
+        return Mix_SetError("music_mpg123: seek index is corrupted");
+    }
+
+    offsets = (off_t *)SDL_malloc(sizeof(off_t) * fill);
+    if (!offsets) {
+        SDL_RWclose(src);
+        return Mix_OutOfMemory();
+    }
+    for (i = 0; i < fill; ++i) {
+        offsets[i] = (off_t)(Sint64)SDL_ReadLE64(src);
+    }
+    SDL_RWclose(src);
+
+    /* mpg123 copies the offsets into its own index */
+    result = mpg123.mpg123_set_index(music->handle, offsets, step, fill);
+    SDL_free(offsets);
+    if (result != MPG123_OK) {
+        return Mix_SetError("mpg123_set_index: %s", mpg_err(music->handle, result));
+    }
+
+    if (total_length > 0) {
+        music->total_length = total_length;
+    }
+    return 0;
+}
+
 static const char* MPG123_GetMetaTag(void *context, Mix_MusicMetaTag tag_type)
 {
     MPG123_Music *music = (MPG123_Music *)context;
@@ -493,7 +655,7 @@ static void MPG123_Delete(void *context)
         mpg123.mpg123_delete(music->handle);
     }
     if (music->stream) {
-        SDL_FreeAudioStream(music->stream);
+        music_stream_free(music->stream);
     }
     if (music->buffer) {
         SDL_free(music->buffer);
@@ -539,6 +701,11 @@ Mix_MusicInterface Mix_MusicInterface_MPG123 =
     NULL,   /* LoopStart */
     NULL,   /* LoopEnd */
     NULL,   /* LoopLength */
+    MPG123_BuildSeekIndex,
+    MPG123_GetSeekIndex,
+    MPG123_SetSeekIndex,
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     MPG123_GetMetaTag,
     NULL,   /* Pause */
     NULL,   /* Resume */
@@ -377,11 +377,9 @@ static void NATIVEMIDI_Destroy(NativeMidiSong *music)
 
 static void *NATIVEMIDI_CreateFromRW(SDL_RWops *src, int freesrc)
 {
-    void *bytes = 0;
-    long filesize = 0;
-    unsigned char byte[1];
-    Sint64 length = 0;
-    size_t bytes_l;
+    const void *bytes = NULL;
+    void *bytes_free = NULL;
+    size_t filesize = 0;
     NativeMidiSong *music = NATIVEMIDI_Create();
 
     if (!music) {
@@ -389,48 +387,31 @@ static void *NATIVEMIDI_CreateFromRW(SDL_RWops *src, int freesrc)
         return NULL;
     }
 
-    length = SDL_RWseek(src, 0, RW_SEEK_END);
-    if (length < 0) {
-        Mix_SetError("NativeMIDI: wrong file\n");
-        NATIVEMIDI_Destroy(music);
-        return NULL;
-    }
-
     SDL_RWseek(src, 0, RW_SEEK_SET);
-    bytes = SDL_malloc((size_t)length);
+    bytes = _Mix_LoadRWData(src, &filesize, &bytes_free);
     if (!bytes) {
-        SDL_OutOfMemory();
-        NATIVEMIDI_Destroy(music);
-        return NULL;
-    }
-
-    filesize = 0;
-    while ((bytes_l = SDL_RWread(src, &byte, sizeof(Uint8), 1)) != 0) {
-        ((Uint8 *)bytes)[filesize] = byte[0];
-        filesize++;
-    }
-
-    if (filesize == 0) {
-        SDL_free(bytes);
-        NATIVEMIDI_Destroy(music);
         Mix_SetError("NativeMIDI: wrong file\n");
+        NATIVEMIDI_Destroy(music);
         return NULL;
     }
 
     init_interface(music);
     music->song = midi_seq_init_interface(&music->seq_if);
     if (!music->song) {
+        SDL_free(bytes_free);
         SDL_OutOfMemory();
         NATIVEMIDI_Destroy(music);
         return NULL;
     }
 
 
-    if (midi_seq_openData(music->song, bytes, filesize) < 0) {
+    if (midi_seq_openData(music->song, (void *)bytes, (unsigned long)filesize) < 0) {
+        SDL_free(bytes_free);
         Mix_SetError("NativeMIDI: %s", midi_seq_get_error(music->song));
         NATIVEMIDI_Destroy(music);
         return NULL;
     }
+    SDL_free(bytes_free);
 
     if (freesrc) {
         SDL_RWclose(src);
@@ -683,6 +664,11 @@ Mix_MusicInterface Mix_MusicInterface_NATIVEMIDI =
     NATIVEMIDI_LoopStart,   /* LoopStart [MIXER-X]*/
     NATIVEMIDI_LoopEnd,   /* LoopEnd [MIXER-X]*/
     NATIVEMIDI_LoopLength,   /* LoopLength [MIXER-X]*/
+    NULL,   /* BuildSeekIndex [MIXER-X] */
+    NULL,   /* GetSeekIndex [MIXER-X] */
+    NULL,   /* SetSeekIndex [MIXER-X] */
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     NATIVEMIDI_GetMetaTag,   /* GetMetaTag [MIXER-X]*/
     NATIVEMIDI_Pause,
     NATIVEMIDI_Resume,
@@ -723,6 +709,11 @@ Mix_MusicInterface Mix_MusicInterface_NATIVEXMI =
     NATIVEMIDI_LoopStart,   /* LoopStart [MIXER-X]*/
     NATIVEMIDI_LoopEnd,   /* LoopEnd [MIXER-X]*/
     NATIVEMIDI_LoopLength,   /* LoopLength [MIXER-X]*/
+    NULL,   /* BuildSeekIndex [MIXER-X] */
+    NULL,   /* GetSeekIndex [MIXER-X] */
+    NULL,   /* SetSeekIndex [MIXER-X] */
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     NATIVEMIDI_GetMetaTag,   /* GetMetaTag [MIXER-X]*/
     NATIVEMIDI_Pause,
     NATIVEMIDI_Resume,
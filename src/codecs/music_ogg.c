@@ -53,6 +53,7 @@ typedef struct {
     ogg_int64_t (*ov_time_total)(OggVorbis_File *vf, int i);
 #else
     long (*ov_read)(OggVorbis_File *vf,char *buffer,int length, int bigendianp,int word,int sgned,int *bitstream);
+    long (*ov_read_float)(OggVorbis_File *vf,float ***pcm_channels,int samples,int *bitstream);
     int (*ov_time_seek)(OggVorbis_File *vf,double pos);
     double (*ov_time_tell)(OggVorbis_File *vf);
     double (*ov_time_total)(OggVorbis_File *vf, int i);
@@ -94,6 +95,7 @@ static int OGG_Load(void)
         FUNCTION_LOADER(ov_time_total, ogg_int64_t (*)(OggVorbis_File *, int))
 #else
         FUNCTION_LOADER(ov_read, long (*)(OggVorbis_File *,char *,int,int,int,int,int *))
+        FUNCTION_LOADER(ov_read_float, long (*)(OggVorbis_File *,float ***,int,int *))
         FUNCTION_LOADER(ov_time_seek, int (*)(OggVorbis_File *,double))
         FUNCTION_LOADER(ov_time_tell, double (*)(OggVorbis_File *))
         FUNCTION_LOADER(ov_time_total, double (*)(OggVorbis_File *, int))
@@ -128,14 +130,17 @@ typedef struct {
     OggVorbis_File vf;
     vorbis_info vi;
     int section;
-    SDL_AudioStream *stream;
+    Mix_MusicStream *stream;
     char *buffer;
     int buffer_size;
+    int sample_size; /* Sint16, or float when the mixer works with floats */
     int loop;
     ogg_int64_t loop_start;
     ogg_int64_t loop_end;
     ogg_int64_t loop_len;
+    Mix_MusicLoopCache loop_cache;
     Mix_MusicMetaTags tags;
+    SDL_bool seekable; /* MIXER-X: Pipes and alike are only read through */
 } OGG_music;
 
 
@@ -182,6 +187,13 @@ static long sdl_tell_func(void *datasource)
 static int OGG_Seek(void *context, double time);
 static void OGG_Delete(void *context);
 
+/* Runs at the worker thread of the loop cache */
+static int OGG_SeekLoopCache(void *context, Sint64 frame)
+{
+    OGG_music *music = (OGG_music *)context;
+    return (vorbis.ov_pcm_seek(&music->vf, frame) < 0) ? -1 : 0;
+}
+
 static int OGG_UpdateSection(OGG_music *music)
 {
     vorbis_info *vi;
@@ -197,23 +209,32 @@ static int OGG_UpdateSection(OGG_music *music)
     }
     SDL_memcpy(&music->vi, vi, sizeof(*vi));
 
+    /* Cached PCM of the loop start is no longer valid, capture it again */
+    if (music->loop &&
+        music_loop_cache_setup(&music->loop_cache, music->loop_start, music->loop_len,
+                               vi->channels * music->sample_size, (int)vi->rate,
+                               OGG_SeekLoopCache, music) < 0) {
+        return -1;
+    }
+
     if (music->buffer) {
         SDL_free(music->buffer);
         music->buffer = NULL;
     }
 
     if (music->stream) {
-        SDL_FreeAudioStream(music->stream);
+        music_stream_free(music->stream);
         music->stream = NULL;
     }
 
-    music->stream = SDL_NewAudioStream(AUDIO_S16SYS, (Uint8)vi->channels, (int)vi->rate,
+    music->stream = music_stream_new((music->sample_size == (int)sizeof(float)) ? AUDIO_F32SYS : AUDIO_S16SYS,
+                                       (Uint8)vi->channels, (int)vi->rate,
                                        music_spec.format, music_spec.channels, music_spec.freq);
     if (!music->stream) {
         return -1;
     }
 
-    music->buffer_size = music_spec.samples * (int)sizeof(Sint16) * vi->channels;
+    music->buffer_size = music_spec.samples * music->sample_size * vi->channels;
     music->buffer = (char *)SDL_malloc((size_t)music->buffer_size);
     if (!music->buffer) {
         return -1;
@@ -240,11 +261,21 @@ static void *OGG_CreateFromRW(SDL_RWops *src, int freesrc)
     music->src = src;
     music->volume = MIX_MAX_VOLUME;
     music->section = -1;
+#ifdef OGG_USE_TREMOR
+    music->sample_size = (int)sizeof(Sint16);
+#else
+    music->sample_size = SDL_AUDIO_ISFLOAT(music_spec.format) ? (int)sizeof(float) : (int)sizeof(Sint16);
+#endif
 
     SDL_zero(callbacks);
     callbacks.read_func = sdl_read_func;
-    callbacks.seek_func = sdl_seek_func;
-    callbacks.tell_func = sdl_tell_func;
+    /* MIXER-X: Without seeking, vorbisfile decodes as the data comes in,
+     * with no duration, seeking and loops */
+    music->seekable = (SDL_RWtell(src) >= 0 && SDL_RWsize(src) >= 0) ? SDL_TRUE : SDL_FALSE;
+    if (music->seekable) {
+        callbacks.seek_func = sdl_seek_func;
+        callbacks.tell_func = sdl_tell_func;
+    }
 
     if (vorbis.ov_open_callbacks(src, &music->vf, NULL, 0, callbacks) < 0) {
         SDL_SetError("Not an Ogg Vorbis audio stream");
@@ -314,6 +345,12 @@ static void *OGG_CreateFromRW(SDL_RWops *src, int freesrc)
     if ((music->loop_end > 0) && (music->loop_end <= full_length) &&
         (music->loop_start < music->loop_end)) {
         music->loop = 1;
+        if (music_loop_cache_setup(&music->loop_cache, music->loop_start, music->loop_len,
+                                   music->vi.channels * music->sample_size, (int)rate,
+                                   OGG_SeekLoopCache, music) < 0) {
+            OGG_Delete(music);
+            return NULL;
+        }
     }
 
     music->freesrc = freesrc;
@@ -351,8 +388,44 @@ static int OGG_Play(void *context, int play_count)
 static void OGG_Stop(void *context)
 {
     OGG_music *music = (OGG_music *)context;
-    SDL_AudioStreamClear(music->stream);
+    music_stream_clear(music->stream);
+}
+
+#ifndef OGG_USE_TREMOR
+/* Decode the floats and interleave them into the buffer, returns bytes */
+static int OGG_ReadFloat(OGG_music *music, int *section)
+{
+    float **pcm;
+    float *dst;
+    long frames, i;
+    int c, channels;
+
+    frames = vorbis.ov_read_float(&music->vf, &pcm, music->buffer_size / (music->sample_size * music->vi.channels), section);
+    if (frames <= 0) {
+        return (int)frames;
+    }
+
+    /* Got the first frames of the next chained stream */
+    if (*section != music->section) {
+        music->section = *section;
+        if (OGG_UpdateSection(music) < 0) {
+            return OV_EFAULT;
+        }
+    }
+
+    channels = music->vi.channels;
+    for (c = 0; c < channels; ++c) {
+        const float *src = pcm[c];
+        dst = (float *)music->buffer + c;
+        for (i = 0; i < frames; ++i) {
+            *dst = src[i];
+            dst += channels;
+        }
+    }
+
+    return (int)frames * channels * (int)sizeof(float);
 }
+#endif
 
 /* Play some of a stream previously started with OGG_play() */
 static int OGG_GetSome(void *context, void *data, int bytes, SDL_bool *done)
@@ -363,7 +436,7 @@ static int OGG_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     int section;
     ogg_int64_t pcmPos;
 
-    filled = SDL_AudioStreamGet(music->stream, data, bytes);
+    filled = music_stream_get(music->stream, data, bytes);
     if (filled != 0) {
         return filled;
     }
@@ -374,11 +447,24 @@ static int OGG_GetSome(void *context, void *data, int bytes, SDL_bool *done)
         return 0;
     }
 
+    filled = music_loop_cache_feed(&music->loop_cache, music->stream, music->buffer_size);
+    if (filled != 0) {
+        return (filled < 0) ? -1 : 0;
+    }
+    /* Continue after the cached PCM */
+    if (music_loop_cache_sync(&music->loop_cache) < 0) {
+        return -1;
+    }
+
     section = music->section;
 #ifdef OGG_USE_TREMOR
     amount = (int)vorbis.ov_read(&music->vf, music->buffer, music->buffer_size, &section);
 #else
-    amount = (int)vorbis.ov_read(&music->vf, music->buffer, music->buffer_size, SDL_BYTEORDER == SDL_BIG_ENDIAN, 2, 1, &section);
+    if (music->sample_size == (int)sizeof(float)) {
+        amount = OGG_ReadFloat(music, &section);
+    } else {
+        amount = (int)vorbis.ov_read(&music->vf, music->buffer, music->buffer_size, SDL_BYTEORDER == SDL_BIG_ENDIAN, 2, 1, &section);
+    }
 #endif
     if (amount < 0) {
         set_ov_error("ov_read", amount);
@@ -393,9 +479,18 @@ static int OGG_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     }
 
     pcmPos = vorbis.ov_pcm_tell(&music->vf);
+    if (amount > 0) {
+        music_loop_cache_capture(&music->loop_cache,
+                                 pcmPos - (amount / (music->sample_size * music->vi.channels)),
+                                 music->buffer, amount);
+    }
     if (music->loop && (music->play_count != 1) && (pcmPos >= music->loop_end)) {
-        amount -= (int)((pcmPos - music->loop_end) * music->vi.channels) * (int)sizeof(Sint16);
-        result = vorbis.ov_pcm_seek(&music->vf, music->loop_start);
+        amount -= (int)((pcmPos - music->loop_end) * music->vi.channels) * music->sample_size;
+        if (music_loop_cache_wrap(&music->loop_cache)) {
+            result = 0; /* Play the cached loop start, the worker seeks */
+        } else {
+            result = vorbis.ov_pcm_seek(&music->vf, music->loop_start);
+        }
         if (result < 0) {
             set_ov_error("ov_pcm_seek", result);
             return -1;
@@ -410,13 +505,13 @@ static int OGG_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     }
 
     if (amount > 0) {
-        if (SDL_AudioStreamPut(music->stream, music->buffer, amount) < 0) {
+        if (music_stream_put(music->stream, music->buffer, amount) < 0) {
             return -1;
         }
     } else if (!looped) {
-        if (music->play_count == 1) {
+        if (music->play_count == 1 || !music->seekable) {
             music->play_count = 0;
-            SDL_AudioStreamFlush(music->stream);
+            music_stream_flush(music->stream);
         } else {
             int play_count = -1;
             if (music->play_count > 0) {
@@ -440,6 +535,15 @@ static int OGG_Seek(void *context, double time)
 {
     OGG_music *music = (OGG_music *)context;
     int result;
+    if (!music->seekable) {
+        /* Only the start of the untouched stream is reachable */
+        if (time == 0.0 && vorbis.ov_pcm_tell(&music->vf) <= 0) {
+            return 0;
+        }
+        Mix_SetError("OGG: Can't seek the non-seekable stream");
+        return -1;
+    }
+    music_loop_cache_stop(&music->loop_cache);
 #ifdef OGG_USE_TREMOR
     result = vorbis.ov_time_seek(&music->vf, (ogg_int64_t)(time * 1000.0));
 #else
@@ -454,6 +558,10 @@ static int OGG_Seek(void *context, double time)
 static double OGG_Tell(void *context)
 {
     OGG_music *music = (OGG_music *)context;
+    Sint64 pos = music_loop_cache_tell(&music->loop_cache);
+    if (pos >= 0) {
+        return (double)pos / music->vi.rate;
+    }
 #ifdef OGG_USE_TREMOR
     return vorbis.ov_time_tell(&music->vf) / 1000.0;
 #else
@@ -465,6 +573,9 @@ static double OGG_Tell(void *context)
 static double OGG_Duration(void *context)
 {
     OGG_music *music = (OGG_music *)context;
+    if (!music->seekable) {
+        return -1.0;
+    }
 #ifdef OGG_USE_TREMOR
     return vorbis.ov_time_total(&music->vf, -1) / 1000.0;
 #else
@@ -505,9 +616,10 @@ static void OGG_Delete(void *context)
 {
     OGG_music *music = (OGG_music *)context;
     meta_tags_clear(&music->tags);
+    music_loop_cache_free(&music->loop_cache);
     vorbis.ov_clear(&music->vf);
     if (music->stream) {
-        SDL_FreeAudioStream(music->stream);
+        music_stream_free(music->stream);
     }
     if (music->buffer) {
         SDL_free(music->buffer);
@@ -548,6 +660,11 @@ Mix_MusicInterface Mix_MusicInterface_OGG =
     OGG_LoopStart,
     OGG_LoopEnd,
     OGG_LoopLength,
+    NULL,   /* BuildSeekIndex [MIXER-X] */
+    NULL,   /* GetSeekIndex [MIXER-X] */
+    NULL,   /* SetSeekIndex [MIXER-X] */
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     OGG_GetMetaTag,   /* GetMetaTag */
     NULL,   /* Pause */
     NULL,   /* Resume */
@@ -34,7 +34,6 @@
 #define STB_VORBIS_SDL 1 /* for SDL_mixer-specific stuff. */
 #define STB_VORBIS_NO_STDIO 1
 #define STB_VORBIS_NO_CRT 1
-#define STB_VORBIS_NO_PUSHDATA_API 1
 #define STB_VORBIS_MAX_CHANNELS 8   /* For 7.1 surround sound */
 #define STB_FORCEINLINE SDL_FORCE_INLINE
 #if SDL_BYTEORDER == SDL_BIG_ENDIAN
@@ -81,7 +80,7 @@ typedef struct {
     stb_vorbis *vf;
     stb_vorbis_info vi;
     int section;
-    SDL_AudioStream *stream;
+    Mix_MusicStream *stream;
     char *buffer;
     int buffer_size;
     int loop;
@@ -89,9 +88,24 @@ typedef struct {
     Sint64 loop_end;
     Sint64 loop_len;
     Sint64 full_length;
+    Mix_MusicLoopCache loop_cache;
     Mix_MusicMetaTags tags;
+    /* MIXER-X: Non-seekable sources are decoded through the pushdata API
+     * from a window of the input, with no seeking, duration and loops */
+    SDL_bool pushdata;
+    Uint8 *window;
+    int window_size;
+    int window_pos;     /* Start of the data not consumed yet */
+    int window_len;     /* End of the data in the window */
+    SDL_bool src_eof;
+    Sint64 pushdata_pos; /* Decoded samples */
 } OGG_music;
 
+/* The window takes the whole Ogg page (up to 64 KiB), it grows only for
+ * the packets spanning several pages */
+#define OGG_PUSHDATA_WINDOW     (64 * 1024)
+#define OGG_PUSHDATA_WINDOW_MAX (1024 * 1024)
+
 static int set_ov_error(const char *function, int error)
 {
 #define HANDLE_ERROR_CASE(X) case X: Mix_SetError("%s: %s", function, #X); break;
@@ -126,6 +140,128 @@ static int set_ov_error(const char *function, int error)
 static int OGG_Seek(void *context, double time);
 static void OGG_Delete(void *context);
 
+/* Runs at the worker thread of the loop cache */
+static int OGG_SeekLoopCache(void *context, Sint64 frame)
+{
+    OGG_music *music = (OGG_music *)context;
+    return stb_vorbis_seek(music->vf, (unsigned int)frame) ? 0 : -1;
+}
+
+/* Read more of the source behind the pending data, returns the number of
+ * bytes read, 0 at the end of the source */
+static int OGG_FillWindow(OGG_music *music)
+{
+    size_t got;
+
+    if (music->window_pos > 0) {
+        SDL_memmove(music->window, music->window + music->window_pos,
+                    (size_t)(music->window_len - music->window_pos));
+        music->window_len -= music->window_pos;
+        music->window_pos = 0;
+    }
+
+    if (music->src_eof) {
+        return 0;
+    }
+
+    /* The decoder needs more than a full window */
+    if (music->window_len == music->window_size) {
+        Uint8 *window;
+        if (music->window_size >= OGG_PUSHDATA_WINDOW_MAX) {
+            Mix_SetError("OGG: The packet is larger than %d bytes", OGG_PUSHDATA_WINDOW_MAX);
+            return -1;
+        }
+        window = (Uint8 *)SDL_realloc(music->window, (size_t)music->window_size * 2);
+        if (!window) {
+            SDL_OutOfMemory();
+            return -1;
+        }
+        music->window = window;
+        music->window_size *= 2;
+    }
+
+    got = SDL_RWread(music->src, music->window + music->window_len, 1,
+                     (size_t)(music->window_size - music->window_len));
+    if (got == 0) {
+        music->src_eof = SDL_TRUE;
+    }
+    music->window_len += (int)got;
+    return (int)got;
+}
+
+static int OGG_OpenPushdata(OGG_music *music)
+{
+    int used = 0, error = VORBIS_need_more_data;
+
+    music->window = (Uint8 *)SDL_malloc(OGG_PUSHDATA_WINDOW);
+    if (!music->window) {
+        SDL_OutOfMemory();
+        return -1;
+    }
+    music->window_size = OGG_PUSHDATA_WINDOW;
+    music->pushdata = SDL_TRUE;
+
+    /* Headers are parsed from the start of the window until they fit */
+    while (!music->vf && error == VORBIS_need_more_data) {
+        int got = OGG_FillWindow(music);
+        if (got < 0) {
+            return -1;
+        }
+        if (got == 0) {
+            break;
+        }
+        music->vf = stb_vorbis_open_pushdata(music->window, music->window_len, &used, &error, NULL);
+    }
+
+    if (!music->vf) {
+        return set_ov_error("stb_vorbis_open_pushdata", error);
+    }
+    music->window_pos = used;
+    return 0;
+}
+
+/* Decode the next frame into the stream, returns the number of samples,
+ * 0 at the end of the source */
+static int OGG_DecodePushdata(OGG_music *music)
+{
+    float **outputs = NULL;
+    int channels = music->vi.channels;
+    int samples = 0, done, frames, i, c;
+
+    while (samples == 0) {
+        int used = stb_vorbis_decode_frame_pushdata(music->vf,
+                                                    music->window + music->window_pos,
+                                                    music->window_len - music->window_pos,
+                                                    &channels, &outputs, &samples);
+        music->window_pos += used;
+        if (used == 0) {
+            int got = OGG_FillWindow(music);
+            if (got <= 0) {
+                return got;
+            }
+        }
+    }
+    music->pushdata_pos += samples;
+
+    /* Interleave into the buffer, by parts if the frame is larger */
+    for (done = 0; done < samples; done += frames) {
+        float *out = (float *)music->buffer;
+        frames = music->buffer_size / (channels * (int)sizeof(float));
+        if (frames > samples - done) {
+            frames = samples - done;
+        }
+        for (i = 0; i < frames; ++i) {
+            for (c = 0; c < channels; ++c) {
+                *out++ = outputs[c][done + i];
+            }
+        }
+        if (music_stream_put(music->stream, music->buffer, frames * channels * (int)sizeof(float)) < 0) {
+            return -1;
+        }
+    }
+    return samples;
+}
+
 static int OGG_UpdateSection(OGG_music *music)
 {
     stb_vorbis_info vi;
@@ -137,17 +273,25 @@ static int OGG_UpdateSection(OGG_music *music)
     }
     SDL_memcpy(&music->vi, &vi, sizeof(vi));
 
+    /* Cached PCM of the loop start is no longer valid, capture it again */
+    if (music->loop &&
+        music_loop_cache_setup(&music->loop_cache, music->loop_start, music->loop_len,
+                               vi.channels * (int)sizeof(float), (int)vi.sample_rate,
+                               OGG_SeekLoopCache, music) < 0) {
+        return -1;
+    }
+
     if (music->buffer) {
         SDL_free(music->buffer);
         music->buffer = NULL;
     }
 
     if (music->stream) {
-        SDL_FreeAudioStream(music->stream);
+        music_stream_free(music->stream);
         music->stream = NULL;
     }
 
-    music->stream = SDL_NewAudioStream(AUDIO_F32SYS, (Uint8)vi.channels, (int)vi.sample_rate,
+    music->stream = music_stream_new(AUDIO_F32SYS, (Uint8)vi.channels, (int)vi.sample_rate,
                                        music_spec.format, music_spec.channels, music_spec.freq);
     if (!music->stream) {
         return -1;
@@ -183,12 +327,20 @@ static void *OGG_CreateFromRW(SDL_RWops *src, int freesrc)
     music->volume = MIX_MAX_VOLUME;
     music->section = -1;
 
-    music->vf = stb_vorbis_open_rwops(src, 0, &error, NULL);
+    if (SDL_RWtell(src) < 0 || SDL_RWsize(src) < 0) {
+        /* MIXER-X: Pipes and alike can be only read through */
+        if (OGG_OpenPushdata(music) < 0) {
+            OGG_Delete(music);
+            return NULL;
+        }
+    } else {
+        music->vf = stb_vorbis_open_rwops(src, 0, &error, NULL);
 
-    if (music->vf == NULL) {
-        set_ov_error("stb_vorbis_open_rwops", error);
-        SDL_free(music);
-        return NULL;
+        if (music->vf == NULL) {
+            set_ov_error("stb_vorbis_open_rwops", error);
+            SDL_free(music);
+            return NULL;
+        }
     }
 
     if (OGG_UpdateSection(music) < 0) {
@@ -256,10 +408,22 @@ static void *OGG_CreateFromRW(SDL_RWops *src, int freesrc)
         }
     }
 
+    if (music->pushdata) {
+        /* Seeking back is impossible, leave the loop for the end */
+        music->freesrc = freesrc;
+        return music;
+    }
+
     music->full_length = stb_vorbis_stream_length_in_samples(music->vf);
     if ((music->loop_end > 0) && (music->loop_end <= music->full_length) &&
         (music->loop_start < music->loop_end)) {
         music->loop = 1;
+        if (music_loop_cache_setup(&music->loop_cache, music->loop_start, music->loop_len,
+                                   music->vi.channels * (int)sizeof(float), (int)rate,
+                                   OGG_SeekLoopCache, music) < 0) {
+            OGG_Delete(music);
+            return NULL;
+        }
     }
 
     OGG_Seek(music, 0.0);
@@ -299,7 +463,7 @@ static int OGG_Play(void *context, int play_count)
 static void OGG_Stop(void *context)
 {
     OGG_music *music = (OGG_music *)context;
-    SDL_AudioStreamClear(music->stream);
+    music_stream_clear(music->stream);
 }
 
 /* Play some of a stream previously started with OGG_play() */
@@ -311,7 +475,7 @@ static int OGG_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     int section;
     Sint64 pcmPos;
 
-    filled = SDL_AudioStreamGet(music->stream, data, bytes);
+    filled = music_stream_get(music->stream, data, bytes);
     if (filled != 0) {
         return filled;
     }
@@ -322,6 +486,28 @@ static int OGG_GetSome(void *context, void *data, int bytes, SDL_bool *done)
         return 0;
     }
 
+    if (music->pushdata) {
+        result = OGG_DecodePushdata(music);
+        if (result < 0) {
+            return -1;
+        }
+        if (result == 0) {
+            /* Can't start over, it's the last play */
+            music->play_count = 0;
+            music_stream_flush(music->stream);
+        }
+        return 0;
+    }
+
+    filled = music_loop_cache_feed(&music->loop_cache, music->stream, music->buffer_size);
+    if (filled != 0) {
+        return (filled < 0) ? -1 : 0;
+    }
+    /* Continue after the cached PCM */
+    if (music_loop_cache_sync(&music->loop_cache) < 0) {
+        return -1;
+    }
+
     section = music->section;
     amount = stb_vorbis_get_samples_float_interleaved(music->vf,
                                                 music->vi.channels,
@@ -338,9 +524,18 @@ static int OGG_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     }
 
     pcmPos = stb_vorbis_get_playback_sample_offset(music->vf);
+    if (amount > 0) {
+        music_loop_cache_capture(&music->loop_cache,
+                                 pcmPos - (amount / ((int)sizeof(float) * music->vi.channels)),
+                                 music->buffer, amount);
+    }
     if (music->loop && (music->play_count != 1) && (pcmPos >= music->loop_end)) {
         amount -= (int)((pcmPos - music->loop_end) * music->vi.channels) * (int)sizeof(float);
-        result = stb_vorbis_seek(music->vf, music->loop_start);
+        if (music_loop_cache_wrap(&music->loop_cache)) {
+            result = 1; /* Play the cached loop start, the worker seeks */
+        } else {
+            result = stb_vorbis_seek(music->vf, music->loop_start);
+        }
         if (!result) {
             set_ov_error("stb_vorbis_seek", stb_vorbis_get_error(music->vf));
             return -1;
@@ -355,13 +550,13 @@ static int OGG_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     }
 
     if (amount > 0) {
-        if (SDL_AudioStreamPut(music->stream, music->buffer, amount) < 0) {
+        if (music_stream_put(music->stream, music->buffer, amount) < 0) {
             return -1;
         }
     } else if (!looped) {
         if (music->play_count == 1) {
             music->play_count = 0;
-            SDL_AudioStreamFlush(music->stream);
+            music_stream_flush(music->stream);
         } else {
             int play_count = -1;
             if (music->play_count > 0) {
@@ -386,6 +581,16 @@ static int OGG_Seek(void *context, double time)
     OGG_music *music = (OGG_music *)context;
     int result;
 
+    if (music->pushdata) {
+        /* Only the start of the untouched stream is reachable */
+        if (time == 0.0 && music->pushdata_pos == 0) {
+            return 0;
+        }
+        Mix_SetError("OGG: Can't seek the non-seekable stream");
+        return -1;
+    }
+
+    music_loop_cache_stop(&music->loop_cache);
     result = stb_vorbis_seek(music->vf, (time * music->vi.sample_rate));
     if (!result) {
         set_ov_error("stb_vorbis_seek", stb_vorbis_get_error(music->vf));
@@ -397,6 +602,13 @@ static int OGG_Seek(void *context, double time)
 static double OGG_Tell(void *context)
 {
     OGG_music *music = (OGG_music *)context;
+    Sint64 pos = music_loop_cache_tell(&music->loop_cache);
+    if (pos >= 0) {
+        return (double)pos / music->vi.sample_rate;
+    }
+    if (music->pushdata) {
+        return (double)music->pushdata_pos / music->vi.sample_rate;
+    }
     return (double)stb_vorbis_get_playback_sample_offset(music->vf) / music->vi.sample_rate;
 }
 
@@ -404,6 +616,9 @@ static double OGG_Tell(void *context)
 static double OGG_Duration(void *context)
 {
     OGG_music *music = (OGG_music *)context;
+    if (music->pushdata) {
+        return -1.0;
+    }
     return (double)music->full_length / music->vi.sample_rate;
 }
 
@@ -440,9 +655,13 @@ static void OGG_Delete(void *context)
 {
     OGG_music *music = (OGG_music *)context;
     meta_tags_clear(&music->tags);
+    music_loop_cache_free(&music->loop_cache);
     stb_vorbis_close(music->vf);
+    if (music->window) {
+        SDL_free(music->window);
+    }
     if (music->stream) {
-        SDL_FreeAudioStream(music->stream);
+        music_stream_free(music->stream);
     }
     if (music->buffer) {
         SDL_free(music->buffer);
@@ -483,6 +702,11 @@ Mix_MusicInterface Mix_MusicInterface_OGG =
     OGG_LoopStart,
     OGG_LoopEnd,
     OGG_LoopLength,
+    NULL,   /* BuildSeekIndex [MIXER-X] */
+    NULL,   /* GetSeekIndex [MIXER-X] */
+    NULL,   /* SetSeekIndex [MIXER-X] */
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     OGG_GetMetaTag,   /* GetMetaTag */
     NULL,   /* Pause */
     NULL,   /* Resume */
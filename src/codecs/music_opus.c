@@ -43,6 +43,7 @@ typedef struct {
     const OpusHead *(*op_head)(const OggOpusFile *,int);
     int (*op_seekable)(const OggOpusFile *);
     int (*op_read)(OggOpusFile *, opus_int16 *,int,int *);
+    int (*op_read_float)(OggOpusFile *, float *,int,int *);
     int (*op_pcm_seek)(OggOpusFile *,ogg_int64_t);
     ogg_int64_t (*op_pcm_tell)(const OggOpusFile *);
     ogg_int64_t (*op_pcm_total)(const OggOpusFile *, int);
@@ -78,6 +79,13 @@ static int OPUS_Load(void)
         FUNCTION_LOADER(op_pcm_seek, int (*)(OggOpusFile *,ogg_int64_t))
         FUNCTION_LOADER(op_pcm_tell, ogg_int64_t (*)(const OggOpusFile *))
         FUNCTION_LOADER(op_pcm_total, ogg_int64_t (*)(const OggOpusFile *, int))
+#if defined(OPUS_DYNAMIC)
+        opus.op_read_float = (int (*)(OggOpusFile *, float *,int,int *)) SDL_LoadFunction(opus.handle, "op_read_float");
+#elif !defined(OP_DISABLE_FLOAT_API)
+        opus.op_read_float = op_read_float;
+#else
+        opus.op_read_float = NULL;
+#endif
     }
     ++opus.loaded;
 
@@ -106,14 +114,16 @@ typedef struct {
     OggOpusFile *of;
     const OpusHead *op_info;
     int section;
-    SDL_AudioStream *stream;
+    Mix_MusicStream *stream;
     char *buffer;
     int buffer_size;
+    int sample_size; /* opus_int16, or float when the mixer works with floats */
     int loop;
     ogg_int64_t loop_start;
     ogg_int64_t loop_end;
     ogg_int64_t loop_len;
     ogg_int64_t full_length;
+    Mix_MusicLoopCache loop_cache;
     Mix_MusicMetaTags tags;
 } OPUS_music;
 
@@ -162,6 +172,13 @@ static opus_int64 sdl_tell_func(void *datasource)
 static int OPUS_Seek(void*, double);
 static void OPUS_Delete(void*);
 
+/* Runs at the worker thread of the loop cache */
+static int OPUS_SeekLoopCache(void *context, Sint64 frame)
+{
+    OPUS_music *music = (OPUS_music *)context;
+    return (opus.op_pcm_seek(music->of, frame) < 0) ? -1 : 0;
+}
+
 static int OPUS_UpdateSection(OPUS_music *music)
 {
     const OpusHead *op_info;
@@ -177,23 +194,32 @@ static int OPUS_UpdateSection(OPUS_music *music)
     }
     music->op_info = op_info;
 
+    /* Cached PCM of the loop start is no longer valid, capture it again */
+    if (music->loop &&
+        music_loop_cache_setup(&music->loop_cache, music->loop_start, music->loop_len,
+                               op_info->channel_count * music->sample_size, 48000,
+                               OPUS_SeekLoopCache, music) < 0) {
+        return -1;
+    }
+
     if (music->buffer) {
         SDL_free(music->buffer);
         music->buffer = NULL;
     }
 
     if (music->stream) {
-        SDL_FreeAudioStream(music->stream);
+        music_stream_free(music->stream);
         music->stream = NULL;
     }
 
-    music->stream = SDL_NewAudioStream(AUDIO_S16SYS, (Uint8)op_info->channel_count, 48000,
+    music->stream = music_stream_new((music->sample_size == (int)sizeof(float)) ? AUDIO_F32SYS : AUDIO_S16SYS,
+                                       (Uint8)op_info->channel_count, 48000,
                                        music_spec.format, music_spec.channels, music_spec.freq);
     if (!music->stream) {
         return -1;
     }
 
-    music->buffer_size = (int)music_spec.samples * (int)sizeof(opus_int16) * op_info->channel_count;
+    music->buffer_size = (int)music_spec.samples * music->sample_size * op_info->channel_count;
     music->buffer = (char *)SDL_malloc((size_t)music->buffer_size);
     if (!music->buffer) {
         return -1;
@@ -219,6 +245,7 @@ static void *OPUS_CreateFromRW(SDL_RWops *src, int freesrc)
     music->src = src;
     music->volume = MIX_MAX_VOLUME;
     music->section = -1;
+    music->sample_size = (SDL_AUDIO_ISFLOAT(music_spec.format) && opus.op_read_float) ? (int)sizeof(float) : (int)sizeof(opus_int16);
 
     SDL_zero(callbacks);
     callbacks.read = sdl_read_func;
@@ -300,6 +327,12 @@ static void *OPUS_CreateFromRW(SDL_RWops *src, int freesrc)
     if ((music->loop_end > 0) && (music->loop_end <= full_length) &&
         (music->loop_start < music->loop_end)) {
         music->loop = 1;
+        if (music_loop_cache_setup(&music->loop_cache, music->loop_start, music->loop_len,
+                                   music->op_info->channel_count * music->sample_size, 48000,
+                                   OPUS_SeekLoopCache, music) < 0) {
+            OPUS_Delete(music);
+            return NULL;
+        }
     }
 
     music->full_length = full_length;
@@ -339,7 +372,7 @@ static int OPUS_Play(void *context, int play_count)
 static void OPUS_Stop(void *context)
 {
     OPUS_music *music = (OPUS_music *)context;
-    SDL_AudioStreamClear(music->stream);
+    music_stream_clear(music->stream);
 }
 
 /* Play some of a stream previously started with OPUS_Play() */
@@ -351,7 +384,7 @@ static int OPUS_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     SDL_bool looped = SDL_FALSE;
     ogg_int64_t pcmPos;
 
-    filled = SDL_AudioStreamGet(music->stream, data, bytes);
+    filled = music_stream_get(music->stream, data, bytes);
     if (filled != 0) {
         return filled;
     }
@@ -362,8 +395,21 @@ static int OPUS_GetSome(void *context, void *data, int bytes, SDL_bool *done)
         return 0;
     }
 
+    filled = music_loop_cache_feed(&music->loop_cache, music->stream, music->buffer_size);
+    if (filled != 0) {
+        return (filled < 0) ? -1 : 0;
+    }
+    /* Continue after the cached PCM */
+    if (music_loop_cache_sync(&music->loop_cache) < 0) {
+        return -1;
+    }
+
     section = music->section;
-    samples = opus.op_read(music->of, (opus_int16 *)music->buffer, music->buffer_size / (int)sizeof(opus_int16), &section);
+    if (music->sample_size == (int)sizeof(float)) {
+        samples = opus.op_read_float(music->of, (float *)music->buffer, music->buffer_size / (int)sizeof(float), &section);
+    } else {
+        samples = opus.op_read(music->of, (opus_int16 *)music->buffer, music->buffer_size / (int)sizeof(opus_int16), &section);
+    }
     if (samples < 0) {
         set_op_error("op_read", samples);
         return -1;
@@ -377,9 +423,17 @@ static int OPUS_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     }
 
     pcmPos = opus.op_pcm_tell(music->of);
+    if (samples > 0) {
+        music_loop_cache_capture(&music->loop_cache, pcmPos - samples, music->buffer,
+                                 samples * music->op_info->channel_count * music->sample_size);
+    }
     if (music->loop && (music->play_count != 1) && (pcmPos >= music->loop_end)) {
-        samples -= (int)((pcmPos - music->loop_end) * music->op_info->channel_count) * (int)sizeof(Sint16);
-        result = opus.op_pcm_seek(music->of, music->loop_start);
+        samples -= (int)(pcmPos - music->loop_end);
+        if (music_loop_cache_wrap(&music->loop_cache)) {
+            result = 0; /* Play the cached loop start, the worker seeks */
+        } else {
+            result = opus.op_pcm_seek(music->of, music->loop_start);
+        }
         if (result < 0) {
             set_op_error("ov_pcm_seek", result);
             return -1;
@@ -394,14 +448,14 @@ static int OPUS_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     }
 
     if (samples > 0) {
-        filled = samples * music->op_info->channel_count * 2;
-        if (SDL_AudioStreamPut(music->stream, music->buffer, filled) < 0) {
+        filled = samples * music->op_info->channel_count * music->sample_size;
+        if (music_stream_put(music->stream, music->buffer, filled) < 0) {
             return -1;
         }
     } else if (!looped) {
         if (music->play_count == 1) {
             music->play_count = 0;
-            SDL_AudioStreamFlush(music->stream);
+            music_stream_flush(music->stream);
         } else {
             int play_count = -1;
             if (music->play_count > 0) {
@@ -425,7 +479,9 @@ static int OPUS_GetAudio(void *context, void *data, int bytes)
 static int OPUS_Seek(void *context, double time)
 {
     OPUS_music *music = (OPUS_music *)context;
-    int result = opus.op_pcm_seek(music->of, (ogg_int64_t)(time * 48000));
+    int result;
+    music_loop_cache_stop(&music->loop_cache);
+    result = opus.op_pcm_seek(music->of, (ogg_int64_t)(time * 48000));
     if (result < 0) {
         return set_op_error("op_pcm_seek", result);
     }
@@ -435,6 +491,10 @@ static int OPUS_Seek(void *context, double time)
 static double OPUS_Tell(void *context)
 {
     OPUS_music *music = (OPUS_music *)context;
+    Sint64 pos = music_loop_cache_tell(&music->loop_cache);
+    if (pos >= 0) {
+        return (double)pos / 48000.0;
+    }
     return (double)(opus.op_pcm_tell(music->of)) / 48000.0;
 }
 
@@ -476,9 +536,10 @@ static double OPUS_LoopLength(void *music_p)
 static void OPUS_Delete(void *context)
 {
     OPUS_music *music = (OPUS_music *)context;
+    music_loop_cache_free(&music->loop_cache);
     opus.op_free(music->of);
     if (music->stream) {
-        SDL_FreeAudioStream(music->stream);
+        music_stream_free(music->stream);
     }
     if (music->buffer) {
         SDL_free(music->buffer);
@@ -519,6 +580,11 @@ Mix_MusicInterface Mix_MusicInterface_Opus =
     OPUS_LoopStart,
     OPUS_LoopEnd,
     OPUS_LoopLength,
+    NULL,   /* BuildSeekIndex [MIXER-X] */
+    NULL,   /* GetSeekIndex [MIXER-X] */
+    NULL,   /* SetSeekIndex [MIXER-X] */
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     OPUS_GetMetaTag,
     NULL,   /* Pause */
     NULL,   /* Resume */
@@ -32,7 +32,7 @@ typedef struct
 {
     int play_count;
     MidiSong *song;
-    SDL_AudioStream *stream;
+    Mix_MusicStream *stream;
     void *buffer;
     Sint32 buffer_size;
     int volume;
@@ -56,6 +56,28 @@ static void TIMIDITY_Delete(void *context);
 #endif
 
 static int timidity_loaded = 0;
+static int timidity_interpolation = TIMIDITY_INTERP_LINEAR;
+static int timidity_polyphony = -1;
+
+int _Mix_Timidity_getInterpolation(void)
+{
+    return timidity_interpolation;
+}
+
+void _Mix_Timidity_setInterpolation(int interpolation)
+{
+    timidity_interpolation = interpolation;
+}
+
+int _Mix_Timidity_getPolyphony(void)
+{
+    return timidity_polyphony;
+}
+
+void _Mix_Timidity_setPolyphony(int voices)
+{
+    timidity_polyphony = voices;
+}
 
 static int TIMIDITY_Open(const SDL_AudioSpec *spec)
 {
@@ -131,7 +153,7 @@ void *TIMIDITY_CreateFromRW(SDL_RWops *src, int freesrc)
     }
 
     if (need_stream) {
-        music->stream = SDL_NewAudioStream(spec.format, spec.channels, spec.freq,
+        music->stream = music_stream_new(spec.format, spec.channels, spec.freq,
                                            music_spec.format, music_spec.channels, music_spec.freq);
         if (!music->stream) {
             TIMIDITY_Delete(music);
@@ -170,6 +192,8 @@ static int TIMIDITY_Play(void *context, int play_count)
 {
     TIMIDITY_Music *music = (TIMIDITY_Music *)context;
     music->play_count = play_count;
+    Timidity_SetInterpolation(music->song, timidity_interpolation);
+    Timidity_SetPolyphony(music->song, timidity_polyphony);
     Timidity_Start(music->song);
     return TIMIDITY_Seek(music, 0.0);
 }
@@ -186,7 +210,7 @@ static int TIMIDITY_GetSome(void *context, void *data, int bytes, SDL_bool *done
     int filled, amount, expected;
 
     if (music->stream) {
-        filled = SDL_AudioStreamGet(music->stream, data, bytes);
+        filled = music_stream_get(music->stream, data, bytes);
         if (filled != 0) {
             return filled;
         }
@@ -201,7 +225,7 @@ static int TIMIDITY_GetSome(void *context, void *data, int bytes, SDL_bool *done
     if (music->stream) {
         expected = music->buffer_size;
         amount = Timidity_PlaySome(music->song, music->buffer, music->buffer_size);
-        if (SDL_AudioStreamPut(music->stream, music->buffer, amount) < 0) {
+        if (music_stream_put(music->stream, music->buffer, amount) < 0) {
             return -1;
         }
     } else {
@@ -264,7 +288,7 @@ static void TIMIDITY_Delete(void *context)
         Timidity_FreeSong(music->song);
     }
     if (music->stream) {
-        SDL_FreeAudioStream(music->stream);
+        music_stream_free(music->stream);
     }
     if (music->buffer) {
         SDL_free(music->buffer);
@@ -309,6 +333,11 @@ Mix_MusicInterface Mix_MusicInterface_TIMIDITY =
     NULL,   /* LoopStart */
     NULL,   /* LoopEnd */
     NULL,   /* LoopLength */
+    NULL,   /* BuildSeekIndex [MIXER-X] */
+    NULL,   /* GetSeekIndex [MIXER-X] */
+    NULL,   /* SetSeekIndex [MIXER-X] */
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     NULL,   /* GetMetaTag */
     NULL,   /* Pause */
     NULL,   /* Resume */
@@ -25,4 +25,9 @@
 
 extern Mix_MusicInterface Mix_MusicInterface_TIMIDITY;
 
+extern int _Mix_Timidity_getInterpolation(void);
+extern void _Mix_Timidity_setInterpolation(int interpolation);
+extern int _Mix_Timidity_getPolyphony(void);
+extern void _Mix_Timidity_setPolyphony(int voices);
+
 /* vi: set ts=4 sw=4 expandtab: */
@@ -25,6 +25,8 @@
 
 #include "music_wav.h"
 #include "mp3utils.h"
+#include "pcm_convert.h"
+#include "utils.h"
 
 typedef struct {
     SDL_bool active;
@@ -44,12 +46,17 @@ typedef struct {
     Sint64 stop;
     Sint64 samplesize;
     Uint8 *buffer;
-    SDL_AudioStream *stream;
+    Mix_MusicStream *stream;
     unsigned int numloops;
     WAVLoopPoint *loops;
     Mix_MusicMetaTags tags;
     Uint16 encoding;
     int (*decode)(void *music, int length);
+    /* MIXER-X: The whole file when its samples are in the device format */
+    const Uint8 *mapped;
+    size_t mapped_size;
+    void *mapping;
+    Sint64 mapped_pos;
 } WAV_Music;
 
 /*
@@ -202,13 +209,35 @@ static void *WAV_CreateFromRW(SDL_RWops *src, int freesrc)
         WAV_Delete(music);
         return NULL;
     }
+
+    /* MIXER-X: Samples already in the device format are mixed right from
+     * the memory, without reading them and without the audio stream */
+    if (music->decode == fetch_pcm &&
+        music->spec.format == music_spec.format &&
+        music->spec.channels == music_spec.channels &&
+        music->spec.freq == music_spec.freq &&
+        (music->start % (SDL_AUDIO_BITSIZE(music->spec.format) / 8)) == 0) {
+        music->mapped = _Mix_MapRW(src, &music->mapped_size, &music->mapping);
+        if (music->mapped && (Uint64)music->stop > (Uint64)music->mapped_size) {
+            /* The data chunk is cut, keep reading it */
+            _Mix_UnmapRW(music->mapping, music->mapped_size);
+            music->mapped = NULL;
+            music->mapping = NULL;
+        }
+    }
+    if (music->mapped) {
+        music->mapped_pos = music->start;
+        music->freesrc = freesrc;
+        return music;
+    }
+
     music->buffer = (Uint8*)SDL_malloc(music->spec.size);
     if (!music->buffer) {
         Mix_OutOfMemory();
         WAV_Delete(music);
         return NULL;
     }
-    music->stream = SDL_NewAudioStream(
+    music->stream = music_stream_new(
         music->spec.format, music->spec.channels, music->spec.freq,
         music_spec.format, music_spec.channels, music_spec.freq);
     if (!music->stream) {
@@ -243,6 +272,10 @@ static int WAV_Play(void *context, int play_count)
         loop->current_play_count = loop->initial_play_count;
     }
     music->play_count = play_count;
+    if (music->mapped) {
+        music->mapped_pos = music->start;
+        return 0;
+    }
     if (SDL_RWseek(music->src, music->start, RW_SEEK_SET) < 0) {
         return -1;
     }
@@ -252,7 +285,9 @@ static int WAV_Play(void *context, int play_count)
 static void WAV_Stop(void *context)
 {
     WAV_Music *music = (WAV_Music *)context;
-    SDL_AudioStreamClear(music->stream);
+    if (music->stream) {
+        music_stream_clear(music->stream);
+    }
 }
 
 static int fetch_pcm(void *context, int length)
@@ -261,232 +296,70 @@ static int fetch_pcm(void *context, int length)
     return (int)SDL_RWread(music->src, music->buffer, 1, (size_t)length);
 }
 
-static Uint32 PCM_S24_to_S32_BE(Uint8 *x) {
-    const Uint32 bits = 24;
-    Uint32 in = (((Uint32)x[0] << 0)  & 0x0000FF) |
-                (((Uint32)x[1] << 8)  & 0x00FF00) |
-                (((Uint32)x[2] << 16) & 0xFF0000);
-    Uint32 m = 1u << (bits - 1);
-    return (in ^ m) - m;
-}
-
-static Uint32 PCM_S24_to_S32_LE(Uint8 *x) {
-    const Uint32 bits = 24;
-    Uint32 in = (((Uint32)x[2] << 0)  & 0x0000FF) |
-                (((Uint32)x[1] << 8)  & 0x00FF00) |
-                (((Uint32)x[0] << 16) & 0xFF0000);
-    Uint32 m = 1u << (bits - 1);
-    return (in ^ m) - m;
-}
-
-static int fetch_pcm24be(void *context, int length)
+static int fetch_pcm24(void *context, int length, SDL_bool big_endian)
 {
     WAV_Music *music = (WAV_Music *)context;
-    int i = 0, o = 0;
-    length = (int)SDL_RWread(music->src, music->buffer, 1, (size_t)((length / 4) * 3));
+    /* Read behind the room for the output, so it can be converted forward */
+    Uint8 *input = music->buffer + (length / 4);
+    length = (int)SDL_RWread(music->src, input, 1, (size_t)((length / 4) * 3));
     if (length % music->samplesize != 0) {
         length -= length % music->samplesize;
     }
-    for (i = length - 3, o = ((length - 3) / 3) * 4; i >= 0; i -= 3, o -= 4) {
-        Uint32 decoded = PCM_S24_to_S32_BE(music->buffer + i);
-        music->buffer[o + 0] = (decoded >> 0) & 0xFF;
-        music->buffer[o + 1] = (decoded >> 8) & 0xFF;
-        music->buffer[o + 2] = (decoded >> 16) & 0xFF;
-        music->buffer[o + 3] = (decoded >> 24) & 0xFF;
-    }
+    pcm_s24_to_s32(music->buffer, input, length / 3, big_endian);
     return (length / 3) * 4;
 }
 
-static int fetch_pcm24le(void *context, int length)
+static int fetch_pcm24be(void *context, int length)
 {
-    WAV_Music *music = (WAV_Music *)context;
-    int i = 0, o = 0;
-    length = (int)SDL_RWread(music->src, music->buffer, 1, (size_t)((length / 4) * 3));
-    if (length % music->samplesize != 0) {
-        length -= length % music->samplesize;
-    }
-    for (i = length - 3, o = ((length - 3) / 3) * 4; i >= 0; i -= 3, o -= 4) {
-        Uint32 decoded = PCM_S24_to_S32_LE(music->buffer + i);
-        music->buffer[o + 3] = (decoded >> 0) & 0xFF;
-        music->buffer[o + 2] = (decoded >> 8) & 0xFF;
-        music->buffer[o + 1] = (decoded >> 16) & 0xFF;
-        music->buffer[o + 0] = (decoded >> 24) & 0xFF;
-    }
-    return (length / 3) * 4;
+    return fetch_pcm24(context, length, SDL_TRUE);
 }
 
-SDL_FORCE_INLINE double
-Mix_SwapDouble(double x)
+static int fetch_pcm24le(void *context, int length)
 {
-    union
-    {
-        double f;
-        Uint64 ui64;
-    } swapper;
-    swapper.f = x;
-    swapper.ui64 = SDL_Swap64(swapper.ui64);
-    return swapper.f;
+    return fetch_pcm24(context, length, SDL_FALSE);
 }
 
-#if SDL_BYTEORDER == SDL_LIL_ENDIAN
-#define Mix_SwapDoubleLE(X)  (X)
-#define Mix_SwapDoubleBE(X)  Mix_SwapDouble(X)
-#else
-#define Mix_SwapDoubleLE(X)  Mix_SwapDouble(X)
-#define Mix_SwapDoubleBE(X)  (X)
-#endif
-
-static int fetch_float64be(void *context, int length)
+static int fetch_float64(void *context, int length, SDL_bool big_endian)
 {
     WAV_Music *music = (WAV_Music *)context;
-    int i = 0, o = 0;
     length = (int)SDL_RWread(music->src, music->buffer, 1, (size_t)(length));
     if (length % music->samplesize != 0) {
         length -= length % music->samplesize;
     }
-    for (i = 0, o = 0; i <= length; i += 8, o += 4) {
-        union
-        {
-            float f;
-            Uint32 ui32;
-        } sample;
-        sample.f = (float)Mix_SwapDoubleBE(*(double*)(music->buffer + i));
-        music->buffer[o + 0] = (sample.ui32 >> 0) & 0xFF;
-        music->buffer[o + 1] = (sample.ui32 >> 8) & 0xFF;
-        music->buffer[o + 2] = (sample.ui32 >> 16) & 0xFF;
-        music->buffer[o + 3] = (sample.ui32 >> 24) & 0xFF;
-    }
+    pcm_f64_to_f32((float *)music->buffer, music->buffer, length / 8, big_endian);
     return length / 2;
 }
 
-static int fetch_float64le(void *context, int length)
-{
-    WAV_Music *music = (WAV_Music *)context;
-    int i = 0, o = 0;
-    length = (int)SDL_RWread(music->src, music->buffer, 1, (size_t)(length));
-    if (length % music->samplesize != 0) {
-        length -= length % music->samplesize;
-    }
-    for (i = 0, o = 0; i <= length; i += 8, o += 4) {
-        union
-        {
-            float f;
-            Uint32 ui32;
-        } sample;
-        sample.f = (float)Mix_SwapDoubleLE(*(double*)(music->buffer + i));
-        music->buffer[o + 0] = (sample.ui32 >> 0) & 0xFF;
-        music->buffer[o + 1] = (sample.ui32 >> 8) & 0xFF;
-        music->buffer[o + 2] = (sample.ui32 >> 16) & 0xFF;
-        music->buffer[o + 3] = (sample.ui32 >> 24) & 0xFF;
-    }
-    return length / 2;
-}
-
-/*
-    G711 decode tables taken from SDL2 (src/audio/SDL_wave.c)
-*/
-#ifdef SDL_WAVE_LAW_LUT
-static const Sint16 alaw_lut[256] = {
-    -5504, -5248, -6016, -5760, -4480, -4224, -4992, -4736, -7552, -7296, -8064, -7808, -6528, -6272, -7040, -6784, -2752,
-    -2624, -3008, -2880, -2240, -2112, -2496, -2368, -3776, -3648, -4032, -3904, -3264, -3136, -3520, -3392, -22016,
-    -20992, -24064, -23040, -17920, -16896, -19968, -18944, -30208, -29184, -32256, -31232, -26112, -25088, -28160, -27136, -11008,
-    -10496, -12032, -11520, -8960, -8448, -9984, -9472, -15104, -14592, -16128, -15616, -13056, -12544, -14080, -13568, -344,
-    -328, -376, -360, -280, -264, -312, -296, -472, -456, -504, -488, -408, -392, -440, -424, -88,
-    -72, -120, -104, -24, -8, -56, -40, -216, -200, -248, -232, -152, -136, -184, -168, -1376,
-    -1312, -1504, -1440, -1120, -1056, -1248, -1184, -1888, -1824, -2016, -1952, -1632, -1568, -1760, -1696, -688,
-    -656, -752, -720, -560, -528, -624, -592, -944, -912, -1008, -976, -816, -784, -880, -848, 5504,
-    5248, 6016, 5760, 4480, 4224, 4992, 4736, 7552, 7296, 8064, 7808, 6528, 6272, 7040, 6784, 2752,
-    2624, 3008, 2880, 2240, 2112, 2496, 2368, 3776, 3648, 4032, 3904, 3264, 3136, 3520, 3392, 22016,
-    20992, 24064, 23040, 17920, 16896, 19968, 18944, 30208, 29184, 32256, 31232, 26112, 25088, 28160, 27136, 11008,
-    10496, 12032, 11520, 8960, 8448, 9984, 9472, 15104, 14592, 16128, 15616, 13056, 12544, 14080, 13568, 344,
-    328, 376, 360, 280, 264, 312, 296, 472, 456, 504, 488, 408, 392, 440, 424, 88,
-    72, 120, 104, 24, 8, 56, 40, 216, 200, 248, 232, 152, 136, 184, 168, 1376,
-    1312, 1504, 1440, 1120, 1056, 1248, 1184, 1888, 1824, 2016, 1952, 1632, 1568, 1760, 1696, 688,
-    656, 752, 720, 560, 528, 624, 592, 944, 912, 1008, 976, 816, 784, 880, 848
-};
-
-static const Sint16 mulaw_lut[256] = {
-    -32124, -31100, -30076, -29052, -28028, -27004, -25980, -24956, -23932, -22908, -21884, -20860, -19836, -18812, -17788, -16764, -15996,
-    -15484, -14972, -14460, -13948, -13436, -12924, -12412, -11900, -11388, -10876, -10364, -9852, -9340, -8828, -8316, -7932,
-    -7676, -7420, -7164, -6908, -6652, -6396, -6140, -5884, -5628, -5372, -5116, -4860, -4604, -4348, -4092, -3900,
-    -3772, -3644, -3516, -3388, -3260, -3132, -3004, -2876, -2748, -2620, -2492, -2364, -2236, -2108, -1980, -1884,
-    -1820, -1756, -1692, -1628, -1564, -1500, -1436, -1372, -1308, -1244, -1180, -1116, -1052, -988, -924, -876,
-    -844, -812, -780, -748, -716, -684, -652, -620, -588, -556, -524, -492, -460, -428, -396, -372,
-    -356, -340, -324, -308, -292, -276, -260, -244, -228, -212, -196, -180, -164, -148, -132, -120,
-    -112, -104, -96, -88, -80, -72, -64, -56, -48, -40, -32, -24, -16, -8, 0, 32124,
-    31100, 30076, 29052, 28028, 27004, 25980, 24956, 23932, 22908, 21884, 20860, 19836, 18812, 17788, 16764, 15996,
-    15484, 14972, 14460, 13948, 13436, 12924, 12412, 11900, 11388, 10876, 10364, 9852, 9340, 8828, 8316, 7932,
-    7676, 7420, 7164, 6908, 6652, 6396, 6140, 5884, 5628, 5372, 5116, 4860, 4604, 4348, 4092, 3900,
-    3772, 3644, 3516, 3388, 3260, 3132, 3004, 2876, 2748, 2620, 2492, 2364, 2236, 2108, 1980, 1884,
-    1820, 1756, 1692, 1628, 1564, 1500, 1436, 1372, 1308, 1244, 1180, 1116, 1052, 988, 924, 876,
-    844, 812, 780, 748, 716, 684, 652, 620, 588, 556, 524, 492, 460, 428, 396, 372,
-    356, 340, 324, 308, 292, 276, 260, 244, 228, 212, 196, 180, 164, 148, 132, 120,
-    112, 104, 96, 88, 80, 72, 64, 56, 48, 40, 32, 24, 16, 8, 0
-};
-#endif
-
-static Sint16 uLAW_To_PCM16(Uint8 u_val)
+static int fetch_float64be(void *context, int length)
 {
-#ifdef SDL_WAVE_LAW_LUT
-    return mulaw_lut[u_val];
-#else
-    Uint8 nibble = ~u_val;
-    Sint16 mantissa = nibble & 0xf;
-    Uint8 exponent = (nibble >> 4) & 0x7;
-    Sint16 step = (Sint16)(4 << (exponent + 1));
-
-    mantissa = (Sint16)(0x80 << exponent) + step * mantissa + step / 2 - 132;
-
-    return nibble & 0x80 ? -mantissa : mantissa;
-#endif
+    return fetch_float64(context, length, SDL_TRUE);
 }
 
-static Sint16 ALAW_To_PCM16(Uint8 a_val)
+static int fetch_float64le(void *context, int length)
 {
-#ifdef SDL_WAVE_LAW_LUT
-    return alaw_lut[a_val];
-#else
-    Uint8 nibble = a_val;
-    Uint8 exponent = (nibble & 0x7f) ^ 0x55;
-    Sint16 mantissa = exponent & 0xf;
-
-    exponent >>= 4;
-    if (exponent > 0) {
-        mantissa |= 0x10;
-    }
-    mantissa = (Sint16)(mantissa << 4) | 0x8;
-    if (exponent > 1) {
-        mantissa <<= exponent - 1;
-    }
-
-    return nibble & 0x80 ? mantissa : -mantissa;
-#endif
+    return fetch_float64(context, length, SDL_FALSE);
 }
 
-static int fetch_xlaw(Sint16 (*decode_sample)(Uint8), void *context, int length)
+static int fetch_xlaw(void (*decode)(Sint16 *, const Uint8 *, int), void *context, int length)
 {
     WAV_Music *music = (WAV_Music *)context;
-    int i = 0, o = 0;
-    length = (int)SDL_RWread(music->src, music->buffer, 1, (size_t)(length / 2));
+    Uint8 *input = music->buffer + (length / 2);
+    length = (int)SDL_RWread(music->src, input, 1, (size_t)(length / 2));
     if (length % music->samplesize != 0) {
         length -= length % music->samplesize;
     }
-    for (i = length - 1, o = (length - 1) * 2; i >= 0; i--, o -= 2) {
-        Uint16 decoded = (Uint16)decode_sample(music->buffer[i]);
-        music->buffer[o] = decoded & 0xFF;
-        music->buffer[o + 1] = (decoded >> 8) & 0xFF;
-    }
+    decode((Sint16 *)music->buffer, input, length);
     return length * 2;
 }
 
 static int fetch_ulaw(void *context, int length)
 {
-    return fetch_xlaw(uLAW_To_PCM16, context, length);
+    return fetch_xlaw(pcm_ulaw_to_s16, context, length);
 }
 
 static int fetch_alaw(void *context, int length)
 {
-    return fetch_xlaw(ALAW_To_PCM16, context, length);
+    return fetch_xlaw(pcm_alaw_to_s16, context, length);
 }
 
 /* Play some of a stream previously started with WAV_Play() */
@@ -502,7 +375,7 @@ static int WAV_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     unsigned int i;
     int filled, amount, result;
 
-    filled = SDL_AudioStreamGet(music->stream, data, bytes);
+    filled = music_stream_get(music->stream, data, bytes);
     if (filled != 0) {
         return filled;
     }
@@ -522,7 +395,8 @@ static int WAV_GetSome(void *context, void *data, int bytes, SDL_bool *done)
             const int bytes_per_sample = (SDL_AUDIO_BITSIZE(music->spec.format) / 8) * music->spec.channels;
             loop_start = music->start + loop->start * (Uint32)bytes_per_sample;
             loop_stop = music->start + (loop->stop + 1) * (Uint32)bytes_per_sample;
-            if (pos >= loop_start && pos < loop_stop) {
+            /* Stop at the loop end even if the loop starts ahead */
+            if (pos < loop_stop) {
                 stop = loop_stop;
                 break;
             }
@@ -537,7 +411,7 @@ static int WAV_GetSome(void *context, void *data, int bytes, SDL_bool *done)
 
     amount = music->decode(music, amount);
     if (amount > 0) {
-        result = SDL_AudioStreamPut(music->stream, music->buffer, amount);
+        result = music_stream_put(music->stream, music->buffer, amount);
         if (result < 0) {
             return -1;
         }
@@ -562,7 +436,7 @@ static int WAV_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     if (!looped && (at_end || SDL_RWtell(music->src) >= music->stop)) {
         if (music->play_count == 1) {
             music->play_count = 0;
-            SDL_AudioStreamFlush(music->stream);
+            music_stream_flush(music->stream);
         } else {
             int play_count = -1;
             if (music->play_count > 0) {
@@ -578,9 +452,96 @@ static int WAV_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     return 0;
 }
 
+/* MIXER-X: Mix the mapped samples, they are in the device format already */
+static int WAV_GetAudioMapped(WAV_Music *music, void *data, int bytes)
+{
+    Uint8 *snd = (Uint8 *)data;
+    int len = bytes;
+    int zero_cycles = 0;
+    const int MAX_ZERO_CYCLES = 10; /* just try to catch infinite loops */
+
+    while (len > 0 && music->play_count) {
+        Sint64 pos = music->mapped_pos;
+        Sint64 stop = music->stop;
+        Sint64 loop_start = music->start;
+        Sint64 loop_stop;
+        WAVLoopPoint *loop = NULL;
+        SDL_bool looped = SDL_FALSE;
+        unsigned int i;
+        int amount;
+
+        for (i = 0; i < music->numloops; ++i) {
+            loop = &music->loops[i];
+            if (loop->active) {
+                loop_start = music->start + loop->start * (Uint32)music->samplesize;
+                loop_stop = music->start + (loop->stop + 1) * (Uint32)music->samplesize;
+                if (pos < loop_stop) {
+                    /* Never read past the data chunk */
+                    if (loop_stop < stop) {
+                        stop = loop_stop;
+                    }
+                    break;
+                }
+            }
+            loop = NULL;
+        }
+
+        amount = len;
+        if ((stop - pos) < amount) {
+            amount = (int)(stop - pos);
+        }
+        if (amount > 0) {
+            amount -= amount % (int)music->samplesize;
+        }
+
+        if (amount > 0) {
+            if (music->volume == MIX_MAX_VOLUME) {
+                SDL_memcpy(snd, music->mapped + pos, (size_t)amount);
+            } else {
+                SDL_MixAudioFormat(snd, music->mapped + pos, music_spec.format, (Uint32)amount, music->volume);
+            }
+            music->mapped_pos += amount;
+            snd += amount;
+            len -= amount;
+            zero_cycles = 0;
+        } else if (++zero_cycles > MAX_ZERO_CYCLES) {
+            break;
+        }
+
+        if (loop && music->mapped_pos >= stop) {
+            if (loop->current_play_count == 1) {
+                loop->active = SDL_FALSE;
+            } else {
+                if (loop->current_play_count > 0) {
+                    --loop->current_play_count;
+                }
+                music->mapped_pos = loop_start;
+                looped = SDL_TRUE;
+            }
+        }
+
+        if (!looped && (amount <= 0 || music->mapped_pos >= music->stop)) {
+            if (music->play_count == 1) {
+                music->play_count = 0;
+            } else {
+                int play_count = -1;
+                if (music->play_count > 0) {
+                    play_count = (music->play_count - 1);
+                }
+                WAV_Play(music, play_count);
+            }
+        }
+    }
+
+    return len;
+}
+
 static int WAV_GetAudio(void *context, void *data, int bytes)
 {
     WAV_Music *music = (WAV_Music *)context;
+    if (music->mapped) {
+        return WAV_GetAudioMapped(music, data, bytes);
+    }
     return music_pcm_getaudio(context, data, bytes, music->volume, WAV_GetSome);
 }
 
@@ -593,6 +554,10 @@ static int WAV_Seek(void *context, double position)
     destpos -= dest_offset % sample_size;
     if (destpos > music->stop)
         return -1;
+    if (music->mapped) {
+        music->mapped_pos = destpos;
+        return 0;
+    }
     if (SDL_RWseek(music->src, destpos, RW_SEEK_SET) < 0)
         return -1;
     return 0;
@@ -601,7 +566,7 @@ static int WAV_Seek(void *context, double position)
 static double WAV_Tell(void *context)
 {
     WAV_Music *music = (WAV_Music *)context;
-    Sint64 phys_pos = SDL_RWtell(music->src);
+    Sint64 phys_pos = music->mapped ? music->mapped_pos : SDL_RWtell(music->src);
     return (double)(phys_pos - music->start) / (double)(music->spec.freq * music->samplesize);
 }
 
@@ -630,11 +595,12 @@ static void WAV_Delete(void *context)
         SDL_free(music->loops);
     }
     if (music->stream) {
-        SDL_FreeAudioStream(music->stream);
+        music_stream_free(music->stream);
     }
     if (music->buffer) {
         SDL_free(music->buffer);
     }
+    _Mix_UnmapRW(music->mapping, music->mapped_size);
     if (music->freesrc) {
         SDL_RWclose(music->src);
     }
@@ -700,8 +666,8 @@ static SDL_bool ParseFMT(WAV_Music *wave, Uint32 chunk_length)
         case 8:
             switch(wave->encoding) {
             case PCM_CODE:  spec->format = AUDIO_U8; break;
-            case ALAW_CODE: spec->format = AUDIO_S16; break;
-            case uLAW_CODE: spec->format = AUDIO_S16; break;
+            case ALAW_CODE: spec->format = AUDIO_S16SYS; break;
+            case uLAW_CODE: spec->format = AUDIO_S16SYS; break;
             default: goto unknown_bits;
             }
             break;
@@ -731,7 +697,7 @@ static SDL_bool ParseFMT(WAV_Music *wave, Uint32 chunk_length)
             switch(wave->encoding) {
             case FLOAT_CODE:
                 wave->decode = fetch_float64le;
-                spec->format = AUDIO_F32;
+                spec->format = AUDIO_F32SYS;
                 break;
             default: goto unknown_bits;
             }
@@ -1150,12 +1116,12 @@ static SDL_bool LoadAIFFMusic(WAV_Music *wave)
         case raw_: spec->format = AUDIO_U8; break;
         case sowt: spec->format = AUDIO_S8; break;
         case ulaw:
-            spec->format = AUDIO_S16LSB;
+            spec->format = AUDIO_S16SYS;
             wave->encoding = uLAW_CODE;
             wave->decode = fetch_ulaw;
             break;
         case alaw:
-            spec->format = AUDIO_S16LSB;
+            spec->format = AUDIO_S16SYS;
             wave->encoding = ALAW_CODE;
             wave->decode = fetch_alaw;
             break;
@@ -1169,12 +1135,12 @@ static SDL_bool LoadAIFFMusic(WAV_Music *wave)
         case sowt: spec->format = AUDIO_S16LSB; break;
         case NONE: spec->format = AUDIO_S16MSB; break;
         case ULAW:
-            spec->format = AUDIO_S16LSB;
+            spec->format = AUDIO_S16SYS;
             wave->encoding = uLAW_CODE;
             wave->decode = fetch_ulaw;
             break;
         case ALAW:
-            spec->format = AUDIO_S16LSB;
+            spec->format = AUDIO_S16SYS;
             wave->encoding = ALAW_CODE;
             wave->decode = fetch_alaw;
             break;
@@ -1187,7 +1153,10 @@ static SDL_bool LoadAIFFMusic(WAV_Music *wave)
         if (!is_AIFC)
             spec->format = AUDIO_S32MSB;
         else switch (compressionType) {
-        case sowt: spec->format = AUDIO_S32LSB; break;
+        case sowt:
+            wave->decode = fetch_pcm24le;
+            spec->format = AUDIO_S32LSB;
+            break;
         case NONE: spec->format = AUDIO_S32MSB; break;
         default: goto unsupported_format;
         }
@@ -1207,10 +1176,10 @@ static SDL_bool LoadAIFFMusic(WAV_Music *wave)
         wave->encoding = FLOAT_CODE;
         wave->decode = fetch_float64be;
         if (!is_AIFC)
-            spec->format = AUDIO_F32;
+            spec->format = AUDIO_F32SYS;
         else switch (compressionType) {
         case fl64:
-            spec->format = AUDIO_F32;
+            spec->format = AUDIO_F32SYS;
             break;
         default: goto unsupported_format;
         }
@@ -1259,6 +1228,11 @@ Mix_MusicInterface Mix_MusicInterface_WAV =
     NULL,   /* LoopStart */
     NULL,   /* LoopEnd */
     NULL,   /* LoopLength */
+    NULL,   /* BuildSeekIndex [MIXER-X] */
+    NULL,   /* GetSeekIndex [MIXER-X] */
+    NULL,   /* SetSeekIndex [MIXER-X] */
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     WAV_GetMetaTag,   /* GetMetaTag */
     NULL,   /* Pause */
     NULL,   /* Resume */
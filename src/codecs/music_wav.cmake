@@ -4,6 +4,8 @@ if(USE_WAV)
     list(APPEND SDLMixerX_SOURCES
         ${CMAKE_CURRENT_LIST_DIR}/music_wav.c
         ${CMAKE_CURRENT_LIST_DIR}/music_wav.h
+        ${CMAKE_CURRENT_LIST_DIR}/pcm_convert.c
+        ${CMAKE_CURRENT_LIST_DIR}/pcm_convert.h
     )
     appendPcmFormats("WAV(Music);AIFF(Music)")
 endif()
@@ -24,6 +24,7 @@
 #include "SDL_loadso.h"
 
 #include "music_xmp.h"
+#include "utils.h"
 
 #ifdef LIBXMP_HEADER
 #include LIBXMP_HEADER
@@ -140,7 +141,7 @@ typedef struct
     struct xmp_module_info mi;
     struct xmp_frame_info fi;
     xmp_context ctx;
-    SDL_AudioStream *stream;
+    Mix_MusicStream *stream;
     void *buffer;
     int buffer_size;
     Mix_MusicMetaTags tags;
@@ -224,13 +225,13 @@ void *XMP_CreateFromRW(SDL_RWops *src, int freesrc)
         err = libxmp.xmp_load_module_from_callbacks(music->ctx, src, file_callbacks);
     } else {
         size_t size;
-        void *mem = SDL_LoadFile_RW(src, &size, SDL_FALSE);
+        void *mem_free;
+        const void *mem = _Mix_LoadRWData(src, &size, &mem_free);
         if (!mem) {
-            SDL_OutOfMemory();
             goto e1;
         }
-        err = libxmp.xmp_load_module_from_memory(music->ctx, mem, (long)size);
-        SDL_free(mem);
+        err = libxmp.xmp_load_module_from_memory(music->ctx, (void *)mem, (long)size);
+        SDL_free(mem_free);
     }
 
     if (err < 0) {
@@ -247,7 +248,7 @@ void *XMP_CreateFromRW(SDL_RWops *src, int freesrc)
     music->volume = MIX_MAX_VOLUME;
     music->tempo = 1.0;
 
-    music->stream = SDL_NewAudioStream(AUDIO_S16SYS, 2, music_spec.freq,
+    music->stream = music_stream_new(AUDIO_S16SYS, 2, music_spec.freq,
                                        music_spec.format, music_spec.channels, music_spec.freq);
     if (!music->stream) {
         goto e3;
@@ -304,7 +305,7 @@ static int XMP_Play(void *context, int play_count)
 static void XMP_Stop(void *context)
 {
     XMP_Music *music = (XMP_Music *)context;
-    SDL_AudioStreamClear(music->stream);
+    music_stream_clear(music->stream);
 }
 
 /* Play some of a stream previously started with xmp_play() */
@@ -313,7 +314,7 @@ static int XMP_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     XMP_Music *music = (XMP_Music *)context;
     int filled, amount, ret;
 
-    filled = SDL_AudioStreamGet(music->stream, data, bytes);
+    filled = music_stream_get(music->stream, data, bytes);
     if (filled != 0) {
         return filled;
     }
@@ -332,7 +333,7 @@ static int XMP_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     amount = music->buffer_size;
 
     if (ret == 0) {
-        if (SDL_AudioStreamPut(music->stream, music->buffer, amount) < 0) {
+        if (music_stream_put(music->stream, music->buffer, amount) < 0) {
             return -1;
         }
     } else {
@@ -341,7 +342,7 @@ static int XMP_GetSome(void *context, void *data, int bytes, SDL_bool *done)
         }
         if (music->play_count == 1) {
             music->play_count = 0;
-            SDL_AudioStreamFlush(music->stream);
+            music_stream_flush(music->stream);
         } else {
             int play_count = -1;
             if (music->play_count > 0) {
@@ -447,7 +448,7 @@ static void XMP_Delete(void *context)
         libxmp.xmp_free_context(music->ctx);
     }
     if (music->stream) {
-        SDL_FreeAudioStream(music->stream);
+        music_stream_free(music->stream);
     }
     if (music->buffer) {
         SDL_free(music->buffer);
@@ -485,6 +486,11 @@ Mix_MusicInterface Mix_MusicInterface_XMP =
     NULL,   /* LoopStart */
     NULL,   /* LoopEnd */
     NULL,   /* LoopLength */
+    NULL,   /* BuildSeekIndex [MIXER-X] */
+    NULL,   /* GetSeekIndex [MIXER-X] */
+    NULL,   /* SetSeekIndex [MIXER-X] */
+    NULL,   /* GetNumTracks [MIXER-X] */
+    NULL,   /* StartTrack [MIXER-X] */
     XMP_GetMetaTag,
     NULL,   /* Pause */
     NULL,   /* Resume */
@@ -0,0 +1,244 @@
+/*
+  SDL Mixer X:  An extended audio mixer library, forked from SDL_mixer
+  Copyright (C) 2014-2022 Vitaly Novichkov <admin@wohlnet.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* MIXER-X: Converters of the PCM formats which SDL can't take directly.
+ *
+ * Every converter walks forward, so the output may be written over the input
+ * read just before (see pcm_convert.h). The SSE2 versions produce the same
+ * output as the scalar ones.
+ */
+
+#include "SDL_endian.h"
+
+#include "pcm_convert.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define PCM_CONVERT_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+/*
+    G711 decode tables taken from SDL2 (src/audio/SDL_wave.c)
+*/
+static const Sint16 alaw_lut[256] = {
+    -5504, -5248, -6016, -5760, -4480, -4224, -4992, -4736, -7552, -7296, -8064, -7808, -6528, -6272, -7040, -6784, -2752,
+    -2624, -3008, -2880, -2240, -2112, -2496, -2368, -3776, -3648, -4032, -3904, -3264, -3136, -3520, -3392, -22016,
+    -20992, -24064, -23040, -17920, -16896, -19968, -18944, -30208, -29184, -32256, -31232, -26112, -25088, -28160, -27136, -11008,
+    -10496, -12032, -11520, -8960, -8448, -9984, -9472, -15104, -14592, -16128, -15616, -13056, -12544, -14080, -13568, -344,
+    -328, -376, -360, -280, -264, -312, -296, -472, -456, -504, -488, -408, -392, -440, -424, -88,
+    -72, -120, -104, -24, -8, -56, -40, -216, -200, -248, -232, -152, -136, -184, -168, -1376,
+    -1312, -1504, -1440, -1120, -1056, -1248, -1184, -1888, -1824, -2016, -1952, -1632, -1568, -1760, -1696, -688,
+    -656, -752, -720, -560, -528, -624, -592, -944, -912, -1008, -976, -816, -784, -880, -848, 5504,
+    5248, 6016, 5760, 4480, 4224, 4992, 4736, 7552, 7296, 8064, 7808, 6528, 6272, 7040, 6784, 2752,
+    2624, 3008, 2880, 2240, 2112, 2496, 2368, 3776, 3648, 4032, 3904, 3264, 3136, 3520, 3392, 22016,
+    20992, 24064, 23040, 17920, 16896, 19968, 18944, 30208, 29184, 32256, 31232, 26112, 25088, 28160, 27136, 11008,
+    10496, 12032, 11520, 8960, 8448, 9984, 9472, 15104, 14592, 16128, 15616, 13056, 12544, 14080, 13568, 344,
+    328, 376, 360, 280, 264, 312, 296, 472, 456, 504, 488, 408, 392, 440, 424, 88,
+    72, 120, 104, 24, 8, 56, 40, 216, 200, 248, 232, 152, 136, 184, 168, 1376,
+    1312, 1504, 1440, 1120, 1056, 1248, 1184, 1888, 1824, 2016, 1952, 1632, 1568, 1760, 1696, 688,
+    656, 752, 720, 560, 528, 624, 592, 944, 912, 1008, 976, 816, 784, 880, 848
+};
+
+static const Sint16 mulaw_lut[256] = {
+    -32124, -31100, -30076, -29052, -28028, -27004, -25980, -24956, -23932, -22908, -21884, -20860, -19836, -18812, -17788, -16764, -15996,
+    -15484, -14972, -14460, -13948, -13436, -12924, -12412, -11900, -11388, -10876, -10364, -9852, -9340, -8828, -8316, -7932,
+    -7676, -7420, -7164, -6908, -6652, -6396, -6140, -5884, -5628, -5372, -5116, -4860, -4604, -4348, -4092, -3900,
+    -3772, -3644, -3516, -3388, -3260, -3132, -3004, -2876, -2748, -2620, -2492, -2364, -2236, -2108, -1980, -1884,
+    -1820, -1756, -1692, -1628, -1564, -1500, -1436, -1372, -1308, -1244, -1180, -1116, -1052, -988, -924, -876,
+    -844, -812, -780, -748, -716, -684, -652, -620, -588, -556, -524, -492, -460, -428, -396, -372,
+    -356, -340, -324, -308, -292, -276, -260, -244, -228, -212, -196, -180, -164, -148, -132, -120,
+    -112, -104, -96, -88, -80, -72, -64, -56, -48, -40, -32, -24, -16, -8, 0, 32124,
+    31100, 30076, 29052, 28028, 27004, 25980, 24956, 23932, 22908, 21884, 20860, 19836, 18812, 17788, 16764, 15996,
+    15484, 14972, 14460, 13948, 13436, 12924, 12412, 11900, 11388, 10876, 10364, 9852, 9340, 8828, 8316, 7932,
+    7676, 7420, 7164, 6908, 6652, 6396, 6140, 5884, 5628, 5372, 5116, 4860, 4604, 4348, 4092, 3900,
+    3772, 3644, 3516, 3388, 3260, 3132, 3004, 2876, 2748, 2620, 2492, 2364, 2236, 2108, 1980, 1884,
+    1820, 1756, 1692, 1628, 1564, 1500, 1436, 1372, 1308, 1244, 1180, 1116, 1052, 988, 924, 876,
+    844, 812, 780, 748, 716, 684, 652, 620, 588, 556, 524, 492, 460, 428, 396, 372,
+    356, 340, 324, 308, 292, 276, 260, 244, 228, 212, 196, 180, 164, 148, 132, 120,
+    112, 104, 96, 88, 80, 72, 64, 56, 48, 40, 32, 24, 16, 8, 0
+};
+
+void pcm_s24_to_s32(Uint8 *dst, const Uint8 *src, int samples, SDL_bool big_endian)
+{
+    int i = 0;
+
+#ifdef PCM_CONVERT_USE_SSE2
+    const __m128i low24 = _mm_set1_epi32(0x00FFFFFF);
+
+    /* Four samples per pass, the load takes 16 of the 12 bytes */
+    for (; i + 6 <= samples; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i * 3));
+        __m128i s01 = _mm_unpacklo_epi32(v, _mm_srli_si128(v, 3));
+        __m128i s23 = _mm_unpacklo_epi32(_mm_srli_si128(v, 6), _mm_srli_si128(v, 9));
+        v = _mm_unpacklo_epi64(s01, s23);
+        if (big_endian) {
+            v = _mm_and_si128(v, low24);
+        } else {
+            v = _mm_slli_epi32(v, 8);
+        }
+        _mm_storeu_si128((__m128i *)(dst + i * 4), v);
+    }
+#endif
+
+    for (; i < samples; ++i) {
+        const Uint8 b0 = src[i * 3 + 0], b1 = src[i * 3 + 1], b2 = src[i * 3 + 2];
+        Uint8 *out = dst + i * 4;
+        if (big_endian) {
+            out[0] = b0;
+            out[1] = b1;
+            out[2] = b2;
+            out[3] = 0;
+        } else {
+            out[0] = 0;
+            out[1] = b0;
+            out[2] = b1;
+            out[3] = b2;
+        }
+    }
+}
+
+#ifdef PCM_CONVERT_USE_SSE2
+static SDL_INLINE __m128i swap64_sse2(__m128i v)
+{
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+    return _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+#endif
+
+void pcm_f64_to_f32(float *dst, const Uint8 *src, int samples, SDL_bool big_endian)
+{
+    int i = 0;
+
+#ifdef PCM_CONVERT_USE_SSE2
+    for (; i + 4 <= samples; i += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + i * 8));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i * 8 + 16));
+        if (big_endian) {
+            a = swap64_sse2(a);
+            b = swap64_sse2(b);
+        }
+        _mm_storeu_ps(dst + i, _mm_movelh_ps(_mm_cvtpd_ps(_mm_castsi128_pd(a)),
+                                             _mm_cvtpd_ps(_mm_castsi128_pd(b))));
+    }
+#endif
+
+    for (; i < samples; ++i) {
+        const Uint8 *in = src + i * 8;
+        union
+        {
+            double f;
+            Uint64 ui64;
+        } sample;
+        if (big_endian) {
+            sample.ui64 = ((Uint64)in[0] << 56) | ((Uint64)in[1] << 48) | ((Uint64)in[2] << 40) | ((Uint64)in[3] << 32) |
+                          ((Uint64)in[4] << 24) | ((Uint64)in[5] << 16) | ((Uint64)in[6] << 8) | (Uint64)in[7];
+        } else {
+            sample.ui64 = ((Uint64)in[7] << 56) | ((Uint64)in[6] << 48) | ((Uint64)in[5] << 40) | ((Uint64)in[4] << 32) |
+                          ((Uint64)in[3] << 24) | ((Uint64)in[2] << 16) | ((Uint64)in[1] << 8) | (Uint64)in[0];
+        }
+        dst[i] = (float)sample.f;
+    }
+}
+
+#ifdef PCM_CONVERT_USE_SSE2
+/* 1 << e of the 16-bit lanes, e is from 0 to 7 */
+static SDL_INLINE __m128i pow2_epi16(__m128i e)
+{
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i two = _mm_set1_epi16(2);
+    const __m128i four = _mm_set1_epi16(4);
+    __m128i p1 = _mm_add_epi16(one, _mm_and_si128(e, one));
+    __m128i p2 = _mm_add_epi16(one, _mm_and_si128(_mm_cmpeq_epi16(_mm_and_si128(e, two), two), _mm_set1_epi16(3)));
+    __m128i p4 = _mm_add_epi16(one, _mm_and_si128(_mm_cmpeq_epi16(_mm_and_si128(e, four), four), _mm_set1_epi16(15)));
+    return _mm_mullo_epi16(_mm_mullo_epi16(p1, p2), p4);
+}
+
+/* Same math as the tables, on eight zero-extended bytes */
+static SDL_INLINE __m128i ulaw_sse2(__m128i u)
+{
+    const __m128i nibble = _mm_xor_si128(u, _mm_set1_epi16(0xFF));
+    const __m128i bias = _mm_set1_epi16(0x84);
+    __m128i mantissa = _mm_and_si128(nibble, _mm_set1_epi16(0x0F));
+    __m128i exponent = _mm_and_si128(_mm_srli_epi16(nibble, 4), _mm_set1_epi16(0x07));
+    __m128i negative = _mm_cmpgt_epi16(nibble, _mm_set1_epi16(0x7F));
+    __m128i v = _mm_add_epi16(_mm_slli_epi16(mantissa, 3), bias);
+    v = _mm_sub_epi16(_mm_mullo_epi16(v, pow2_epi16(exponent)), bias);
+    return _mm_sub_epi16(_mm_xor_si128(v, negative), negative);
+}
+
+static SDL_INLINE __m128i alaw_sse2(__m128i a)
+{
+    const __m128i t = _mm_xor_si128(_mm_and_si128(a, _mm_set1_epi16(0x7F)), _mm_set1_epi16(0x55));
+    __m128i mantissa = _mm_and_si128(t, _mm_set1_epi16(0x0F));
+    __m128i exponent = _mm_srli_epi16(t, 4);
+    __m128i has_exponent = _mm_cmpgt_epi16(exponent, _mm_setzero_si128());
+    __m128i negative = _mm_cmpgt_epi16(_mm_set1_epi16(0x80), a);
+    __m128i v;
+    mantissa = _mm_or_si128(mantissa, _mm_and_si128(has_exponent, _mm_set1_epi16(0x10)));
+    mantissa = _mm_or_si128(_mm_slli_epi16(mantissa, 4), _mm_set1_epi16(0x08));
+    /* Shift by exponent - 1 when it's above zero */
+    v = _mm_mullo_epi16(mantissa, pow2_epi16(_mm_add_epi16(exponent, has_exponent)));
+    return _mm_sub_epi16(_mm_xor_si128(v, negative), negative);
+}
+#endif
+
+void pcm_ulaw_to_s16(Sint16 *dst, const Uint8 *src, int samples)
+{
+    int i = 0;
+
+#ifdef PCM_CONVERT_USE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= samples; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i lo = ulaw_sse2(_mm_unpacklo_epi8(v, zero));
+        __m128i hi = ulaw_sse2(_mm_unpackhi_epi8(v, zero));
+        _mm_storeu_si128((__m128i *)(dst + i), lo);
+        _mm_storeu_si128((__m128i *)(dst + i + 8), hi);
+    }
+#endif
+
+    for (; i < samples; ++i) {
+        dst[i] = mulaw_lut[src[i]];
+    }
+}
+
+void pcm_alaw_to_s16(Sint16 *dst, const Uint8 *src, int samples)
+{
+    int i = 0;
+
+#ifdef PCM_CONVERT_USE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= samples; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i lo = alaw_sse2(_mm_unpacklo_epi8(v, zero));
+        __m128i hi = alaw_sse2(_mm_unpackhi_epi8(v, zero));
+        _mm_storeu_si128((__m128i *)(dst + i), lo);
+        _mm_storeu_si128((__m128i *)(dst + i + 8), hi);
+    }
+#endif
+
+    for (; i < samples; ++i) {
+        dst[i] = alaw_lut[src[i]];
+    }
+}
+
+/* vi: set ts=4 sw=4 expandtab: */
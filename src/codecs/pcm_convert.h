@@ -0,0 +1,45 @@
+/*
+  SDL Mixer X:  An extended audio mixer library, forked from SDL_mixer
+  Copyright (C) 2014-2022 Vitaly Novichkov <admin@wohlnet.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* This file provides converters of the PCM formats not supported by SDL into
+ * the formats supported by it. All of them can work in place: the output may
+ * start at the same address as the input of 64-bit floats, and before the
+ * input of other formats by at least 'samples' bytes. */
+
+#ifndef MIX_PCM_CONVERT_H
+#define MIX_PCM_CONVERT_H
+
+#include "SDL_stdinc.h"
+
+/* 24-bit integers into 32-bit ones of the same byte order, not the native
+ * one: AUDIO_S32LSB when the input is little-endian, AUDIO_S32MSB otherwise */
+extern void pcm_s24_to_s32(Uint8 *dst, const Uint8 *src, int samples, SDL_bool big_endian);
+
+/* 64-bit floats into AUDIO_F32SYS */
+extern void pcm_f64_to_f32(float *dst, const Uint8 *src, int samples, SDL_bool big_endian);
+
+/* G.711 u-law and A-law into AUDIO_S16SYS */
+extern void pcm_ulaw_to_s16(Sint16 *dst, const Uint8 *src, int samples);
+extern void pcm_alaw_to_s16(Sint16 *dst, const Uint8 *src, int samples);
+
+#endif /* MIX_PCM_CONVERT_H */
+
+/* vi: set ts=4 sw=4 expandtab: */
@@ -1397,6 +1397,12 @@ static uint8 get8(vorb *z)
 {
    #ifdef STB_VORBIS_SDL
    uint8 c;
+   #ifndef STB_VORBIS_NO_PUSHDATA_API
+   if (z->push_mode) {
+      if (z->stream >= z->stream_end) { z->eof = TRUE; return 0; }
+      return *z->stream++;
+   }
+   #endif
    if (SDL_RWread(z->rwops, &c, 1, 1) != 1) { z->eof = TRUE; return 0; }
    return c;
 
@@ -1443,6 +1449,14 @@ static uint64 get64(vorb *f)
 static int getn(vorb *z, uint8 *data, int n)
 {
    #ifdef STB_VORBIS_SDL
+   #ifndef STB_VORBIS_NO_PUSHDATA_API
+   if (z->push_mode) {
+      if (z->stream+n > z->stream_end) { z->eof = 1; return 0; }
+      memcpy(data, z->stream, n);
+      z->stream += n;
+      return 1;
+   }
+   #endif
    if (SDL_RWread(z->rwops, data, n, 1) == 1) return 1;
    z->eof = 1;
    return 0;
@@ -1469,6 +1483,13 @@ static int getn(vorb *z, uint8 *data, int n)
 static void skip(vorb *z, int n)
 {
    #ifdef STB_VORBIS_SDL
+   #ifndef STB_VORBIS_NO_PUSHDATA_API
+   if (z->push_mode) {
+      z->stream += n;
+      if (z->stream >= z->stream_end) z->eof = 1;
+      return;
+   }
+   #endif
    SDL_RWseek(z->rwops, n, RW_SEEK_CUR);
 
    #else
@@ -36,6 +36,48 @@ static void free_instrument(Instrument *ip)
   SDL_free(ip);
 }
 
+/* Decoded instruments are shared by all songs. An instrument depends only
+   on the patch, the parameters it was loaded with and the output rate, so
+   these are the key of the cache. Unused instruments stay cached for the
+   next songs until Timidity_Exit(). */
+typedef struct _CachedInstrument {
+  char *name;
+  int panning, amp, note_to_use, strip_loop, strip_envelope, strip_tail;
+  Sint32 rate, control_ratio;
+  Instrument *ip;
+  int refcount;
+  int stale; /* Left from the previous configuration, freed once unused */
+  struct _CachedInstrument *next;
+} CachedInstrument;
+
+static CachedInstrument *instrument_cache = NULL;
+static SDL_mutex *instrument_cache_lock = NULL;
+
+static void free_cached_instrument(CachedInstrument **link)
+{
+  CachedInstrument *c = *link;
+  *link = c->next;
+  free_instrument(c->ip);
+  SDL_free(c->name);
+  SDL_free(c);
+}
+
+static void release_instrument(Instrument *ip)
+{
+  CachedInstrument **link, *c;
+
+  SDL_LockMutex(instrument_cache_lock);
+  for (link = &instrument_cache; (c = *link) != NULL; link = &c->next)
+    if (c->ip == ip)
+      {
+	c->refcount--;
+	if (c->stale && c->refcount <= 0)
+	  free_cached_instrument(link);
+	break;
+      }
+  SDL_UnlockMutex(instrument_cache_lock);
+}
+
 static void free_bank(MidiSong *song, int dr, int b)
 {
   int i;
@@ -44,7 +86,7 @@ static void free_bank(MidiSong *song, int dr, int b)
     if (bank->instrument[i])
       {
 	if (bank->instrument[i] != MAGIC_LOAD_INSTRUMENT)
-	  free_instrument(bank->instrument[i]);
+	  release_instrument(bank->instrument[i]);
 	bank->instrument[i] = NULL;
       }
 }
@@ -502,6 +544,66 @@ badpat:
   *out = NULL;
 }
 
+/* Same as load_instrument(), but takes the instrument from the cache */
+static void load_shared_instrument(MidiSong *song, const char *name,
+				   Instrument **out,
+				   int percussion, int panning,
+				   int amp, int note_to_use,
+				   int strip_loop, int strip_envelope,
+				   int strip_tail)
+{
+  CachedInstrument *c;
+
+  *out = NULL;
+  if (!name) return;
+
+  SDL_LockMutex(instrument_cache_lock);
+  for (c = instrument_cache; c; c = c->next)
+    if (!c->stale && c->panning == panning && c->amp == amp &&
+	c->note_to_use == note_to_use && c->strip_loop == strip_loop &&
+	c->strip_envelope == strip_envelope && c->strip_tail == strip_tail &&
+	c->rate == song->rate && c->control_ratio == song->control_ratio &&
+	!SDL_strcmp(c->name, name))
+      break;
+
+  if (!c)
+    {
+      Instrument *ip;
+      load_instrument(song, name, &ip, percussion, panning, amp,
+		      note_to_use, strip_loop, strip_envelope, strip_tail);
+      if (!ip)
+	{
+	  SDL_UnlockMutex(instrument_cache_lock);
+	  return;
+	}
+      c = SDL_calloc(1, sizeof(CachedInstrument));
+      if (c) c->name = SDL_strdup(name);
+      if (!c || !c->name)
+	{
+	  SDL_free(c);
+	  free_instrument(ip);
+	  SDL_UnlockMutex(instrument_cache_lock);
+	  song->oom=1;
+	  return;
+	}
+      c->panning = panning;
+      c->amp = amp;
+      c->note_to_use = note_to_use;
+      c->strip_loop = strip_loop;
+      c->strip_envelope = strip_envelope;
+      c->strip_tail = strip_tail;
+      c->rate = song->rate;
+      c->control_ratio = song->control_ratio;
+      c->ip = ip;
+      c->next = instrument_cache;
+      instrument_cache = c;
+    }
+
+  c->refcount++;
+  *out = c->ip;
+  SDL_UnlockMutex(instrument_cache_lock);
+}
+
 static int fill_bank(MidiSong *song, int dr, int b)
 {
   int i, errors=0;
@@ -543,7 +645,7 @@ static int fill_bank(MidiSong *song, int dr, int b)
 	    }
 	  else
 	    {
-	      load_instrument(song,
+	      load_shared_instrument(song,
 				     bank->tone[i].name, 
 				     &bank->instrument[i],
 				     (dr) ? 1 : 0,
@@ -594,13 +696,52 @@ void free_instruments(MidiSong *song)
       if (song->drumset[i])
 	free_bank(song, 1, i);
     }
+  if (song->default_instrument)
+    {
+      release_instrument(song->default_instrument);
+      song->default_instrument = NULL;
+    }
 }
 
 int set_default_instrument(MidiSong *song, const char *name)
 {
-  load_instrument(song, name, &song->default_instrument, 0, -1, -1, -1, 0, 0, 0);
+  load_shared_instrument(song, name, &song->default_instrument, 0, -1, -1, -1, 0, 0, 0);
   if (!song->default_instrument)
     return -1;
   song->default_program = SPECIAL_PROGRAM;
   return 0;
 }
+
+int init_instrument_cache(void)
+{
+  if (!instrument_cache_lock)
+    instrument_cache_lock = SDL_CreateMutex();
+  return (instrument_cache_lock) ? 0 : -1;
+}
+
+void free_instrument_cache(void)
+{
+  CachedInstrument **link = &instrument_cache, *c;
+
+  if (!instrument_cache_lock) return;
+
+  SDL_LockMutex(instrument_cache_lock);
+  while ((c = *link) != NULL)
+    {
+      if (c->refcount <= 0)
+	free_cached_instrument(link);
+      else
+	{
+	  /* Still used by a song, gets freed with it */
+	  c->stale = 1;
+	  link = &c->next;
+	}
+    }
+  SDL_UnlockMutex(instrument_cache_lock);
+
+  if (!instrument_cache)
+    {
+      SDL_DestroyMutex(instrument_cache_lock);
+      instrument_cache_lock = NULL;
+    }
+}
@@ -29,9 +29,15 @@
 #define load_missing_instruments TIMI_NAMESPACE(load_missing_instruments)
 #define free_instruments TIMI_NAMESPACE(free_instruments)
 #define set_default_instrument TIMI_NAMESPACE(set_default_instrument)
+#define init_instrument_cache TIMI_NAMESPACE(init_instrument_cache)
+#define free_instrument_cache TIMI_NAMESPACE(free_instrument_cache)
 
 extern int load_missing_instruments(MidiSong *song);
 extern void free_instruments(MidiSong *song);
 extern int set_default_instrument(MidiSong *song, const char *name);
 
+/* Process-wide cache of decoded instruments, shared by all songs */
+extern int init_instrument_cache(void);
+extern void free_instrument_cache(void);
+
 #endif /* TIMIDITY_INSTRUM_H */
@@ -19,6 +19,10 @@
 #include "resample.h"
 #include "mix.h"
 
+#ifdef TIMIDITY_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 /* Returns 1 if envelope runs out */
 int recompute_envelope(MidiSong *song, int v)
 {
@@ -168,6 +172,135 @@ static int update_signal(MidiSong *song, int v)
 
 #define MIXATION(a)	*lp++ += (a)*s;
 
+/* Mixing of a run of samples with constant volumes. These are the hot
+   loops of the synth, with SSE2 they mix 8 samples at once. The volumes
+   fit into 16 bits, so the 16x16 bit products are exact. */
+#define FITS_SINT16(a) ((a) >= -32768 && (a) <= 32767)
+
+static void mix_run_mystery(const sample_t *sp, Sint32 *lp,
+			    final_volume_t left, final_volume_t right,
+			    int count)
+{
+  sample_t s;
+#ifdef TIMIDITY_USE_SSE2
+  if (FITS_SINT16(left) && FITS_SINT16(right))
+    {
+      const __m128i v = _mm_set_epi16((short)right, (short)left,
+				      (short)right, (short)left,
+				      (short)right, (short)left,
+				      (short)right, (short)left);
+      __m128i *d = (__m128i *)lp;
+      for (; count >= 8; count -= 8, sp += 8, d += 4)
+	{
+	  __m128i x = _mm_loadu_si128((const __m128i *)sp);
+	  __m128i a = _mm_unpacklo_epi16(x, x), b = _mm_unpackhi_epi16(x, x);
+	  __m128i alo = _mm_mullo_epi16(a, v), ahi = _mm_mulhi_epi16(a, v);
+	  __m128i blo = _mm_mullo_epi16(b, v), bhi = _mm_mulhi_epi16(b, v);
+	  _mm_storeu_si128(d, _mm_add_epi32(_mm_loadu_si128(d), _mm_unpacklo_epi16(alo, ahi)));
+	  _mm_storeu_si128(d + 1, _mm_add_epi32(_mm_loadu_si128(d + 1), _mm_unpackhi_epi16(alo, ahi)));
+	  _mm_storeu_si128(d + 2, _mm_add_epi32(_mm_loadu_si128(d + 2), _mm_unpacklo_epi16(blo, bhi)));
+	  _mm_storeu_si128(d + 3, _mm_add_epi32(_mm_loadu_si128(d + 3), _mm_unpackhi_epi16(blo, bhi)));
+	}
+      lp = (Sint32 *)d;
+    }
+#endif
+  while (count--)
+    {
+      s = *sp++;
+      MIXATION(left);
+      MIXATION(right);
+    }
+}
+
+static void mix_run_center(const sample_t *sp, Sint32 *lp,
+			   final_volume_t left, int count)
+{
+  sample_t s;
+#ifdef TIMIDITY_USE_SSE2
+  if (FITS_SINT16(left))
+    {
+      const __m128i v = _mm_set1_epi16((short)left);
+      __m128i *d = (__m128i *)lp;
+      for (; count >= 8; count -= 8, sp += 8, d += 4)
+	{
+	  __m128i x = _mm_loadu_si128((const __m128i *)sp);
+	  __m128i lo = _mm_mullo_epi16(x, v), hi = _mm_mulhi_epi16(x, v);
+	  __m128i a = _mm_unpacklo_epi16(lo, hi), b = _mm_unpackhi_epi16(lo, hi);
+	  _mm_storeu_si128(d, _mm_add_epi32(_mm_loadu_si128(d), _mm_unpacklo_epi32(a, a)));
+	  _mm_storeu_si128(d + 1, _mm_add_epi32(_mm_loadu_si128(d + 1), _mm_unpackhi_epi32(a, a)));
+	  _mm_storeu_si128(d + 2, _mm_add_epi32(_mm_loadu_si128(d + 2), _mm_unpacklo_epi32(b, b)));
+	  _mm_storeu_si128(d + 3, _mm_add_epi32(_mm_loadu_si128(d + 3), _mm_unpackhi_epi32(b, b)));
+	}
+      lp = (Sint32 *)d;
+    }
+#endif
+  while (count--)
+    {
+      s = *sp++;
+      MIXATION(left);
+      MIXATION(left);
+    }
+}
+
+static void mix_run_single(const sample_t *sp, Sint32 *lp,
+			   final_volume_t left, int count)
+{
+  sample_t s;
+#ifdef TIMIDITY_USE_SSE2
+  if (FITS_SINT16(left))
+    {
+      /* Adds zeros to the other channel. Keeps the last sample for the
+	 scalar loop: for the right channel the block ends there. */
+      const __m128i v = _mm_set1_epi16((short)left);
+      const __m128i z = _mm_setzero_si128();
+      __m128i *d = (__m128i *)lp;
+      for (; count > 8; count -= 8, sp += 8, d += 4)
+	{
+	  __m128i x = _mm_loadu_si128((const __m128i *)sp);
+	  __m128i lo = _mm_mullo_epi16(x, v), hi = _mm_mulhi_epi16(x, v);
+	  __m128i a = _mm_unpacklo_epi16(lo, hi), b = _mm_unpackhi_epi16(lo, hi);
+	  _mm_storeu_si128(d, _mm_add_epi32(_mm_loadu_si128(d), _mm_unpacklo_epi32(a, z)));
+	  _mm_storeu_si128(d + 1, _mm_add_epi32(_mm_loadu_si128(d + 1), _mm_unpackhi_epi32(a, z)));
+	  _mm_storeu_si128(d + 2, _mm_add_epi32(_mm_loadu_si128(d + 2), _mm_unpacklo_epi32(b, z)));
+	  _mm_storeu_si128(d + 3, _mm_add_epi32(_mm_loadu_si128(d + 3), _mm_unpackhi_epi32(b, z)));
+	}
+      lp = (Sint32 *)d;
+    }
+#endif
+  while (count--)
+    {
+      s = *sp++;
+      MIXATION(left);
+      lp++;
+    }
+}
+
+static void mix_run_mono(const sample_t *sp, Sint32 *lp,
+			 final_volume_t left, int count)
+{
+  sample_t s;
+#ifdef TIMIDITY_USE_SSE2
+  if (FITS_SINT16(left))
+    {
+      const __m128i v = _mm_set1_epi16((short)left);
+      __m128i *d = (__m128i *)lp;
+      for (; count >= 8; count -= 8, sp += 8, d += 2)
+	{
+	  __m128i x = _mm_loadu_si128((const __m128i *)sp);
+	  __m128i lo = _mm_mullo_epi16(x, v), hi = _mm_mulhi_epi16(x, v);
+	  _mm_storeu_si128(d, _mm_add_epi32(_mm_loadu_si128(d), _mm_unpacklo_epi16(lo, hi)));
+	  _mm_storeu_si128(d + 1, _mm_add_epi32(_mm_loadu_si128(d + 1), _mm_unpackhi_epi16(lo, hi)));
+	}
+      lp = (Sint32 *)d;
+    }
+#endif
+  while (count--)
+    {
+      s = *sp++;
+      MIXATION(left);
+    }
+}
+
 static void mix_mystery_signal(MidiSong *song, sample_t *sp, Sint32 *lp, int v,
 			       int count)
 {
@@ -176,7 +309,6 @@ static void mix_mystery_signal(MidiSong *song, sample_t *sp, Sint32 *lp, int v,
     left=vp->left_mix, 
     right=vp->right_mix;
   int cc;
-  sample_t s;
 
   if (!(cc = vp->control_counter))
     {
@@ -191,12 +323,9 @@ static void mix_mystery_signal(MidiSong *song, sample_t *sp, Sint32 *lp, int v,
     if (cc < count)
       {
 	count -= cc;
-	while (cc--)
-	  {
-	    s = *sp++;
-	    MIXATION(left);
-	    MIXATION(right);
-	  }
+	mix_run_mystery(sp, lp, left, right, cc);
+	sp += cc;
+	lp += cc * 2;
 	cc = song->control_ratio;
 	if (update_signal(song, v))
 	  return;	/* Envelope ran out */
@@ -206,12 +335,7 @@ static void mix_mystery_signal(MidiSong *song, sample_t *sp, Sint32 *lp, int v,
     else
       {
 	vp->control_counter = cc - count;
-	while (count--)
-	  {
-	    s = *sp++;
-	    MIXATION(left);
-	    MIXATION(right);
-	  }
+	mix_run_mystery(sp, lp, left, right, count);
 	return;
       }
 }
@@ -223,7 +347,6 @@ static void mix_center_signal(MidiSong *song, sample_t *sp, Sint32 *lp, int v,
   final_volume_t 
     left=vp->left_mix;
   int cc;
-  sample_t s;
 
   if (!(cc = vp->control_counter))
     {
@@ -237,12 +360,9 @@ static void mix_center_signal(MidiSong *song, sample_t *sp, Sint32 *lp, int v,
     if (cc < count)
       {
 	count -= cc;
-	while (cc--)
-	  {
-	    s = *sp++;
-	    MIXATION(left);
-	    MIXATION(left);
-	  }
+	mix_run_center(sp, lp, left, cc);
+	sp += cc;
+	lp += cc * 2;
 	cc = song->control_ratio;
 	if (update_signal(song, v))
 	  return;	/* Envelope ran out */
@@ -251,12 +371,7 @@ static void mix_center_signal(MidiSong *song, sample_t *sp, Sint32 *lp, int v,
     else
       {
 	vp->control_counter = cc - count;
-	while (count--)
-	  {
-	    s = *sp++;
-	    MIXATION(left);
-	    MIXATION(left);
-	  }
+	mix_run_center(sp, lp, left, count);
 	return;
       }
 }
@@ -268,7 +383,6 @@ static void mix_single_signal(MidiSong *song, sample_t *sp, Sint32 *lp, int v,
   final_volume_t 
     left=vp->left_mix;
   int cc;
-  sample_t s;
 
   if (!(cc = vp->control_counter))
     {
@@ -282,12 +396,9 @@ static void mix_single_signal(MidiSong *song, sample_t *sp, Sint32 *lp, int v,
     if (cc < count)
       {
 	count -= cc;
-	while (cc--)
-	  {
-	    s = *sp++;
-	    MIXATION(left);
-	    lp++;
-	  }
+	mix_run_single(sp, lp, left, cc);
+	sp += cc;
+	lp += cc * 2;
 	cc = song->control_ratio;
 	if (update_signal(song, v))
 	  return;	/* Envelope ran out */
@@ -296,12 +407,7 @@ static void mix_single_signal(MidiSong *song, sample_t *sp, Sint32 *lp, int v,
     else
       {
 	vp->control_counter = cc - count;
-	while (count--)
-	  {
-	    s = *sp++;
-	    MIXATION(left);
-	    lp++;
-	  }
+	mix_run_single(sp, lp, left, count);
 	return;
       }
 }
@@ -313,7 +419,6 @@ static void mix_mono_signal(MidiSong *song, sample_t *sp, Sint32 *lp, int v,
   final_volume_t 
     left=vp->left_mix;
   int cc;
-  sample_t s;
 
   if (!(cc = vp->control_counter))
     {
@@ -327,11 +432,9 @@ static void mix_mono_signal(MidiSong *song, sample_t *sp, Sint32 *lp, int v,
     if (cc < count)
       {
 	count -= cc;
-	while (cc--)
-	  {
-	    s = *sp++;
-	    MIXATION(left);
-	  }
+	mix_run_mono(sp, lp, left, cc);
+	sp += cc;
+	lp += cc;
 	cc = song->control_ratio;
 	if (update_signal(song, v))
 	  return;	/* Envelope ran out */
@@ -340,69 +443,29 @@ static void mix_mono_signal(MidiSong *song, sample_t *sp, Sint32 *lp, int v,
     else
       {
 	vp->control_counter = cc - count;
-	while (count--)
-	  {
-	    s = *sp++;
-	    MIXATION(left);
-	  }
+	mix_run_mono(sp, lp, left, count);
 	return;
       }
 }
 
 static void mix_mystery(MidiSong *song, sample_t *sp, Sint32 *lp, int v, int count)
 {
-  final_volume_t 
-    left = song->voice[v].left_mix, 
-    right = song->voice[v].right_mix;
-  sample_t s;
-
-  while (count--)
-    {
-      s = *sp++;
-      MIXATION(left);
-      MIXATION(right);
-    }
+  mix_run_mystery(sp, lp, song->voice[v].left_mix, song->voice[v].right_mix, count);
 }
 
 static void mix_center(MidiSong *song, sample_t *sp, Sint32 *lp, int v, int count)
 {
-  final_volume_t 
-    left = song->voice[v].left_mix;
-  sample_t s;
-
-  while (count--)
-    {
-      s = *sp++;
-      MIXATION(left);
-      MIXATION(left);
-    }
+  mix_run_center(sp, lp, song->voice[v].left_mix, count);
 }
 
 static void mix_single(MidiSong *song, sample_t *sp, Sint32 *lp, int v, int count)
 {
-  final_volume_t 
-    left = song->voice[v].left_mix;
-  sample_t s;
-
-  while (count--)
-    {
-      s = *sp++;
-      MIXATION(left);
-      lp++;
-    }
+  mix_run_single(sp, lp, song->voice[v].left_mix, count);
 }
 
 static void mix_mono(MidiSong *song, sample_t *sp, Sint32 *lp, int v, int count)
 {
-  final_volume_t 
-    left = song->voice[v].left_mix;
-  sample_t s;
-
-  while (count--)
-    {
-      s = *sp++;
-      MIXATION(left);
-    }
+  mix_run_mono(sp, lp, song->voice[v].left_mix, count);
 }
 
 /* Ramp a note out in c samples */
@@ -104,4 +104,9 @@
 #define PI 3.14159265358979323846
 #endif
 
+/* SSE2 versions of the mixing and output conversion loops */
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define TIMIDITY_USE_SSE2
+#endif
+
 #endif /* TIMIDITY_OPTIONS_H */
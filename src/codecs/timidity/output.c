@@ -15,6 +15,22 @@
 #include "options.h"
 #include "output.h"
 
+#ifdef TIMIDITY_USE_SSE2
+#include <emmintrin.h>
+
+/* Eight samples shifted down and saturated to 16 bits */
+#define PACK8_S16(lp, shift) \
+  _mm_packs_epi32(_mm_srai_epi32(_mm_loadu_si128((const __m128i *)(lp)), (shift)), \
+		  _mm_srai_epi32(_mm_loadu_si128((const __m128i *)((lp) + 4)), (shift)))
+
+/* Sixteen samples shifted down and saturated to 8 bits */
+#define PACK16_S8(lp) \
+  _mm_packs_epi16(PACK8_S16((lp), 32-8-GUARD_BITS), \
+		  PACK8_S16((lp) + 8, 32-8-GUARD_BITS))
+
+#define SWAP16_X8(v) _mm_or_si128(_mm_slli_epi16((v), 8), _mm_srli_epi16((v), 8))
+#endif
+
 /*****************************************************************/
 /* Some functions to convert signed 32-bit data to other formats */
 
@@ -22,6 +38,10 @@ void timi_s32tos8(void *dp, Sint32 *lp, Sint32 c)
 {
   Sint8 *cp=(Sint8 *)(dp);
   Sint32 l;
+#ifdef TIMIDITY_USE_SSE2
+  for (; c >= 16; c -= 16, lp += 16, cp += 16)
+    _mm_storeu_si128((__m128i *)cp, PACK16_S8(lp));
+#endif
   while (c--)
     {
       l=(*lp++)>>(32-8-GUARD_BITS);
@@ -35,6 +55,11 @@ void timi_s32tou8(void *dp, Sint32 *lp, Sint32 c)
 {
   Uint8 *cp=(Uint8 *)(dp);
   Sint32 l;
+#ifdef TIMIDITY_USE_SSE2
+  const __m128i sign = _mm_set1_epi8((char)0x80);
+  for (; c >= 16; c -= 16, lp += 16, cp += 16)
+    _mm_storeu_si128((__m128i *)cp, _mm_xor_si128(PACK16_S8(lp), sign));
+#endif
   while (c--)
     {
       l=(*lp++)>>(32-8-GUARD_BITS);
@@ -48,6 +73,10 @@ void timi_s32tos16(void *dp, Sint32 *lp, Sint32 c)
 {
   Sint16 *sp=(Sint16 *)(dp);
   Sint32 l;
+#ifdef TIMIDITY_USE_SSE2
+  for (; c >= 8; c -= 8, lp += 8, sp += 8)
+    _mm_storeu_si128((__m128i *)sp, PACK8_S16(lp, 32-16-GUARD_BITS));
+#endif
   while (c--)
     {
       l=(*lp++)>>(32-16-GUARD_BITS);
@@ -61,6 +90,11 @@ void timi_s32tou16(void *dp, Sint32 *lp, Sint32 c)
 {
   Uint16 *sp=(Uint16 *)(dp);
   Sint32 l;
+#ifdef TIMIDITY_USE_SSE2
+  const __m128i sign = _mm_set1_epi16((short)0x8000);
+  for (; c >= 8; c -= 8, lp += 8, sp += 8)
+    _mm_storeu_si128((__m128i *)sp, _mm_xor_si128(PACK8_S16(lp, 32-16-GUARD_BITS), sign));
+#endif
   while (c--)
     {
       l=(*lp++)>>(32-16-GUARD_BITS);
@@ -74,6 +108,13 @@ void timi_s32tos16x(void *dp, Sint32 *lp, Sint32 c)
 {
   Sint16 *sp=(Sint16 *)(dp);
   Sint32 l;
+#ifdef TIMIDITY_USE_SSE2
+  for (; c >= 8; c -= 8, lp += 8, sp += 8)
+    {
+      __m128i v = PACK8_S16(lp, 32-16-GUARD_BITS);
+      _mm_storeu_si128((__m128i *)sp, SWAP16_X8(v));
+    }
+#endif
   while (c--)
     {
       l=(*lp++)>>(32-16-GUARD_BITS);
@@ -87,6 +128,14 @@ void timi_s32tou16x(void *dp, Sint32 *lp, Sint32 c)
 {
   Uint16 *sp=(Uint16 *)(dp);
   Sint32 l;
+#ifdef TIMIDITY_USE_SSE2
+  const __m128i sign = _mm_set1_epi16((short)0x8000);
+  for (; c >= 8; c -= 8, lp += 8, sp += 8)
+    {
+      __m128i v = _mm_xor_si128(PACK8_S16(lp, 32-16-GUARD_BITS), sign);
+      _mm_storeu_si128((__m128i *)sp, SWAP16_X8(v));
+    }
+#endif
   while (c--)
     {
       l=(*lp++)>>(32-16-GUARD_BITS);
@@ -99,6 +148,11 @@ void timi_s32tou16x(void *dp, Sint32 *lp, Sint32 c)
 void timi_s32tof32(void *dp, Sint32 *lp, Sint32 c)
 {
   float *sp=(float *)(dp);
+#ifdef TIMIDITY_USE_SSE2
+  const __m128 scale = _mm_set1_ps(2147483647.0f);
+  for (; c >= 4; c -= 4, lp += 4, sp += 4)
+    _mm_storeu_ps(sp, _mm_div_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)lp)), scale));
+#endif
   while (c--)
     {
       *sp++ = (float)(*lp++) / 2147483647.0f;
@@ -107,11 +161,7 @@ void timi_s32tof32(void *dp, Sint32 *lp, Sint32 c)
 
 void timi_s32tos32(void *dp, Sint32 *lp, Sint32 c)
 {
-  Sint32 *sp=(Sint32 *)(dp);
-  while (c--)
-    {
-      *sp++ = (*lp++);
-    }
+  SDL_memcpy(dp, lp, c * sizeof(Sint32));
 }
 
 void timi_s32tos32x(void *dp, Sint32 *lp, Sint32 c)
@@ -29,6 +29,65 @@ static void reset_voices(MidiSong *song)
   int i;
   for (i=0; i<MAX_VOICES; i++)
     song->voice[i].status=VOICE_FREE;
+  for (i=0; i<MAX_VOICES/32; i++)
+    song->free_voices[i]=0xFFFFFFFF;
+  song->active_voices=0;
+}
+
+/* Move the voices which went free from the active list to the free set */
+static void collect_voices(MidiSong *song)
+{
+  int i, j, v;
+  for (i=j=0; i<song->active_voices; i++)
+    {
+      v=song->active_voice[i];
+      if (song->voice[v].status==VOICE_FREE)
+	song->free_voices[v>>5] |= (Uint32)1 << (v & 31);
+      else
+	song->active_voice[j++]=v;
+    }
+  song->active_voices=j;
+}
+
+/* Take the free voice with the lowest number, as the voices keep some of
+   their state between the notes. Returns -1 when all the voices are in
+   use. */
+static int alloc_voice(MidiSong *song)
+{
+  static const Uint8 debruijn[32] = {
+    0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+    31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+  };
+  Uint32 m;
+  int i, v;
+
+  /* Voices can also go free on the events */
+  collect_voices(song);
+  if (song->active_voices >= song->voices)
+    return -1;
+
+  for (i=0; i<MAX_VOICES/32; i++)
+    if ((m = song->free_voices[i]) != 0)
+      {
+	v = (i<<5) + debruijn[((m & (~m + 1)) * 0x077CB531U) >> 27];
+	song->free_voices[i] &= ~((Uint32)1 << (v & 31));
+	song->active_voice[song->active_voices++]=v;
+	return v;
+      }
+  return -1;
+}
+
+/* Voices are stolen from the dying notes first, then from the released,
+   the sustained and at last from the playing ones */
+static int steal_priority(int status)
+{
+  switch (status)
+    {
+    case VOICE_DIE: return 0;
+    case VOICE_OFF: return 1;
+    case VOICE_SUSTAINED: return 2;
+    default: return 3;
+    }
 }
 
 /* Process the Reset All Controllers event */
@@ -309,42 +368,41 @@ static void kill_note(MidiSong *song, int i)
 /* Only one instance of a note can be playing on a single channel. */
 static void note_on(MidiSong *song)
 {
-  int i = song->voices, lowest=-1;
-  Sint32 lv=0x7FFFFFFF, v;
+  int i, v, p, lowest=-1, lp=0;
+  Sint32 lv=0x7FFFFFFF, vol;
   MidiEvent *e = song->current_event;
 
-  while (i--)
+  for (i = 0; i < song->active_voices; i++)
     {
-      if (song->voice[i].status == VOICE_FREE)
-	lowest=i; /* Can't get a lower volume than silence */
-      else if (song->voice[i].channel==e->channel && 
-	       (song->voice[i].note==e->a || song->channel[song->voice[i].channel].mono))
-	kill_note(song, i);
+      v = song->active_voice[i];
+      if (song->voice[v].status != VOICE_FREE &&
+	  song->voice[v].channel==e->channel &&
+	  (song->voice[v].note==e->a || song->channel[song->voice[v].channel].mono))
+	kill_note(song, v);
     }
 
-  if (lowest != -1)
+  v = alloc_voice(song);
+  if (v != -1)
     {
       /* Found a free voice. */
-      start_note(song,e,lowest);
+      start_note(song,e,v);
       return;
     }
 
-  /* Look for the decaying note with the lowest volume */
-  i = song->voices;
-  while (i--)
+  /* Look for the quietest note among the ones of the lowest priority */
+  for (i = 0; i < song->active_voices; i++)
     {
-      if ((song->voice[i].status != VOICE_ON) &&
-	  (song->voice[i].status != VOICE_DIE))
+      v = song->active_voice[i];
+      p = steal_priority(song->voice[v].status);
+      vol = song->voice[v].left_mix;
+      if ((song->voice[v].panned == PANNED_MYSTERY)
+	  && (song->voice[v].right_mix > vol))
+	vol = song->voice[v].right_mix;
+      if (lowest == -1 || p < lp || (p == lp && vol < lv))
 	{
-	  v = song->voice[i].left_mix;
-	  if ((song->voice[i].panned == PANNED_MYSTERY)
-	      && (song->voice[i].right_mix > v))
-	    v = song->voice[i].right_mix;
-	  if (v<lv)
-	    {
-	      lv=v;
-	      lowest=i;
-	    }
+	  lowest=v;
+	  lp=p;
+	  lv=vol;
 	}
     }
 
@@ -384,108 +442,129 @@ static void finish_note(MidiSong *song, int i)
 
 static void note_off(MidiSong *song)
 {
-  int i = song->voices;
+  int i, j = song->active_voices;
   MidiEvent *e = song->current_event;
 
-  while (i--)
-    if (song->voice[i].status == VOICE_ON &&
-	song->voice[i].channel == e->channel &&
-	song->voice[i].note == e->a)
-      {
-	if (song->channel[e->channel].sustain)
-	  {
-	    song->voice[i].status = VOICE_SUSTAINED;
-	  }
-	else
-	  finish_note(song, i);
-	return;
-      }
+  while (j--)
+    {
+      i = song->active_voice[j];
+      if (song->voice[i].status == VOICE_ON &&
+	  song->voice[i].channel == e->channel &&
+	  song->voice[i].note == e->a)
+	{
+	  if (song->channel[e->channel].sustain)
+	    {
+	      song->voice[i].status = VOICE_SUSTAINED;
+	    }
+	  else
+	    finish_note(song, i);
+	  return;
+	}
+    }
 }
 
 /* Process the All Notes Off event */
 static void all_notes_off(MidiSong *song)
 {
-  int i = song->voices;
+  int i, j = song->active_voices;
   int c = song->current_event->channel;
 
   SNDDBG(("All notes off on channel %d", c));
-  while (i--)
-    if (song->voice[i].status == VOICE_ON &&
-	song->voice[i].channel == c)
-      {
-	if (song->channel[c].sustain) 
-	  song->voice[i].status = VOICE_SUSTAINED;
-	else
-	  finish_note(song, i);
-      }
+  while (j--)
+    {
+      i = song->active_voice[j];
+      if (song->voice[i].status == VOICE_ON &&
+	  song->voice[i].channel == c)
+	{
+	  if (song->channel[c].sustain) 
+	    song->voice[i].status = VOICE_SUSTAINED;
+	  else
+	    finish_note(song, i);
+	}
+    }
 }
 
 /* Process the All Sounds Off event */
 static void all_sounds_off(MidiSong *song)
 {
-  int i = song->voices;
+  int i, j = song->active_voices;
   int c = song->current_event->channel;
 
-  while (i--)
-    if (song->voice[i].channel == c && 
-	song->voice[i].status != VOICE_FREE &&
-	song->voice[i].status != VOICE_DIE)
-      {
-	kill_note(song, i);
-      }
+  while (j--)
+    {
+      i = song->active_voice[j];
+      if (song->voice[i].channel == c && 
+	  song->voice[i].status != VOICE_FREE &&
+	  song->voice[i].status != VOICE_DIE)
+	{
+	  kill_note(song, i);
+	}
+    }
 }
 
 static void adjust_pressure(MidiSong *song)
 {
   MidiEvent *e = song->current_event;
-  int i = song->voices;
+  int i, j = song->active_voices;
 
-  while (i--)
-    if (song->voice[i].status == VOICE_ON &&
-	song->voice[i].channel == e->channel &&
-	song->voice[i].note == e->a)
-      {
-	song->voice[i].velocity = e->b;
-	recompute_amp(song, i);
-	apply_envelope_to_amp(song, i);
-	return;
-      }
+  while (j--)
+    {
+      i = song->active_voice[j];
+      if (song->voice[i].status == VOICE_ON &&
+	  song->voice[i].channel == e->channel &&
+	  song->voice[i].note == e->a)
+	{
+	  song->voice[i].velocity = e->b;
+	  recompute_amp(song, i);
+	  apply_envelope_to_amp(song, i);
+	  return;
+	}
+    }
 }
 
 static void drop_sustain(MidiSong *song)
 {
-  int i = song->voices;
+  int i, j = song->active_voices;
   int c = song->current_event->channel;
 
-  while (i--)
-    if (song->voice[i].status == VOICE_SUSTAINED && song->voice[i].channel == c)
-      finish_note(song, i);
+  while (j--)
+    {
+      i = song->active_voice[j];
+      if (song->voice[i].status == VOICE_SUSTAINED && song->voice[i].channel == c)
+	finish_note(song, i);
+    }
 }
 
 static void adjust_pitchbend(MidiSong *song)
 {
   int c = song->current_event->channel;
-  int i = song->voices;
+  int i, j = song->active_voices;
 
-  while (i--)
-    if (song->voice[i].status != VOICE_FREE && song->voice[i].channel == c)
-      {
-	recompute_freq(song, i);
-      }
+  while (j--)
+    {
+      i = song->active_voice[j];
+      if (song->voice[i].status != VOICE_FREE && song->voice[i].channel == c)
+	{
+	  recompute_freq(song, i);
+	}
+    }
 }
 
 static void adjust_volume(MidiSong *song)
 {
   int c = song->current_event->channel;
-  int i = song->voices;
+  int i, j = song->active_voices;
 
-  while (i--)
-    if (song->voice[i].channel == c &&
-	(song->voice[i].status==VOICE_ON || song->voice[i].status==VOICE_SUSTAINED))
-      {
-	recompute_amp(song, i);
-	apply_envelope_to_amp(song, i);
-      }
+  while (j--)
+    {
+      i = song->active_voice[j];
+      if (song->voice[i].channel == c &&
+	  (song->voice[i].status==VOICE_ON || song->voice[i].status==VOICE_SUSTAINED))
+	{
+	  recompute_amp(song, i);
+	  apply_envelope_to_amp(song, i);
+	}
+    }
 }
 
 static void seek_forward(MidiSong *song, Sint32 until_time)
@@ -576,14 +655,16 @@ static void skip_to(MidiSong *song, Sint32 until_time)
 
 static void do_compute_data(MidiSong *song, Sint32 count)
 {
-  int i;
+  int i, v;
   SDL_memset(song->buffer_pointer, 0, 
 	 (song->encoding & PE_MONO) ? (count * 4) : (count * 8));
-  for (i = 0; i < song->voices; i++)
+  for (i = 0; i < song->active_voices; i++)
     {
-      if(song->voice[i].status != VOICE_FREE)
-	mix_voice(song, song->buffer_pointer, i, count);
+      v = song->active_voice[i];
+      if(song->voice[v].status != VOICE_FREE)
+	mix_voice(song, song->buffer_pointer, v, count);
     }
+  collect_voices(song);
   song->current_sample += count;
 }
 
@@ -782,9 +863,27 @@ int Timidity_PlaySome(MidiSong *song, void *stream, Sint32 len)
   return samples * bytes_per_sample;
 }
 
+void Timidity_SetPolyphony(MidiSong *song, int voices)
+{
+  if (voices < 1)
+    song->voices = DEFAULT_VOICES;
+  else if (voices > MAX_VOICES)
+    song->voices = MAX_VOICES;
+  else
+    song->voices = voices;
+}
+
+void Timidity_SetInterpolation(MidiSong *song, int interpolation)
+{
+  if (interpolation == TIMI_INTERP_CUBIC || interpolation == TIMI_INTERP_SINC)
+    song->interpolation = interpolation;
+  else
+    song->interpolation = TIMI_INTERP_LINEAR;
+}
+
 void Timidity_SetVolume(MidiSong *song, int volume)
 {
-  int i;
+  int i, j;
   if (volume > MAX_AMPLIFICATION)
     song->amplification = MAX_AMPLIFICATION;
   else
@@ -793,10 +892,13 @@ void Timidity_SetVolume(MidiSong *song, int volume)
   else
     song->amplification = volume;
   adjust_amplification(song);
-  for (i = 0; i < song->voices; i++)
-    if (song->voice[i].status != VOICE_FREE)
-      {
-	recompute_amp(song, i);
-	apply_envelope_to_amp(song, i);
-      }
+  for (j = 0; j < song->active_voices; j++)
+    {
+      i = song->active_voice[j];
+      if (song->voice[i].status != VOICE_FREE)
+	{
+	  recompute_amp(song, i);
+	  apply_envelope_to_amp(song, i);
+	}
+    }
 }
@@ -15,6 +15,22 @@
 #include "playmidi.h"
 #include "readmidi.h"
 
+/* State of the reader of one MIDI file. Every load has its own one, so
+   several songs can be loaded at the same time. */
+typedef struct {
+  MidiSong *song;
+  SDL_RWops *rw;
+  Sint32 at;
+  Uint8 laststatus, lastchan;
+  Uint8 nrpn, rpn_msb[16], rpn_lsb[16]; /* one per channel */
+  /* All events read so far, sorted by time */
+  MidiEvent *events;
+  Sint32 event_count, events_size;
+  /* Events of the track being read */
+  MidiEvent *track;
+  Sint32 track_count, track_size;
+} MidiReader;
+
 /* Computes how many (fractional) samples one MIDI delta-time unit contains */
 static void compute_sample_increment(MidiSong *song, Sint32 tempo,
 				     Sint32 divisions)
@@ -77,69 +93,61 @@ static int dumpstring(SDL_RWops *rw, Sint32 len, Uint8 type)
 #endif
 
 #define MIDIEVENT(at,t,ch,pa,pb)				\
-  newlist = (MidiEventList *) SDL_malloc(sizeof(MidiEventList));\
-  if (!newlist) {song->oom = 1; return NULL;}			\
-  newlist->event.time = at;					\
-  newlist->event.type = t;					\
-  newlist->event.channel = ch;					\
-  newlist->event.a = pa;					\
-  newlist->event.b = pb;					\
-  newlist->next = NULL;						\
-  return newlist;
-
-#define MAGIC_EOT ((MidiEventList *)(-1))
-
-/* Read a MIDI event, returning a freshly allocated element that can
-   be linked to the event list */
-static MidiEventList *read_midi_event(MidiSong *song)
+  ev->time = at;						\
+  ev->type = t;							\
+  ev->channel = ch;						\
+  ev->a = pa;							\
+  ev->b = pb;							\
+  return 1;
+
+/* Read a MIDI event into ev. Returns 1 for an event, 0 at the end of
+   the track and -1 on error. */
+static int read_midi_event(MidiReader *r, MidiEvent *ev)
 {
-  static Uint8 laststatus, lastchan;
-  static Uint8 nrpn=0, rpn_msb[16], rpn_lsb[16]; /* one per channel */
   Uint8 me, type, a,b,c;
   Sint32 len;
-  MidiEventList *newlist;
 
   for (;;)
     {
-      song->at += getvl(song->rw);
-      if (SDL_RWread(song->rw, &me, 1, 1) != 1)
+      r->at += getvl(r->rw);
+      if (SDL_RWread(r->rw, &me, 1, 1) != 1)
 	{
 	  SNDDBG(("read_midi_event: SDL_RWread() failure\n"));
-	  return NULL;
+	  return -1;
 	}
 
       if(me==0xF0 || me == 0xF7) /* SysEx event */
 	{
-	  len=getvl(song->rw);
-	  SDL_RWseek(song->rw, len, RW_SEEK_CUR);
+	  len=getvl(r->rw);
+	  SDL_RWseek(r->rw, len, RW_SEEK_CUR);
 	}
       else if(me==0xFF) /* Meta event */
 	{
-	  SDL_RWread(song->rw, &type, 1, 1);
-	  len=getvl(song->rw);
+	  SDL_RWread(r->rw, &type, 1, 1);
+	  len=getvl(r->rw);
 	  if (type>0 && type<16)
 	    {
 	      #if (defined DEBUG_CHATTER)
-	      dumpstring(song->rw, len, type);
+	      dumpstring(r->rw, len, type);
 	      #else
-	      SDL_RWseek(song->rw, len, RW_SEEK_CUR);
+	      SDL_RWseek(r->rw, len, RW_SEEK_CUR);
 	      #endif
 	    }
 	  else
 	    switch(type)
 	      {
 	      case 0x2F: /* End of Track */
-		return MAGIC_EOT;
+		return 0;
 
 	      case 0x51: /* Tempo */
-		SDL_RWread(song->rw, &a, 1, 1);
-		SDL_RWread(song->rw, &b, 1, 1);
-		SDL_RWread(song->rw, &c, 1, 1);
-		MIDIEVENT(song->at, ME_TEMPO, c, a, b);
+		SDL_RWread(r->rw, &a, 1, 1);
+		SDL_RWread(r->rw, &b, 1, 1);
+		SDL_RWread(r->rw, &c, 1, 1);
+		MIDIEVENT(r->at, ME_TEMPO, c, a, b);
 
 	      default:
 		SNDDBG(("(Meta event type 0x%02x, length %d)\n", type, len));
-		SDL_RWseek(song->rw, len, RW_SEEK_CUR);
+		SDL_RWseek(r->rw, len, RW_SEEK_CUR);
 		break;
 	      }
 	}
@@ -148,30 +156,30 @@ static MidiEventList *read_midi_event(MidiSong *song)
 	  a=me;
 	  if (a & 0x80) /* status byte */
 	    {
-	      lastchan=a & 0x0F;
-	      laststatus=(a>>4) & 0x07;
-	      SDL_RWread(song->rw, &a, 1, 1);
+	      r->lastchan=a & 0x0F;
+	      r->laststatus=(a>>4) & 0x07;
+	      SDL_RWread(r->rw, &a, 1, 1);
 	      a &= 0x7F;
 	    }
-	  switch(laststatus)
+	  switch(r->laststatus)
 	    {
 	    case 0: /* Note off */
-	      SDL_RWread(song->rw, &b, 1, 1);
+	      SDL_RWread(r->rw, &b, 1, 1);
 	      b &= 0x7F;
-	      MIDIEVENT(song->at, ME_NOTEOFF, lastchan, a,b);
+	      MIDIEVENT(r->at, ME_NOTEOFF, r->lastchan, a,b);
 
 	    case 1: /* Note on */
-	      SDL_RWread(song->rw, &b, 1, 1);
+	      SDL_RWread(r->rw, &b, 1, 1);
 	      b &= 0x7F;
-	      MIDIEVENT(song->at, ME_NOTEON, lastchan, a,b);
+	      MIDIEVENT(r->at, ME_NOTEON, r->lastchan, a,b);
 
 	    case 2: /* Key Pressure */
-	      SDL_RWread(song->rw, &b, 1, 1);
+	      SDL_RWread(r->rw, &b, 1, 1);
 	      b &= 0x7F;
-	      MIDIEVENT(song->at, ME_KEYPRESSURE, lastchan, a, b);
+	      MIDIEVENT(r->at, ME_KEYPRESSURE, r->lastchan, a, b);
 
 	    case 3: /* Control change */
-	      SDL_RWread(song->rw, &b, 1, 1);
+	      SDL_RWread(r->rw, &b, 1, 1);
 	      b &= 0x7F;
 	      {
 		int control=255;
@@ -202,20 +210,20 @@ static MidiEventList *read_midi_event(MidiSong *song)
 #endif
 		    break;
 
-		  case 100: nrpn=0; rpn_msb[lastchan]=b; break;
-		  case 101: nrpn=0; rpn_lsb[lastchan]=b; break;
-		  case 99: nrpn=1; rpn_msb[lastchan]=b; break;
-		  case 98: nrpn=1; rpn_lsb[lastchan]=b; break;
+		  case 100: r->nrpn=0; r->rpn_msb[r->lastchan]=b; break;
+		  case 101: r->nrpn=0; r->rpn_lsb[r->lastchan]=b; break;
+		  case 99: r->nrpn=1; r->rpn_msb[r->lastchan]=b; break;
+		  case 98: r->nrpn=1; r->rpn_lsb[r->lastchan]=b; break;
 
 		  case 6:
-		    if (nrpn)
+		    if (r->nrpn)
 		      {
 			SNDDBG(("(Data entry (MSB) for NRPN %02x,%02x: %d)\n",
-				rpn_msb[lastchan], rpn_lsb[lastchan], b));
+				r->rpn_msb[r->lastchan], r->rpn_lsb[r->lastchan], b));
 			break;
 		      }
 
-		    switch((rpn_msb[lastchan]<<8) | rpn_lsb[lastchan])
+		    switch((r->rpn_msb[r->lastchan]<<8) | r->rpn_lsb[r->lastchan])
 		      {
 		      case 0x0000: /* Pitch bend sensitivity */
 			control=ME_PITCH_SENS;
@@ -223,11 +231,11 @@ static MidiEventList *read_midi_event(MidiSong *song)
 
 		      case 0x7F7F: /* RPN reset */
 			/* reset pitch bend sensitivity to 2 */
-			MIDIEVENT(song->at, ME_PITCH_SENS, lastchan, 2, 0);
+			MIDIEVENT(r->at, ME_PITCH_SENS, r->lastchan, 2, 0);
 
 		      default:
 			SNDDBG(("(Data entry (MSB) for RPN %02x,%02x: %d)\n",
-				rpn_msb[lastchan], rpn_lsb[lastchan], b));
+				r->rpn_msb[r->lastchan], r->rpn_lsb[r->lastchan], b));
 			break;
 		      }
 		    break;
@@ -238,124 +246,163 @@ static MidiEventList *read_midi_event(MidiSong *song)
 		  }
 		if (control != 255)
 		  {
-		    MIDIEVENT(song->at, control, lastchan, b, 0); 
+		    MIDIEVENT(r->at, control, r->lastchan, b, 0); 
 		  }
 	      }
 	      break;
 
 	    case 4: /* Program change */
 	      a &= 0x7f;
-	      MIDIEVENT(song->at, ME_PROGRAM, lastchan, a, 0);
+	      MIDIEVENT(r->at, ME_PROGRAM, r->lastchan, a, 0);
 
 	    case 5: /* Channel pressure - NOT IMPLEMENTED */
 	      break;
 
 	    case 6: /* Pitch wheel */
-	      SDL_RWread(song->rw, &b, 1, 1);
+	      SDL_RWread(r->rw, &b, 1, 1);
 	      b &= 0x7F;
-	      MIDIEVENT(song->at, ME_PITCHWHEEL, lastchan, a, b);
+	      MIDIEVENT(r->at, ME_PITCHWHEEL, r->lastchan, a, b);
 
 	    default:
 	      SNDDBG(("*** Can't happen: status 0x%02X, channel 0x%02X\n",
-		      laststatus, lastchan));
+		      r->laststatus, r->lastchan));
 	      break;
 	    }
 	}
     }
 
-  return newlist;
+  return -1;
 }
 
 #undef MIDIEVENT
 
-/* Read a midi track into the linked list, either merging with any previous
-   tracks or appending to them. */
-static int read_track(MidiSong *song, int append)
+/* Make room for count events in the list, growing it by a half */
+static int reserve_events(MidiSong *song, MidiEvent **list, Sint32 *size,
+			  Sint32 count)
+{
+  MidiEvent *p;
+  Sint32 n;
+
+  if (count <= *size)
+    return 0;
+
+  n = *size ? *size : 256;
+  while (n < count)
+    n += n / 2;
+  p = (MidiEvent *) SDL_realloc(*list, n * sizeof(MidiEvent));
+  if (!p)
+    {
+      song->oom = 1;
+      return -1;
+    }
+  *list = p;
+  *size = n;
+  return 0;
+}
+
+/* Merge the events of the track into the list of all events. At the
+   same time, the new events go before the ones of the previous tracks,
+   or after all of them when appending. The do-nothing event stays first. */
+static int merge_track(MidiReader *r, int append)
+{
+  Sint32 i, j, k;
+
+  if (reserve_events(r->song, &r->events, &r->events_size,
+		     r->event_count + r->track_count))
+    return -1;
+
+  if (append)
+    SDL_memcpy(r->events + r->event_count, r->track,
+	       r->track_count * sizeof(MidiEvent));
+  else
+    {
+      i = r->event_count - 1;
+      j = r->track_count - 1;
+      k = i + j + 1;
+      while (j >= 0)
+	{
+	  if (i >= 1 && r->events[i].time >= r->track[j].time)
+	    r->events[k--] = r->events[i--];
+	  else
+	    r->events[k--] = r->track[j--];
+	}
+    }
+
+  r->event_count += r->track_count;
+  return 0;
+}
+
+/* Read a midi track, either merging it with any previous tracks or
+   appending it to them. */
+static int read_track(MidiReader *r, int append)
 {
-  MidiEventList *meep;
-  MidiEventList *next, *newlist;
   Sint32 len;
   Sint64 next_pos, pos;
   char tmp[4];
+  int rc;
 
-  meep = song->evlist;
-  if (append && meep)
-    {
-      /* find the last event in the list */
-      for (; meep->next; meep=meep->next)
-	;
-      song->at = meep->event.time;
-    }
+  if (append)
+    r->at = r->events[r->event_count - 1].time;
   else
-    song->at=0;
+    r->at=0;
 
   /* Check the formalities */
-  if (SDL_RWread(song->rw, tmp, 1, 4) != 4 || SDL_RWread(song->rw, &len, 4, 1) != 1)
+  if (SDL_RWread(r->rw, tmp, 1, 4) != 4 || SDL_RWread(r->rw, &len, 4, 1) != 1)
     {
       SNDDBG(("Can't read track header.\n"));
       return -1;
     }
   len=(Sint32)SDL_SwapBE32((Uint32)len);
-  next_pos = SDL_RWtell(song->rw) + len;
+  next_pos = SDL_RWtell(r->rw) + len;
   if (SDL_memcmp(tmp, "MTrk", 4))
     {
       SNDDBG(("Corrupt MIDI file.\n"));
       return -2;
     }
 
+  r->track_count = 0;
   for (;;)
     {
-      if (!(newlist=read_midi_event(song))) /* Some kind of error  */
+      if (reserve_events(r->song, &r->track, &r->track_size, r->track_count + 1))
+	return -2;
+
+      rc = read_midi_event(r, &r->track[r->track_count]);
+      if (rc < 0) /* Some kind of error  */
 	return -2;
 
-      if (newlist==MAGIC_EOT) /* End-of-track Hack. */
+      if (rc == 0) /* End of track */
 	{
 	/* If the track ends before the size of the
 	 * track data, skip any junk at the end.  */
-	  pos = SDL_RWtell(song->rw);
+	  pos = SDL_RWtell(r->rw);
 	  if (pos < next_pos)
-	    SDL_RWseek(song->rw, next_pos - pos, RW_SEEK_CUR);
-	  return 0;
+	    SDL_RWseek(r->rw, next_pos - pos, RW_SEEK_CUR);
+	  return merge_track(r, append) ? -2 : 0;
 	}
 
-      next=meep->next;
-      while (next && (next->event.time < newlist->event.time))
-	{
-	  meep=next;
-	  next=meep->next;
-	}
-
-      newlist->next=next;
-      meep->next=newlist;
-
-      song->event_count++; /* Count the event. (About one?) */
-      meep=newlist;
+      r->track_count++;
     }
 }
 
-/* Free the linked event list from memory. */
-static void free_midi_list(MidiSong *song)
+/* Free the event lists of the reader. */
+static void free_midi_list(MidiReader *r)
 {
-  MidiEventList *meep, *next;
-  meep = song->evlist;
-  while (meep)
-    {
-      next=meep->next;
-      SDL_free(meep);
-      meep=next;
-    }
-  song->evlist = NULL;
+  SDL_free(r->events);
+  SDL_free(r->track);
+  r->events = r->track = NULL;
+  r->event_count = r->events_size = 0;
+  r->track_count = r->track_size = 0;
 }
 
-/* Allocate an array of MidiEvents and fill it from the linked list of
-   events, marking used instruments for loading. Convert event times to
-   samples: handle tempo changes. Strip unnecessary events from the list.
-   Free the linked list. */
-static MidiEvent *groom_list(MidiSong *song, Sint32 divisions,Sint32 *eventsp,
+/* Groom the list of events in place, marking used instruments for
+   loading. Convert event times to samples: handle tempo changes. Strip
+   unnecessary events from the list. The list is handed over to the
+   caller. */
+static MidiEvent *groom_list(MidiReader *r, Sint32 divisions,Sint32 *eventsp,
 			     Sint32 *samplesp)
 {
-  MidiEvent *groomed_list, *lp;
-  MidiEventList *meep;
+  MidiSong *song = r->song;
+  MidiEvent *groomed_list, *lp, *meep;
   Sint32 i, our_event_count, tempo, skip_this_event, new_value;
   Sint32 sample_cum, samples_to_do, at, st, dt, counting_time;
 
@@ -372,52 +419,51 @@ static MidiEvent *groom_list(MidiSong *song, Sint32 divisions,Sint32 *eventsp,
   tempo=500000;
   compute_sample_increment(song, tempo, divisions);
 
-  /* This may allocate a bit more than we need */
-  groomed_list=lp=SDL_malloc(sizeof(MidiEvent) * (song->event_count+1));
-  if (!groomed_list) {
-    song->oom=1;
-    free_midi_list(song);
+  /* The groomed events never get ahead of the read ones, only the
+     End-of-Track event needs one more */
+  if (reserve_events(song, &r->events, &r->events_size, r->event_count+1)) {
+    free_midi_list(r);
     return NULL;
   }
-  meep=song->evlist;
+  groomed_list=lp=meep=r->events;
 
   our_event_count=0;
   st=at=sample_cum=0;
   counting_time=2; /* We strip any silence before the first NOTE ON. */
 
-  for (i = 0; i < song->event_count; i++)
+  for (i = 0; i < r->event_count; i++)
     {
       skip_this_event=0;
 
-      if (meep->event.type==ME_TEMPO)
+      if (meep->type==ME_TEMPO)
 	{
 	  skip_this_event=1;
 	}
-      else if (meep->event.channel >= MAXCHAN)
+      else if (meep->channel >= MAXCHAN)
         skip_this_event=1;
-      else switch (meep->event.type)
+      else switch (meep->type)
 	{
 	case ME_PROGRAM:
-	  if (ISDRUMCHANNEL(song, meep->event.channel))
+	  if (ISDRUMCHANNEL(song, meep->channel))
 	    {
-	      if (song->drumset[meep->event.a]) /* Is this a defined drumset? */
-		new_value=meep->event.a;
+	      if (song->drumset[meep->a]) /* Is this a defined drumset? */
+		new_value=meep->a;
 	      else
 		{
-		  SNDDBG(("Drum set %d is undefined\n", meep->event.a));
-		  new_value=meep->event.a=0;
+		  SNDDBG(("Drum set %d is undefined\n", meep->a));
+		  new_value=meep->a=0;
 		}
-	      if (current_set[meep->event.channel] != new_value)
-		current_set[meep->event.channel]=new_value;
+	      if (current_set[meep->channel] != new_value)
+		current_set[meep->channel]=new_value;
 	      else
 		skip_this_event=1;
 	    }
 	  else
 	    {
-	      new_value=meep->event.a;
-	      if ((current_program[meep->event.channel] != SPECIAL_PROGRAM)
-		  && (current_program[meep->event.channel] != new_value))
-		current_program[meep->event.channel] = new_value;
+	      new_value=meep->a;
+	      if ((current_program[meep->channel] != SPECIAL_PROGRAM)
+		  && (current_program[meep->channel] != new_value))
+		current_program[meep->channel] = new_value;
 	      else
 		skip_this_event=1;
 	    }
@@ -426,49 +472,49 @@ static MidiEvent *groom_list(MidiSong *song, Sint32 divisions,Sint32 *eventsp,
 	case ME_NOTEON:
 	  if (counting_time)
 	    counting_time=1;
-	  if (ISDRUMCHANNEL(song, meep->event.channel))
+	  if (ISDRUMCHANNEL(song, meep->channel))
 	    {
 	      /* Mark this instrument to be loaded */
-	      if (!(song->drumset[current_set[meep->event.channel]]
-		    ->instrument[meep->event.a]))
-		song->drumset[current_set[meep->event.channel]]
-		  ->instrument[meep->event.a] = MAGIC_LOAD_INSTRUMENT;
+	      if (!(song->drumset[current_set[meep->channel]]
+		    ->instrument[meep->a]))
+		song->drumset[current_set[meep->channel]]
+		  ->instrument[meep->a] = MAGIC_LOAD_INSTRUMENT;
 	    }
 	  else
 	    {
-	      if (current_program[meep->event.channel]==SPECIAL_PROGRAM)
+	      if (current_program[meep->channel]==SPECIAL_PROGRAM)
 		break;
 	      /* Mark this instrument to be loaded */
-	      if (!(song->tonebank[current_bank[meep->event.channel]]
-		    ->instrument[current_program[meep->event.channel]]))
-		song->tonebank[current_bank[meep->event.channel]]
-		  ->instrument[current_program[meep->event.channel]] =
+	      if (!(song->tonebank[current_bank[meep->channel]]
+		    ->instrument[current_program[meep->channel]]))
+		song->tonebank[current_bank[meep->channel]]
+		  ->instrument[current_program[meep->channel]] =
 		    MAGIC_LOAD_INSTRUMENT;
 	    }
 	  break;
 
 	case ME_TONE_BANK:
-	  if (ISDRUMCHANNEL(song, meep->event.channel))
+	  if (ISDRUMCHANNEL(song, meep->channel))
 	    {
 	      skip_this_event=1;
 	      break;
 	    }
-	  if (song->tonebank[meep->event.a]) /* Is this a defined tone bank? */
-	    new_value=meep->event.a;
+	  if (song->tonebank[meep->a]) /* Is this a defined tone bank? */
+	    new_value=meep->a;
 	  else
 	    {
-	      SNDDBG(("Tone bank %d is undefined\n", meep->event.a));
-	      new_value=meep->event.a=0;
+	      SNDDBG(("Tone bank %d is undefined\n", meep->a));
+	      new_value=meep->a=0;
 	    }
-	  if (current_bank[meep->event.channel]!=new_value)
-	    current_bank[meep->event.channel]=new_value;
+	  if (current_bank[meep->channel]!=new_value)
+	    current_bank[meep->channel]=new_value;
 	  else
 	    skip_this_event=1;
 	  break;
 	}
 
       /* Recompute time in samples*/
-      if ((dt=meep->event.time - at) && !counting_time)
+      if ((dt=meep->time - at) && !counting_time)
 	{
 	  if (song->sample_increment  > 2147483647/dt ||
 	      song->sample_correction > 2147483647/dt) {
@@ -484,35 +530,40 @@ static MidiEvent *groom_list(MidiSong *song, Sint32 divisions,Sint32 *eventsp,
 	  if (st >= 2147483647 - samples_to_do) {
 	  _overflow:
 	      SNDDBG(("Overflow in sample counter\n"));
-	      free_midi_list(song);
-	      SDL_free(groomed_list);
+	      free_midi_list(r);
 	      return NULL;
 	    }
 	  st += samples_to_do;
 	}
       else if (counting_time==1) counting_time=0;
-      if (meep->event.type==ME_TEMPO)
+      if (meep->type==ME_TEMPO)
 	{
 	  tempo=
-	    meep->event.channel + meep->event.b * 256 + meep->event.a * 65536;
+	    meep->channel + meep->b * 256 + meep->a * 65536;
 	  compute_sample_increment(song, tempo, divisions);
 	}
       if (!skip_this_event)
 	{
 	  /* Add the event to the list */
-	  *lp=meep->event;
+	  *lp=*meep;
 	  lp->time=st;
 	  lp++;
 	  our_event_count++;
 	}
-      at=meep->event.time;
-      meep=meep->next;
+      at=meep->time;
+      meep++;
     }
   /* Add an End-of-Track event */
   lp->time=st;
   lp->type=ME_EOT;
   our_event_count++;
-  free_midi_list(song);
+
+  /* Give back the unused space */
+  lp = (MidiEvent *) SDL_realloc(groomed_list, our_event_count * sizeof(MidiEvent));
+  if (lp)
+    groomed_list = lp;
+  r->events = NULL;
+  free_midi_list(r);
 
   *eventsp=our_event_count;
   *samplesp=st;
@@ -521,14 +572,15 @@ static MidiEvent *groom_list(MidiSong *song, Sint32 divisions,Sint32 *eventsp,
 
 MidiEvent *read_midi_file(MidiSong *song, Sint32 *count, Sint32 *sp)
 {
+  MidiReader reader, *r = &reader;
   Sint32 len, divisions;
   Sint16 format, tracks, divisions_tmp;
   int i;
   char tmp[4];
 
-  song->event_count=0;
-  song->at=0;
-  song->evlist = NULL;
+  SDL_zero(reader);
+  r->song = song;
+  r->rw = song->rw;
 
   if (SDL_RWread(song->rw, tmp, 1, 4) != 4 || SDL_RWread(song->rw, &len, 4, 1) != 1)
     {
@@ -593,41 +645,39 @@ MidiEvent *read_midi_file(MidiSong *song, Sint32 *count, Sint32 *sp)
 	  format, tracks, divisions));
 
   /* Put a do-nothing event first in the list for easier processing */
-  song->evlist=SDL_calloc(1, sizeof(MidiEventList));
-  if (!song->evlist) {
-    song->oom=1;
+  if (reserve_events(song, &r->events, &r->events_size, 1))
     return NULL;
-  }
-  song->event_count++;
+  SDL_zerop(r->events);
+  r->event_count++;
 
   switch(format)
     {
     case 0:
-      if (read_track(song, 0))
+      if (read_track(r, 0))
 	{
-	  free_midi_list(song);
+	  free_midi_list(r);
 	  return NULL;
 	}
       break;
 
     case 1:
       for (i=0; i<tracks; i++)
-	if (read_track(song, 0))
+	if (read_track(r, 0))
 	  {
-	    free_midi_list(song);
+	    free_midi_list(r);
 	    return NULL;
 	  }
       break;
 
     case 2: /* We simply play the tracks sequentially */
       for (i=0; i<tracks; i++)
-	if (read_track(song, 1))
+	if (read_track(r, 1))
 	  {
-	    free_midi_list(song);
+	    free_midi_list(r);
 	    return NULL;
 	  }
       break;
     }
 
-  return groom_list(song, divisions, count, sp);
+  return groom_list(r, divisions, count, sp);
 }
@@ -19,8 +19,217 @@
 #include "tables.h"
 #include "resample.h"
 
+#ifdef TIMIDITY_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 #define PRECALC_LOOP_COUNT(start, end, incr) (((end) - (start) + (incr) - 1) / (incr))
 
+/*************** interpolation between the sample points *****************/
+
+/* The cubic and sinc filters have tables of their taps for
+   1<<INTERP_PHASE_BITS positions between two sample points. The taps
+   are scaled by 1<<INTERP_COEF_BITS and fit into 16 bits, so SSE2 can
+   do the products and their pairwise sums exactly. The linear loop
+   stays scalar: without gathers, loading the pairs of points for SSE2
+   costs more than the products. */
+#define INTERP_PHASE_BITS 10
+#define INTERP_COEF_BITS 14
+#define INTERP_PHASE(ofs) (((ofs) & FRACTION_MASK) >> (FRACTION_BITS - INTERP_PHASE_BITS))
+
+#define CUBIC_TAPS 4
+#define SINC_TAPS 8
+
+static Sint16 cubic_taps[1 << INTERP_PHASE_BITS][CUBIC_TAPS];
+static Sint16 sinc_taps[1 << INTERP_PHASE_BITS][SINC_TAPS];
+static int interp_tables_ready = 0;
+
+/* Scale the taps so that their sum is exactly 1<<INTERP_COEF_BITS */
+static void quantize_taps(const double *c, int taps, Sint16 *out)
+{
+  double sum = 0;
+  Sint32 total = 0;
+  int i, big = 0;
+
+  for (i = 0; i < taps; i++)
+    sum += c[i];
+  for (i = 0; i < taps; i++)
+    {
+      out[i] = (Sint16)SDL_floor(c[i] * (1 << INTERP_COEF_BITS) / sum + 0.5);
+      total += out[i];
+      if (out[i] > out[big])
+	big = i;
+    }
+  out[big] += (Sint16)((1 << INTERP_COEF_BITS) - total);
+}
+
+void init_resample(void)
+{
+  double c[SINC_TAPS], x, t, n;
+  int i, k;
+
+  if (interp_tables_ready)
+    return;
+
+  for (i = 0; i < (1 << INTERP_PHASE_BITS); i++)
+    {
+      x = (double)i / (1 << INTERP_PHASE_BITS);
+
+      /* The same cubic as pre_resample() uses */
+      c[0] = x / 6.0 * (-2.0 + x * (3.0 - x));
+      c[1] = 1.0 + x / 6.0 * (-3.0 + x * (-6.0 + 3.0 * x));
+      c[2] = x / 6.0 * (6.0 + x * (3.0 - 3.0 * x));
+      c[3] = x / 6.0 * (x * x - 1.0);
+      quantize_taps(c, CUBIC_TAPS, cubic_taps[i]);
+
+      /* Blackman windowed sinc over the 8 nearest points */
+      for (k = 0; k < SINC_TAPS; k++)
+	{
+	  t = (double)(k - (SINC_TAPS/2 - 1)) - x;
+	  n = (t + SINC_TAPS/2) / SINC_TAPS;
+	  c[k] = (t == 0.0) ? 1.0 : SDL_sin(PI * t) / (PI * t);
+	  c[k] *= 0.42 - 0.5 * SDL_cos(2 * PI * n) + 0.08 * SDL_cos(4 * PI * n);
+	}
+      quantize_taps(c, SINC_TAPS, sinc_taps[i]);
+    }
+
+  interp_tables_ready = 1;
+}
+
+static sample_t *interp_linear(const sample_t *src, sample_t *dest,
+			       Sint32 ofs, Sint32 incr, Sint32 count)
+{
+  sample_t v1, v2;
+
+  while (count--)
+    {
+      v1 = src[ofs >> FRACTION_BITS];
+      v2 = src[(ofs >> FRACTION_BITS)+1];
+      *dest++ = v1 + (((v2 - v1) * (ofs & FRACTION_MASK)) >> FRACTION_BITS);
+      ofs += incr;
+    }
+  return dest;
+}
+
+/* One point of the cubic or sinc filter. The points outside of the
+   sample data (and of its two padding points) count as silence. */
+static sample_t interp_point(const Sint16 *table, int taps,
+			     const sample_t *src, Sint32 last, Sint32 ofs)
+{
+  const Sint16 *c = table + INTERP_PHASE(ofs) * taps;
+  Sint32 i = (ofs >> FRACTION_BITS) - (taps/2 - 1), k, v = 0;
+
+  if (i >= 0 && i + taps - 1 <= last)
+    for (k = 0; k < taps; k++)
+      v += c[k] * src[i + k];
+  else
+    for (k = 0; k < taps; k++, i++)
+      if (i >= 0 && i <= last)
+	v += c[k] * src[i];
+
+  v = (v + (1 << (INTERP_COEF_BITS - 1))) >> INTERP_COEF_BITS;
+  return (sample_t)((v > 32767) ? 32767 : ((v < -32768) ? -32768 : v));
+}
+
+#ifdef TIMIDITY_USE_SSE2
+/* Sums of the four lanes of each of a, b, c and d */
+static SDL_INLINE __m128i sum_lanes4(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+  __m128i ab = _mm_add_epi32(_mm_unpacklo_epi32(a, b), _mm_unpackhi_epi32(a, b));
+  __m128i cd = _mm_add_epi32(_mm_unpacklo_epi32(c, d), _mm_unpackhi_epi32(c, d));
+  return _mm_add_epi32(_mm_unpacklo_epi64(ab, cd), _mm_unpackhi_epi64(ab, cd));
+}
+
+#define SINC_DOT(o) _mm_madd_epi16( \
+  _mm_loadu_si128((const __m128i *)(src + ((o) >> FRACTION_BITS) - (SINC_TAPS/2 - 1))), \
+  _mm_loadu_si128((const __m128i *)sinc_taps[INTERP_PHASE(o)]))
+
+#define CUBIC_DOT2(o, p) _mm_madd_epi16( \
+  _mm_unpacklo_epi64( \
+    _mm_loadl_epi64((const __m128i *)(src + ((o) >> FRACTION_BITS) - (CUBIC_TAPS/2 - 1))), \
+    _mm_loadl_epi64((const __m128i *)(src + ((p) >> FRACTION_BITS) - (CUBIC_TAPS/2 - 1)))), \
+  _mm_unpacklo_epi64( \
+    _mm_loadl_epi64((const __m128i *)cubic_taps[INTERP_PHASE(o)]), \
+    _mm_loadl_epi64((const __m128i *)cubic_taps[INTERP_PHASE(p)])))
+#endif
+
+static sample_t *interp_filter(int taps, const sample_t *src, Sint32 data_length,
+			       sample_t *dest, Sint32 ofs, Sint32 incr, Sint32 count)
+{
+  const Sint16 *table = (taps == SINC_TAPS) ? sinc_taps[0] : cubic_taps[0];
+  Sint32 last = (data_length >> FRACTION_BITS) + 1;
+
+#ifdef TIMIDITY_USE_SSE2
+  /* Offsets where all the taps are inside of the data */
+  const Sint32
+    lo = (taps/2 - 1) << FRACTION_BITS,
+    hi = data_length - ((taps/2 - 2) << FRACTION_BITS);
+  const __m128i round = _mm_set1_epi32(1 << (INTERP_COEF_BITS - 1));
+  __m128i v;
+
+  for (; count >= 4; count -= 4, dest += 4)
+    {
+      Sint32 o0 = ofs, o1 = o0 + incr, o2 = o1 + incr, o3 = o2 + incr;
+      ofs = o3 + incr;
+      if (o0 < lo || o0 >= hi || o3 < lo || o3 >= hi)
+	{
+	  dest[0] = interp_point(table, taps, src, last, o0);
+	  dest[1] = interp_point(table, taps, src, last, o1);
+	  dest[2] = interp_point(table, taps, src, last, o2);
+	  dest[3] = interp_point(table, taps, src, last, o3);
+	  continue;
+	}
+      if (taps == SINC_TAPS)
+	v = sum_lanes4(SINC_DOT(o0), SINC_DOT(o1), SINC_DOT(o2), SINC_DOT(o3));
+      else
+	{
+	  /* Two points per product, their sums are in the even and odd lanes */
+	  __m128i a = CUBIC_DOT2(o0, o1), b = CUBIC_DOT2(o2, o3);
+	  a = _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0));
+	  b = _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0));
+	  v = _mm_add_epi32(_mm_unpacklo_epi64(a, b), _mm_unpackhi_epi64(a, b));
+	}
+      v = _mm_srai_epi32(_mm_add_epi32(v, round), INTERP_COEF_BITS);
+      _mm_storel_epi64((__m128i *)dest, _mm_packs_epi32(v, v));
+    }
+#endif
+
+  while (count--)
+    {
+      *dest++ = interp_point(table, taps, src, last, ofs);
+      ofs += incr;
+    }
+  return dest;
+}
+
+/* Interpolate 'count' points of the voice sample and advance the offset */
+static sample_t *resample_run(MidiSong *song, Voice *vp, sample_t *dest,
+			      Sint32 *ofs, Sint32 incr, Sint32 count)
+{
+  sample_t *src = vp->sample->data;
+
+  if (count <= 0)
+    return dest;
+
+  switch (song->interpolation)
+    {
+    case TIMI_INTERP_CUBIC:
+      dest = interp_filter(CUBIC_TAPS, src, vp->sample->data_length,
+			   dest, *ofs, incr, count);
+      break;
+    case TIMI_INTERP_SINC:
+      dest = interp_filter(SINC_TAPS, src, vp->sample->data_length,
+			   dest, *ofs, incr, count);
+      break;
+    default:
+      dest = interp_linear(src, dest, *ofs, incr, count);
+      break;
+    }
+
+  *ofs += incr * count;
+  return dest;
+}
+
 /*************** resampling with fixed increment *****************/
 
 static sample_t *rs_plain(MidiSong *song, int v, Sint32 *countptr)
@@ -28,7 +237,6 @@ static sample_t *rs_plain(MidiSong *song, int v, Sint32 *countptr)
 
   /* Play sample until end, then free the voice. */
 
-  sample_t v1, v2;
   Voice 
     *vp=&(song->voice[v]);
   sample_t 
@@ -39,7 +247,7 @@ static sample_t *rs_plain(MidiSong *song, int v, Sint32 *countptr)
     incr=vp->sample_increment,
     le=vp->sample->data_length,
     count=*countptr;
-  Sint32 i, j;
+  Sint32 i;
 
   if (incr<0) incr = -incr; /* In case we're coming out of a bidir loop */
 
@@ -54,13 +262,7 @@ static sample_t *rs_plain(MidiSong *song, int v, Sint32 *countptr)
     }
   else count -= i;
 
-  for (j = 0; j < i; j++)
-    {
-      v1 = src[ofs >> FRACTION_BITS];
-      v2 = src[(ofs >> FRACTION_BITS)+1];
-      *dest++ = v1 + (((v2 - v1) * (ofs & FRACTION_MASK)) >> FRACTION_BITS);
-      ofs += incr;
-    }
+  dest = resample_run(song, vp, dest, &ofs, incr, i);
 
   if (ofs >= le)
     {
@@ -78,16 +280,14 @@ static sample_t *rs_loop(MidiSong *song, Voice *vp, Sint32 count)
 {
   /* Play sample until end-of-loop, skip back and continue. */
 
-  sample_t v1, v2;
   Sint32 
     ofs=vp->sample_offset,
     incr=vp->sample_increment,
     le=vp->sample->loop_end,
     ll=le - vp->sample->loop_start;
   sample_t
-    *dest=song->resample_buffer,
-    *src=vp->sample->data;
-  Sint32 i, j;
+    *dest=song->resample_buffer;
+  Sint32 i;
 
   while (count)
     {
@@ -101,13 +301,7 @@ static sample_t *rs_loop(MidiSong *song, Voice *vp, Sint32 count)
 	  count = 0;
 	}
       else count -= i;
-      for (j = 0; j < i; j++)
-	{
-	  v1 = src[ofs >> FRACTION_BITS];
-	  v2 = src[(ofs >> FRACTION_BITS)+1];
-	  *dest++ = v1 + (((v2 - v1) * (ofs & FRACTION_MASK)) >> FRACTION_BITS);
-	  ofs += incr;
-	}
+      dest = resample_run(song, vp, dest, &ofs, incr, i);
     }
 
   vp->sample_offset=ofs; /* Update offset */
@@ -116,19 +310,17 @@ static sample_t *rs_loop(MidiSong *song, Voice *vp, Sint32 count)
 
 static sample_t *rs_bidir(MidiSong *song, Voice *vp, Sint32 count)
 {
-  sample_t v1, v2;
   Sint32 
     ofs=vp->sample_offset,
     incr=vp->sample_increment,
     le=vp->sample->loop_end,
     ls=vp->sample->loop_start;
   sample_t 
-    *dest=song->resample_buffer,
-    *src=vp->sample->data;
+    *dest=song->resample_buffer;
   Sint32
     le2 = le<<1,
     ls2 = ls<<1,
-    i, j;
+    i;
   /* Play normally until inside the loop region */
 
   if (incr > 0 && ofs < ls)
@@ -143,13 +335,7 @@ static sample_t *rs_bidir(MidiSong *song, Voice *vp, Sint32 count)
 	  count = 0;
 	}
       else count -= i;
-      for (j = 0; j < i; j++)
-	{
-	  v1 = src[ofs >> FRACTION_BITS];
-	  v2 = src[(ofs >> FRACTION_BITS)+1];
-	  *dest++ = v1 + (((v2 - v1) * (ofs & FRACTION_MASK)) >> FRACTION_BITS);
-	  ofs += incr;
-	}
+      dest = resample_run(song, vp, dest, &ofs, incr, i);
     }
 
   /* Then do the bidirectional looping */
@@ -163,13 +349,7 @@ static sample_t *rs_bidir(MidiSong *song, Voice *vp, Sint32 count)
 	  count = 0;
 	}
       else count -= i;
-      for (j = 0; j < i; j++)
-	{
-	  v1 = src[ofs >> FRACTION_BITS];
-	  v2 = src[(ofs >> FRACTION_BITS)+1];
-	  *dest++ = v1 + (((v2 - v1) * (ofs & FRACTION_MASK)) >> FRACTION_BITS);
-	  ofs += incr;
-	}
+      dest = resample_run(song, vp, dest, &ofs, incr, i);
       if (ofs>=le)
 	{
 	  /* fold the overshoot back in */
@@ -268,7 +448,6 @@ static sample_t *rs_vib_plain(MidiSong *song, int v, Sint32 *countptr)
 {
   /* Play sample until end, then free the voice. */
 
-  sample_t v1, v2;
   Voice *vp=&(song->voice[v]);
   sample_t 
     *dest=song->resample_buffer, 
@@ -292,10 +471,7 @@ static sample_t *rs_vib_plain(MidiSong *song, int v, Sint32 *countptr)
 	  cc=vp->vibrato_control_ratio;
 	  incr=update_vibrato(song, vp, 0);
 	}
-      v1 = src[ofs >> FRACTION_BITS];
-      v2 = src[(ofs >> FRACTION_BITS)+1];
-      *dest++ = v1 + (((v2 - v1) * (ofs & FRACTION_MASK)) >> FRACTION_BITS);
-      ofs += incr;
+      dest = resample_run(song, vp, dest, &ofs, incr, 1);
       if (ofs >= le)
 	{
 	  if (ofs == le)
@@ -316,18 +492,16 @@ static sample_t *rs_vib_loop(MidiSong *song, Voice *vp, Sint32 count)
 {
   /* Play sample until end-of-loop, skip back and continue. */
 
-  sample_t v1, v2;
   Sint32 
     ofs=vp->sample_offset,
     incr=vp->sample_increment,
     le=vp->sample->loop_end,
     ll=le - vp->sample->loop_start;
   sample_t 
-    *dest=song->resample_buffer,
-    *src=vp->sample->data;
+    *dest=song->resample_buffer;
   int 
     cc=vp->vibrato_control_counter;
-  Sint32 i, j;
+  Sint32 i;
   int
     vibflag=0;
 
@@ -347,13 +521,7 @@ static sample_t *rs_vib_loop(MidiSong *song, Voice *vp, Sint32 count)
 	}
       else cc -= i;
       count -= i;
-      for (j = 0; j < i; j++)
-	{
-	  v1 = src[ofs >> FRACTION_BITS];
-	  v2 = src[(ofs >> FRACTION_BITS)+1];
-	  *dest++ = v1 + (((v2 - v1) * (ofs & FRACTION_MASK)) >> FRACTION_BITS);
-	  ofs += incr;
-	}
+      dest = resample_run(song, vp, dest, &ofs, incr, i);
       if(vibflag)
 	{
 	  cc = vp->vibrato_control_ratio;
@@ -370,21 +538,19 @@ static sample_t *rs_vib_loop(MidiSong *song, Voice *vp, Sint32 count)
 
 static sample_t *rs_vib_bidir(MidiSong *song, Voice *vp, Sint32 count)
 {
-  sample_t v1, v2;
   Sint32 
     ofs=vp->sample_offset,
     incr=vp->sample_increment,
     le=vp->sample->loop_end,
     ls=vp->sample->loop_start;
   sample_t 
-    *dest=song->resample_buffer,
-    *src=vp->sample->data;
+    *dest=song->resample_buffer;
   int 
     cc=vp->vibrato_control_counter;
   Sint32
     le2=le<<1,
     ls2=ls<<1,
-    i, j;
+    i;
   int
     vibflag = 0;
 
@@ -400,13 +566,7 @@ static sample_t *rs_vib_bidir(MidiSong *song, Voice *vp, Sint32 count)
 	}
       else cc -= i;
       count -= i;
-      for (j = 0; j < i; j++)
-	{
-	  v1 = src[ofs >> FRACTION_BITS];
-	  v2 = src[(ofs >> FRACTION_BITS)+1];
-	  *dest++ = v1 + (((v2 - v1) * (ofs & FRACTION_MASK)) >> FRACTION_BITS);
-	  ofs += incr;
-	}
+      dest = resample_run(song, vp, dest, &ofs, incr, i);
       if (vibflag)
 	{
 	  cc = vp->vibrato_control_ratio;
@@ -428,13 +588,7 @@ static sample_t *rs_vib_bidir(MidiSong *song, Voice *vp, Sint32 count)
 	}
       else cc -= i;
       count -= i;
-      while (i--)
-	{
-	  v1 = src[ofs >> FRACTION_BITS];
-	  v2 = src[(ofs >> FRACTION_BITS)+1];
-	  *dest++ = v1 + (((v2 - v1) * (ofs & FRACTION_MASK)) >> FRACTION_BITS);
-	  ofs += incr;
-	}
+      dest = resample_run(song, vp, dest, &ofs, incr, i);
       if (vibflag)
 	{
 	  cc = vp->vibrato_control_ratio;
@@ -13,8 +13,10 @@
 
 #define resample_voice TIMI_NAMESPACE(resample_voice)
 #define pre_resample TIMI_NAMESPACE(pre_resample)
+#define init_resample TIMI_NAMESPACE(init_resample)
 
 extern sample_t *resample_voice(MidiSong *song, int v, Sint32 *countptr);
 extern void pre_resample(MidiSong *song, Sample *sp);
+extern void init_resample(void);
 
 #endif /* TIMIDITY_RESAMPLE_H */
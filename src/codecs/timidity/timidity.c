@@ -17,6 +17,7 @@
 #include "playmidi.h"
 #include "readmidi.h"
 #include "output.h"
+#include "resample.h"
 
 #include "tables.h"
 
@@ -497,6 +498,9 @@ int Timidity_Init_NoConfig(void)
 {
   master_tonebank[0] = NULL;
   master_drumset[0] = NULL;
+  if (init_instrument_cache() != 0)
+    return -2;
+  init_resample();
   return init_alloc_banks();
 }
 
@@ -687,4 +691,5 @@ void Timidity_Exit(void)
   }
 
   timi_free_pathlist();
+  free_instrument_cache();
 }
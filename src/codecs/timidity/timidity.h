@@ -25,6 +25,11 @@ typedef Sint32 final_volume_t;
 /* #define MAXCHAN	64 */
 #define MAXBANK	128
 
+/* Interpolation of the voices between the sample points */
+#define TIMI_INTERP_LINEAR	0
+#define TIMI_INTERP_CUBIC	1
+#define TIMI_INTERP_SINC	2
+
 typedef struct {
   Sint32
     loop_start, loop_end, data_length,
@@ -100,11 +105,6 @@ typedef struct {
     Uint8 channel, type, a, b;
 } MidiEvent;
 
-typedef struct _MidiEventList {
-    MidiEvent event;
-    struct _MidiEventList *next;
-} MidiEventList;
-
 typedef struct {
     int oom; /* malloc() failed */
     int playing;
@@ -113,6 +113,7 @@ typedef struct {
     Sint32 encoding;
     float master_volume;
     Sint32 amplification;
+    int interpolation;
     ToneBank *tonebank[MAXBANK];
     ToneBank *drumset[MAXBANK];
     Instrument *default_instrument;
@@ -129,7 +130,10 @@ typedef struct {
     Sint32 sample_correction;
     Channel channel[MAXCHAN];
     Voice voice[MAX_VOICES];
-    int voices;
+    int voices; /* polyphony limit */
+    int active_voice[MAX_VOICES];
+    int active_voices;
+    Uint32 free_voices[MAX_VOICES / 32]; /* bit set for each free voice */
     Sint32 drumchannels;
     Sint32 buffered_count;
     Sint32 control_ratio;
@@ -138,10 +142,7 @@ typedef struct {
     Sint32 samples;
     MidiEvent *events;
     MidiEvent *current_event;
-    MidiEventList *evlist;
     Sint32 current_sample;
-    Sint32 event_count;
-    Sint32 at;
     Sint32 groomed_event_count;
 } MidiSong;
 
@@ -150,6 +151,8 @@ typedef struct {
 extern int Timidity_Init(const char *config_file);
 extern int Timidity_Init_NoConfig(void);
 extern void Timidity_SetVolume(MidiSong *song, int volume);
+extern void Timidity_SetInterpolation(MidiSong *song, int interpolation);
+extern void Timidity_SetPolyphony(MidiSong *song, int voices);
 extern int Timidity_PlaySome(MidiSong *song, void *stream, Sint32 len);
 extern MidiSong *Timidity_LoadSong(SDL_RWops *rw, SDL_AudioSpec *audio);
 extern void Timidity_Start(MidiSong *song);
@@ -24,6 +24,7 @@
 #include "SDL_mixer.h"
 #include "mixer.h"
 #include "music.h"
+#include "utils.h"
 #include "load_aiff.h"
 #include "load_voc.h"
 
@@ -71,6 +72,33 @@ typedef struct _Mix_effectinfo
     struct _Mix_effectinfo *next;
 } effect_info;
 
+/* MIXER-X: The decoder of the compressed chunk attached to a playing channel */
+typedef struct _Mix_ChunkVoice
+{
+    void *music;
+    Uint8 *buffer;
+    int buffer_size;
+    SDL_bool busy;
+    struct _Mix_ChunkVoice *next;
+} Mix_ChunkVoice;
+
+/* MIXER-X: The chunk kept compressed, it gets decoded while playing */
+typedef struct _Mix_CompressedChunk
+{
+    Mix_Chunk chunk; /* Must be the first */
+    Mix_MusicType type;
+    Mix_MusicInterface *interface;
+    Uint8 *data;
+    size_t size;
+    Mix_ChunkVoice *voices; /* The pool of decoders, both busy and idle */
+} Mix_CompressedChunk;
+
+/* The 'allocated' value of the compressed chunks */
+#define MIX_CHUNK_COMPRESSED    2
+
+/* Frames decoded by the voice at once */
+#define MIX_VOICE_FRAMES        1024
+
 static struct _Mix_Channel {
     Mix_Chunk *chunk;
     int playing;
@@ -87,6 +115,7 @@ static struct _Mix_Channel {
     Uint32 fade_length;
     Uint32 ticks_fade;
     effect_info *effects;
+    Mix_ChunkVoice *voice; /*MIXER-X*/
 } *mix_channel = NULL;
 
 static effect_info *posteffects = NULL;
@@ -322,6 +351,75 @@ static void *Mix_DoEffects(int chan, void *snd, int len)
 }
 
 
+/* MIXER-X: Give the decoder of the channel back to the pool of its chunk.
+ *  MAKE SURE Mix_LockAudio() is called before this (or you're in the
+ *   audio callback).
+ */
+static void Mix_ReleaseChunkVoice(int channel)
+{
+    if (mix_channel[channel].voice) {
+        mix_channel[channel].voice->busy = SDL_FALSE;
+        mix_channel[channel].voice = NULL;
+    }
+}
+
+/* MIXER-X: Mix the compressed chunk of the channel, decoding just the data to mix */
+static void mix_chunk_voice(int i, Uint8 *stream, int len, int master_vol)
+{
+    Mix_ChunkVoice *voice;
+    Mix_MusicInterface *interface;
+    Uint8 *mix_input;
+    int index = 0;
+    int empty_ends = 0;
+    int volume, amount, left;
+
+    while (index < len && mix_channel[i].voice) {
+        voice = mix_channel[i].voice;
+        if (mix_channel[i].playing <= 0) {
+            /* Halted or finished */
+            Mix_ReleaseChunkVoice(i);
+            break;
+        }
+
+        interface = ((Mix_CompressedChunk *)mix_channel[i].chunk)->interface;
+        volume = (master_vol * (mix_channel[i].volume * mix_channel[i].chunk->volume)) / (MIX_MAX_VOLUME * MIX_MAX_VOLUME);
+
+        amount = len - index;
+        if (amount > voice->buffer_size) {
+            amount = voice->buffer_size;
+        }
+        left = interface->GetAudio(voice->music, voice->buffer, amount);
+        amount -= left;
+
+        if (amount > 0) {
+            mix_input = Mix_DoEffects(i, voice->buffer, amount);
+            SDL_MixAudioFormat(stream+index, mix_input, mixer.format, (Uint32)amount, volume);
+            if (mix_input != voice->buffer)
+                SDL_free(mix_input);
+            index += amount;
+            empty_ends = 0;
+        }
+
+        if (left > 0 || (interface->IsPlaying && !interface->IsPlaying(voice->music))) {
+            if (amount == 0) {
+                ++empty_ends;
+            }
+            /* Rewind the decoder, unless the sound has nothing to play */
+            if (mix_channel[i].looping && empty_ends < 2 &&
+                interface->Play && interface->Play(voice->music, 1) == 0) {
+                if (mix_channel[i].looping > 0) {
+                    --mix_channel[i].looping;
+                }
+            } else {
+                mix_channel[i].playing = 0;
+                mix_channel[i].looping = 0;
+                /* The callback may start another chunk at this channel */
+                _Mix_channel_done_playing(i);
+            }
+        }
+    }
+}
+
 /* Mixing function */
 static void SDLCALL
 mix_channels(void *udata, Uint8 *stream, int len)
@@ -374,6 +472,11 @@ mix_channels(void *udata, Uint8 *stream, int len)
                     }
                 }
             }
+            if (mix_channel[i].voice) {
+                /* MIXER-X: The compressed chunk gets decoded as it plays */
+                mix_chunk_voice(i, stream, len, master_vol);
+                continue;
+            }
             if (mix_channel[i].playing > 0) {
                 int volume = (master_vol * (mix_channel[i].volume * mix_channel[i].chunk->volume)) / (MIX_MAX_VOLUME * MIX_MAX_VOLUME);
                 int index = 0;
@@ -517,6 +620,7 @@ int MIXCALLCC Mix_InitMixer(const SDL_AudioSpec *spec, SDL_bool skip_init_check)
         mix_channel[i].expire = 0;
         mix_channel[i].effects = NULL;
         mix_channel[i].paused = 0;
+        mix_channel[i].voice = NULL;
     }
     Mix_VolumeMusicStream(NULL, SDL_MIX_MAXVOLUME);
 
@@ -623,6 +727,7 @@ int MIXCALLCC Mix_AllocateChannels(int numchans)
             mix_channel[i].expire = 0;
             mix_channel[i].effects = NULL;
             mix_channel[i].paused = 0;
+            mix_channel[i].voice = NULL;
         }
     }
     num_channels = numchans;
@@ -654,27 +759,13 @@ typedef struct _MusicFragment
     struct _MusicFragment *next;
 } MusicFragment;
 
-static SDL_AudioSpec *Mix_LoadMusic_RW(SDL_RWops *src, int freesrc, SDL_AudioSpec *spec, Uint8 **audio_buf, Uint32 *audio_len)
+/* Open the sound by the first music interface that can decode it for the chunk */
+static void *Mix_CreateChunkMusic(SDL_RWops *src, int freesrc, Mix_MusicType music_type, Mix_MusicInterface **result)
 {
     int i;
-    Mix_MusicType music_type;
-    Mix_MusicInterface *interface = NULL;
-    void *music = NULL;
+    Mix_MusicInterface *interface;
+    void *music;
     Sint64 start;
-    SDL_bool playing;
-    MusicFragment *first = NULL, *last = NULL, *fragment = NULL;
-    int count = 0;
-    int fragment_size;
-
-    music_type = detect_music_type(src);
-    if (!load_music_type(music_type) || !open_music_type_ex(music_type, mididevice_current)) {
-        return NULL;
-    }
-
-    *spec = mixer;
-
-    /* Use fragments sized on full audio frame boundaries - this'll do */
-    fragment_size = spec->size;
 
     start = SDL_RWtell(src);
     for (i = 0; i < get_num_music_interfaces(); ++i) {
@@ -697,15 +788,43 @@ static SDL_AudioSpec *Mix_LoadMusic_RW(SDL_RWops *src, int freesrc, SDL_AudioSpe
 
         music = interface->CreateFromRW(src, freesrc);
         if (music) {
-            /* The interface owns the data source now */
-            freesrc = SDL_FALSE;
-            break;
+            *result = interface;
+            return music;
         }
 
         /* Reset the stream for the next decoder */
         SDL_RWseek(src, start, RW_SEEK_SET);
     }
 
+    return NULL;
+}
+
+static SDL_AudioSpec *Mix_LoadMusic_RW(SDL_RWops *src, int freesrc, SDL_AudioSpec *spec, Uint8 **audio_buf, Uint32 *audio_len)
+{
+    Mix_MusicType music_type;
+    Mix_MusicInterface *interface = NULL;
+    void *music = NULL;
+    SDL_bool playing;
+    MusicFragment *first = NULL, *last = NULL, *fragment = NULL;
+    int count = 0;
+    int fragment_size;
+
+    music_type = detect_music_type(src);
+    if (!load_music_type(music_type) || !open_music_type_ex(music_type, mididevice_current)) {
+        return NULL;
+    }
+
+    *spec = mixer;
+
+    /* Use fragments sized on full audio frame boundaries - this'll do */
+    fragment_size = spec->size;
+
+    music = Mix_CreateChunkMusic(src, freesrc, music_type, &interface);
+    if (music) {
+        /* The interface owns the data source now */
+        freesrc = SDL_FALSE;
+    }
+
     if (!music) {
         if (freesrc) {
             SDL_RWclose(src);
@@ -820,6 +939,9 @@ Mix_Chunk * MIXCALLCC Mix_LoadWAV_RW(SDL_RWops *src, int freesrc)
         return(NULL);
     }
 
+    /* MIXER-X: Buffer the small reads of the loaders */
+    src = _Mix_RWFromBuffered(src, &freesrc);
+
     /* Allocate the chunk memory */
     chunk = (Mix_Chunk *)SDL_malloc(sizeof(Mix_Chunk));
     if (chunk == NULL) {
@@ -902,6 +1024,221 @@ Mix_Chunk * MIXCALLCC Mix_LoadWAV_RW(SDL_RWops *src, int freesrc)
     return(chunk);
 }
 
+/* MIXER-X: Create another decoder of the compressed chunk, it's busy */
+static Mix_ChunkVoice *Mix_NewChunkVoice(Mix_CompressedChunk *cchunk)
+{
+    Mix_ChunkVoice *voice;
+    SDL_RWops *rw;
+
+    voice = (Mix_ChunkVoice *)SDL_calloc(1, sizeof(Mix_ChunkVoice));
+    if (voice == NULL) {
+        Mix_OutOfMemory();
+        return NULL;
+    }
+    voice->buffer_size = (SDL_AUDIO_BITSIZE(mixer.format) / 8) * mixer.channels * MIX_VOICE_FRAMES;
+    voice->buffer = (Uint8 *)SDL_malloc((size_t)voice->buffer_size);
+    if (voice->buffer == NULL) {
+        Mix_OutOfMemory();
+        SDL_free(voice);
+        return NULL;
+    }
+
+    /* Every decoder reads the same compressed data */
+    rw = SDL_RWFromConstMem(cchunk->data, (int)cchunk->size);
+    if (rw) {
+        if (cchunk->interface) {
+            voice->music = cchunk->interface->CreateFromRW(rw, SDL_TRUE);
+        } else {
+            voice->music = Mix_CreateChunkMusic(rw, SDL_TRUE, cchunk->type, &cchunk->interface);
+            if (!voice->music) {
+                Mix_SetError("Unrecognized audio format");
+            }
+        }
+        if (!voice->music) {
+            SDL_RWclose(rw);
+        }
+    }
+    if (!voice->music) {
+        SDL_free(voice->buffer);
+        SDL_free(voice);
+        return NULL;
+    }
+
+    voice->busy = SDL_TRUE;
+    Mix_LockAudio();
+    voice->next = cchunk->voices;
+    cchunk->voices = voice;
+    Mix_UnlockAudio();
+    return voice;
+}
+
+/* MIXER-X: Get an idle decoder of the compressed chunk from the pool, or create a new one */
+static Mix_ChunkVoice *Mix_AcquireChunkVoice(Mix_CompressedChunk *cchunk)
+{
+    Mix_MusicInterface *interface = cchunk->interface;
+    Mix_ChunkVoice *voice;
+
+    Mix_LockAudio();
+    for (voice = cchunk->voices; voice; voice = voice->next) {
+        if (!voice->busy) {
+            voice->busy = SDL_TRUE;
+            break;
+        }
+    }
+    Mix_UnlockAudio();
+
+    if (voice) {
+        /* Nothing else uses the busy decoder, reset it out of the lock */
+        if (interface->Stop) {
+            interface->Stop(voice->music);
+        }
+    } else {
+        voice = Mix_NewChunkVoice(cchunk);
+        if (!voice) {
+            return NULL;
+        }
+    }
+
+    if (interface->Play && interface->Play(voice->music, 1) < 0) {
+        Mix_LockAudio();
+        voice->busy = SDL_FALSE;
+        Mix_UnlockAudio();
+        return NULL;
+    }
+    return voice;
+}
+
+/* MIXER-X: Delete all decoders and the data of the compressed chunk */
+static void Mix_FreeChunkVoices(Mix_CompressedChunk *cchunk)
+{
+    Mix_ChunkVoice *voice;
+
+    while (cchunk->voices) {
+        voice = cchunk->voices;
+        cchunk->voices = voice->next;
+        cchunk->interface->Delete(voice->music);
+        SDL_free(voice->buffer);
+        SDL_free(voice);
+    }
+    SDL_free(cchunk->data);
+}
+
+/* MIXER-X: Count the decoders of the compressed chunk and the busy ones */
+int _Mix_CountChunkVoices(Mix_Chunk *chunk, int *busy)
+{
+    Mix_CompressedChunk *cchunk = (Mix_CompressedChunk *)chunk;
+    Mix_ChunkVoice *voice;
+    int count = 0;
+
+    if (!chunk || chunk->allocated != MIX_CHUNK_COMPRESSED) {
+        Mix_SetError("Not a compressed chunk");
+        return -1;
+    }
+
+    *busy = 0;
+    Mix_LockAudio();
+    for (voice = cchunk->voices; voice; voice = voice->next) {
+        count++;
+        if (voice->busy) {
+            (*busy)++;
+        }
+    }
+    Mix_UnlockAudio();
+    return count;
+}
+
+/* MIXER-X: Load a sound keeping it compressed in memory */
+Mix_Chunk * MIXCALLCC Mix_LoadWAV_RW_Compressed(SDL_RWops *src, int freesrc, int keep_compressed)
+{
+    Mix_CompressedChunk *cchunk;
+    Mix_MusicType music_type;
+    Mix_ChunkVoice *voice;
+    double duration = -1.0;
+    double frames;
+    int frame_size;
+
+    if (!keep_compressed) {
+        return Mix_LoadWAV_RW(src, freesrc);
+    }
+
+    if (!src) {
+        Mix_SetError("Mix_LoadWAV_RW_Compressed with NULL src");
+        return(NULL);
+    }
+
+    /* Make sure audio has been opened */
+    if (!audio_opened) {
+        Mix_SetError("Audio device hasn't been opened");
+        if (freesrc) {
+            SDL_RWclose(src);
+        }
+        return(NULL);
+    }
+
+    /* The PCM and synthesized sounds are decoded in full */
+    music_type = detect_music_type(src);
+    switch (music_type) {
+    case MUS_OGG:
+    case MUS_OPUS:
+    case MUS_FLAC:
+    case MUS_MP3:
+        break;
+    default:
+        return Mix_LoadWAV_RW(src, freesrc);
+    }
+
+    if (!load_music_type(music_type) || !open_music_type(music_type)) {
+        if (freesrc) {
+            SDL_RWclose(src);
+        }
+        return(NULL);
+    }
+
+    cchunk = (Mix_CompressedChunk *)SDL_calloc(1, sizeof(Mix_CompressedChunk));
+    if (cchunk == NULL) {
+        Mix_OutOfMemory();
+        if (freesrc) {
+            SDL_RWclose(src);
+        }
+        return(NULL);
+    }
+    cchunk->type = music_type;
+
+    cchunk->data = (Uint8 *)SDL_LoadFile_RW(src, &cchunk->size, freesrc);
+    if (cchunk->data == NULL) {
+        SDL_free(cchunk);
+        return(NULL);
+    }
+
+    /* The first decoder checks the data, then waits in the pool */
+    voice = Mix_NewChunkVoice(cchunk);
+    if (!voice) {
+        SDL_free(cchunk->data);
+        SDL_free(cchunk);
+        return(NULL);
+    }
+    voice->busy = SDL_FALSE;
+
+    /* The estimated length of the decoded data, nothing reads it */
+    if (cchunk->interface->Duration) {
+        duration = cchunk->interface->Duration(voice->music);
+    }
+    if (duration > 0.0) {
+        frame_size = (SDL_AUDIO_BITSIZE(mixer.format) / 8) * mixer.channels;
+        frames = SDL_floor(duration * mixer.freq);
+        if (frames > (double)(0xFFFFFFFF / (Uint32)frame_size)) {
+            frames = (double)(0xFFFFFFFF / (Uint32)frame_size);
+        }
+        cchunk->chunk.alen = (Uint32)frames * (Uint32)frame_size;
+    }
+
+    cchunk->chunk.allocated = MIX_CHUNK_COMPRESSED;
+    cchunk->chunk.abuf = NULL;
+    cchunk->chunk.volume = MIX_MAX_VOLUME;
+
+    return &cchunk->chunk;
+}
+
 /* Load a wave file of the mixer format from a memory buffer */
 Mix_Chunk * MIXCALLCC Mix_QuickLoad_WAV(Uint8 *mem)
 {
@@ -978,12 +1315,15 @@ void MIXCALLCC Mix_FreeChunk(Mix_Chunk *chunk)
                 if (chunk == mix_channel[i].chunk) {
                     mix_channel[i].playing = 0;
                     mix_channel[i].looping = 0;
+                    mix_channel[i].voice = NULL;
                 }
             }
         }
         Mix_UnlockAudio();
         /* Actually free the chunk */
-        if (chunk->allocated) {
+        if (chunk->allocated == MIX_CHUNK_COMPRESSED) {
+            Mix_FreeChunkVoices((Mix_CompressedChunk *)chunk);
+        } else if (chunk->allocated) {
             SDL_free(chunk->abuf);
         }
         SDL_free(chunk);
@@ -1086,13 +1426,20 @@ static int checkchunkintegral(Mix_Chunk *chunk)
 int MIXCALLCC Mix_PlayChannelTimedVolume(int which, Mix_Chunk *chunk, int loops, int ticks, int volume)
 {
     int i;
+    Mix_ChunkVoice *voice = NULL;
 
     /* Don't play null pointers :-) */
     if (chunk == NULL) {
         Mix_SetError("Tried to play a NULL chunk");
         return(-1);
     }
-    if (!checkchunkintegral(chunk)) {
+    if (chunk->allocated == MIX_CHUNK_COMPRESSED) {
+        /* MIXER-X: The channel gets a decoder instead of the samples */
+        voice = Mix_AcquireChunkVoice((Mix_CompressedChunk *)chunk);
+        if (!voice) {
+            return(-1);
+        }
+    } else if (!checkchunkintegral(chunk)) {
         Mix_SetError("Tried to play a chunk with a bad frame");
         return(-1);
     }
@@ -1120,8 +1467,11 @@ int MIXCALLCC Mix_PlayChannelTimedVolume(int which, Mix_Chunk *chunk, int loops,
         /* Queue up the audio data for this channel */
         if (which >= 0 && which < num_channels) {
             Uint32 sdl_ticks = SDL_GetTicks();
+            Mix_ReleaseChunkVoice(which);
+            mix_channel[which].voice = voice;
             mix_channel[which].samples = chunk->abuf;
-            mix_channel[which].playing = (int)chunk->alen;
+            /* The voice only needs a positive value here, it knows the end itself */
+            mix_channel[which].playing = voice ? 1 : (int)chunk->alen;
             mix_channel[which].looping = loops;
             mix_channel[which].chunk = chunk;
             mix_channel[which].paused = 0;
@@ -1131,6 +1481,9 @@ int MIXCALLCC Mix_PlayChannelTimedVolume(int which, Mix_Chunk *chunk, int loops,
             if (volume >= 0) {
                 mix_channel[which].volume = (volume > MIX_MAX_VOLUME) ? MIX_MAX_VOLUME : volume;
             }
+        } else if (voice) {
+            /* Back to the pool, no channel to play it */
+            voice->busy = SDL_FALSE;
         }
     }
     Mix_UnlockAudio();
@@ -1173,12 +1526,19 @@ int MIXCALLCC Mix_ExpireChannel(int which, int ticks)
 int MIXCALLCC Mix_FadeInChannelTimedVolume(int which, Mix_Chunk *chunk, int loops, int ms, int ticks, int volume)
 {
     int i;
+    Mix_ChunkVoice *voice = NULL;
 
     /* Don't play null pointers :-) */
     if (chunk == NULL) {
         return(-1);
     }
-    if (!checkchunkintegral(chunk)) {
+    if (chunk->allocated == MIX_CHUNK_COMPRESSED) {
+        /* MIXER-X: The channel gets a decoder instead of the samples */
+        voice = Mix_AcquireChunkVoice((Mix_CompressedChunk *)chunk);
+        if (!voice) {
+            return(-1);
+        }
+    } else if (!checkchunkintegral(chunk)) {
         Mix_SetError("Tried to play a chunk with a bad frame");
         return(-1);
     }
@@ -1205,8 +1565,11 @@ int MIXCALLCC Mix_FadeInChannelTimedVolume(int which, Mix_Chunk *chunk, int loop
         /* Queue up the audio data for this channel */
         if (which >= 0 && which < num_channels) {
             Uint32 sdl_ticks = SDL_GetTicks();
+            Mix_ReleaseChunkVoice(which);
+            mix_channel[which].voice = voice;
             mix_channel[which].samples = chunk->abuf;
-            mix_channel[which].playing = (int)chunk->alen;
+            /* The voice only needs a positive value here, it knows the end itself */
+            mix_channel[which].playing = voice ? 1 : (int)chunk->alen;
             mix_channel[which].looping = loops;
             mix_channel[which].chunk = chunk;
             mix_channel[which].paused = 0;
@@ -1222,6 +1585,9 @@ int MIXCALLCC Mix_FadeInChannelTimedVolume(int which, Mix_Chunk *chunk, int loop
             mix_channel[which].fade_length = (Uint32)ms;
             mix_channel[which].start_time = mix_channel[which].ticks_fade = sdl_ticks;
             mix_channel[which].expire = (ticks > 0) ? (sdl_ticks+(Uint32)ticks) : 0;
+        } else if (voice) {
+            /* Back to the pool, no channel to play it */
+            voice->busy = SDL_FALSE;
         }
     }
     Mix_UnlockAudio();
@@ -1292,6 +1658,7 @@ int MIXCALLCC Mix_HaltChannel(int which)
             mix_channel[which].playing = 0;
             mix_channel[which].looping = 0;
         }
+        Mix_ReleaseChunkVoice(which);
         mix_channel[which].expire = 0;
         if (mix_channel[which].fading != MIX_NO_FADING) /* Restore volume */
             mix_channel[which].volume = mix_channel[which].fade_volume_reset;
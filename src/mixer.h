@@ -27,6 +27,10 @@ extern void Mix_UnlockAudio(void);
 
 extern void add_chunk_decoder(const char *decoder);
 
+/* MIXER-X: Count the decoders of the compressed chunk and the busy ones,
+ * returns -1 if the chunk isn't compressed */
+extern int _Mix_CountChunkVoices(Mix_Chunk *chunk, int *busy);
+
 #endif /* MIXER_H_ */
 
 /* vi: set ts=4 sw=4 expandtab: */
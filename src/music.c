@@ -44,6 +44,10 @@
 #include "music_midi_adl.h"
 #include "music_midi_opn.h"
 #include "music_midi_edmidi.h"
+#if defined(MUSIC_MID_FLUIDLITE) || defined(MUSIC_MID_NATIVE_ALT)
+#define MUSIC_HAS_MIDI_SEQUENCER
+#include "midi_seq/mix_midi_seq.h"
+#endif
 
 #include "utils.h"
 
@@ -1277,6 +1281,28 @@ static Mix_MusicType xmi_compatible_midi_player()
 }
 #endif
 
+/*
+    MIXER-X: The song cache can be played by MIDI players based on the built-in sequencer only.
+ */
+#if defined(MUSIC_HAS_MIDI_SEQUENCER)
+static Mix_MusicType song_cache_compatible_midi_player()
+{
+#if defined(MUSIC_MID_NATIVE_ALT)
+    if (mididevice_current == MIDI_Native) {
+        return MUS_MID;
+    }
+#endif
+#if defined(MUSIC_MID_FLUIDLITE)
+    if (mididevice_current == MIDI_Fluidsynth) {
+        return MUS_MID;
+    }
+    return MUS_FLUIDLITE;
+#else
+    return MUS_NATIVEMIDI;
+#endif
+}
+#endif
+
 #ifdef MUSIC_MID_ADLMIDI
 static int detect_imf(SDL_RWops *in, Sint64 start)
 {
@@ -1506,6 +1532,11 @@ Mix_MusicType detect_music_type(SDL_RWops *src)
     if (SDL_memcmp(magic, "CTMF", 4) == 0) {
         return MUS_ADLMIDI;
     }
+#if defined(MUSIC_HAS_MIDI_SEQUENCER)
+    if (SDL_memcmp(magic, MIDI_SONG_CACHE_MAGIC, 8) == 0) {
+        return song_cache_compatible_midi_player();
+    }
+#endif
 
     if (SDL_memcmp(magic, "ID3", 3) == 0 ||
     /* see: https://bugzilla.libsdl.org/show_bug.cgi?id=5322 */
@@ -1824,6 +1855,9 @@ Mix_Music * MIXCALLCC Mix_LoadMUSType_RW_ARG(SDL_RWops *src, Mix_MusicType type,
         Mix_SetError("RWops pointer is NULL");
         return NULL;
     }
+
+    /* MIXER-X: Buffer the small reads of the detection and of the codecs */
+    src = _Mix_RWFromBuffered(src, &freesrc);
     start = SDL_RWtell(src);
 
     /* If the caller wants auto-detection, figure out what kind of file
@@ -2519,6 +2553,59 @@ int MIXCALLCC Mix_SetMusicTrackMute(Mix_Music *music, int track, int mute)
 }
 
 
+/* Get the count of songs in the file */
+static int music_internal_num_tracks(Mix_Music *music)
+{
+    if (music->interface->GetNumTracks) {
+        return music->interface->GetNumTracks(music->context);
+    }
+    return -1;
+}
+int MIXCALLCC Mix_GetNumTracks(Mix_Music *music)
+{
+    int retval;
+
+    Mix_LockAudio();
+    if (music) {
+        retval = music_internal_num_tracks(music);
+    } else if (music_playing) {
+        retval = music_internal_num_tracks(music_playing);
+    } else {
+        Mix_SetError("Music isn't playing");
+        retval = -1;
+    }
+    Mix_UnlockAudio();
+
+    return(retval);
+}
+
+/* Switch to another song of the file */
+static int music_internal_start_track(Mix_Music *music, int track)
+{
+    if (music->interface->StartTrack) {
+        return music->interface->StartTrack(music->context, track);
+    }
+    Mix_SetError("Switching of songs is not implemented for music type");
+    return -1;
+}
+int MIXCALLCC Mix_StartTrack(Mix_Music *music, int track)
+{
+    int retval;
+
+    Mix_LockAudio();
+    if (music) {
+        retval = music_internal_start_track(music, track);
+    } else if (music_playing) {
+        retval = music_internal_start_track(music_playing, track);
+    } else {
+        Mix_SetError("Music isn't playing");
+        retval = -1;
+    }
+    Mix_UnlockAudio();
+
+    return(retval);
+}
+
 /* Get Loop start position */
 static double music_internal_loop_start(Mix_Music *music)
 {
@@ -2599,6 +2686,239 @@ double MIXCALLCC Mix_GetMusicLoopLengthTime(Mix_Music *music)
 
 
 
+/* Seek index of the music */
+#define SEEK_INDEX_MAGIC    "MXSEEKIX"
+#define SEEK_INDEX_VERSION  1
+#define SEEK_INDEX_TAG_SIZE 16
+
+static int music_internal_build_seek_index(Mix_Music *music)
+{
+    if (music->interface->BuildSeekIndex) {
+        return music->interface->BuildSeekIndex(music->context);
+    }
+    Mix_SetError("Seek index is not supported for music type");
+    return -1;
+}
+
+/* The codecs scan the stream without holding the audio lock, they only take
+ * it to read the stream of the playing music and to put the index in place */
+int MIXCALLCC Mix_BuildMusicSeekIndex(Mix_Music *music)
+{
+    if (!music) {
+        Mix_LockAudio();
+        music = music_playing;
+        Mix_UnlockAudio();
+    }
+    if (!music) {
+        Mix_SetError("Music isn't playing");
+        return -1;
+    }
+    return music_internal_build_seek_index(music);
+}
+
+int MIXCALLCC Mix_SaveMusicSeekIndex(Mix_Music *music, const char *file)
+{
+    char tag[SEEK_INDEX_TAG_SIZE];
+    void *data = NULL;
+    size_t size = 0;
+    SDL_RWops *dst;
+    int retval = -1;
+
+    if (!music) {
+        Mix_SetError("music is NULL");
+        return -1;
+    }
+
+    if (!music->interface->GetSeekIndex) {
+        Mix_SetError("Seek index is not supported for music type");
+        return -1;
+    }
+
+    Mix_LockAudio();
+    retval = music->interface->GetSeekIndex(music->context, &data, &size);
+    Mix_UnlockAudio();
+
+    if (retval < 0) {
+        if (music_internal_build_seek_index(music) < 0) {
+            return -1;
+        }
+        Mix_LockAudio();
+        retval = music->interface->GetSeekIndex(music->context, &data, &size);
+        Mix_UnlockAudio();
+        if (retval < 0) {
+            return -1;
+        }
+    }
+
+    dst = SDL_RWFromFile(file, "wb");
+    if (!dst) {
+        SDL_free(data);
+        return -1;
+    }
+
+    SDL_memset(tag, 0, sizeof(tag));
+    SDL_strlcpy(tag, music->interface->tag, sizeof(tag));
+
+    if (SDL_RWwrite(dst, SEEK_INDEX_MAGIC, 1, 8) != 8 ||
+        SDL_WriteLE32(dst, SEEK_INDEX_VERSION) != 1 ||
+        SDL_RWwrite(dst, tag, 1, sizeof(tag)) != sizeof(tag) ||
+        SDL_WriteLE32(dst, (Uint32)size) != 1 ||
+        SDL_RWwrite(dst, data, 1, size) != size) {
+        Mix_SetError("Failed to write the seek index into %s", file);
+        retval = -1;
+    }
+
+    SDL_free(data);
+    if (SDL_RWclose(dst) < 0) {
+        retval = -1;
+    }
+    return retval;
+}
+
+int MIXCALLCC Mix_LoadMusicSeekIndex(Mix_Music *music, const char *file)
+{
+    char magic[8], tag[SEEK_INDEX_TAG_SIZE];
+    SDL_RWops *src;
+    Uint32 size;
+    Sint64 file_size;
+    void *data;
+    int retval;
+
+    if (!music) {
+        Mix_SetError("music is NULL");
+        return -1;
+    }
+    if (!music->interface->SetSeekIndex) {
+        Mix_SetError("Seek index is not supported for music type");
+        return -1;
+    }
+
+    src = SDL_RWFromFile(file, "rb");
+    if (!src) {
+        return -1;
+    }
+
+    file_size = SDL_RWsize(src);
+    if (SDL_RWread(src, magic, 1, 8) != 8 || SDL_memcmp(magic, SEEK_INDEX_MAGIC, 8) != 0 ||
+        SDL_ReadLE32(src) != SEEK_INDEX_VERSION ||
+        SDL_RWread(src, tag, 1, sizeof(tag)) != sizeof(tag)) {
+        SDL_RWclose(src);
+        Mix_SetError("%s is not a seek index file", file);
+        return -1;
+    }
+
+    tag[SEEK_INDEX_TAG_SIZE - 1] = '\0';
+    if (SDL_strcmp(tag, music->interface->tag) != 0) {
+        SDL_RWclose(src);
+        Mix_SetError("Seek index of %s is made by the %s codec", file, tag);
+        return -1;
+    }
+
+    size = SDL_ReadLE32(src);
+    if (size == 0 || (file_size >= 0 && (Sint64)size > file_size)) {
+        SDL_RWclose(src);
+        Mix_SetError("Seek index of %s is corrupted", file);
+        return -1;
+    }
+
+    data = SDL_malloc(size);
+    if (!data) {
+        SDL_RWclose(src);
+        return Mix_OutOfMemory();
+    }
+
+    if (SDL_RWread(src, data, 1, size) != size) {
+        SDL_free(data);
+        SDL_RWclose(src);
+        Mix_SetError("Seek index of %s is truncated", file);
+        return -1;
+    }
+    SDL_RWclose(src);
+
+    Mix_LockAudio();
+    retval = music->interface->SetSeekIndex(music->context, data, size);
+    Mix_UnlockAudio();
+
+    SDL_free(data);
+    return retval;
+}
+
+
+int MIXCALLCC Mix_SaveMIDISongCache_RW(SDL_RWops *src, int freesrc, SDL_RWops *dst)
+{
+#if defined(MUSIC_HAS_MIDI_SEQUENCER)
+    void *seq, *bytes, *data = NULL;
+    size_t bytes_size = 0, size = 0;
+    int retval = -1;
+
+    if (!src || !dst) {
+        if (src && freesrc) {
+            SDL_RWclose(src);
+        }
+        Mix_SetError("RWops pointer is NULL");
+        return -1;
+    }
+
+    bytes = SDL_LoadFile_RW(src, &bytes_size, freesrc);
+    if (!bytes) {
+        return -1;
+    }
+
+    if (!(seq = midi_seq_init_silent())) {
+        SDL_free(bytes);
+        return SDL_OutOfMemory();
+    }
+
+    if (midi_seq_openData(seq, bytes, (unsigned long)bytes_size) < 0) {
+        Mix_SetError("Failed to load MIDI song: %s", midi_seq_get_error(seq));
+    } else if (midi_seq_save_cache(seq, &data, &size) < 0) {
+        Mix_SetError("Failed to build the MIDI song cache");
+    } else if (SDL_RWwrite(dst, data, 1, size) != size) {
+        Mix_SetError("Failed to write the MIDI song cache");
+    } else {
+        retval = 0;
+    }
+
+    if (data) {
+        SDL_free(data);
+    }
+    midi_seq_free(seq);
+    SDL_free(bytes);
+    return retval;
+#else
+    if (src && freesrc) {
+        SDL_RWclose(src);
+    }
+    (void)dst;
+    Mix_SetError("MIDI song cache requires FluidSynth or Native MIDI player");
+    return -1;
+#endif
+}
+
+int MIXCALLCC Mix_SaveMIDISongCache(const char *file, const char *cache_file)
+{
+    SDL_RWops *src, *dst;
+    int retval;
+
+    src = SDL_RWFromFile(file, "rb");
+    if (!src) {
+        return -1;
+    }
+
+    dst = SDL_RWFromFile(cache_file, "wb");
+    if (!dst) {
+        SDL_RWclose(src);
+        return -1;
+    }
+
+    retval = Mix_SaveMIDISongCache_RW(src, SDL_TRUE, dst);
+    if (SDL_RWclose(dst) < 0) {
+        retval = -1;
+    }
+    return retval;
+}
+
+
 /* Set the music's initial volume */
 static void music_internal_initialize_volume(void)
 {
@@ -3075,6 +3395,42 @@ const char* MIXCALLCC Mix_GetTimidityCfg(void)
     return timidity_cfg;
 }
 
+int MIXCALLCC Mix_Timidity_getInterpolation(void)
+{
+#ifdef MUSIC_MID_TIMIDITY
+    return _Mix_Timidity_getInterpolation();
+#else
+    return -1;
+#endif
+}
+
+void MIXCALLCC Mix_Timidity_setInterpolation(int interpolation)
+{
+#ifdef MUSIC_MID_TIMIDITY
+    _Mix_Timidity_setInterpolation(interpolation);
+#else
+    (void)interpolation;
+#endif
+}
+
+int MIXCALLCC Mix_Timidity_getPolyphony(void)
+{
+#ifdef MUSIC_MID_TIMIDITY
+    return _Mix_Timidity_getPolyphony();
+#else
+    return -1;
+#endif
+}
+
+void MIXCALLCC Mix_Timidity_setPolyphony(int voices)
+{
+#ifdef MUSIC_MID_TIMIDITY
+    _Mix_Timidity_setPolyphony(voices);
+#else
+    (void)voices;
+#endif
+}
+
 int MIXCALLCC Mix_SetSoundFonts(const char *paths)
 {
     if (soundfont_paths) {
@@ -3163,6 +3519,15 @@ int MIXCALLCC Mix_EachSoundFontEx(const char* cpaths, int (SDLCALL *function)(co
     return (soundfonts_found > 0);
 }
 
+int MIXCALLCC Mix_FlushSoundFontCache(void)
+{
+#ifdef MUSIC_MID_FLUIDLITE
+    return _Mix_FLUIDSYNTH_FlushSoundFonts();
+#else
+    return 0;
+#endif
+}
+
 
 int MIXCALLCC Mix_GetMidiPlayer()
 {
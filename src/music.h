@@ -158,6 +158,22 @@ typedef struct
     /* Tell a loop length position (in seconds) */
     double (*LoopLength)(void *music);
 
+    /* MIXER-X: Build the seek index for the fast seeking. Called without the
+     * audio lock: the codec takes it itself to touch the playback state */
+    int (*BuildSeekIndex)(void *music);
+
+    /* MIXER-X: Export the seek index into the new buffer (free it with SDL_free()) */
+    int (*GetSeekIndex)(void *music, void **data, size_t *size);
+
+    /* MIXER-X: Import the seek index previously exported by GetSeekIndex() */
+    int (*SetSeekIndex)(void *music, const void *data, size_t size);
+
+    /* MIXER-X: Get the count of songs stored in the file (GME) */
+    int (*GetNumTracks)(void *music);
+
+    /* MIXER-X: Switch to another song of the file without reopening it */
+    int (*StartTrack)(void *music, int track);
+
     /* Get a meta-tag string if available */
     const char* (*GetMetaTag)(void *music, Mix_MusicMetaTag tag_type);
 
@@ -185,6 +201,9 @@ typedef struct
 extern int get_num_music_interfaces(void);
 extern Mix_MusicInterface *get_music_interface(int index);
 extern Mix_MusicType detect_music_type(SDL_RWops *src);
+
+/* MIXER-X: Magic of the song cache made by the built-in MIDI sequencer */
+#define MIDI_SONG_CACHE_MAGIC   "BWSQCACH"
 extern SDL_bool load_music_type(Mix_MusicType type);
 extern SDL_bool open_music_type(Mix_MusicType type);
 extern SDL_bool open_music_type_ex(Mix_MusicType type, int midi_device);
@@ -192,6 +211,82 @@ extern SDL_bool has_music(Mix_MusicType type);
 extern void open_music(const SDL_AudioSpec *spec);
 extern int music_pcm_getaudio(void *context, void *data, int bytes, int volume,
                               int (*GetSome)(void *context, void *data, int bytes, SDL_bool *done));
+/* Format and sample rate conversion stage shared by all music codecs,
+ * a drop-in replacement of SDL_AudioStream that uses the resampler
+ * selected by Mix_SetMusicResampleQuality() */
+typedef struct _Mix_MusicStream Mix_MusicStream;
+
+extern Mix_MusicStream *music_stream_new(SDL_AudioFormat src_format, Uint8 src_channels, int src_rate,
+                                         SDL_AudioFormat dst_format, Uint8 dst_channels, int dst_rate);
+extern int music_stream_put(Mix_MusicStream *stream, const void *buf, int len);
+extern int music_stream_get(Mix_MusicStream *stream, void *buf, int len);
+extern int music_stream_flush(Mix_MusicStream *stream);
+extern void music_stream_clear(Mix_MusicStream *stream);
+extern void music_stream_free(Mix_MusicStream *stream);
+
+/* PCM cache of the loop start, lets the codecs to wrap the loop while a
+ * worker thread shared by all caches seeks the decoder past the cached frames. The length is set
+ * by Mix_SetMusicLoopCache(). A zero-filled structure is a valid empty cache.
+ *
+ * After a wrap, the decoder belongs to the worker: the codec may only call
+ * music_loop_cache_feed() until music_loop_cache_sync() returns, and Seek,
+ * Tell and Delete of the codec must go through music_loop_cache_stop(),
+ * music_loop_cache_tell() or music_loop_cache_free() first. */
+typedef struct _Mix_MusicLoopCache
+{
+    Uint8 *data;
+    int size;           /* Bytes allocated */
+    int filled;         /* Bytes captured */
+    int frame_size;
+    Sint64 start;       /* First cached PCM frame */
+    int read_pos;
+    SDL_bool playing;
+    SDL_bool seeking;       /* The worker owns the decoder */
+    SDL_bool seek_pending;  /* No worker, seek at the next sync */
+    SDL_bool seek_failed;
+    int seek_result;
+    int (*seek)(void *context, Sint64 frame); /* Returns 0, or -1 on failure */
+    void *seek_context;
+    struct _Mix_LoopCacheWorker *worker;    /* Shared worker used by this cache */
+    SDL_sem *done;
+    struct _Mix_MusicLoopCache *next_job;   /* Link in the job queue of the worker */
+} Mix_MusicLoopCache;
+
+extern int music_loop_cache_setup(Mix_MusicLoopCache *cache, Sint64 start, Sint64 length, int frame_size, int rate,
+                                  int (*seek)(void *context, Sint64 frame), void *context);
+extern void music_loop_cache_capture(Mix_MusicLoopCache *cache, Sint64 pos, const void *data, int bytes);
+extern SDL_bool music_loop_cache_wrap(Mix_MusicLoopCache *cache);
+extern int music_loop_cache_feed(Mix_MusicLoopCache *cache, Mix_MusicStream *stream, int bytes);
+/* Returns 1 when the decoder was just moved past the cache, 0 if nothing
+ * changed, or -1 if the seek has failed */
+extern int music_loop_cache_sync(Mix_MusicLoopCache *cache);
+extern void music_loop_cache_wait(Mix_MusicLoopCache *cache);
+/* Returns the played PCM frame while the decoder is not in sync, or -1 */
+extern Sint64 music_loop_cache_tell(Mix_MusicLoopCache *cache);
+extern void music_loop_cache_stop(Mix_MusicLoopCache *cache);
+extern void music_loop_cache_free(Mix_MusicLoopCache *cache);
+
+/* Pool of warm synthesizer instances of MIDI backends, reused by the next
+ * songs of the same configuration, and the cache of custom bank files.
+ * Initialized on the backend load and released on the backend unload. */
+typedef struct _Mix_SynthPoolItem Mix_SynthPoolItem;
+typedef struct _Mix_SynthPoolBank Mix_SynthPoolBank;
+
+typedef struct
+{
+    SDL_mutex *lock;
+    void (*close_synth)(void *synth);
+    Mix_SynthPoolItem *idle;
+    int idle_count;
+    Mix_SynthPoolBank *banks;
+} Mix_SynthPool;
+
+extern int music_synth_pool_init(Mix_SynthPool *pool, void (*close_synth)(void *synth));
+extern void *music_synth_pool_take(Mix_SynthPool *pool, const char *key);
+extern void music_synth_pool_give(Mix_SynthPool *pool, const char *key, void *synth);
+extern const void *music_synth_pool_bank(Mix_SynthPool *pool, const char *path, size_t *size);
+extern void music_synth_pool_quit(Mix_SynthPool *pool);
+
 extern void SDLCALL multi_music_mixer(void *udata, Uint8 *stream, int len);
 extern void SDLCALL music_mixer(void *udata, Uint8 *stream, int len);
 extern void pause_async_music(int pause_on);
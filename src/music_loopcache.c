@@ -0,0 +1,395 @@
+/*
+  SDL Mixer X:  An extended audio mixer library, forked from SDL_mixer
+  Copyright (C) 2014-2022 Vitaly Novichkov <admin@wohlnet.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* MIXER-X: PCM cache of the loop start.
+ *
+ * The first time the decoder passes through the loop start, the decoded
+ * frames are copied into the cache. When the loop wraps, the codec plays
+ * the cached frames, and meanwhile the worker thread shared by all caches
+ * seeks the decoder past them. The codec doesn't touch the decoder until the cached
+ * frames were sent to the output stream, and then it waits for the worker
+ * only if the seek took longer than the cache lasts.
+ *
+ * Without the worker (the thread couldn't be created), the seek happens at
+ * the audio thread once the cached frames were played.
+ */
+
+#include "SDL_mixer.h"
+#include "music.h"
+
+static int music_loop_cache_ms = 0;
+
+int MIXCALLCC Mix_SetMusicLoopCache(int milliseconds)
+{
+    if (milliseconds < 0) {
+        Mix_SetError("Invalid loop cache length %d", milliseconds);
+        return -1;
+    }
+    music_loop_cache_ms = milliseconds;
+    return 0;
+}
+
+int MIXCALLCC Mix_GetMusicLoopCache(void)
+{
+    return music_loop_cache_ms;
+}
+
+
+static Sint64 music_loop_cache_end(Mix_MusicLoopCache *cache)
+{
+    return cache->start + (cache->filled / cache->frame_size);
+}
+
+/* One worker thread serves the caches of all songs: it runs while any song
+ * with a cache is loaded. Caches keep the worker which they were registered
+ * with, so a worker which is being stopped never gets new jobs. */
+struct _Mix_LoopCacheWorker
+{
+    SDL_Thread *thread;
+    SDL_sem *jobs;
+    Mix_MusicLoopCache *head;
+    Mix_MusicLoopCache *tail;
+    int users;
+    SDL_bool quit;
+};
+
+/* Guards the current worker, and the job queue and users of every worker */
+static SDL_SpinLock loop_cache_lock = 0;
+static struct _Mix_LoopCacheWorker *loop_cache_worker = NULL;
+
+static int SDLCALL music_loop_cache_worker(void *data)
+{
+    struct _Mix_LoopCacheWorker *worker = (struct _Mix_LoopCacheWorker *)data;
+    Mix_MusicLoopCache *cache;
+
+    for (;;) {
+        SDL_SemWait(worker->jobs);
+        SDL_AtomicLock(&loop_cache_lock);
+        cache = worker->head;
+        if (cache) {
+            worker->head = cache->next_job;
+            if (!worker->head) {
+                worker->tail = NULL;
+            }
+            cache->next_job = NULL;
+        }
+        SDL_AtomicUnlock(&loop_cache_lock);
+
+        if (!cache) {
+            if (worker->quit) {
+                break;
+            }
+            continue;
+        }
+        cache->seek_result = cache->seek(cache->seek_context, music_loop_cache_end(cache));
+        SDL_SemPost(cache->done);
+    }
+    return 0;
+}
+
+static void music_loop_cache_worker_free(struct _Mix_LoopCacheWorker *worker)
+{
+    if (worker->thread) {
+        worker->quit = SDL_TRUE;
+        SDL_SemPost(worker->jobs);
+        SDL_WaitThread(worker->thread, NULL);
+    }
+    if (worker->jobs) {
+        SDL_DestroySemaphore(worker->jobs);
+    }
+    SDL_free(worker);
+}
+
+static struct _Mix_LoopCacheWorker *music_loop_cache_worker_new(void)
+{
+    struct _Mix_LoopCacheWorker *worker;
+
+    worker = (struct _Mix_LoopCacheWorker *)SDL_calloc(1, sizeof(struct _Mix_LoopCacheWorker));
+    if (!worker) {
+        return NULL;
+    }
+    worker->jobs = SDL_CreateSemaphore(0);
+    if (worker->jobs) {
+        worker->thread = SDL_CreateThread(music_loop_cache_worker, "Mix_LoopCache", worker);
+    }
+    if (!worker->thread) {
+        music_loop_cache_worker_free(worker);
+        return NULL;
+    }
+    return worker;
+}
+
+/* Take the shared worker for the cache, start it if there is none yet */
+static void music_loop_cache_register(Mix_MusicLoopCache *cache)
+{
+    struct _Mix_LoopCacheWorker *worker, *spare = NULL;
+
+    cache->done = SDL_CreateSemaphore(0);
+    if (!cache->done) {
+        return; /* Seek at the audio thread instead */
+    }
+
+    SDL_AtomicLock(&loop_cache_lock);
+    worker = loop_cache_worker;
+    if (worker) {
+        worker->users++;
+    }
+    SDL_AtomicUnlock(&loop_cache_lock);
+
+    if (!worker) {
+        spare = music_loop_cache_worker_new();
+        if (!spare) {
+            SDL_DestroySemaphore(cache->done);
+            cache->done = NULL;
+            return; /* Seek at the audio thread instead */
+        }
+        SDL_AtomicLock(&loop_cache_lock);
+        worker = loop_cache_worker;
+        if (!worker) {
+            /* Nobody has started one meanwhile */
+            worker = loop_cache_worker = spare;
+            spare = NULL;
+        }
+        worker->users++;
+        SDL_AtomicUnlock(&loop_cache_lock);
+        if (spare) {
+            music_loop_cache_worker_free(spare);
+        }
+    }
+
+    cache->worker = worker;
+}
+
+/* Give the worker back, it stops together with its last user */
+static void music_loop_cache_unregister(Mix_MusicLoopCache *cache)
+{
+    struct _Mix_LoopCacheWorker *worker = cache->worker;
+    SDL_bool last;
+
+    SDL_AtomicLock(&loop_cache_lock);
+    last = (--worker->users == 0);
+    if (last && loop_cache_worker == worker) {
+        loop_cache_worker = NULL;
+    }
+    SDL_AtomicUnlock(&loop_cache_lock);
+
+    if (last) {
+        music_loop_cache_worker_free(worker);
+    }
+    SDL_DestroySemaphore(cache->done);
+    cache->done = NULL;
+    cache->worker = NULL;
+}
+
+static void music_loop_cache_queue(Mix_MusicLoopCache *cache)
+{
+    struct _Mix_LoopCacheWorker *worker = cache->worker;
+
+    SDL_AtomicLock(&loop_cache_lock);
+    cache->next_job = NULL;
+    if (worker->tail) {
+        worker->tail->next_job = cache;
+    } else {
+        worker->head = cache;
+    }
+    worker->tail = cache;
+    SDL_AtomicUnlock(&loop_cache_lock);
+    SDL_SemPost(worker->jobs);
+}
+
+int music_loop_cache_setup(Mix_MusicLoopCache *cache, Sint64 start, Sint64 length, int frame_size, int rate,
+                           int (*seek)(void *context, Sint64 frame), void *context)
+{
+    Sint64 frames;
+
+    /* Drop the frames of the previous setup, the worker stays */
+    music_loop_cache_stop(cache);
+    if (cache->data) {
+        SDL_free(cache->data);
+        cache->data = NULL;
+    }
+    cache->size = 0;
+    cache->filled = 0;
+    cache->read_pos = 0;
+
+    frames = ((Sint64)music_loop_cache_ms * rate) / 1000;
+    if (frames > length) {
+        frames = length;
+    }
+    if (frames <= 0 || frame_size <= 0) {
+        return 0; /* Disabled */
+    }
+
+    cache->data = (Uint8 *)SDL_malloc((size_t)(frames * frame_size));
+    if (!cache->data) {
+        return SDL_OutOfMemory();
+    }
+    cache->size = (int)(frames * frame_size);
+    cache->frame_size = frame_size;
+    cache->start = start;
+    cache->seek = seek;
+    cache->seek_context = context;
+
+    if (!cache->worker) {
+        music_loop_cache_register(cache);
+    }
+    return 0;
+}
+
+void music_loop_cache_capture(Mix_MusicLoopCache *cache, Sint64 pos, const void *data, int bytes)
+{
+    Sint64 next, offset;
+    int amount;
+
+    if (!cache->data || cache->filled >= cache->size || cache->playing) {
+        return;
+    }
+
+    /* Only take the frames that continue what was captured already */
+    next = music_loop_cache_end(cache);
+    if (next < pos || next >= pos + (bytes / cache->frame_size)) {
+        return;
+    }
+
+    offset = (next - pos) * cache->frame_size;
+    amount = bytes - (int)offset;
+    if (amount > cache->size - cache->filled) {
+        amount = cache->size - cache->filled;
+    }
+    SDL_memcpy(cache->data + cache->filled, (const Uint8 *)data + offset, (size_t)amount);
+    cache->filled += amount;
+}
+
+SDL_bool music_loop_cache_wrap(Mix_MusicLoopCache *cache)
+{
+    if (!cache->data || cache->filled < cache->size) {
+        return SDL_FALSE;
+    }
+    cache->read_pos = 0;
+    cache->playing = SDL_TRUE;
+    if (cache->worker) {
+        /* The decoder is left to the worker until the next sync */
+        cache->seeking = SDL_TRUE;
+        music_loop_cache_queue(cache);
+    } else {
+        cache->seek_pending = SDL_TRUE;
+    }
+    return SDL_TRUE;
+}
+
+int music_loop_cache_feed(Mix_MusicLoopCache *cache, Mix_MusicStream *stream, int bytes)
+{
+    int amount;
+
+    if (!cache->playing) {
+        return 0;
+    }
+
+    amount = cache->filled - cache->read_pos;
+    if (amount > bytes) {
+        amount = bytes - (bytes % cache->frame_size);
+        if (amount <= 0) {
+            amount = cache->frame_size;
+        }
+    }
+
+    if (music_stream_put(stream, cache->data + cache->read_pos, amount) < 0) {
+        return -1;
+    }
+
+    cache->read_pos += amount;
+    if (cache->read_pos >= cache->filled) {
+        cache->playing = SDL_FALSE;
+    }
+    return 1;
+}
+
+void music_loop_cache_wait(Mix_MusicLoopCache *cache)
+{
+    if (!cache->seeking) {
+        return;
+    }
+    SDL_SemWait(cache->done);
+    cache->seeking = SDL_FALSE;
+    if (cache->seek_result < 0) {
+        cache->seek_failed = SDL_TRUE;
+    }
+}
+
+int music_loop_cache_sync(Mix_MusicLoopCache *cache)
+{
+    int result = 0;
+
+    if (cache->playing) {
+        return 0;
+    }
+
+    if (cache->seeking) {
+        music_loop_cache_wait(cache);
+        result = 1;
+    } else if (cache->seek_pending) {
+        cache->seek_pending = SDL_FALSE;
+        if (cache->seek(cache->seek_context, music_loop_cache_end(cache)) < 0) {
+            cache->seek_failed = SDL_TRUE;
+        }
+        result = 1;
+    }
+
+    if (cache->seek_failed) {
+        cache->seek_failed = SDL_FALSE;
+        Mix_SetError("Couldn't seek the decoder past the cached loop start");
+        return -1;
+    }
+    return result;
+}
+
+Sint64 music_loop_cache_tell(Mix_MusicLoopCache *cache)
+{
+    if (cache->playing) {
+        return cache->start + (cache->read_pos / cache->frame_size);
+    }
+    if (cache->seeking || cache->seek_pending) {
+        return music_loop_cache_end(cache);
+    }
+    return -1;
+}
+
+void music_loop_cache_stop(Mix_MusicLoopCache *cache)
+{
+    music_loop_cache_wait(cache);
+    cache->playing = SDL_FALSE;
+    cache->seek_pending = SDL_FALSE;
+    cache->seek_failed = SDL_FALSE;
+}
+
+void music_loop_cache_free(Mix_MusicLoopCache *cache)
+{
+    music_loop_cache_stop(cache);
+    if (cache->worker) {
+        music_loop_cache_unregister(cache);
+    }
+    if (cache->data) {
+        SDL_free(cache->data);
+    }
+    SDL_zerop(cache);
+}
+
+/* vi: set ts=4 sw=4 expandtab: */
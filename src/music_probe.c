@@ -0,0 +1,1271 @@
+/*
+  SDL Mixer X:  An extended audio mixer library, forked from SDL_mixer
+  Copyright (C) 2014-2022 Vitaly Novichkov <admin@wohlnet.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* MIXER-X: Probing of music files without creating of decoders.
+ *
+ * The type, length, loop points, format and tags are taken from the file
+ * headers only. Formats which have no header parser here (trackers, GME,
+ * XMI/MUS and other MIDI-like formats) are loaded in full as a fallback.
+ */
+
+#include "SDL_thread.h"
+#include "SDL_atomic.h"
+#include "SDL_cpuinfo.h"
+
+#include "SDL_mixer.h"
+#include "music.h"
+#include "utils.h"
+#include "codecs/mp3utils.h"
+
+/* Largest header packet or metadata block to read, bigger ones are skipped */
+#define PROBE_MAX_BLOCK     (16 * 1024 * 1024)
+/* Size of the window used to find the last Ogg page */
+#define PROBE_OGG_WINDOW    65536
+/* How many windows to try before giving up on the Ogg stream length */
+#define PROBE_OGG_WINDOWS   16
+/* How many bytes to scan to find the first MP3 frame */
+#define PROBE_MP3_SCAN      65536
+
+typedef struct
+{
+    Mix_MusicInfo *info;
+    Mix_MusicMetaTags tags;
+    Sint64 loop_start;
+    Sint64 loop_end;
+    Sint64 loop_len;
+    SDL_bool is_loop_length;
+    SDL_bool has_loop;
+} ProbeState;
+
+
+static void probe_info_reset(Mix_MusicInfo *info)
+{
+    SDL_zerop(info);
+    info->type = MUS_NONE;
+    info->duration = -1.0;
+    info->loop_start = -1.0;
+    info->loop_end = -1.0;
+}
+
+static void *probe_read_block(SDL_RWops *src, Uint32 size)
+{
+    Uint8 *data;
+
+    if (size > PROBE_MAX_BLOCK) {
+        return NULL;
+    }
+    data = (Uint8 *)SDL_malloc(size + 1);
+    if (!data) {
+        return NULL;
+    }
+    if (size > 0 && SDL_RWread(src, data, size, 1) != 1) {
+        SDL_free(data);
+        return NULL;
+    }
+    data[size] = '\0';
+    return data;
+}
+
+/* Vorbis comment list, the same for Vorbis, Opus and FLAC */
+static void probe_vorbis_comments(ProbeState *st, const Uint8 *data, size_t size, long rate)
+{
+    size_t pos = 0;
+    Uint32 len, count, i;
+    char *param, *argument, *value;
+
+    st->is_loop_length = SDL_FALSE;
+
+    if (size < 8) {
+        return;
+    }
+    len = (Uint32)data[0] | ((Uint32)data[1] << 8) | ((Uint32)data[2] << 16) | ((Uint32)data[3] << 24);
+    if ((size_t)len > size - 8) {
+        return;
+    }
+    pos = 4 + (size_t)len;
+    count = (Uint32)data[pos] | ((Uint32)data[pos + 1] << 8) | ((Uint32)data[pos + 2] << 16) | ((Uint32)data[pos + 3] << 24);
+    pos += 4;
+
+    for (i = 0; i < count && pos + 4 <= size; ++i) {
+        len = (Uint32)data[pos] | ((Uint32)data[pos + 1] << 8) | ((Uint32)data[pos + 2] << 16) | ((Uint32)data[pos + 3] << 24);
+        pos += 4;
+        if ((size_t)len > size - pos) {
+            break;
+        }
+
+        param = (char *)SDL_malloc((size_t)len + 1);
+        if (!param) {
+            break;
+        }
+        SDL_memcpy(param, data + pos, len);
+        param[len] = '\0';
+        pos += len;
+
+        argument = param;
+        value = SDL_strchr(param, '=');
+        if (value == NULL) {
+            value = param + SDL_strlen(param);
+        } else {
+            *(value++) = '\0';
+        }
+
+        /* Want to match LOOP-START, LOOP_START, etc. Remove - or _ from
+         * string if it is present at position 4. */
+        if (_Mix_IsLoopTag(argument) && ((argument[4] == '_') || (argument[4] == '-'))) {
+            SDL_memmove(argument + 4, argument + 5, SDL_strlen(argument) - 4);
+        }
+
+        if (SDL_strcasecmp(argument, "LOOPSTART") == 0) {
+            st->loop_start = _Mix_ParseTime(value, rate);
+            st->has_loop = SDL_TRUE;
+        } else if (SDL_strcasecmp(argument, "LOOPLENGTH") == 0) {
+            st->loop_len = SDL_strtoll(value, NULL, 10);
+            st->is_loop_length = SDL_TRUE;
+        } else if (SDL_strcasecmp(argument, "LOOPEND") == 0) {
+            st->loop_end = _Mix_ParseTime(value, rate);
+            st->is_loop_length = SDL_FALSE;
+        } else if (SDL_strcasecmp(argument, "TITLE") == 0) {
+            meta_tags_set(&st->tags, MIX_META_TITLE, value);
+        } else if (SDL_strcasecmp(argument, "ARTIST") == 0) {
+            meta_tags_set(&st->tags, MIX_META_ARTIST, value);
+        } else if (SDL_strcasecmp(argument, "ALBUM") == 0) {
+            meta_tags_set(&st->tags, MIX_META_ALBUM, value);
+        } else if (SDL_strcasecmp(argument, "COPYRIGHT") == 0) {
+            meta_tags_set(&st->tags, MIX_META_COPYRIGHT, value);
+        }
+        SDL_free(param);
+    }
+
+    if (st->is_loop_length) {
+        st->loop_end = st->loop_start + st->loop_len;
+    }
+}
+
+/* Loop points in samples into seconds, with the same validation as codecs do */
+static void probe_apply_loop(ProbeState *st, Sint64 full_length, long rate)
+{
+    if (!st->has_loop || rate <= 0) {
+        return;
+    }
+    if (st->loop_end <= 0 && full_length > 0) {
+        st->loop_end = full_length; /* Loop until the end */
+    }
+    if (st->loop_start < 0 || st->loop_end <= 0 || st->loop_start >= st->loop_end ||
+        (full_length > 0 && st->loop_end > full_length)) {
+        return;
+    }
+    st->info->loop_start = (double)st->loop_start / rate;
+    st->info->loop_end = (double)st->loop_end / rate;
+}
+
+
+/* ================================ Ogg ===================================== */
+
+typedef struct
+{
+    SDL_RWops *src;
+    Uint32 serial;
+    SDL_bool have_serial;
+    Uint8 lacing[255];
+    int segments;
+    int segment;
+    Uint8 *page;
+    Uint32 page_size;
+    Uint32 page_pos;
+} ProbeOggReader;
+
+static SDL_bool probe_ogg_next_page(ProbeOggReader *r)
+{
+    Uint8 header[27];
+    Uint32 serial, size;
+    int i;
+
+    for (;;) {
+        if (SDL_RWread(r->src, header, 27, 1) != 1 || SDL_memcmp(header, "OggS", 4) != 0) {
+            return SDL_FALSE;
+        }
+        serial = (Uint32)header[14] | ((Uint32)header[15] << 8) | ((Uint32)header[16] << 16) | ((Uint32)header[17] << 24);
+        r->segments = header[26];
+        if (SDL_RWread(r->src, r->lacing, 1, (size_t)r->segments) != (size_t)r->segments) {
+            return SDL_FALSE;
+        }
+        size = 0;
+        for (i = 0; i < r->segments; ++i) {
+            size += r->lacing[i];
+        }
+
+        if (!r->have_serial) {
+            r->serial = serial;
+            r->have_serial = SDL_TRUE;
+        }
+
+        if (serial != r->serial) {
+            /* Skip pages of other logical streams */
+            if (SDL_RWseek(r->src, size, RW_SEEK_CUR) < 0) {
+                return SDL_FALSE;
+            }
+            continue;
+        }
+
+        if (r->page) {
+            SDL_free(r->page);
+        }
+        r->page = (Uint8 *)probe_read_block(r->src, size);
+        if (!r->page) {
+            return SDL_FALSE;
+        }
+        r->page_size = size;
+        r->page_pos = 0;
+        r->segment = 0;
+        return SDL_TRUE;
+    }
+}
+
+/* Reads the next complete packet of the first logical stream */
+static Uint8 *probe_ogg_packet(ProbeOggReader *r, size_t *out_size)
+{
+    Uint8 *packet = NULL, *grown;
+    size_t size = 0;
+    Uint8 lace;
+
+    for (;;) {
+        if (!r->page || r->segment >= r->segments) {
+            if (!probe_ogg_next_page(r)) {
+                break;
+            }
+            continue;
+        }
+
+        lace = r->lacing[r->segment++];
+        if (size + lace > PROBE_MAX_BLOCK) {
+            break;
+        }
+        grown = (Uint8 *)SDL_realloc(packet, size + lace + 1);
+        if (!grown) {
+            break;
+        }
+        packet = grown;
+        SDL_memcpy(packet + size, r->page + r->page_pos, lace);
+        r->page_pos += lace;
+        size += lace;
+
+        if (lace < 255) {
+            packet[size] = '\0';
+            *out_size = size;
+            return packet;
+        }
+    }
+
+    if (packet) {
+        SDL_free(packet);
+    }
+    return NULL;
+}
+
+/* Finds the granule position of the last page of the stream */
+static Sint64 probe_ogg_last_granule(SDL_RWops *src, Sint64 start, Uint32 serial)
+{
+    Uint8 *buffer;
+    Sint64 end, window_start, granule = -1;
+    size_t got;
+    int window, i;
+
+    end = SDL_RWseek(src, 0, RW_SEEK_END);
+    if (end < 0) {
+        return -1;
+    }
+
+    buffer = (Uint8 *)SDL_malloc(PROBE_OGG_WINDOW);
+    if (!buffer) {
+        return -1;
+    }
+
+    for (window = 0; window < PROBE_OGG_WINDOWS && granule < 0 && end > start; ++window) {
+        window_start = end - PROBE_OGG_WINDOW;
+        if (window_start < start) {
+            window_start = start;
+        }
+        if (SDL_RWseek(src, window_start, RW_SEEK_SET) < 0) {
+            break;
+        }
+        got = SDL_RWread(src, buffer, 1, (size_t)(end - window_start));
+        for (i = (int)got - 27; i >= 0; --i) {
+            Uint32 page_serial;
+            Sint64 page_granule;
+            int b;
+            if (SDL_memcmp(buffer + i, "OggS", 4) != 0) {
+                continue;
+            }
+            page_serial = (Uint32)buffer[i + 14] | ((Uint32)buffer[i + 15] << 8) |
+                          ((Uint32)buffer[i + 16] << 16) | ((Uint32)buffer[i + 17] << 24);
+            page_granule = 0;
+            for (b = 7; b >= 0; --b) {
+                page_granule = (page_granule << 8) | buffer[i + 6 + b];
+            }
+            if (page_serial == serial && page_granule >= 0) {
+                granule = page_granule;
+                break;
+            }
+        }
+        /* Overlap the windows by a page header */
+        end = window_start + 27;
+        if (window_start == start) {
+            break;
+        }
+    }
+
+    SDL_free(buffer);
+    return granule;
+}
+
+static int probe_ogg(SDL_RWops *src, ProbeState *st, SDL_bool opus)
+{
+    ProbeOggReader r;
+    Uint8 *head, *tags;
+    size_t head_size, tags_size;
+    Sint64 start = SDL_RWtell(src), granule;
+    Sint64 pre_skip = 0;
+    long rate;
+
+    SDL_zero(r);
+    r.src = src;
+
+    head = probe_ogg_packet(&r, &head_size);
+    if (!head) {
+        if (r.page) {
+            SDL_free(r.page);
+        }
+        Mix_SetError("Ogg: couldn't read the identification header");
+        return -1;
+    }
+
+    if (opus) {
+        if (head_size < 19 || SDL_memcmp(head, "OpusHead", 8) != 0) {
+            SDL_free(head);
+            SDL_free(r.page);
+            Mix_SetError("Opus: invalid identification header");
+            return -1;
+        }
+        st->info->channels = head[9];
+        pre_skip = (Sint64)head[10] | ((Sint64)head[11] << 8);
+        /* Opus is always decoded at 48000 Hz */
+        st->info->rate = 48000;
+    } else {
+        if (head_size < 30 || head[0] != 1 || SDL_memcmp(head + 1, "vorbis", 6) != 0) {
+            SDL_free(head);
+            SDL_free(r.page);
+            Mix_SetError("Ogg Vorbis: invalid identification header");
+            return -1;
+        }
+        st->info->channels = head[11];
+        st->info->rate = (int)((Uint32)head[12] | ((Uint32)head[13] << 8) | ((Uint32)head[14] << 16) | ((Uint32)head[15] << 24));
+    }
+    SDL_free(head);
+    rate = st->info->rate;
+
+    tags = probe_ogg_packet(&r, &tags_size);
+    if (tags) {
+        if (opus && tags_size >= 8 && SDL_memcmp(tags, "OpusTags", 8) == 0) {
+            probe_vorbis_comments(st, tags + 8, tags_size - 8, rate);
+        } else if (!opus && tags_size >= 7 && tags[0] == 3 && SDL_memcmp(tags + 1, "vorbis", 6) == 0) {
+            probe_vorbis_comments(st, tags + 7, tags_size - 7, rate);
+        }
+        SDL_free(tags);
+    }
+    if (r.page) {
+        SDL_free(r.page);
+    }
+
+    granule = probe_ogg_last_granule(src, start, r.serial);
+    if (granule >= 0 && rate > 0) {
+        granule -= pre_skip;
+        if (granule < 0) {
+            granule = 0;
+        }
+        st->info->duration = (double)granule / rate;
+    }
+
+    probe_apply_loop(st, granule, rate);
+    return 0;
+}
+
+
+/* ================================ FLAC ==================================== */
+
+static int probe_flac(SDL_RWops *src, ProbeState *st)
+{
+    Uint8 magic[4], header[4], *block;
+    Uint32 size;
+    Sint64 total = -1;
+    int type;
+    SDL_bool last = SDL_FALSE;
+
+    if (SDL_RWread(src, magic, 4, 1) != 1 || SDL_memcmp(magic, "fLaC", 4) != 0) {
+        Mix_SetError("FLAC: invalid stream");
+        return -1;
+    }
+
+    while (!last) {
+        if (SDL_RWread(src, header, 4, 1) != 1) {
+            break;
+        }
+        last = (header[0] & 0x80) ? SDL_TRUE : SDL_FALSE;
+        type = header[0] & 0x7F;
+        size = ((Uint32)header[1] << 16) | ((Uint32)header[2] << 8) | header[3];
+
+        if (type == 0 && size >= 18) { /* STREAMINFO */
+            block = (Uint8 *)probe_read_block(src, size);
+            if (!block) {
+                break;
+            }
+            st->info->rate = (int)(((Uint32)block[10] << 12) | ((Uint32)block[11] << 4) | (block[12] >> 4));
+            st->info->channels = ((block[12] >> 1) & 0x07) + 1;
+            total = ((Sint64)(block[13] & 0x0F) << 32) | ((Sint64)block[14] << 24) |
+                    ((Sint64)block[15] << 16) | ((Sint64)block[16] << 8) | block[17];
+            SDL_free(block);
+        } else if (type == 4 && st->info->rate > 0) { /* VORBIS_COMMENT */
+            block = (Uint8 *)probe_read_block(src, size);
+            if (!block) {
+                break;
+            }
+            probe_vorbis_comments(st, block, size, st->info->rate);
+            SDL_free(block);
+        } else if (SDL_RWseek(src, size, RW_SEEK_CUR) < 0) {
+            break;
+        }
+    }
+
+    if (st->info->rate <= 0) {
+        Mix_SetError("FLAC: missing STREAMINFO block");
+        return -1;
+    }
+
+    /* Zero means the length is unknown */
+    if (total > 0) {
+        st->info->duration = (double)total / st->info->rate;
+    } else {
+        total = -1;
+    }
+
+    probe_apply_loop(st, total, st->info->rate);
+    return 0;
+}
+
+
+/* ============================ WAV and AIFF ================================ */
+
+static void probe_riff_info(ProbeState *st, const Uint8 *data, Uint32 size)
+{
+    Uint32 pos = 4, len;
+    Mix_MusicMetaTag tag;
+
+    if (size < 4 || SDL_memcmp(data, "INFO", 4) != 0) {
+        return;
+    }
+
+    while (pos + 8 <= size) {
+        len = (Uint32)data[pos + 4] | ((Uint32)data[pos + 5] << 8) | ((Uint32)data[pos + 6] << 16) | ((Uint32)data[pos + 7] << 24);
+        if (len > size - pos - 8) {
+            break;
+        }
+
+        tag = MIX_META_LAST;
+        if (SDL_memcmp(data + pos, "INAM", 4) == 0) {
+            tag = MIX_META_TITLE;
+        } else if (SDL_memcmp(data + pos, "IART", 4) == 0) {
+            tag = MIX_META_ARTIST;
+        } else if (SDL_memcmp(data + pos, "IALB", 4) == 0) {
+            tag = MIX_META_ALBUM;
+        } else if (SDL_memcmp(data + pos, "BCPR", 4) == 0) {
+            tag = MIX_META_COPYRIGHT;
+        }
+
+        if (tag != MIX_META_LAST && len > 0) {
+            char *value = (char *)SDL_malloc(len + 1);
+            if (value) {
+                SDL_memcpy(value, data + pos + 8, len);
+                value[len] = '\0';
+                meta_tags_set(&st->tags, tag, value);
+                SDL_free(value);
+            }
+        }
+
+        pos += 8 + len + (len & 1);
+    }
+}
+
+static int probe_wav(SDL_RWops *src, ProbeState *st)
+{
+    Uint8 header[12], *block;
+    Uint32 chunk, size;
+    Uint16 block_align = 0, encoding = 0;
+    Sint64 data_size = -1, frames = -1, fact_frames = -1;
+    Sint64 loop_start = -1, loop_end = -1;
+
+    if (SDL_RWread(src, header, 12, 1) != 1 || SDL_memcmp(header, "RIFF", 4) != 0 || SDL_memcmp(header + 8, "WAVE", 4) != 0) {
+        Mix_SetError("WAV: invalid RIFF header");
+        return -1;
+    }
+
+    for (;;) {
+        chunk = SDL_ReadLE32(src);
+        size = SDL_ReadLE32(src);
+        if (chunk == 0 && size == 0) {
+            break; /* End of file */
+        }
+
+        if (chunk == 0x20746D66 /* "fmt " */ && size >= 16) {
+            block = (Uint8 *)probe_read_block(src, size);
+            if (!block) {
+                break;
+            }
+            encoding = (Uint16)(block[0] | (block[1] << 8));
+            st->info->channels = block[2] | (block[3] << 8);
+            st->info->rate = (int)((Uint32)block[4] | ((Uint32)block[5] << 8) | ((Uint32)block[6] << 16) | ((Uint32)block[7] << 24));
+            block_align = (Uint16)(block[12] | (block[13] << 8));
+            SDL_free(block);
+        } else if (chunk == 0x74636166 /* "fact" */ && size >= 4) {
+            fact_frames = SDL_ReadLE32(src);
+            SDL_RWseek(src, size - 4, RW_SEEK_CUR);
+        } else if (chunk == 0x61746164 /* "data" */) {
+            data_size = size;
+            SDL_RWseek(src, size, RW_SEEK_CUR);
+        } else if (chunk == 0x6c706d73 /* "smpl" */ && size >= 36) {
+            block = (Uint8 *)probe_read_block(src, size);
+            if (!block) {
+                break;
+            }
+            /* The first forward loop only */
+            if (size >= 36 + 24 && (block[28] | block[29] | block[30] | block[31]) != 0) {
+                const Uint8 *l = block + 36;
+                Uint32 type = (Uint32)l[4] | ((Uint32)l[5] << 8) | ((Uint32)l[6] << 16) | ((Uint32)l[7] << 24);
+                if (type == 0) {
+                    loop_start = (Sint64)((Uint32)l[8] | ((Uint32)l[9] << 8) | ((Uint32)l[10] << 16) | ((Uint32)l[11] << 24));
+                    loop_end = (Sint64)((Uint32)l[12] | ((Uint32)l[13] << 8) | ((Uint32)l[14] << 16) | ((Uint32)l[15] << 24)) + 1;
+                }
+            }
+            SDL_free(block);
+        } else if (chunk == 0x5453494c /* "LIST" */) {
+            block = (Uint8 *)probe_read_block(src, size);
+            if (!block) {
+                break;
+            }
+            probe_riff_info(st, block, size);
+            SDL_free(block);
+        } else if (chunk == 0x20336469 /* "id3 " */ || chunk == 0x20334449 /* "ID3 " */) {
+            block = (Uint8 *)probe_read_block(src, size);
+            if (!block) {
+                break;
+            }
+            read_id3v2_from_mem(&st->tags, block, size);
+            SDL_free(block);
+        } else if (SDL_RWseek(src, size, RW_SEEK_CUR) < 0) {
+            break;
+        }
+
+        /* RIFF chunks are aligned by two bytes */
+        if (size & 1) {
+            SDL_RWseek(src, 1, RW_SEEK_CUR);
+        }
+    }
+
+    if (st->info->rate <= 0 || block_align == 0) {
+        Mix_SetError("WAV: missing fmt chunk");
+        return -1;
+    }
+
+    if (encoding == 1 /* PCM */ || encoding == 3 /* IEEE float */ || encoding == 0xFFFE /* Extensible */ ||
+        encoding == 6 /* A-law */ || encoding == 7 /* mu-law */) {
+        if (data_size >= 0) {
+            frames = data_size / block_align;
+        }
+    } else {
+        frames = fact_frames; /* Compressed formats give the length at the fact chunk */
+    }
+
+    if (frames >= 0) {
+        st->info->duration = (double)frames / st->info->rate;
+    }
+
+    if (loop_start >= 0 && loop_end > loop_start) {
+        st->info->loop_start = (double)loop_start / st->info->rate;
+        st->info->loop_end = (double)loop_end / st->info->rate;
+    }
+
+    return 0;
+}
+
+static int probe_aiff(SDL_RWops *src, ProbeState *st)
+{
+    Uint8 header[12], *block;
+    Uint32 chunk, size, frames = 0;
+    Mix_MusicMetaTag tag;
+
+    if (SDL_RWread(src, header, 12, 1) != 1 || SDL_memcmp(header, "FORM", 4) != 0) {
+        Mix_SetError("AIFF: invalid FORM header");
+        return -1;
+    }
+
+    for (;;) {
+        chunk = SDL_ReadBE32(src);
+        size = SDL_ReadBE32(src);
+        if (chunk == 0 && size == 0) {
+            break;
+        }
+
+        tag = MIX_META_LAST;
+        if (chunk == 0x434F4D4D /* "COMM" */ && size >= 18) {
+            Uint32 mantissa;
+            int exponent;
+            block = (Uint8 *)probe_read_block(src, size);
+            if (!block) {
+                break;
+            }
+            st->info->channels = (block[0] << 8) | block[1];
+            frames = ((Uint32)block[2] << 24) | ((Uint32)block[3] << 16) | ((Uint32)block[4] << 8) | block[5];
+            /* 80-bit IEEE 754 extended float, only the integer part matters */
+            exponent = ((block[8] & 0x7F) << 8) | block[9];
+            mantissa = ((Uint32)block[10] << 24) | ((Uint32)block[11] << 16) | ((Uint32)block[12] << 8) | block[13];
+            exponent -= 16383 + 31;
+            if (exponent < 0 && exponent > -32) {
+                st->info->rate = (int)(mantissa >> -exponent);
+            }
+            SDL_free(block);
+        } else if (chunk == 0x4E414D45 /* "NAME" */) {
+            tag = MIX_META_TITLE;
+        } else if (chunk == 0x41555448 /* "AUTH" */) {
+            tag = MIX_META_ARTIST;
+        } else if (chunk == 0x28632920 /* "(c) " */) {
+            tag = MIX_META_COPYRIGHT;
+        } else if (SDL_RWseek(src, size, RW_SEEK_CUR) < 0) {
+            break;
+        }
+
+        if (tag != MIX_META_LAST) {
+            block = (Uint8 *)probe_read_block(src, size);
+            if (!block) {
+                break;
+            }
+            meta_tags_set(&st->tags, tag, (const char *)block);
+            SDL_free(block);
+        }
+
+        if (size & 1) {
+            SDL_RWseek(src, 1, RW_SEEK_CUR);
+        }
+    }
+
+    if (st->info->rate <= 0) {
+        Mix_SetError("AIFF: missing COMM chunk");
+        return -1;
+    }
+
+    st->info->duration = (double)frames / st->info->rate;
+    return 0;
+}
+
+
+/* ================================ MP3 ===================================== */
+
+static const int probe_mp3_bitrates[2][3][15] =
+{
+    { /* MPEG 1 */
+        { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+        { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 }
+    },
+    { /* MPEG 2 and 2.5 */
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 }
+    }
+};
+
+static const int probe_mp3_rates[3] = { 44100, 48000, 32000 };
+
+static int probe_mp3(SDL_RWops *src, ProbeState *st)
+{
+    struct mp3file_t fil;
+    Uint8 *buffer;
+    size_t got, i;
+    int version, layer, bitrate, rate, mono, samples_per_frame, side_info;
+    Sint64 frames = -1;
+
+    if (MP3_RWinit(&fil, src) < 0) {
+        return -1;
+    }
+    /* Skips the tags: start and length will describe the audio data only */
+    if (mp3_read_tags(&st->tags, &fil, SDL_FALSE) < 0) {
+        Mix_SetError("MP3: file is too short or has corrupted tags");
+        return -1;
+    }
+
+    buffer = (Uint8 *)SDL_malloc(PROBE_MP3_SCAN);
+    if (!buffer) {
+        return Mix_OutOfMemory();
+    }
+
+    MP3_RWseek(&fil, 0, RW_SEEK_SET);
+    got = MP3_RWread(&fil, buffer, 1, PROBE_MP3_SCAN);
+
+    for (i = 0; i + 4 <= got; ++i) {
+        const Uint8 *h = buffer + i;
+        int bitrate_index, rate_index;
+        if (h[0] != 0xFF || (h[1] & 0xE0) != 0xE0) {
+            continue;
+        }
+        version = (h[1] >> 3) & 0x03; /* 0 - MPEG 2.5, 2 - MPEG 2, 3 - MPEG 1 */
+        layer = (h[1] >> 1) & 0x03;   /* 1 - Layer III, 2 - Layer II, 3 - Layer I */
+        bitrate_index = h[2] >> 4;
+        rate_index = (h[2] >> 2) & 0x03;
+        if (version == 1 || layer == 0 || bitrate_index == 0 || bitrate_index == 15 || rate_index == 3) {
+            continue;
+        }
+
+        bitrate = probe_mp3_bitrates[version == 3 ? 0 : 1][3 - layer][bitrate_index];
+        rate = probe_mp3_rates[rate_index];
+        if (version == 2) {
+            rate /= 2;
+        } else if (version == 0) {
+            rate /= 4;
+        }
+        mono = ((h[3] >> 6) == 3);
+
+        if (layer == 3) {
+            samples_per_frame = 384;
+        } else if (layer == 2 || version == 3) {
+            samples_per_frame = 1152;
+        } else {
+            samples_per_frame = 576;
+        }
+
+        st->info->rate = rate;
+        st->info->channels = mono ? 1 : 2;
+
+        /* VBR files have the frame count at the Xing or VBRI header */
+        if (version == 3) {
+            side_info = mono ? 17 : 32;
+        } else {
+            side_info = mono ? 9 : 17;
+        }
+        if (i + 4 + side_info + 12 <= got &&
+            (SDL_memcmp(h + 4 + side_info, "Xing", 4) == 0 || SDL_memcmp(h + 4 + side_info, "Info", 4) == 0)) {
+            const Uint8 *x = h + 4 + side_info;
+            if (x[7] & 0x01) {
+                frames = ((Sint64)x[8] << 24) | ((Sint64)x[9] << 16) | ((Sint64)x[10] << 8) | x[11];
+            }
+        } else if (i + 4 + 32 + 18 <= got && SDL_memcmp(h + 4 + 32, "VBRI", 4) == 0) {
+            const Uint8 *v = h + 4 + 32;
+            frames = ((Sint64)v[14] << 24) | ((Sint64)v[15] << 16) | ((Sint64)v[16] << 8) | v[17];
+        }
+
+        if (frames >= 0) {
+            st->info->duration = (double)frames * samples_per_frame / rate;
+        } else {
+            /* Constant bit rate */
+            st->info->duration = (double)(fil.length - (Sint64)i) * 8.0 / (bitrate * 1000.0);
+        }
+        break;
+    }
+
+    SDL_free(buffer);
+
+    if (st->info->rate <= 0) {
+        Mix_SetError("MP3: no frames found");
+        return -1;
+    }
+    return 0;
+}
+
+
+/* ================================ MIDI ==================================== */
+
+typedef struct
+{
+    Uint64 tick;
+    Uint32 tempo;
+} ProbeMidiTempo;
+
+static Uint32 probe_midi_vlq(const Uint8 *data, size_t size, size_t *pos)
+{
+    Uint32 value = 0;
+    int i;
+    for (i = 0; i < 4 && *pos < size; ++i) {
+        Uint8 b = data[(*pos)++];
+        value = (value << 7) | (b & 0x7F);
+        if (!(b & 0x80)) {
+            break;
+        }
+    }
+    return value;
+}
+
+static double probe_midi_time(const ProbeMidiTempo *tempos, size_t count, Uint64 tick, Uint16 division)
+{
+    double seconds = 0.0;
+    Uint64 last_tick = 0;
+    Uint32 tempo = 500000;
+    size_t i;
+
+    if (division & 0x8000) {
+        /* SMPTE time division */
+        int fps = -(Sint8)(division >> 8);
+        int ticks_per_frame = division & 0xFF;
+        if (fps <= 0 || ticks_per_frame == 0) {
+            return 0.0;
+        }
+        return (double)tick / (fps * ticks_per_frame);
+    }
+
+    if (division == 0) {
+        return 0.0;
+    }
+
+    for (i = 0; i < count && tempos[i].tick < tick; ++i) {
+        seconds += (double)(tempos[i].tick - last_tick) * tempo / (1000000.0 * division);
+        last_tick = tempos[i].tick;
+        tempo = tempos[i].tempo;
+    }
+    seconds += (double)(tick - last_tick) * tempo / (1000000.0 * division);
+    return seconds;
+}
+
+static int probe_midi(SDL_RWops *src, ProbeState *st)
+{
+    Uint8 *file = NULL, *data;
+    Sint64 file_size, start = SDL_RWtell(src);
+    size_t size, pos, track_end, count = 0, capacity = 0, i, j;
+    Uint16 tracks, division, track;
+    Uint64 tick, end_tick = 0, loop_start = 0, loop_end = 0;
+    SDL_bool has_loop_start = SDL_FALSE, has_loop_end = SDL_FALSE;
+    ProbeMidiTempo *tempos = NULL, *grown;
+    Uint8 status, type;
+    Uint32 len;
+
+    file_size = SDL_RWsize(src);
+    if (file_size > 0) {
+        file_size -= start;
+    }
+    if (file_size < 14 || file_size > PROBE_MAX_BLOCK) {
+        Mix_SetError("MIDI: invalid file size");
+        return -1;
+    }
+
+    file = (Uint8 *)probe_read_block(src, (Uint32)file_size);
+    if (!file) {
+        Mix_SetError("MIDI: couldn't read the file");
+        return -1;
+    }
+    data = file;
+    size = (size_t)file_size;
+
+    /* RIFF MIDI: the SMF data is at the "data" chunk */
+    if (SDL_memcmp(data, "RIFF", 4) == 0) {
+        pos = 12;
+        while (pos + 8 <= size) {
+            len = (Uint32)data[pos + 4] | ((Uint32)data[pos + 5] << 8) | ((Uint32)data[pos + 6] << 16) | ((Uint32)data[pos + 7] << 24);
+            if (SDL_memcmp(data + pos, "data", 4) == 0 && len <= size - pos - 8) {
+                data += pos + 8;
+                size = len;
+                break;
+            }
+            pos += 8 + (size_t)len + (len & 1);
+        }
+    }
+
+    if (size < 14 || SDL_memcmp(data, "MThd", 4) != 0) {
+        SDL_free(file);
+        Mix_SetError("MIDI: invalid header");
+        return -1;
+    }
+
+    tracks = (Uint16)((data[10] << 8) | data[11]);
+    division = (Uint16)((data[12] << 8) | data[13]);
+    pos = 8 + (((size_t)data[4] << 24) | ((size_t)data[5] << 16) | ((size_t)data[6] << 8) | data[7]);
+
+    for (track = 0; track < tracks && pos + 8 <= size; ++track) {
+        len = ((Uint32)data[pos + 4] << 24) | ((Uint32)data[pos + 5] << 16) | ((Uint32)data[pos + 6] << 8) | data[pos + 7];
+        if (SDL_memcmp(data + pos, "MTrk", 4) != 0) {
+            pos += 8 + (size_t)len;
+            --track;
+            continue;
+        }
+        pos += 8;
+        track_end = pos + len;
+        if (track_end > size) {
+            track_end = size;
+        }
+
+        tick = 0;
+        status = 0;
+        while (pos < track_end) {
+            tick += probe_midi_vlq(data, track_end, &pos);
+            if (pos >= track_end) {
+                break;
+            }
+
+            if (data[pos] & 0x80) {
+                status = data[pos++];
+            } else if (status == 0 || status >= 0xF0) {
+                break; /* Running status without a status */
+            }
+
+            if (status == 0xFF) {
+                if (pos >= track_end) {
+                    break;
+                }
+                type = data[pos++];
+                len = probe_midi_vlq(data, track_end, &pos);
+                if (len > track_end - pos) {
+                    break;
+                }
+
+                if (type == 0x51 && len == 3) {
+                    if (count == capacity) {
+                        capacity = capacity ? capacity * 2 : 32;
+                        grown = (ProbeMidiTempo *)SDL_realloc(tempos, sizeof(ProbeMidiTempo) * capacity);
+                        if (!grown) {
+                            break;
+                        }
+                        tempos = grown;
+                    }
+                    tempos[count].tick = tick;
+                    tempos[count].tempo = ((Uint32)data[pos] << 16) | ((Uint32)data[pos + 1] << 8) | data[pos + 2];
+                    ++count;
+                } else if ((type == 0x03 || type == 0x02 || type == 0x06) && len > 0) {
+                    char *text = (char *)SDL_malloc(len + 1);
+                    if (text) {
+                        SDL_memcpy(text, data + pos, len);
+                        text[len] = '\0';
+                        if (type == 0x03 && track == 0 && !meta_tags_get(&st->tags, MIX_META_TITLE)[0]) {
+                            _Mix_ParseMidiMetaTag(&st->tags, MIX_META_TITLE, text);
+                        } else if (type == 0x02 && !meta_tags_get(&st->tags, MIX_META_COPYRIGHT)[0]) {
+                            _Mix_ParseMidiMetaTag(&st->tags, MIX_META_COPYRIGHT, text);
+                        } else if (type == 0x06 && SDL_strcasecmp(text, "loopStart") == 0) {
+                            loop_start = tick;
+                            has_loop_start = SDL_TRUE;
+                        } else if (type == 0x06 && SDL_strcasecmp(text, "loopEnd") == 0) {
+                            loop_end = tick;
+                            has_loop_end = SDL_TRUE;
+                        }
+                        SDL_free(text);
+                    }
+                } else if (type == 0x2F) {
+                    pos += len;
+                    break; /* End of track */
+                }
+                pos += len;
+            } else if (status == 0xF0 || status == 0xF7) {
+                len = probe_midi_vlq(data, track_end, &pos);
+                pos += len;
+                status = 0;
+            } else {
+                Uint8 kind = status & 0xF0;
+                if (kind == 0xC0 || kind == 0xD0) {
+                    pos += 1;
+                } else {
+                    /* Controller 111 is the RPG Maker loop start */
+                    if (kind == 0xB0 && pos < track_end && data[pos] == 111 && !has_loop_start) {
+                        loop_start = tick;
+                        has_loop_start = SDL_TRUE;
+                    }
+                    pos += 2;
+                }
+            }
+        }
+
+        if (tick > end_tick) {
+            end_tick = tick;
+        }
+        pos = track_end;
+    }
+
+    /* Tempo changes of all tracks in the time order */
+    for (i = 1; i < count; ++i) {
+        ProbeMidiTempo t = tempos[i];
+        for (j = i; j > 0 && tempos[j - 1].tick > t.tick; --j) {
+            tempos[j] = tempos[j - 1];
+        }
+        tempos[j] = t;
+    }
+
+    st->info->duration = probe_midi_time(tempos, count, end_tick, division);
+    if (has_loop_start || has_loop_end) {
+        if (!has_loop_end) {
+            loop_end = end_tick;
+        }
+        if (loop_start < loop_end) {
+            st->info->loop_start = probe_midi_time(tempos, count, loop_start, division);
+            st->info->loop_end = probe_midi_time(tempos, count, loop_end, division);
+        }
+    }
+
+    if (tempos) {
+        SDL_free(tempos);
+    }
+    SDL_free(file);
+    return 0;
+}
+
+
+/* ============================== Fallback ================================== */
+
+static int probe_full_load(SDL_RWops *src, ProbeState *st, Mix_MusicType type)
+{
+    Mix_Music *music;
+
+    music = Mix_LoadMUSType_RW(src, type, SDL_FALSE);
+    if (!music) {
+        return -1;
+    }
+
+    st->info->duration = Mix_MusicDuration(music);
+    st->info->loop_start = Mix_GetMusicLoopStartTime(music);
+    st->info->loop_end = Mix_GetMusicLoopEndTime(music);
+    meta_tags_set(&st->tags, MIX_META_TITLE, Mix_GetMusicTitleTag(music));
+    meta_tags_set(&st->tags, MIX_META_ARTIST, Mix_GetMusicArtistTag(music));
+    meta_tags_set(&st->tags, MIX_META_ALBUM, Mix_GetMusicAlbumTag(music));
+    meta_tags_set(&st->tags, MIX_META_COPYRIGHT, Mix_GetMusicCopyrightTag(music));
+    /* Synthesized music has no own format */
+    Mix_FreeMusic(music);
+    return 0;
+}
+
+
+static int probe_music(SDL_RWops *src, Mix_MusicInfo *info, SDL_mutex *load_lock)
+{
+    ProbeState st;
+    Mix_MusicType type;
+    Sint64 start;
+    Uint8 magic[12];
+    int ret;
+
+    probe_info_reset(info);
+
+    SDL_zero(st);
+    st.info = info;
+    meta_tags_init(&st.tags);
+
+    start = SDL_RWtell(src);
+    type = detect_music_type(src);
+    if (type == MUS_NONE) {
+        return -1;
+    }
+
+    SDL_memset(magic, 0, sizeof(magic));
+    SDL_RWread(src, magic, 1, sizeof(magic));
+    SDL_RWseek(src, start, RW_SEEK_SET);
+
+    switch (type) {
+    case MUS_OGG:
+        ret = probe_ogg(src, &st, SDL_FALSE);
+        break;
+    case MUS_OPUS:
+        ret = probe_ogg(src, &st, SDL_TRUE);
+        break;
+    case MUS_FLAC:
+        ret = probe_flac(src, &st);
+        break;
+    case MUS_WAV:
+        if (SDL_memcmp(magic, "RIFF", 4) == 0) {
+            ret = probe_wav(src, &st);
+        } else {
+            ret = probe_aiff(src, &st);
+        }
+        break;
+    case MUS_MP3:
+        ret = probe_mp3(src, &st);
+        break;
+    case MUS_MID:
+        if (SDL_memcmp(magic, MIDI_SONG_CACHE_MAGIC, 8) != 0) {
+            ret = probe_midi(src, &st);
+            break;
+        }
+        /* The song cache is readable by the built-in MIDI sequencer only */
+        /* fallthrough */
+    default:
+        if (load_lock) {
+            SDL_LockMutex(load_lock);
+        }
+        ret = probe_full_load(src, &st, type);
+        if (load_lock) {
+            SDL_UnlockMutex(load_lock);
+        }
+        break;
+    }
+
+    if (ret == 0) {
+        info->type = type;
+        SDL_strlcpy(info->title, meta_tags_get(&st.tags, MIX_META_TITLE), sizeof(info->title));
+        SDL_strlcpy(info->artist, meta_tags_get(&st.tags, MIX_META_ARTIST), sizeof(info->artist));
+        SDL_strlcpy(info->album, meta_tags_get(&st.tags, MIX_META_ALBUM), sizeof(info->album));
+        SDL_strlcpy(info->copyright, meta_tags_get(&st.tags, MIX_META_COPYRIGHT), sizeof(info->copyright));
+    } else {
+        probe_info_reset(info);
+    }
+
+    meta_tags_clear(&st.tags);
+    return ret;
+}
+
+static int probe_music_file(const char *file, Mix_MusicInfo *info, SDL_mutex *load_lock)
+{
+    SDL_RWops *src;
+    int freesrc, ret;
+
+    if (!file) {
+        probe_info_reset(info);
+        Mix_SetError("Null filename!");
+        return -1;
+    }
+
+    src = SDL_RWFromFile(file, "rb");
+    if (!src) {
+        probe_info_reset(info);
+        Mix_SetError("Couldn't open '%s'", file);
+        return -1;
+    }
+
+    freesrc = 1;
+    src = _Mix_RWFromBuffered(src, &freesrc);
+    ret = probe_music(src, info, load_lock);
+    SDL_RWclose(src);
+    return ret;
+}
+
+int MIXCALLCC Mix_ProbeMusic(const char *file, Mix_MusicInfo *info)
+{
+    if (!info) {
+        Mix_SetError("Null info pointer");
+        return -1;
+    }
+    return probe_music_file(file, info, NULL);
+}
+
+int MIXCALLCC Mix_ProbeMusic_RW(SDL_RWops *src, int freesrc, Mix_MusicInfo *info)
+{
+    int ret;
+
+    if (!src) {
+        Mix_SetError("RWops pointer is NULL");
+        return -1;
+    }
+    if (!info) {
+        if (freesrc) {
+            SDL_RWclose(src);
+        }
+        Mix_SetError("Null info pointer");
+        return -1;
+    }
+
+    ret = probe_music(src, info, NULL);
+    if (freesrc) {
+        SDL_RWclose(src);
+    }
+    return ret;
+}
+
+
+typedef struct
+{
+    const char * const *files;
+    Mix_MusicInfo *infos;
+    int count;
+    SDL_atomic_t next;
+    SDL_atomic_t probed;
+    SDL_mutex *load_lock;
+} ProbeBatch;
+
+static int SDLCALL probe_batch_worker(void *data)
+{
+    ProbeBatch *batch = (ProbeBatch *)data;
+    int i;
+
+    while ((i = SDL_AtomicAdd(&batch->next, 1)) < batch->count) {
+        if (probe_music_file(batch->files[i], &batch->infos[i], batch->load_lock) == 0) {
+            SDL_AtomicAdd(&batch->probed, 1);
+        }
+    }
+    return 0;
+}
+
+int MIXCALLCC Mix_ProbeMusicBatch(const char * const *files, Mix_MusicInfo *infos, int count, int threads)
+{
+    ProbeBatch batch;
+    SDL_Thread **workers;
+    int i;
+
+    if (!files || !infos || count < 0) {
+        Mix_SetError("Invalid arguments");
+        return -1;
+    }
+
+    if (threads <= 0) {
+        threads = SDL_GetCPUCount();
+    }
+    if (threads > count) {
+        threads = count;
+    }
+
+    SDL_zero(batch);
+    batch.files = files;
+    batch.infos = infos;
+    batch.count = count;
+
+    if (threads <= 1) {
+        probe_batch_worker(&batch);
+        return SDL_AtomicGet(&batch.probed);
+    }
+
+    /* Full loads of the fallback formats go through the codec libraries,
+     * some of them have a global state, so these are done one at a time */
+    batch.load_lock = SDL_CreateMutex();
+    if (!batch.load_lock) {
+        return -1;
+    }
+
+    /* The calling thread is one of the workers */
+    --threads;
+    workers = (SDL_Thread **)SDL_calloc((size_t)threads, sizeof(SDL_Thread *));
+    if (!workers) {
+        SDL_DestroyMutex(batch.load_lock);
+        return Mix_OutOfMemory();
+    }
+
+    for (i = 0; i < threads; ++i) {
+        workers[i] = SDL_CreateThread(probe_batch_worker, "Mix_ProbeMusic", &batch);
+    }
+
+    /* Does everything if no thread has started */
+    probe_batch_worker(&batch);
+
+    for (i = 0; i < threads; ++i) {
+        if (workers[i]) {
+            SDL_WaitThread(workers[i], NULL);
+        }
+    }
+
+    SDL_free(workers);
+    SDL_DestroyMutex(batch.load_lock);
+    return SDL_AtomicGet(&batch.probed);
+}
+
+/* vi: set ts=4 sw=4 expandtab: */
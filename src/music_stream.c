@@ -0,0 +1,592 @@
+/*
+  SDL Mixer X:  An extended audio mixer library, forked from SDL_mixer
+  Copyright (C) 2014-2022 Vitaly Novichkov <admin@wohlnet.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* MIXER-X: Shared format and sample rate conversion stage for music codecs.
+ *
+ * Codecs hand their native frames to a Mix_MusicStream instead of creating
+ * an SDL_AudioStream directly. When the rates differ and a resampler other
+ * than SDL's one is selected, the frames are unpacked into planar floats,
+ * resampled with a polyphase FIR filter, and the remaining format/channel
+ * mapping is done by an SDL_AudioStream at equal rates (which is cheap).
+ */
+
+#include "SDL_mixer.h"
+#include "music.h"
+
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define MUSIC_STREAM_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+/* Bits of the 32-bit position fraction used to pick a filter phase */
+#define PHASE_BITS_MEDIUM   8
+#define PHASE_BITS_HIGH     9
+
+#define TAPS_MEDIUM         16
+#define TAPS_HIGH           32
+
+/* Frames produced per pass before being handed to the output stream */
+#define OUTPUT_CHUNK        1024
+
+static int music_resample_quality = MIX_RESAMPLE_SDL;
+
+struct _Mix_MusicStream
+{
+    /* Converts resampled F32 frames into the output format/channels.
+     * When the resampler is bypassed, it does the whole conversion. */
+    SDL_AudioStream *cvt;
+    /* Unpacks source formats other than S16 and F32 into F32 */
+    SDL_AudioStream *unpack;
+    SDL_bool bypass;
+
+    SDL_AudioFormat src_format;
+    int channels;
+    int src_frame_size;
+
+    int quality;
+    float *filter;      /* (phases + 1) rows of 'taps' coefficients */
+    int taps;
+    int phase_bits;
+
+    float *planes;      /* 'channels' planes of 'capacity' frames each */
+    int capacity;
+    int frames;         /* Valid frames in every plane */
+    int history;        /* Frames kept before the read position */
+
+    int pos;            /* Integer read position */
+    Uint32 frac;        /* Fractional read position */
+    int step_int;
+    Uint32 step_frac;
+
+    float *scratch;     /* Unpacked interleaved input */
+    int scratch_size;
+    float *out;         /* Interleaved output of a single pass */
+};
+
+
+int MIXCALLCC Mix_SetMusicResampleQuality(int quality)
+{
+    if (quality < MIX_RESAMPLE_SDL || quality > MIX_RESAMPLE_HIGH) {
+        Mix_SetError("Unknown resampler quality %d", quality);
+        return -1;
+    }
+    music_resample_quality = quality;
+    return 0;
+}
+
+int MIXCALLCC Mix_GetMusicResampleQuality(void)
+{
+    return music_resample_quality;
+}
+
+
+/* Zeroth-order modified Bessel function of the first kind (for Kaiser window) */
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0, hx = x / 2.0;
+    int k;
+
+    for (k = 1; k < 32; ++k) {
+        term *= hx / k;
+        sum += term * term;
+        if (term * term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+static int build_filter(Mix_MusicStream *s, double cutoff)
+{
+    const int phases = 1 << s->phase_bits;
+    const int half = s->taps / 2;
+    const double kaiser_beta = 8.6;
+    const double i0_beta = bessel_i0(kaiser_beta);
+    int p, k;
+
+    s->filter = (float *)SDL_malloc(sizeof(float) * (size_t)(s->taps * (phases + 1)));
+    if (!s->filter) {
+        SDL_OutOfMemory();
+        return -1;
+    }
+
+    for (p = 0; p <= phases; ++p) {
+        float *row = s->filter + (p * s->taps);
+        double f = (double)p / phases;
+        double sum = 0.0;
+
+        for (k = 0; k < s->taps; ++k) {
+            /* Distance between tap k and the interpolated point */
+            double t = (double)(k - half + 1) - f;
+            double x = t / half; /* -1.0 ... 1.0 over the window */
+            double h, w;
+
+            if (t == 0.0) {
+                h = cutoff;
+            } else {
+                h = SDL_sin(M_PI * cutoff * t) / (M_PI * t);
+            }
+
+            if (x <= -1.0 || x >= 1.0) {
+                w = 0.0;
+            } else if (s->quality == MIX_RESAMPLE_HIGH) {
+                w = bessel_i0(kaiser_beta * SDL_sqrt(1.0 - x * x)) / i0_beta;
+            } else { /* Blackman */
+                w = 0.42 + 0.5 * SDL_cos(M_PI * x) + 0.08 * SDL_cos(2.0 * M_PI * x);
+            }
+
+            row[k] = (float)(h * w);
+            sum += row[k];
+        }
+
+        /* Keep unity gain at DC for every phase */
+        if (sum != 0.0) {
+            for (k = 0; k < s->taps; ++k) {
+                row[k] = (float)(row[k] / sum);
+            }
+        }
+    }
+
+    return 0;
+}
+
+static SDL_INLINE float dot_product(const float *x, const float *c, int taps)
+{
+#ifdef MUSIC_STREAM_USE_SSE
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    float r[4];
+    int k;
+
+    for (k = 0; k < taps; k += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x + k), _mm_loadu_ps(c + k)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(x + k + 4), _mm_loadu_ps(c + k + 4)));
+    }
+    _mm_storeu_ps(r, _mm_add_ps(acc0, acc1));
+    return (r[0] + r[1]) + (r[2] + r[3]);
+#else
+    /* Independent accumulators let the compiler vectorize this loop */
+    float a0 = 0.0f, a1 = 0.0f, a2 = 0.0f, a3 = 0.0f;
+    int k;
+
+    for (k = 0; k < taps; k += 4) {
+        a0 += x[k + 0] * c[k + 0];
+        a1 += x[k + 1] * c[k + 1];
+        a2 += x[k + 2] * c[k + 2];
+        a3 += x[k + 3] * c[k + 3];
+    }
+    return (a0 + a1) + (a2 + a3);
+#endif
+}
+
+/* Blend two neighbor filter phases into 'dst' */
+static SDL_INLINE void blend_phases(float *dst, const float *c0, const float *c1, float t, int taps)
+{
+#ifdef MUSIC_STREAM_USE_SSE
+    const __m128 vt = _mm_set1_ps(t);
+    int k;
+
+    for (k = 0; k < taps; k += 4) {
+        __m128 a = _mm_loadu_ps(c0 + k);
+        __m128 b = _mm_loadu_ps(c1 + k);
+        _mm_storeu_ps(dst + k, _mm_add_ps(a, _mm_mul_ps(vt, _mm_sub_ps(b, a))));
+    }
+#else
+    int k;
+
+    for (k = 0; k < taps; ++k) {
+        dst[k] = c0[k] + t * (c1[k] - c0[k]);
+    }
+#endif
+}
+
+static int ensure_capacity(Mix_MusicStream *s, int frames)
+{
+    float *planes;
+    int capacity, ch;
+
+    if (frames <= s->capacity) {
+        return 0;
+    }
+
+    capacity = s->capacity ? s->capacity : 4096;
+    while (capacity < frames) {
+        capacity *= 2;
+    }
+
+    planes = (float *)SDL_malloc(sizeof(float) * (size_t)(capacity * s->channels));
+    if (!planes) {
+        return SDL_OutOfMemory();
+    }
+
+    if (s->planes) {
+        for (ch = 0; ch < s->channels; ++ch) {
+            SDL_memcpy(planes + (ch * capacity),
+                       s->planes + (ch * s->capacity),
+                       sizeof(float) * (size_t)s->frames);
+        }
+        SDL_free(s->planes);
+    }
+
+    s->planes = planes;
+    s->capacity = capacity;
+    return 0;
+}
+
+static void reset_planes(Mix_MusicStream *s)
+{
+    int ch;
+
+    /* Prime the history with silence */
+    for (ch = 0; ch < s->channels; ++ch) {
+        SDL_memset(s->planes + (ch * s->capacity), 0, sizeof(float) * (size_t)s->history);
+    }
+    s->frames = s->history;
+    s->pos = s->history;
+    s->frac = 0;
+}
+
+/* Append interleaved F32 frames into the planes */
+static void append_float(Mix_MusicStream *s, const float *src, int frames)
+{
+    const int channels = s->channels;
+    int ch, i;
+
+    for (ch = 0; ch < channels; ++ch) {
+        float *dst = s->planes + (ch * s->capacity) + s->frames;
+        const float *in = src + ch;
+        for (i = 0; i < frames; ++i) {
+            dst[i] = in[i * channels];
+        }
+    }
+    s->frames += frames;
+}
+
+/* Append interleaved S16 frames into the planes */
+static void append_s16(Mix_MusicStream *s, const Sint16 *src, int frames)
+{
+    const int channels = s->channels;
+    const float scale = 1.0f / 32768.0f;
+    int ch, i;
+
+    for (ch = 0; ch < channels; ++ch) {
+        float *dst = s->planes + (ch * s->capacity) + s->frames;
+        const Sint16 *in = src + ch;
+        for (i = 0; i < frames; ++i) {
+            dst[i] = (float)in[i * channels] * scale;
+        }
+    }
+    s->frames += frames;
+}
+
+/* Resample all the frames that have enough lookahead and send them out */
+static int resample_pending(Mix_MusicStream *s)
+{
+    const int channels = s->channels;
+    const int taps = s->taps;
+    const int before = s->history;          /* taps / 2 - 1 */
+    const int after = taps - before - 1;    /* taps / 2 */
+    const int shift = 32 - s->phase_bits;
+    const Uint32 blend_mask = ((Uint32)1 << shift) - 1;
+    const float blend_scale = 1.0f / (float)((Uint32)1 << shift);
+    float coefs[TAPS_HIGH];
+    int produced, ch, drop;
+
+    while (s->pos + after < s->frames) {
+        float *out = s->out;
+        produced = 0;
+
+        while (produced < OUTPUT_CHUNK && s->pos + after < s->frames) {
+            const int base = s->pos - before;
+            Uint32 frac_next;
+
+            if (!s->filter) { /* Linear */
+                const float t = (float)s->frac * (1.0f / 4294967296.0f);
+                for (ch = 0; ch < channels; ++ch) {
+                    const float *x = s->planes + (ch * s->capacity) + s->pos;
+                    out[ch] = x[0] + t * (x[1] - x[0]);
+                }
+            } else {
+                const Uint32 phase = s->frac >> shift;
+                const float *c = s->filter + (phase * (Uint32)taps);
+
+                if (s->quality == MIX_RESAMPLE_HIGH) {
+                    blend_phases(coefs, c, c + taps, (float)(s->frac & blend_mask) * blend_scale, taps);
+                    c = coefs;
+                }
+
+                for (ch = 0; ch < channels; ++ch) {
+                    out[ch] = dot_product(s->planes + (ch * s->capacity) + base, c, taps);
+                }
+            }
+
+            out += channels;
+            ++produced;
+
+            frac_next = s->frac + s->step_frac;
+            s->pos += s->step_int + (frac_next < s->frac ? 1 : 0);
+            s->frac = frac_next;
+        }
+
+        if (SDL_AudioStreamPut(s->cvt, s->out, produced * channels * (int)sizeof(float)) < 0) {
+            return -1;
+        }
+    }
+
+    /* Drop the consumed frames, but keep the history needed by the filter */
+    drop = s->pos - before;
+    if (drop > 0) {
+        if (drop > s->frames) {
+            drop = s->frames;
+        }
+        for (ch = 0; ch < channels; ++ch) {
+            float *plane = s->planes + (ch * s->capacity);
+            SDL_memmove(plane, plane + drop, sizeof(float) * (size_t)(s->frames - drop));
+        }
+        s->frames -= drop;
+        s->pos -= drop;
+    }
+
+    return 0;
+}
+
+Mix_MusicStream *music_stream_new(SDL_AudioFormat src_format, Uint8 src_channels, int src_rate,
+                                  SDL_AudioFormat dst_format, Uint8 dst_channels, int dst_rate)
+{
+    Mix_MusicStream *s;
+    Uint64 step;
+
+    s = (Mix_MusicStream *)SDL_calloc(1, sizeof(Mix_MusicStream));
+    if (!s) {
+        SDL_OutOfMemory();
+        return NULL;
+    }
+
+    s->quality = music_resample_quality;
+    s->src_format = src_format;
+    s->channels = src_channels;
+    s->src_frame_size = (SDL_AUDIO_BITSIZE(src_format) / 8) * src_channels;
+
+    if (s->quality == MIX_RESAMPLE_SDL || src_rate == dst_rate || src_channels == 0) {
+        s->bypass = SDL_TRUE;
+        s->cvt = SDL_NewAudioStream(src_format, src_channels, src_rate,
+                                    dst_format, dst_channels, dst_rate);
+        if (!s->cvt) {
+            SDL_free(s);
+            return NULL;
+        }
+        return s;
+    }
+
+    s->cvt = SDL_NewAudioStream(AUDIO_F32SYS, src_channels, dst_rate,
+                                dst_format, dst_channels, dst_rate);
+    if (!s->cvt) {
+        music_stream_free(s);
+        return NULL;
+    }
+
+    if (src_format != AUDIO_S16SYS && src_format != AUDIO_F32SYS) {
+        s->unpack = SDL_NewAudioStream(src_format, src_channels, src_rate,
+                                       AUDIO_F32SYS, src_channels, src_rate);
+        if (!s->unpack) {
+            music_stream_free(s);
+            return NULL;
+        }
+    }
+
+    switch (s->quality) {
+    case MIX_RESAMPLE_LINEAR:
+        s->taps = 2;
+        break;
+    case MIX_RESAMPLE_MEDIUM:
+        s->taps = TAPS_MEDIUM;
+        s->phase_bits = PHASE_BITS_MEDIUM;
+        break;
+    case MIX_RESAMPLE_HIGH:
+    default:
+        s->taps = TAPS_HIGH;
+        s->phase_bits = PHASE_BITS_HIGH;
+        break;
+    }
+    s->history = s->taps / 2 - 1;
+
+    if (s->phase_bits > 0) {
+        /* Move the cutoff below the output Nyquist frequency when downsampling */
+        double cutoff = (dst_rate < src_rate) ? ((double)dst_rate / src_rate) : 1.0;
+        if (build_filter(s, cutoff * 0.97) < 0) {
+            music_stream_free(s);
+            return NULL;
+        }
+    }
+
+    step = ((Uint64)src_rate << 32) / (Uint64)dst_rate;
+    s->step_int = (int)(step >> 32);
+    s->step_frac = (Uint32)(step & 0xFFFFFFFF);
+
+    s->out = (float *)SDL_malloc(sizeof(float) * (size_t)(OUTPUT_CHUNK * src_channels));
+    if (!s->out || ensure_capacity(s, 4096) < 0) {
+        SDL_OutOfMemory();
+        music_stream_free(s);
+        return NULL;
+    }
+    reset_planes(s);
+
+    return s;
+}
+
+/* Unpack whatever the SDL stream has converted into F32 */
+static int drain_unpack(Mix_MusicStream *s)
+{
+    const int frame_size = s->channels * (int)sizeof(float);
+    int available = SDL_AudioStreamAvailable(s->unpack);
+
+    while (available >= frame_size) {
+        int got, frames = available / frame_size;
+
+        if (ensure_capacity(s, s->frames + frames) < 0) {
+            return -1;
+        }
+        if (s->scratch_size < frames * frame_size) {
+            float *scratch = (float *)SDL_realloc(s->scratch, (size_t)(frames * frame_size));
+            if (!scratch) {
+                return SDL_OutOfMemory();
+            }
+            s->scratch = scratch;
+            s->scratch_size = frames * frame_size;
+        }
+
+        got = SDL_AudioStreamGet(s->unpack, s->scratch, frames * frame_size);
+        if (got <= 0) {
+            return got;
+        }
+        append_float(s, s->scratch, got / frame_size);
+        available = SDL_AudioStreamAvailable(s->unpack);
+    }
+
+    return 0;
+}
+
+int music_stream_put(Mix_MusicStream *s, const void *buf, int len)
+{
+    int frames;
+
+    if (s->bypass) {
+        return SDL_AudioStreamPut(s->cvt, buf, len);
+    }
+
+    if (s->unpack) {
+        if (SDL_AudioStreamPut(s->unpack, buf, len) < 0 || drain_unpack(s) < 0) {
+            return -1;
+        }
+        return resample_pending(s);
+    }
+
+    /* Codecs always hand over whole frames */
+    frames = len / s->src_frame_size;
+    if (frames <= 0) {
+        return 0;
+    }
+    if (ensure_capacity(s, s->frames + frames) < 0) {
+        return -1;
+    }
+
+    if (s->src_format == AUDIO_F32SYS) {
+        append_float(s, (const float *)buf, frames);
+    } else {
+        append_s16(s, (const Sint16 *)buf, frames);
+    }
+
+    return resample_pending(s);
+}
+
+int music_stream_get(Mix_MusicStream *s, void *buf, int len)
+{
+    return SDL_AudioStreamGet(s->cvt, buf, len);
+}
+
+int music_stream_flush(Mix_MusicStream *s)
+{
+    if (!s->bypass) {
+        const int tail = s->taps - s->history;
+        int ch;
+
+        if (s->unpack) {
+            if (SDL_AudioStreamFlush(s->unpack) < 0 || drain_unpack(s) < 0) {
+                return -1;
+            }
+        }
+
+        /* Pad with silence to push the last frames through the filter */
+        if (ensure_capacity(s, s->frames + tail) < 0) {
+            return -1;
+        }
+        for (ch = 0; ch < s->channels; ++ch) {
+            SDL_memset(s->planes + (ch * s->capacity) + s->frames, 0, sizeof(float) * (size_t)tail);
+        }
+        s->frames += tail;
+
+        if (resample_pending(s) < 0) {
+            return -1;
+        }
+        reset_planes(s);
+    }
+
+    return SDL_AudioStreamFlush(s->cvt);
+}
+
+void music_stream_clear(Mix_MusicStream *s)
+{
+    if (!s->bypass) {
+        if (s->unpack) {
+            SDL_AudioStreamClear(s->unpack);
+        }
+        reset_planes(s);
+    }
+    SDL_AudioStreamClear(s->cvt);
+}
+
+void music_stream_free(Mix_MusicStream *s)
+{
+    if (!s) {
+        return;
+    }
+    if (s->cvt) {
+        SDL_FreeAudioStream(s->cvt);
+    }
+    if (s->unpack) {
+        SDL_FreeAudioStream(s->unpack);
+    }
+    if (s->filter) {
+        SDL_free(s->filter);
+    }
+    if (s->planes) {
+        SDL_free(s->planes);
+    }
+    if (s->scratch) {
+        SDL_free(s->scratch);
+    }
+    if (s->out) {
+        SDL_free(s->out);
+    }
+    SDL_free(s);
+}
+
+/* vi: set ts=4 sw=4 expandtab: */
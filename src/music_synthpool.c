@@ -0,0 +1,183 @@
+/*
+  SDL Mixer X:  An extended audio mixer library, forked from SDL_mixer
+  Copyright (C) 2014-2022 Vitaly Novichkov <admin@wohlnet.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* MIXER-X: Pool of warm synthesizer instances.
+ *
+ * Closed songs give their synthesizer back to the pool of the backend under
+ * the key of its configuration (sample rate, bank, emulator, chips count...).
+ * The next song with the same configuration takes it instead of initializing
+ * a new synthesizer and loading the bank again. The content of custom bank
+ * files is kept too, so new instances don't read them from the disk.
+ */
+
+#include "SDL_mixer.h"
+#include "music.h"
+
+/* Idle synthesizers kept per backend, the rest gets closed */
+#define MUSIC_SYNTH_POOL_MAX_IDLE   4
+
+struct _Mix_SynthPoolItem
+{
+    char *key;
+    void *synth;
+    struct _Mix_SynthPoolItem *next;
+};
+
+struct _Mix_SynthPoolBank
+{
+    char *path;
+    void *data;
+    size_t size;
+    struct _Mix_SynthPoolBank *next;
+};
+
+int music_synth_pool_init(Mix_SynthPool *pool, void (*close_synth)(void *synth))
+{
+    SDL_zerop(pool);
+    pool->lock = SDL_CreateMutex();
+    if (!pool->lock) {
+        return -1;
+    }
+    pool->close_synth = close_synth;
+    return 0;
+}
+
+void *music_synth_pool_take(Mix_SynthPool *pool, const char *key)
+{
+    Mix_SynthPoolItem **link, *item;
+    void *synth = NULL;
+
+    if (!pool->lock) {
+        return NULL;
+    }
+
+    SDL_LockMutex(pool->lock);
+    for (link = &pool->idle; (item = *link) != NULL; link = &item->next) {
+        if (SDL_strcmp(item->key, key) == 0) {
+            *link = item->next;
+            pool->idle_count--;
+            synth = item->synth;
+            SDL_free(item->key);
+            SDL_free(item);
+            break;
+        }
+    }
+    SDL_UnlockMutex(pool->lock);
+
+    return synth;
+}
+
+void music_synth_pool_give(Mix_SynthPool *pool, const char *key, void *synth)
+{
+    Mix_SynthPoolItem *item = NULL;
+
+    if (pool->lock) {
+        SDL_LockMutex(pool->lock);
+        if (pool->idle_count < MUSIC_SYNTH_POOL_MAX_IDLE) {
+            item = (Mix_SynthPoolItem *)SDL_calloc(1, sizeof(Mix_SynthPoolItem));
+            if (item && (item->key = SDL_strdup(key)) != NULL) {
+                item->synth = synth;
+                item->next = pool->idle;
+                pool->idle = item;
+                pool->idle_count++;
+            } else if (item) {
+                SDL_free(item);
+                item = NULL;
+            }
+        }
+        SDL_UnlockMutex(pool->lock);
+    }
+
+    if (!item) {
+        pool->close_synth(synth);
+    }
+}
+
+const void *music_synth_pool_bank(Mix_SynthPool *pool, const char *path, size_t *size)
+{
+    Mix_SynthPoolBank *bank;
+
+    if (!pool->lock) {
+        return NULL;
+    }
+
+    SDL_LockMutex(pool->lock);
+    for (bank = pool->banks; bank; bank = bank->next) {
+        if (SDL_strcmp(bank->path, path) == 0) {
+            break;
+        }
+    }
+
+    if (!bank) {
+        bank = (Mix_SynthPoolBank *)SDL_calloc(1, sizeof(Mix_SynthPoolBank));
+        if (bank) {
+            bank->path = SDL_strdup(path);
+            bank->data = SDL_LoadFile(path, &bank->size);
+        }
+        if (!bank || !bank->path || !bank->data) {
+            /* Let the caller to load the file by itself and report the error */
+            if (bank) {
+                if (bank->path) {
+                    SDL_free(bank->path);
+                }
+                if (bank->data) {
+                    SDL_free(bank->data);
+                }
+                SDL_free(bank);
+            }
+            SDL_UnlockMutex(pool->lock);
+            return NULL;
+        }
+        bank->next = pool->banks;
+        pool->banks = bank;
+    }
+    SDL_UnlockMutex(pool->lock);
+
+    *size = bank->size;
+    return bank->data;
+}
+
+void music_synth_pool_quit(Mix_SynthPool *pool)
+{
+    Mix_SynthPoolItem *item;
+    Mix_SynthPoolBank *bank;
+
+    while ((item = pool->idle) != NULL) {
+        pool->idle = item->next;
+        pool->close_synth(item->synth);
+        SDL_free(item->key);
+        SDL_free(item);
+    }
+
+    while ((bank = pool->banks) != NULL) {
+        pool->banks = bank->next;
+        SDL_free(bank->path);
+        SDL_free(bank->data);
+        SDL_free(bank);
+    }
+
+    if (pool->lock) {
+        SDL_DestroyMutex(pool->lock);
+    }
+    SDL_zerop(pool);
+}
+
+/* vi: set ts=4 sw=4 expandtab: */
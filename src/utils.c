@@ -21,6 +21,8 @@
 
 /* misc helper routines */
 
+#include "SDL_hints.h"
+#include "SDL_rwops.h"
 #include "utils.h"
 #include <stddef.h>
 
@@ -174,3 +176,280 @@ Sint64 _Mix_ParseTime(char *time, long samplerate_hz)
     if ((val = SDL_atoi(num_start)) < 0) return -1;
     return (result * 60 + val) * samplerate_hz;
 }
+
+
+/* Read-ahead buffer around file-backed RWops. Format detection and
+ * several codecs do many small reads and short back seeks, every one of
+ * them is a system call (or worse, a network round trip) without it. */
+
+#define RWBUFFER_DEFAULT_SIZE   65536
+
+typedef struct
+{
+    SDL_RWops *src;
+    SDL_bool close_src;
+    Uint8 *buffer;
+    size_t capacity;
+    size_t len;     /* Bytes in the buffer */
+    size_t cur;     /* Read position in the buffer */
+    Sint64 base;    /* Source position of the buffer start */
+} RWBuffer;
+
+static Sint64 SDLCALL rwbuffer_size(SDL_RWops *context)
+{
+    RWBuffer *b = (RWBuffer *)context->hidden.unknown.data1;
+    return SDL_RWsize(b->src);
+}
+
+static Sint64 SDLCALL rwbuffer_seek(SDL_RWops *context, Sint64 offset, int whence)
+{
+    RWBuffer *b = (RWBuffer *)context->hidden.unknown.data1;
+    Sint64 target, size;
+
+    switch (whence) {
+    case RW_SEEK_SET:
+        target = offset;
+        break;
+    case RW_SEEK_CUR:
+        target = b->base + (Sint64)b->cur + offset;
+        break;
+    case RW_SEEK_END:
+        size = SDL_RWsize(b->src);
+        if (size < 0) {
+            /* Let the source to resolve the end */
+            target = SDL_RWseek(b->src, offset, RW_SEEK_END);
+            if (target < 0) {
+                SDL_RWseek(b->src, b->base + (Sint64)b->len, RW_SEEK_SET);
+                return -1;
+            }
+            b->base = target;
+            b->len = b->cur = 0;
+            return target;
+        }
+        target = size + offset;
+        break;
+    default:
+        return SDL_SetError("Unknown value for 'whence'");
+    }
+
+    if (target < 0) {
+        return SDL_Error(SDL_EFSEEK);
+    }
+
+    /* Seeks inside of the buffer don't touch the source */
+    if (target >= b->base && target <= b->base + (Sint64)b->len) {
+        b->cur = (size_t)(target - b->base);
+        return target;
+    }
+
+    if (SDL_RWseek(b->src, target, RW_SEEK_SET) < 0) {
+        return -1;
+    }
+    b->base = target;
+    b->len = b->cur = 0;
+    return target;
+}
+
+static size_t SDLCALL rwbuffer_read(SDL_RWops *context, void *ptr, size_t size, size_t maxnum)
+{
+    RWBuffer *b = (RWBuffer *)context->hidden.unknown.data1;
+    Uint8 *dst = (Uint8 *)ptr;
+    size_t total, done = 0, amount, got;
+
+    if (size == 0 || maxnum == 0) {
+        return 0;
+    }
+    total = size * maxnum;
+
+    while (done < total) {
+        amount = b->len - b->cur;
+        if (amount > 0) {
+            if (amount > total - done) {
+                amount = total - done;
+            }
+            SDL_memcpy(dst + done, b->buffer + b->cur, amount);
+            b->cur += amount;
+            done += amount;
+            continue;
+        }
+
+        /* The buffer is exhausted: the source is at its end */
+        b->base += (Sint64)b->len;
+        b->len = b->cur = 0;
+
+        if (total - done >= b->capacity) {
+            /* Big reads go directly */
+            got = SDL_RWread(b->src, dst + done, 1, total - done);
+            b->base += (Sint64)got;
+            done += got;
+            break;
+        }
+
+        got = SDL_RWread(b->src, b->buffer, 1, b->capacity);
+        if (got == 0) {
+            break;
+        }
+        b->len = got;
+    }
+
+    return done / size;
+}
+
+static size_t SDLCALL rwbuffer_write(SDL_RWops *context, const void *ptr, size_t size, size_t num)
+{
+    (void)context;
+    (void)ptr;
+    (void)size;
+    (void)num;
+    SDL_SetError("Can't write to the read-only stream");
+    return 0;
+}
+
+static int SDLCALL rwbuffer_close(SDL_RWops *context)
+{
+    RWBuffer *b = (RWBuffer *)context->hidden.unknown.data1;
+    int ret = 0;
+
+    if (b->close_src) {
+        ret = SDL_RWclose(b->src);
+    } else {
+        /* Leave the source at the same position as the reader sees it */
+        SDL_RWseek(b->src, b->base + (Sint64)b->cur, RW_SEEK_SET);
+    }
+
+    SDL_free(b->buffer);
+    SDL_free(b);
+    SDL_FreeRW(context);
+    return ret;
+}
+
+SDL_RWops *_Mix_RWFromBuffered(SDL_RWops *src, int *freesrc)
+{
+    SDL_RWops *rw;
+    RWBuffer *b;
+    const char *hint;
+    int capacity = RWBUFFER_DEFAULT_SIZE;
+    Sint64 pos;
+
+    if (!src) {
+        return NULL;
+    }
+
+    /* Memory streams have nothing to gain, and don't wrap twice */
+    if (src->type == SDL_RWOPS_MEMORY || src->type == SDL_RWOPS_MEMORY_RO ||
+        src->close == rwbuffer_close) {
+        return src;
+    }
+
+    hint = SDL_GetHint(SDL_MIXER_HINT_RWOPS_BUFFER);
+    if (hint && *hint) {
+        capacity = SDL_atoi(hint);
+    }
+    if (capacity <= 0) {
+        return src;
+    }
+
+    /* Non-seekable streams keep going directly */
+    pos = SDL_RWtell(src);
+    if (pos < 0) {
+        return src;
+    }
+
+    b = (RWBuffer *)SDL_calloc(1, sizeof(RWBuffer));
+    if (!b) {
+        return src;
+    }
+    b->buffer = (Uint8 *)SDL_malloc((size_t)capacity);
+    rw = SDL_AllocRW();
+    if (!b->buffer || !rw) {
+        if (rw) {
+            SDL_FreeRW(rw);
+        }
+        SDL_free(b->buffer);
+        SDL_free(b);
+        return src;
+    }
+
+    b->src = src;
+    b->close_src = *freesrc ? SDL_TRUE : SDL_FALSE;
+    b->capacity = (size_t)capacity;
+    b->base = pos;
+
+    rw->size = rwbuffer_size;
+    rw->seek = rwbuffer_seek;
+    rw->read = rwbuffer_read;
+    rw->write = rwbuffer_write;
+    rw->close = rwbuffer_close;
+    rw->type = SDL_RWOPS_UNKNOWN;
+    rw->hidden.unknown.data1 = b;
+
+    *freesrc = 1;
+    return rw;
+}
+
+const void *_Mix_LoadRWData(SDL_RWops *src, size_t *size, void **to_free)
+{
+    Sint64 pos, length;
+    size_t got;
+    Uint8 *data;
+
+    *to_free = NULL;
+    *size = 0;
+
+    /* Memory streams already hold the whole content */
+    if (src->type == SDL_RWOPS_MEMORY || src->type == SDL_RWOPS_MEMORY_RO) {
+        data = src->hidden.mem.here;
+        *size = (size_t)(src->hidden.mem.stop - src->hidden.mem.here);
+        src->hidden.mem.here = src->hidden.mem.stop;
+        if (*size == 0) {
+            SDL_SetError("The stream is empty");
+            return NULL;
+        }
+        return data;
+    }
+
+    pos = SDL_RWtell(src);
+    length = SDL_RWsize(src);
+    if (pos < 0 || length <= pos) {
+        /* The size is unknown, read by blocks until the end */
+        data = (Uint8 *)SDL_LoadFile_RW(src, size, SDL_FALSE);
+        if (data && *size == 0) {
+            SDL_free(data);
+            data = NULL;
+            SDL_SetError("The stream is empty");
+        }
+        *to_free = data;
+        return data;
+    }
+
+    length -= pos;
+    if ((Uint64)length > (Uint64)(~(size_t)0)) {
+        SDL_OutOfMemory();
+        return NULL;
+    }
+
+    data = (Uint8 *)SDL_malloc((size_t)length);
+    if (!data) {
+        SDL_OutOfMemory();
+        return NULL;
+    }
+
+    got = SDL_RWread(src, data, 1, (size_t)length);
+    if (got == 0) {
+        SDL_free(data);
+        SDL_SetError("Failed to read the stream");
+        return NULL;
+    }
+
+    *to_free = data;
+    *size = got;
+    return data;
+}
+
+SDL_RWops *_Mix_RWBufferSource(SDL_RWops *src)
+{
+    if (src && src->close == rwbuffer_close) {
+        return ((RWBuffer *)src->hidden.unknown.data1)->src;
+    }
+    return src;
+}
@@ -46,5 +46,35 @@ extern Sint64 _Mix_ParseTime(char *time, long samplerate_hz);
 
 extern SDL_bool _Mix_IsLoopTag(const char *tag);
 
+/* Size of the read-ahead buffer installed around file-backed RWops,
+ * in bytes, set to 0 to disable the buffering */
+#define SDL_MIXER_HINT_RWOPS_BUFFER "SDL_MIXER_RWOPS_BUFFER"
+
+/* Wrap the file-backed RWops into the read-ahead buffer. Returns the wrapper
+ * which must be closed by the caller (*freesrc is set to 1), the wrapper
+ * closes the source if *freesrc was set before, or rewinds it to the read
+ * position otherwise. Returns the source itself if it doesn't need the
+ * buffering or the wrapper failed to be created. */
+extern SDL_RWops *_Mix_RWFromBuffered(SDL_RWops *src, int *freesrc);
+
+/* Get the stream wrapped by the read-ahead buffer, or the stream itself if
+ * it's not a read-ahead buffer */
+extern SDL_RWops *_Mix_RWBufferSource(SDL_RWops *src);
+
+/* Get the content of the stream from its read position up to the end, the
+ * stream is left at its end. Memory streams give their own buffer without
+ * copying, other streams are read into a new buffer at once. The buffer to
+ * release with SDL_free() is stored into *to_free (NULL if nothing to free).
+ * Returns NULL and sets the error on failure or on the empty stream. */
+extern const void *_Mix_LoadRWData(SDL_RWops *src, size_t *size, void **to_free);
+
+/* Get the whole content of the file-backed or memory stream in place: the
+ * byte at the stream position N is at the returned address + N. Files are
+ * mapped into the memory, the mapping to release with _Mix_UnmapRW() is
+ * stored into *mapping (NULL if nothing to release). Returns NULL without
+ * setting the error when the stream can't be accessed this way. */
+extern const Uint8 *_Mix_MapRW(SDL_RWops *src, size_t *size, void **mapping); /* utils_mmap.c */
+extern void _Mix_UnmapRW(void *mapping, size_t size);
+
 #endif /* UTILS_H_ */
 
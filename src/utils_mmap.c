@@ -0,0 +1,118 @@
+/*
+  SDL Mixer X:  An extended audio mixer library, forked from SDL_mixer
+  Copyright (C) 2014-2022 Vitaly Novichkov <admin@wohlnet.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* MIXER-X: Memory mapping of the file-backed streams. This is a unit of
+ * its own to keep the POSIX feature macro away from the rest of the code. */
+
+#if defined(__unix__) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L /* fileno() and mmap() under the strict C89 */
+#endif
+
+#include "SDL_rwops.h"
+#include "utils.h"
+
+#if defined(_WIN32)
+#define MIX_MAP_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(HAVE_STDIO_H) && (defined(__unix__) || defined(__APPLE__))
+#define MIX_MAP_POSIX
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+const Uint8 *_Mix_MapRW(SDL_RWops *src, size_t *size, void **mapping)
+{
+    *size = 0;
+    *mapping = NULL;
+
+    /* The read-ahead buffer keeps the positions of the stream it wraps */
+    src = _Mix_RWBufferSource(src);
+
+    if (src->type == SDL_RWOPS_MEMORY || src->type == SDL_RWOPS_MEMORY_RO) {
+        *size = (size_t)(src->hidden.mem.stop - src->hidden.mem.base);
+        return src->hidden.mem.base;
+    }
+
+#if defined(MIX_MAP_WINDOWS)
+    if (src->type == SDL_RWOPS_WINFILE) {
+        LARGE_INTEGER length;
+        HANDLE file_map;
+        void *view;
+
+        if (!GetFileSizeEx((HANDLE)src->hidden.windowsio.h, &length) || length.QuadPart <= 0 ||
+            (Uint64)length.QuadPart > (Uint64)(~(size_t)0)) {
+            return NULL;
+        }
+        file_map = CreateFileMappingW((HANDLE)src->hidden.windowsio.h, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!file_map) {
+            return NULL;
+        }
+        view = MapViewOfFile(file_map, FILE_MAP_READ, 0, 0, 0);
+        /* The view keeps the mapping alive */
+        CloseHandle(file_map);
+        if (!view) {
+            return NULL;
+        }
+        *size = (size_t)length.QuadPart;
+        *mapping = view;
+        return (const Uint8 *)view;
+    }
+#elif defined(MIX_MAP_POSIX)
+    if (src->type == SDL_RWOPS_STDFILE) {
+        int fd = fileno((FILE *)src->hidden.stdio.fp);
+        struct stat st;
+        void *view;
+
+        if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+            (Uint64)st.st_size > (Uint64)(~(size_t)0)) {
+            return NULL;
+        }
+        view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED) {
+            return NULL;
+        }
+        *size = (size_t)st.st_size;
+        *mapping = view;
+        return (const Uint8 *)view;
+    }
+#endif
+
+    return NULL;
+}
+
+void _Mix_UnmapRW(void *mapping, size_t size)
+{
+    if (!mapping) {
+        return;
+    }
+#if defined(MIX_MAP_WINDOWS)
+    (void)size;
+    UnmapViewOfFile(mapping);
+#elif defined(MIX_MAP_POSIX)
+    munmap(mapping, size);
+#else
+    (void)size;
+#endif
+}
+
+/* vi: set ts=4 sw=4 expandtab: */
@@ -0,0 +1,140 @@
+#include "SDL_test.h"
+
+#include "SDL_mixer.h"
+#include "mixer.h"
+
+#define TEST_CHANNELS   4
+
+static Mix_Chunk *chunk = NULL;
+
+static void voices_setup(void *arg)
+{
+    (void)arg;
+    SDL_Init(SDL_INIT_AUDIO);
+    if (Mix_OpenAudio(44100, AUDIO_S16SYS, 2, 1024) < 0) {
+        SDLTest_LogError("Mix_OpenAudio: %s", Mix_GetError());
+        return;
+    }
+    Mix_AllocateChannels(TEST_CHANNELS * 2);
+    chunk = Mix_LoadWAV_RW_Compressed(SDL_RWFromFile("notags.mp3", "rb"), 1, 1);
+    if (!chunk) {
+        SDLTest_LogError("Mix_LoadWAV_RW_Compressed: %s", Mix_GetError());
+    }
+}
+
+static void voices_teardown(void *arg)
+{
+    (void)arg;
+    if (chunk) {
+        Mix_FreeChunk(chunk);
+        chunk = NULL;
+    }
+    Mix_CloseAudio();
+    SDL_Quit();
+}
+
+/* Plays the chunk on every test channel at once, returns the count of played */
+static int play_on_channels(void)
+{
+    int i, played = 0;
+    for (i = 0; i < TEST_CHANNELS; ++i) {
+        /* Looped, so no voice gets released by the end of the sound */
+        if (Mix_PlayChannel(-1, chunk, -1) >= 0) {
+            played++;
+        }
+    }
+    return played;
+}
+
+static int check_voices(int want_count, int want_busy)
+{
+    int count, busy = -1;
+    count = _Mix_CountChunkVoices(chunk, &busy);
+    SDLTest_AssertCheck(count == want_count, "Got %d voices, want %d", count, want_count);
+    SDLTest_AssertCheck(busy == want_busy, "Got %d busy voices, want %d", busy, want_busy);
+    return (count == want_count && busy == want_busy);
+}
+
+static int voices_reuse(void *arg)
+{
+    int round;
+
+    (void)arg;
+    SDLTest_AssertCheck(chunk != NULL, "The compressed chunk is loaded");
+    if (!chunk) {
+        return TEST_ABORTED;
+    }
+
+    /* The decoder which has checked the data waits in the pool */
+    check_voices(1, 0);
+
+    for (round = 0; round < 3; ++round) {
+        int played = play_on_channels();
+        SDLTest_AssertCheck(played == TEST_CHANNELS, "Played on %d channels, want %d", played, TEST_CHANNELS);
+        /* A decoder per channel, the idle ones are taken first */
+        check_voices(TEST_CHANNELS, TEST_CHANNELS);
+        SDLTest_AssertCheck(Mix_Playing(-1) == TEST_CHANNELS, "%d channels are playing", Mix_Playing(-1));
+
+        /* Let the mixer decode them for a while */
+        SDL_Delay(50);
+
+        Mix_HaltChannel(-1);
+        SDLTest_AssertCheck(Mix_Playing(-1) == 0, "No channels are playing after the halt");
+        /* Back to the pool, nothing new gets created at the next round */
+        check_voices(TEST_CHANNELS, 0);
+    }
+
+    /* Restarting a playing channel hands its decoder back first */
+    SDLTest_AssertCheck(Mix_PlayChannel(0, chunk, -1) == 0, "Played on the channel 0");
+    SDLTest_AssertCheck(Mix_PlayChannel(0, chunk, -1) == 0, "Played on the channel 0 again");
+    check_voices(TEST_CHANNELS, 1);
+    Mix_HaltChannel(0);
+    check_voices(TEST_CHANNELS, 0);
+
+    return TEST_COMPLETED;
+}
+
+static const SDLTest_TestCaseReference reuseTest =
+        { (SDLTest_TestCaseFp)voices_reuse, "voices_reuse",  "Plays a compressed chunk on several channels at once", TEST_ENABLED };
+
+static const SDLTest_TestCaseReference *chunkVoicesTests[] =  {
+    &reuseTest,
+    NULL
+};
+
+/* Compressed chunk voices test suite (global) */
+SDLTest_TestSuiteReference chunkVoicesTestSuite = {
+    "chunk_voices",
+    (SDLTest_TestCaseSetUpFp)voices_setup,
+    chunkVoicesTests,
+    (SDLTest_TestCaseTearDownFp)voices_teardown
+};
+
+
+/* All test suites */
+SDLTest_TestSuiteReference *testSuites[] =  {
+    &chunkVoicesTestSuite,
+    NULL
+};
+
+/* Call this instead of exit(), so we can clean up SDL: atexit() is evil. */
+static void quit(int rc)
+{
+    exit(rc);
+}
+
+int
+main(int argc, char *argv[])
+{
+    int result;
+
+    (void)argc;
+    (void)argv;
+
+    /* Call Harness */
+    result = SDLTest_RunSuites(testSuites, NULL, 0, NULL, 1);
+
+    /* Shutdown everything */
+    quit(result);
+    return(result);
+}
@@ -0,0 +1,339 @@
+#include "SDL_test.h"
+
+#include <vector>
+#include <map>
+#include <cstring>
+
+#include "midi_seq/midi_sequencer_impl.hpp"
+
+/* Synthesizer model: the channel state which the seek must restore */
+struct ModelChannel
+{
+    int controllers[128];
+    int program, bankMsb, bankLsb;
+    int bend, afterTouch;
+    int paramMsb, paramLsb;
+    bool nrpn;
+    std::map<int, int> params; /* (NRPN flag | MSB | LSB) * 2 + data part -> value */
+};
+
+struct Model
+{
+    ModelChannel channels[16];
+
+    void resetChannel(ModelChannel &ch)
+    {
+        std::memset(ch.controllers, 0, sizeof(ch.controllers));
+        ch.controllers[7] = 100;
+        ch.controllers[10] = 64;
+        ch.controllers[11] = 127;
+        ch.program = ch.bankMsb = ch.bankLsb = 0;
+        ch.bend = 8192;
+        ch.afterTouch = 0;
+        ch.paramMsb = ch.paramLsb = 0;
+        ch.nrpn = false;
+        ch.params.clear();
+    }
+
+    Model()
+    {
+        for(int c = 0; c < 16; ++c)
+            resetChannel(channels[c]);
+    }
+};
+
+static Model *s_model = NULL;
+
+static void modelNoteOn(void *, uint8_t, uint8_t, uint8_t) {}
+static void modelNoteOff(void *, uint8_t, uint8_t) {}
+static void modelNoteAfterTouch(void *, uint8_t, uint8_t, uint8_t) {}
+
+static void modelChannelAfterTouch(void *, uint8_t channel, uint8_t atVal)
+{
+    s_model->channels[channel & 15].afterTouch = atVal;
+}
+
+static void modelControllerChange(void *, uint8_t channel, uint8_t type, uint8_t value)
+{
+    ModelChannel &ch = s_model->channels[channel & 15];
+    int key = ((ch.nrpn ? 0x10000 : 0) | (ch.paramMsb << 8) | ch.paramLsb) * 2;
+
+    switch(type)
+    {
+    case 6:
+        ch.params[key] = value;
+        break;
+    case 38:
+        ch.params[key + 1] = value;
+        break;
+    case 98: case 100:
+        ch.paramLsb = value;
+        ch.nrpn = (type == 98);
+        break;
+    case 99: case 101:
+        ch.paramMsb = value;
+        ch.nrpn = (type == 99);
+        break;
+    case 121: /* Like ADLMIDI, also resets the volume and the pitch bend range */
+        ch.controllers[1] = 0;
+        ch.controllers[7] = 100;
+        ch.params.erase(0);
+        ch.params.erase(1);
+        ch.controllers[11] = 127;
+        ch.controllers[64] = ch.controllers[65] = ch.controllers[66] = ch.controllers[67] = 0;
+        ch.bend = 8192;
+        ch.afterTouch = 0;
+        ch.paramMsb = ch.paramLsb = 0;
+        ch.nrpn = false;
+        break;
+    default:
+        ch.controllers[type] = value;
+        break;
+    }
+}
+
+static void modelPatchChange(void *, uint8_t channel, uint8_t patch)
+{
+    ModelChannel &ch = s_model->channels[channel & 15];
+    ch.program = patch;
+    ch.bankMsb = ch.controllers[0];
+    ch.bankLsb = ch.controllers[32];
+}
+
+static void modelPitchBend(void *, uint8_t channel, uint8_t msb, uint8_t lsb)
+{
+    s_model->channels[channel & 15].bend = (msb << 7) | lsb;
+}
+
+static void modelSysEx(void *, const uint8_t *msg, size_t size)
+{
+    static const uint8_t gmReset[] = {0x7E, 0x7F, 0x09, 0x01};
+    for(size_t i = 0; i + sizeof(gmReset) <= size; ++i)
+    {
+        if(std::memcmp(msg + i, gmReset, sizeof(gmReset)) == 0)
+        {
+            for(int c = 0; c < 16; ++c)
+                s_model->resetChannel(s_model->channels[c]);
+            return;
+        }
+    }
+}
+
+static void modelMeta(void *, uint8_t, const uint8_t *, size_t) {}
+
+/* Simple format 0 MIDI file writer */
+class SongWriter
+{
+    std::vector<uint8_t> m_track;
+    void delta(uint32_t ticks)
+    {
+        uint8_t buf[4];
+        int n = 0;
+        buf[n++] = ticks & 0x7F;
+        while((ticks >>= 7) != 0)
+            buf[n++] = 0x80 | (ticks & 0x7F);
+        while(n > 0)
+            m_track.push_back(buf[--n]);
+    }
+public:
+    void event(uint32_t ticks, uint8_t status, uint8_t d0, uint8_t d1)
+    {
+        delta(ticks);
+        m_track.push_back(status);
+        m_track.push_back(d0);
+        if((status & 0xE0) != 0xC0)
+            m_track.push_back(d1);
+    }
+    void cc(uint32_t ticks, uint8_t ch, uint8_t type, uint8_t value)
+    {
+        event(ticks, 0xB0 | ch, type, value);
+    }
+    void gmReset(uint32_t ticks)
+    {
+        static const uint8_t msg[] = {0xF0, 0x05, 0x7E, 0x7F, 0x09, 0x01, 0xF7};
+        delta(ticks);
+        m_track.insert(m_track.end(), msg, msg + sizeof(msg));
+    }
+    void notes(int rows, uint8_t ch)
+    {
+        for(int i = 0; i < rows; ++i)
+        {
+            event(i ? 24 : 0, 0x90 | ch, 60 + (i % 12), 100);
+            event(24, 0x80 | ch, 60 + (i % 12), 0);
+        }
+    }
+    std::vector<uint8_t> file()
+    {
+        static const uint8_t header[] = {'M','T','h','d', 0,0,0,6, 0,0, 0,1, 0,96, 'M','T','r','k'};
+        static const uint8_t end[] = {0x00, 0xFF, 0x2F, 0x00};
+        std::vector<uint8_t> f(header, header + sizeof(header));
+        uint32_t size = (uint32_t)m_track.size() + sizeof(end);
+        f.push_back((size >> 24) & 0xFF);
+        f.push_back((size >> 16) & 0xFF);
+        f.push_back((size >> 8) & 0xFF);
+        f.push_back(size & 0xFF);
+        f.insert(f.end(), m_track.begin(), m_track.end());
+        f.insert(f.end(), end, end + sizeof(end));
+        return f;
+    }
+};
+
+static void initInterface(BW_MidiRtInterface &iface)
+{
+    std::memset(&iface, 0, sizeof(iface));
+    iface.rt_noteOn = modelNoteOn;
+    iface.rt_noteOff = modelNoteOff;
+    iface.rt_noteAfterTouch = modelNoteAfterTouch;
+    iface.rt_channelAfterTouch = modelChannelAfterTouch;
+    iface.rt_controllerChange = modelControllerChange;
+    iface.rt_patchChange = modelPatchChange;
+    iface.rt_pitchBend = modelPitchBend;
+    iface.rt_systemExclusive = modelSysEx;
+    iface.rt_metaEvent = modelMeta;
+}
+
+/* Registered parameters must match exactly, the restore must never add the other ones */
+static bool sameChannel(const ModelChannel &played, const ModelChannel &seeked)
+{
+    std::map<int, int>::const_iterator it;
+
+    if(std::memcmp(played.controllers, seeked.controllers, sizeof(played.controllers)) != 0 ||
+       played.program != seeked.program || played.bankMsb != seeked.bankMsb ||
+       played.bankLsb != seeked.bankLsb || played.bend != seeked.bend ||
+       played.afterTouch != seeked.afterTouch || played.nrpn != seeked.nrpn ||
+       played.paramMsb != seeked.paramMsb || played.paramLsb != seeked.paramLsb)
+        return false;
+
+    for(it = played.params.begin(); it != played.params.end(); ++it)
+    {
+        if(it->first < 6 * 2 && (seeked.params.find(it->first) == seeked.params.end() ||
+                                 seeked.params.find(it->first)->second != it->second))
+            return false;
+    }
+    for(it = seeked.params.begin(); it != seeked.params.end(); ++it)
+    {
+        if(played.params.find(it->first) == played.params.end() ||
+           played.params.find(it->first)->second != it->second)
+            return false;
+    }
+    return true;
+}
+
+/* Compare the state after seeking with the state after playing up to the same time */
+static void verify_seeks(const std::vector<uint8_t> &song, const double *times, int count)
+{
+    BW_MidiRtInterface iface;
+    BW_MidiSequencer seeker;
+
+    initInterface(iface);
+    seeker.setInterface(&iface);
+    SDLTest_AssertCheck(seeker.loadMIDI(&song[0], song.size()), "Check that the song is loaded");
+
+    for(int i = 0; i < count; ++i)
+    {
+        BW_MidiSequencer player;
+        Model played, seeked;
+        int mismatches = 0;
+
+        s_model = &played;
+        player.setInterface(&iface);
+        player.loadMIDI(&song[0], song.size());
+        while(player.tell() < times[i] && !player.positionAtEnd())
+            player.Tick(0.001, 0.001);
+
+        s_model = &seeked;
+        seeker.seek(times[i], 0.001);
+
+        for(int c = 0; c < 16; ++c)
+        {
+            if(!sameChannel(played.channels[c], seeked.channels[c]))
+                ++mismatches;
+        }
+        SDLTest_AssertCheck(mismatches == 0, "Check that seeking to %.3f restores the played state (%d channels differ)",
+                            times[i], mismatches);
+    }
+    s_model = NULL;
+}
+
+static void song_prologue(SongWriter &w, uint8_t ch)
+{
+    w.cc(0, ch, 0, 3);
+    w.cc(0, ch, 32, 2);
+    w.event(0, 0xC0 | ch, 7, 0);
+    w.cc(0, ch, 7, 50);
+    w.cc(0, ch, 101, 0);
+    w.cc(0, ch, 100, 0);
+    w.cc(0, ch, 6, 12);
+    w.cc(0, ch, 99, 1);
+    w.cc(0, ch, 98, 8);
+    w.event(0, 0xE0 | ch, 0x10, 0x50);
+}
+
+static int seek_reset(void *arg)
+{
+    static const double times[] = {10.0625, 140.0625, 160.0625, 290.0625, 295.0625};
+    SongWriter w;
+
+    (void)arg;
+    song_prologue(w, 0);
+    w.notes(600, 0);
+    w.gmReset(24);
+    w.cc(0, 1, 7, 90);
+    w.notes(600, 0);
+
+    verify_seeks(w.file(), times, SDL_arraysize(times));
+    return TEST_COMPLETED;
+}
+
+static int seek_parameters(void *arg)
+{
+    static const double times[] = {70.0625, 150.0625, 220.0625};
+    SongWriter w;
+
+    (void)arg;
+    song_prologue(w, 0);
+    w.notes(300, 0);
+    /* Switch a half of the selection only, the data goes to RPN 0x0008 */
+    w.cc(24, 0, 101, 0);
+    w.cc(0, 0, 100, 1);
+    w.cc(0, 0, 6, 70);
+    w.cc(0, 0, 38, 5);
+    w.cc(0, 0, 121, 0);
+    w.cc(0, 0, 99, 1);
+    w.notes(300, 0);
+    w.cc(24, 0, 6, 64);
+    w.notes(300, 0);
+
+    verify_seeks(w.file(), times, SDL_arraysize(times));
+    return TEST_COMPLETED;
+}
+
+static const SDLTest_TestCaseReference resetTest =
+        { (SDLTest_TestCaseFp)seek_reset, "seek_reset",  "Tests seeking the song with the mid-song GM reset", TEST_ENABLED };
+static const SDLTest_TestCaseReference parametersTest =
+        { (SDLTest_TestCaseFp)seek_parameters, "seek_parameters",  "Tests seeking the song with the parameter selections", TEST_ENABLED };
+
+static const SDLTest_TestCaseReference *midiSeekTests[] =  {
+    &resetTest,
+    &parametersTest,
+    NULL
+};
+
+static SDLTest_TestSuiteReference midiSeekTestSuite = {
+    "MIDI Seek",
+    NULL,
+    midiSeekTests,
+    NULL
+};
+
+static SDLTest_TestSuiteReference *testSuites[] =  {
+    &midiSeekTestSuite,
+    NULL
+};
+
+int main(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+    return SDLTest_RunSuites(testSuites, NULL, 0, NULL, 1);
+}
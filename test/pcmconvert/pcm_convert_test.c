@@ -0,0 +1,407 @@
+#include "SDL_test.h"
+
+#include "pcm_convert.h"
+
+/* Odd on purpose, so the tails of the vectorized loops get tested too */
+#define TEST_SAMPLES    4099
+#define BENCH_SAMPLES   65536
+#define BENCH_PASSES    200
+
+/* Sample-by-sample references of the converters */
+static Sint16 ref_ulaw(Uint8 u_val)
+{
+    Uint8 nibble = ~u_val;
+    Sint16 mantissa = nibble & 0xf;
+    Uint8 exponent = (nibble >> 4) & 0x7;
+    Sint16 step = (Sint16)(4 << (exponent + 1));
+
+    mantissa = (Sint16)(0x80 << exponent) + step * mantissa + step / 2 - 132;
+
+    return nibble & 0x80 ? -mantissa : mantissa;
+}
+
+static Sint16 ref_alaw(Uint8 a_val)
+{
+    Uint8 nibble = a_val;
+    Uint8 exponent = (nibble & 0x7f) ^ 0x55;
+    Sint16 mantissa = exponent & 0xf;
+
+    exponent >>= 4;
+    if (exponent > 0) {
+        mantissa |= 0x10;
+    }
+    mantissa = (Sint16)(mantissa << 4) | 0x8;
+    if (exponent > 1) {
+        mantissa <<= exponent - 1;
+    }
+
+    return nibble & 0x80 ? mantissa : -mantissa;
+}
+
+static Sint32 ref_s24(const Uint8 *x, SDL_bool big_endian)
+{
+    Uint32 in = big_endian ?
+                (((Uint32)x[0] << 24) | ((Uint32)x[1] << 16) | ((Uint32)x[2] << 8)) :
+                (((Uint32)x[2] << 24) | ((Uint32)x[1] << 16) | ((Uint32)x[0] << 8));
+    return (Sint32)in;
+}
+
+static float ref_f64(const Uint8 *x, SDL_bool big_endian)
+{
+    union
+    {
+        double f;
+        Uint64 ui64;
+    } sample;
+    SDL_memcpy(&sample.ui64, x, 8);
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+    if (big_endian) {
+#else
+    if (!big_endian) {
+#endif
+        sample.ui64 = SDL_Swap64(sample.ui64);
+    }
+    return (float)sample.f;
+}
+
+static void fill_random(Uint8 *data, int size)
+{
+    int i;
+    for (i = 0; i < size; ++i) {
+        data[i] = (Uint8)SDLTest_RandomUint8();
+    }
+}
+
+static void fill_doubles(Uint8 *data, int samples, SDL_bool big_endian)
+{
+    int i;
+    for (i = 0; i < samples; ++i) {
+        union
+        {
+            double f;
+            Uint64 ui64;
+        } sample;
+        sample.f = SDLTest_RandomUnitDouble() * 2.0 - 1.0;
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+        if (big_endian) {
+#else
+        if (!big_endian) {
+#endif
+            sample.ui64 = SDL_Swap64(sample.ui64);
+        }
+        SDL_memcpy(data + i * 8, &sample.ui64, 8);
+    }
+}
+
+static int convert_xlaw(void *arg)
+{
+    Uint8 *buffer = (Uint8 *)SDL_malloc(TEST_SAMPLES * 2);
+    Uint8 *input = buffer + TEST_SAMPLES;
+    Uint8 *copy = (Uint8 *)SDL_malloc(TEST_SAMPLES);
+    Sint16 *output = (Sint16 *)buffer;
+    int i, mismatches;
+    (void)arg;
+
+    SDLTest_AssertCheck(buffer && copy, "Check that buffers are allocated");
+    if (!buffer || !copy) {
+        SDL_free(buffer);
+        SDL_free(copy);
+        return TEST_ABORTED;
+    }
+
+    /* Every code first, then a random noise, all converted in place */
+    for (i = 0; i < TEST_SAMPLES; ++i) {
+        copy[i] = (Uint8)(i < 256 ? i : SDLTest_RandomUint8());
+    }
+
+    SDL_memcpy(input, copy, TEST_SAMPLES);
+    pcm_ulaw_to_s16(output, input, TEST_SAMPLES);
+    for (i = 0, mismatches = 0; i < TEST_SAMPLES; ++i) {
+        mismatches += (output[i] != ref_ulaw(copy[i]));
+    }
+    SDLTest_AssertCheck(mismatches == 0, "Check that u-law samples are decoded (%d mismatches)", mismatches);
+
+    SDL_memcpy(input, copy, TEST_SAMPLES);
+    pcm_alaw_to_s16(output, input, TEST_SAMPLES);
+    for (i = 0, mismatches = 0; i < TEST_SAMPLES; ++i) {
+        mismatches += (output[i] != ref_alaw(copy[i]));
+    }
+    SDLTest_AssertCheck(mismatches == 0, "Check that A-law samples are decoded (%d mismatches)", mismatches);
+
+    SDL_free(buffer);
+    SDL_free(copy);
+    return TEST_COMPLETED;
+}
+
+static int convert_s24(void *arg)
+{
+    Uint8 *buffer = (Uint8 *)SDL_malloc(TEST_SAMPLES * 4);
+    Uint8 *input = buffer + TEST_SAMPLES;
+    Uint8 *copy = (Uint8 *)SDL_malloc(TEST_SAMPLES * 3);
+    Sint32 *output = (Sint32 *)buffer;
+    int i, mismatches, order;
+    (void)arg;
+
+    SDLTest_AssertCheck(buffer && copy, "Check that buffers are allocated");
+    if (!buffer || !copy) {
+        SDL_free(buffer);
+        SDL_free(copy);
+        return TEST_ABORTED;
+    }
+
+    fill_random(copy, TEST_SAMPLES * 3);
+
+    for (order = 0; order < 2; ++order) {
+        const SDL_bool big_endian = order ? SDL_TRUE : SDL_FALSE;
+        SDL_memcpy(input, copy, TEST_SAMPLES * 3);
+        pcm_s24_to_s32(buffer, input, TEST_SAMPLES, big_endian);
+        for (i = 0, mismatches = 0; i < TEST_SAMPLES; ++i) {
+            Sint32 value = big_endian ? (Sint32)SDL_SwapBE32((Uint32)output[i]) : (Sint32)SDL_SwapLE32((Uint32)output[i]);
+            mismatches += (value != ref_s24(copy + i * 3, big_endian));
+        }
+        SDLTest_AssertCheck(mismatches == 0, "Check that 24-bit %s samples are converted (%d mismatches)",
+                            big_endian ? "big-endian" : "little-endian", mismatches);
+    }
+
+    SDL_free(buffer);
+    SDL_free(copy);
+    return TEST_COMPLETED;
+}
+
+/* Known samples, checks the byte order of the output itself */
+static int convert_s24_order(void *arg)
+{
+    /* Enough samples for the vectorized loop and its tail */
+    enum { ORDER_SAMPLES = 9 };
+    Uint8 input[ORDER_SAMPLES * 3];
+    Uint8 output[ORDER_SAMPLES * 4];
+    Uint32 first;
+    int i, order, mismatches;
+    (void)arg;
+
+    for (order = 0; order < 2; ++order) {
+        const SDL_bool big_endian = order ? SDL_TRUE : SDL_FALSE;
+
+        /* Samples 0x1234n6 and 0xF0CDnF, n is the sample number */
+        for (i = 0; i < ORDER_SAMPLES; ++i) {
+            const Uint8 hi = (i & 1) ? 0xF0 : 0x12;
+            const Uint8 mid = (i & 1) ? 0xCD : 0x34;
+            const Uint8 lo = (Uint8)(((i & 1) ? 0x0F : 0x06) | (i << 4));
+            input[i * 3 + 0] = big_endian ? hi : lo;
+            input[i * 3 + 1] = mid;
+            input[i * 3 + 2] = big_endian ? lo : hi;
+        }
+
+        pcm_s24_to_s32(output, input, ORDER_SAMPLES, big_endian);
+
+        /* AUDIO_S32MSB from big-endian input, AUDIO_S32LSB from little-endian one */
+        for (i = 0, mismatches = 0; i < ORDER_SAMPLES; ++i) {
+            const Uint8 *in = input + i * 3;
+            const Uint8 *out = output + i * 4;
+            if (big_endian) {
+                mismatches += (out[0] != in[0] || out[1] != in[1] || out[2] != in[2] || out[3] != 0);
+            } else {
+                mismatches += (out[0] != 0 || out[1] != in[0] || out[2] != in[1] || out[3] != in[2]);
+            }
+        }
+        SDLTest_AssertCheck(mismatches == 0, "Check that 24-bit %s samples keep the input byte order (%d mismatches)",
+                            big_endian ? "big-endian" : "little-endian", mismatches);
+    }
+
+    /* The first big-endian sample 0x123406 read back as AUDIO_S32MSB */
+    SDL_memcpy(&first, output, 4);
+    SDLTest_AssertCheck((Sint32)SDL_SwapBE32(first) == 0x12340600,
+                        "Check the value of the first big-endian sample");
+
+    return TEST_COMPLETED;
+}
+
+static int convert_f64(void *arg)
+{
+    Uint8 *buffer = (Uint8 *)SDL_malloc(TEST_SAMPLES * 8);
+    Uint8 *copy = (Uint8 *)SDL_malloc(TEST_SAMPLES * 8);
+    float *output = (float *)buffer;
+    int i, mismatches, order;
+    (void)arg;
+
+    SDLTest_AssertCheck(buffer && copy, "Check that buffers are allocated");
+    if (!buffer || !copy) {
+        SDL_free(buffer);
+        SDL_free(copy);
+        return TEST_ABORTED;
+    }
+
+    for (order = 0; order < 2; ++order) {
+        const SDL_bool big_endian = order ? SDL_TRUE : SDL_FALSE;
+        fill_doubles(copy, TEST_SAMPLES, big_endian);
+        SDL_memcpy(buffer, copy, TEST_SAMPLES * 8);
+        pcm_f64_to_f32(output, buffer, TEST_SAMPLES, big_endian);
+        for (i = 0, mismatches = 0; i < TEST_SAMPLES; ++i) {
+            mismatches += (output[i] != ref_f64(copy + i * 8, big_endian));
+        }
+        SDLTest_AssertCheck(mismatches == 0, "Check that 64-bit %s floats are converted (%d mismatches)",
+                            big_endian ? "big-endian" : "little-endian", mismatches);
+    }
+
+    SDL_free(buffer);
+    SDL_free(copy);
+    return TEST_COMPLETED;
+}
+
+/* Prints the time of the converters against the sample-by-sample references */
+static double bench_seconds(Uint64 begin)
+{
+    return (double)(SDL_GetPerformanceCounter() - begin) / (double)SDL_GetPerformanceFrequency();
+}
+
+static int convert_benchmark(void *arg)
+{
+    Uint8 *input = (Uint8 *)SDL_malloc(BENCH_SAMPLES * 8);
+    Uint8 *output = (Uint8 *)SDL_malloc(BENCH_SAMPLES * 4);
+    volatile Sint32 sink = 0;
+    double ref_time, time;
+    Uint64 begin;
+    int i, pass;
+    (void)arg;
+
+    SDLTest_AssertCheck(input && output, "Check that buffers are allocated");
+    if (!input || !output) {
+        SDL_free(input);
+        SDL_free(output);
+        return TEST_ABORTED;
+    }
+
+    fill_random(input, BENCH_SAMPLES * 3);
+
+    begin = SDL_GetPerformanceCounter();
+    for (pass = 0; pass < BENCH_PASSES; ++pass) {
+        for (i = 0; i < BENCH_SAMPLES; ++i) {
+            ((Sint16 *)output)[i] = ref_ulaw(input[i]);
+        }
+        sink += ((Sint16 *)output)[pass];
+    }
+    ref_time = bench_seconds(begin);
+    begin = SDL_GetPerformanceCounter();
+    for (pass = 0; pass < BENCH_PASSES; ++pass) {
+        pcm_ulaw_to_s16((Sint16 *)output, input, BENCH_SAMPLES);
+        sink += ((Sint16 *)output)[pass];
+    }
+    time = bench_seconds(begin);
+    SDLTest_Log("u-law: %.3f ms per pass, %.3f ms by reference (x%.2f)",
+                time * 1000.0 / BENCH_PASSES, ref_time * 1000.0 / BENCH_PASSES, ref_time / time);
+
+    begin = SDL_GetPerformanceCounter();
+    for (pass = 0; pass < BENCH_PASSES; ++pass) {
+        for (i = 0; i < BENCH_SAMPLES; ++i) {
+            ((Sint16 *)output)[i] = ref_alaw(input[i]);
+        }
+        sink += ((Sint16 *)output)[pass];
+    }
+    ref_time = bench_seconds(begin);
+    begin = SDL_GetPerformanceCounter();
+    for (pass = 0; pass < BENCH_PASSES; ++pass) {
+        pcm_alaw_to_s16((Sint16 *)output, input, BENCH_SAMPLES);
+        sink += ((Sint16 *)output)[pass];
+    }
+    time = bench_seconds(begin);
+    SDLTest_Log("A-law: %.3f ms per pass, %.3f ms by reference (x%.2f)",
+                time * 1000.0 / BENCH_PASSES, ref_time * 1000.0 / BENCH_PASSES, ref_time / time);
+
+    begin = SDL_GetPerformanceCounter();
+    for (pass = 0; pass < BENCH_PASSES; ++pass) {
+        for (i = 0; i < BENCH_SAMPLES; ++i) {
+            ((Sint32 *)output)[i] = ref_s24(input + i * 3, SDL_FALSE);
+        }
+        sink += ((Sint32 *)output)[pass];
+    }
+    ref_time = bench_seconds(begin);
+    begin = SDL_GetPerformanceCounter();
+    for (pass = 0; pass < BENCH_PASSES; ++pass) {
+        pcm_s24_to_s32(output, input, BENCH_SAMPLES, SDL_FALSE);
+        sink += ((Sint32 *)output)[pass];
+    }
+    time = bench_seconds(begin);
+    SDLTest_Log("24-bit: %.3f ms per pass, %.3f ms by reference (x%.2f)",
+                time * 1000.0 / BENCH_PASSES, ref_time * 1000.0 / BENCH_PASSES, ref_time / time);
+
+    fill_doubles(input, BENCH_SAMPLES, SDL_TRUE);
+    begin = SDL_GetPerformanceCounter();
+    for (pass = 0; pass < BENCH_PASSES; ++pass) {
+        for (i = 0; i < BENCH_SAMPLES; ++i) {
+            ((float *)output)[i] = ref_f64(input + i * 8, SDL_TRUE);
+        }
+        sink += (Sint32)((float *)output)[pass];
+    }
+    ref_time = bench_seconds(begin);
+    begin = SDL_GetPerformanceCounter();
+    for (pass = 0; pass < BENCH_PASSES; ++pass) {
+        pcm_f64_to_f32((float *)output, input, BENCH_SAMPLES, SDL_TRUE);
+        sink += (Sint32)((float *)output)[pass];
+    }
+    time = bench_seconds(begin);
+    SDLTest_Log("64-bit float: %.3f ms per pass, %.3f ms by reference (x%.2f)",
+                time * 1000.0 / BENCH_PASSES, ref_time * 1000.0 / BENCH_PASSES, ref_time / time);
+
+    SDL_free(input);
+    SDL_free(output);
+    return TEST_COMPLETED;
+}
+
+static const SDLTest_TestCaseReference xlawTest =
+        { (SDLTest_TestCaseFp)convert_xlaw, "convert_xlaw",  "Tests G.711 u-law and A-law decoding", TEST_ENABLED };
+static const SDLTest_TestCaseReference s24Test =
+        { (SDLTest_TestCaseFp)convert_s24, "convert_s24",  "Tests 24-bit into 32-bit conversion", TEST_ENABLED };
+static const SDLTest_TestCaseReference s24OrderTest =
+        { (SDLTest_TestCaseFp)convert_s24_order, "convert_s24_order",  "Tests the byte order of 24-bit conversion", TEST_ENABLED };
+static const SDLTest_TestCaseReference f64Test =
+        { (SDLTest_TestCaseFp)convert_f64, "convert_f64",  "Tests 64-bit into 32-bit float conversion", TEST_ENABLED };
+/* Too slow for every test run, use the --bench argument to run it */
+static const SDLTest_TestCaseReference benchTest =
+        { (SDLTest_TestCaseFp)convert_benchmark, "convert_benchmark",  "Measures converters against references", TEST_DISABLED };
+
+static const SDLTest_TestCaseReference *pcmConvertTests[] =  {
+    &xlawTest, &s24Test, &s24OrderTest, &f64Test, &benchTest,
+    NULL
+};
+
+/* PCM converters test suite (global) */
+SDLTest_TestSuiteReference pcmConvertTestSuite = {
+    "pcm_convert",
+    NULL,
+    pcmConvertTests,
+    NULL
+};
+
+
+/* All test suites */
+SDLTest_TestSuiteReference *testSuites[] =  {
+    &pcmConvertTestSuite,
+    NULL
+};
+
+/* Call this instead of exit(), so we can clean up SDL: atexit() is evil. */
+static void quit(int rc)
+{
+    exit(rc);
+}
+
+int
+main(int argc, char *argv[])
+{
+    int result, i;
+    const char *filter = NULL;
+
+    for (i = 1; i < argc; ++i) {
+        if (SDL_strcmp(argv[i], "--bench") == 0) {
+            /* The filter forces the disabled test to run */
+            filter = "convert_benchmark";
+        }
+    }
+
+    /* Call Harness */
+    result = SDLTest_RunSuites(testSuites, NULL, 0, filter, 1);
+
+    /* Shutdown everything */
+    quit(result);
+    return(result);
+}